@@ -0,0 +1,530 @@
+/******************************************************************************
+ * File Name: spi_flash_bench.c
+ *
+ * Description: Host benchmark of the driver against the simulated PMG1
+ *                           peripherals and flash. Runs sequential and random reads, page
+ *                           writes, erase ranges and a mixed workload through
+ *                           spi_eeprom_submit and reports throughput, operation rate, latency
+ *                           percentiles, interrupts and bus occupancy per workload, as a
+ *                           table or as JSON lines to keep as a baseline.
+ *
+ * Related Document: See README.md
+ *
+ *******************************************************************************
+ * Copyright 2023, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+
+
+/*******************************************************************************
+ * Include header files
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim.h"
+#include "spi_eeprom_master.h"
+#include "spi_eeprom_calibration.h"
+#include "spi_eeprom_erase.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Operations of one workload at most */
+#define BENCH_MAX_OPS       (2048u)
+
+/* Page used by the clock calibration, clear of the workload areas */
+#define BENCH_CAL_PAGE      (0u)
+
+/* Areas: sequential reads, page writes and erases each have their own */
+#define BENCH_READ_ADDR     (0x100000u)
+#define BENCH_READ_SIZE     (0x100000u)
+#define BENCH_WRITE_ADDR    (0x200000u)
+#define BENCH_WRITE_SIZE    (0x80000u)
+#define BENCH_ERASE_ADDR    (0x300000u)
+#define BENCH_ERASE_SIZE    (0x100000u)
+#define BENCH_MIXED_ADDR    (0x400000u)
+
+/* Ranges of spi_eeprom_erase_range in the erase area: from the second
+ * sector to the end of each 256 KB, i.e. 7 sectors, a 32 KB block and
+ * three 64 KB blocks */
+#define BENCH_RANGE_STRIDE  (0x40000u)
+#define BENCH_RANGE_SIZE    (BENCH_RANGE_STRIDE - SPI_EEPROM_SECTOR_SIZE)
+
+/* Percent of reads in the mixed workload */
+#define BENCH_MIXED_READS   (70u)
+
+/* Upper bound for a single wait, in virtual time */
+#define WAIT_TIMEOUT_NS     (10000000000ull)
+
+/*******************************************************************************
+* Global Variables
+*******************************************************************************/
+/* Options */
+static struct
+{
+    bool json;
+    uint32_t depth;         /* Operations in flight, 1 to SPI_EEPROM_QUEUE_LEN */
+    uint32_t divider;       /* Read clock divider, 0 for calibration */
+    sim_flash_timing_t timing;
+} opt =
+{
+    .json = false,
+    .depth = 2u,
+    .divider = 0u,
+    .timing = SIM_FLASH_TIMING_TYP,
+};
+
+/* Workload in progress */
+static struct
+{
+    uint32_t ops;
+    uint32_t submitted;
+    volatile uint32_t completed;
+    uint64_t bytes;
+    bool failed;
+    uint64_t start_ns[BENCH_MAX_OPS];
+    uint64_t latency_ns[BENCH_MAX_OPS];
+} run;
+
+/* Data of reads and writes; each operation in flight has its own */
+static uint8_t buffers[SPI_EEPROM_QUEUE_LEN][SPI_EEPROM_SECTOR_SIZE];
+
+static uint32_t rand_state = 1u;
+
+/*******************************************************************************
+* Function Name: bench_rand
+********************************************************************************
+* Summary:
+*  Pseudo random number (xorshift32), the same sequence on every run.
+*
+*******************************************************************************/
+static uint32_t bench_rand(void)
+{
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    return rand_state;
+}
+
+static void fail(const char *message)
+{
+    fprintf(stderr, "FAIL: %s (error 0x%08X)\n", message, (unsigned) spi_transfer_get_error());
+    exit(EXIT_FAILURE);
+}
+
+static bool eeprom_done(void)
+{
+    return spi_eeprom_done();
+}
+
+static void wait_done(const char *what)
+{
+    if (!sim_run_until(eeprom_done, WAIT_TIMEOUT_NS) || (spi_transfer_get_error() != 0))
+    {
+        fail(what);
+    }
+}
+
+static void op_done(eeprom_dma_status_t status, cy_rslt_t error, void *ctx)
+{
+    uint32_t op = (uint32_t) (uintptr_t) ctx;
+
+    (void) error;
+    if (status != INIT_SUCCESS)
+    {
+        run.failed = true;
+    }
+    run.latency_ns[op] = sim_time_ns() - run.start_ns[op];
+    run.completed++;
+}
+
+static bool slot_free(void)
+{
+    return (run.submitted - run.completed) < opt.depth;
+}
+
+static bool all_done(void)
+{
+    return run.completed == run.submitted;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+
+    return (x > y) - (x < y);
+}
+
+/*******************************************************************************
+* Function Name: percentile_us
+********************************************************************************
+* Summary:
+*  Percentile of the sorted latencies of the workload, nearest rank.
+*
+*******************************************************************************/
+static double percentile_us(uint32_t percent)
+{
+    uint32_t rank = (run.ops * percent + 99u) / 100u;
+
+    return (double) run.latency_ns[(rank > 0u) ? (rank - 1u) : 0u] / 1000.0;
+}
+
+/*******************************************************************************
+* Function Name: op_bytes
+********************************************************************************
+* Summary:
+*  Bytes an operation moves or erases, for the MB/s of its workload.
+*
+*******************************************************************************/
+static uint32_t op_bytes(spi_eeprom_op_t op, uint32_t size)
+{
+    switch (op)
+    {
+        case SPI_EEPROM_OP_ERASE_4K:
+            return SPI_EEPROM_SECTOR_SIZE;
+        case SPI_EEPROM_OP_ERASE_32K:
+            return SPI_EEPROM_BLOCK_32K_SIZE;
+        case SPI_EEPROM_OP_ERASE_64K:
+            return SPI_EEPROM_BLOCK_64K_SIZE;
+        case SPI_EEPROM_OP_ERASE_CHIP:
+            return spi_eeprom_get_geometry(0)->size;
+        default:
+            return size;
+    }
+}
+
+/*******************************************************************************
+* Function Name: bench_begin / bench_submit / bench_end
+********************************************************************************
+* Summary:
+*  Run a workload of ops operations: keep opt.depth of them queued, each
+*  timed from its submit to its callback, then report the workload.
+*  bench_erase_range runs one spi_eeprom_erase_range at a time instead.
+*
+*******************************************************************************/
+static void bench_begin(uint32_t ops)
+{
+    memset(&run, 0, sizeof(run));
+    run.ops = ops;
+}
+
+static void bench_submit(spi_eeprom_op_t op, uint32_t addr, uint32_t size)
+{
+    uint32_t n = run.submitted;
+    uint8_t *buffer = buffers[n % SPI_EEPROM_QUEUE_LEN];
+
+    if (!sim_run_until(slot_free, WAIT_TIMEOUT_NS))
+    {
+        fail("queue slot");
+    }
+    run.start_ns[n] = sim_time_ns();
+    run.submitted++;
+    if (spi_eeprom_submit(op, addr, buffer, size, op_done, (void *) (uintptr_t) n) != STATE_UNCONFIRMED_SUCCESS)
+    {
+        fail("spi_eeprom_submit");
+    }
+    run.bytes += op_bytes(op, size);
+}
+
+static void bench_erase_range(uint32_t addr, uint32_t size, bool blank_check)
+{
+    uint32_t n = run.submitted;
+
+    if (!sim_run_until(all_done, WAIT_TIMEOUT_NS))
+    {
+        fail("erase range");
+    }
+    run.start_ns[n] = sim_time_ns();
+    run.submitted++;
+    if (spi_eeprom_erase_range(addr, size, blank_check, op_done, (void *) (uintptr_t) n) !=
+        STATE_UNCONFIRMED_SUCCESS)
+    {
+        fail("spi_eeprom_erase_range");
+    }
+    run.bytes += size;
+}
+
+static void bench_end(const char *name, uint64_t start_ns, const sim_stats_t *start)
+{
+    sim_stats_t s;
+    double elapsed_s;
+    uint32_t isr;
+    double occupancy;
+
+    if (!sim_run_until(all_done, WAIT_TIMEOUT_NS) || run.failed)
+    {
+        fail(name);
+    }
+    sim_get_stats(&s);
+    elapsed_s = (double) (sim_time_ns() - start_ns) / 1e9;
+    isr = s.isr_count - start->isr_count;
+    occupancy = (double) (s.bus_busy_ns - start->bus_busy_ns) / 1e9 / elapsed_s;
+    qsort(run.latency_ns, run.ops, sizeof(run.latency_ns[0]), compare_u64);
+
+    if (opt.json)
+    {
+        printf("{\"bench\":\"%s\",\"ops\":%u,\"bytes\":%llu,\"seconds\":%.6f,\"mb_s\":%.4f,\"ops_s\":%.1f,"
+               "\"p50_us\":%.1f,\"p99_us\":%.1f,\"max_us\":%.1f,\"isr\":%u,\"isr_per_op\":%.2f,"
+               "\"bus_occupancy\":%.4f}\n",
+               name, (unsigned) run.ops, (unsigned long long) run.bytes, elapsed_s,
+               (double) run.bytes / elapsed_s / 1e6, (double) run.ops / elapsed_s,
+               percentile_us(50u), percentile_us(99u), percentile_us(100u), (unsigned) isr,
+               (double) isr / run.ops, occupancy);
+    }
+    else
+    {
+        printf("%-16s %6u %9.3f %9.1f %10.1f %10.1f %10.1f %8u %6.1f%%\n", name, (unsigned) run.ops,
+               (double) run.bytes / elapsed_s / 1e6, (double) run.ops / elapsed_s, percentile_us(50u),
+               percentile_us(99u), percentile_us(100u), (unsigned) isr, occupancy * 100.0);
+    }
+}
+
+/*******************************************************************************
+* Function Name: bench_erase_area
+********************************************************************************
+* Summary:
+*  Erase an area before a workload that programs it, outside the timing.
+*
+*******************************************************************************/
+static void bench_erase_area(uint32_t addr, uint32_t size)
+{
+    if (spi_eeprom_erase_range(addr, size, true, NULL, NULL) != STATE_UNCONFIRMED_SUCCESS)
+    {
+        fail("spi_eeprom_erase_range");
+    }
+    while (spi_eeprom_erase_busy())
+    {
+        wait_done("erase range");
+    }
+}
+
+/*******************************************************************************
+* Function Name: bench_workloads
+********************************************************************************
+* Summary:
+*  Run each workload with its own counters.
+*
+*******************************************************************************/
+static void bench_workloads(void)
+{
+    sim_stats_t start;
+    uint64_t start_ns;
+
+#define BENCH(name, ops, body)                      \
+    do                                              \
+    {                                               \
+        bench_begin(ops);                           \
+        sim_get_stats(&start);                      \
+        start_ns = sim_time_ns();                   \
+        for (uint32_t i = 0; i < (ops); i++)        \
+        {                                           \
+            body;                                   \
+        }                                           \
+        bench_end(name, start_ns, &start);          \
+    } while (0)
+
+    BENCH("seq_read_4k", BENCH_READ_SIZE / SPI_EEPROM_SECTOR_SIZE,
+          bench_submit(SPI_EEPROM_OP_READ, BENCH_READ_ADDR + i * SPI_EEPROM_SECTOR_SIZE, SPI_EEPROM_SECTOR_SIZE));
+
+    BENCH("rand_read_256", 1024u,
+          bench_submit(SPI_EEPROM_OP_READ, (bench_rand() % EEPROM_NUM_PAGES) * EEPROM_PAGE_SIZE, EEPROM_PAGE_SIZE));
+
+    BENCH("rand_read_16", 1024u,
+          bench_submit(SPI_EEPROM_OP_READ, bench_rand() % (EEPROM_NUM_PAGES * EEPROM_PAGE_SIZE - 16u), 16u));
+
+    bench_erase_area(BENCH_WRITE_ADDR, BENCH_WRITE_SIZE);
+    BENCH("page_write", 1024u,
+          bench_submit(SPI_EEPROM_OP_WRITE, BENCH_WRITE_ADDR + i * EEPROM_PAGE_SIZE, EEPROM_PAGE_SIZE));
+
+    BENCH("erase_4k", 32u,
+          bench_submit(SPI_EEPROM_OP_ERASE_4K, BENCH_ERASE_ADDR + i * SPI_EEPROM_SECTOR_SIZE, 0));
+
+    BENCH("erase_64k", 8u,
+          bench_submit(SPI_EEPROM_OP_ERASE_64K, BENCH_ERASE_ADDR + i * SPI_EEPROM_BLOCK_64K_SIZE, 0));
+
+    BENCH("erase_range", BENCH_ERASE_SIZE / BENCH_RANGE_STRIDE,
+          bench_erase_range(BENCH_ERASE_ADDR + i * BENCH_RANGE_STRIDE + SPI_EEPROM_SECTOR_SIZE,
+                            BENCH_RANGE_SIZE, false));
+
+    /* One page programmed in every other 64 KB block, the rest blank */
+    for (uint32_t a = BENCH_ERASE_ADDR; a < (BENCH_ERASE_ADDR + BENCH_ERASE_SIZE); a += 2u * SPI_EEPROM_BLOCK_64K_SIZE)
+    {
+        spi_eeprom_write_range(a + SPI_EEPROM_BLOCK_64K_SIZE / 2u, buffers[0], EEPROM_PAGE_SIZE, NULL, NULL);
+        wait_done("write range");
+    }
+    BENCH("erase_range_chk", BENCH_ERASE_SIZE / BENCH_RANGE_STRIDE,
+          bench_erase_range(BENCH_ERASE_ADDR + i * BENCH_RANGE_STRIDE + SPI_EEPROM_SECTOR_SIZE,
+                            BENCH_RANGE_SIZE, true));
+
+    bench_erase_area(BENCH_MIXED_ADDR, BENCH_WRITE_SIZE);
+    {
+        uint32_t written = 0;
+
+        BENCH("mixed_70r_30w", 1024u,
+              if ((bench_rand() % 100u) < BENCH_MIXED_READS)
+              {
+                  bench_submit(SPI_EEPROM_OP_READ, (bench_rand() % EEPROM_NUM_PAGES) * EEPROM_PAGE_SIZE,
+                               EEPROM_PAGE_SIZE);
+              }
+              else
+              {
+                  bench_submit(SPI_EEPROM_OP_WRITE, BENCH_MIXED_ADDR + written * EEPROM_PAGE_SIZE,
+                               EEPROM_PAGE_SIZE);
+                  written++;
+              });
+    }
+#undef BENCH
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-j] [-q depth] [-d divider] [-t typ|max|spread]\n"
+            "  -j  JSON lines instead of a table\n"
+            "  -q  operations in flight, 1 to %u (default 2)\n"
+            "  -d  read clock divider (default: calibrated)\n"
+            "  -t  program and erase times of the flash model (default typ)\n",
+            prog, (unsigned) SPI_EEPROM_QUEUE_LEN);
+    exit(EXIT_FAILURE);
+}
+
+static void parse_options(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-j") == 0)
+        {
+            opt.json = true;
+        }
+        else if ((strcmp(argv[i], "-q") == 0) && ((i + 1) < argc))
+        {
+            opt.depth = (uint32_t) strtoul(argv[++i], NULL, 0);
+            if ((opt.depth == 0) || (opt.depth > SPI_EEPROM_QUEUE_LEN))
+            {
+                usage(argv[0]);
+            }
+        }
+        else if ((strcmp(argv[i], "-d") == 0) && ((i + 1) < argc))
+        {
+            opt.divider = (uint32_t) strtoul(argv[++i], NULL, 0);
+        }
+        else if ((strcmp(argv[i], "-t") == 0) && ((i + 1) < argc))
+        {
+            i++;
+            if (strcmp(argv[i], "typ") == 0)
+            {
+                opt.timing = SIM_FLASH_TIMING_TYP;
+            }
+            else if (strcmp(argv[i], "max") == 0)
+            {
+                opt.timing = SIM_FLASH_TIMING_MAX;
+            }
+            else if (strcmp(argv[i], "spread") == 0)
+            {
+                opt.timing = SIM_FLASH_TIMING_SPREAD;
+            }
+            else
+            {
+                usage(argv[0]);
+            }
+        }
+        else
+        {
+            usage(argv[0]);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    sim_flash_config_t flash_cfg;
+    uint32_t cmd_divider;
+    uint32_t read_divider;
+
+    parse_options(argc, argv);
+
+    sim_init();
+    sim_flash_default_config(&flash_cfg);
+    flash_cfg.timing = opt.timing;
+    sim_flash_detach(0u);
+    (void) sim_flash_attach(0u, &flash_cfg);
+
+    if (spi_eeprom_init() != INIT_SUCCESS)
+    {
+        fail("spi_eeprom_init");
+    }
+    __enable_irq();
+    if (spi_eeprom_probe(0) != INIT_SUCCESS)
+    {
+        fail("spi_eeprom_probe");
+    }
+    spi_eeprom_write_status_reg(false, NULL, NULL);
+    wait_done("write status");
+
+    if (opt.divider == 0)
+    {
+        if (spi_eeprom_calibrate_clock(BENCH_CAL_PAGE, &read_divider) != INIT_SUCCESS)
+        {
+            fail("spi_eeprom_calibrate_clock");
+        }
+    }
+    else
+    {
+        spi_eeprom_get_clock_divider(&cmd_divider, &read_divider);
+        if (spi_eeprom_set_clock_divider(cmd_divider, opt.divider) != INIT_SUCCESS)
+        {
+            usage(argv[0]);
+        }
+    }
+    spi_eeprom_get_clock_divider(&cmd_divider, &read_divider);
+
+    if (opt.json)
+    {
+        printf("{\"config\":{\"depth\":%u,\"read_divider\":%u,\"read_bps\":%u,\"cmd_bps\":%u,\"timing\":%u}}\n",
+               (unsigned) opt.depth, (unsigned) read_divider, (unsigned) spi_eeprom_get_data_rate(read_divider),
+               (unsigned) spi_eeprom_get_data_rate(cmd_divider), (unsigned) opt.timing);
+    }
+    else
+    {
+        printf("queue depth %u, read %u bps (divider %u), commands %u bps\n", (unsigned) opt.depth,
+               (unsigned) spi_eeprom_get_data_rate(read_divider), (unsigned) read_divider,
+               (unsigned) spi_eeprom_get_data_rate(cmd_divider));
+        printf("%-16s %6s %9s %9s %10s %10s %10s %8s %7s\n", "workload", "ops", "MB/s", "ops/s",
+               "p50 us", "p99 us", "max us", "isr", "bus");
+    }
+
+    bench_workloads();
+    return EXIT_SUCCESS;
+}
+
+/* [] END OF FILE */
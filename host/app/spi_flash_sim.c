@@ -0,0 +1,2503 @@
+/******************************************************************************
+ * File Name: spi_flash_sim.c
+ *
+ * Description: Host version of the code example. Runs the sequence of main.c
+ *              (status check, sector erase, page write, read back and
+ *              compare) against the simulated PMG1 peripherals and flash,
+ *              then measures page read and page program throughput, printing
+ *              virtual time, bus and interrupt statistics for each step.
+ *
+ * Related Document: See README.md
+ *
+ *******************************************************************************
+ * Copyright 2023, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+
+/*******************************************************************************
+ * Include header files
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include "sim.h"
+#include "spi_eeprom_master.h"
+#include "dma_master.h"
+#include "spi_eeprom_calibration.h"
+#include "spi_eeprom_cache.h"
+#include "spi_eeprom_writeback.h"
+#include "spi_eeprom_update.h"
+#include "spi_eeprom_erase.h"
+#include "spi_eeprom_kv.h"
+#include "spi_eeprom_log.h"
+#include "crc32.h"
+#include "spi_eeprom_trace.h"
+#include "spi_eeprom_stripe.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Same data set as main.c */
+#define DATA_SIZE           (200u)
+#define DATA_PAGE           (0u)
+#define RETRY_COUNT         (3u)
+
+/* Pages used by the throughput measurement (one 4 KB sector) */
+#define THROUGHPUT_PAGES    (16u)
+
+/* Training page of the clock calibration, in a sector of its own */
+#define CALIBRATION_PAGE    (3u * THROUGHPUT_PAGES)
+
+/* Part of run_calibration whose board limits SCLK between two read data
+ * rates at the command divider used, closer to the faster one than
+ * SPI_CALIBRATION_MARGIN_PCT allows */
+#define CALIBRATION_SS          (3u)
+#define CALIBRATION_CMD_DIVIDER (12u)
+#define CALIBRATION_SCLK_MAX_HZ (520000u)
+
+/* Transfers of run_calibration: the failing one breaks its chip select
+ * with late interrupts, as run_crc */
+#define CALIBRATION_GOOD_SIZE   (16u)
+#define CALIBRATION_FAIL_SIZE   (3u * EEPROM_PAGE_SIZE)
+
+/* First page of the callback chain of run_async, in a sector of its own */
+#define ASYNC_PAGE          (2u * THROUGHPUT_PAGES)
+
+/* First page of the operations of run_queue, in a sector of its own */
+#define QUEUE_PAGE          (4u * THROUGHPUT_PAGES)
+
+/* First page of run_cache, in a sector of its own */
+#define CACHE_PAGE          (5u * THROUGHPUT_PAGES)
+
+/* Pages of run_cache read repeatedly, fewer than the cache holds */
+#define CACHE_HOT_PAGES     (4u)
+
+/* First page of run_writeback, in a sector of its own */
+#define WB_PAGE             (6u * THROUGHPUT_PAGES)
+
+/* Telemetry records of run_writeback */
+#define WB_RECORD_SIZE      (24u)
+#define WB_RECORDS          (10u)
+
+/* First page of run_update, in the two sectors from there */
+#define UPDATE_PAGE         (7u * THROUGHPUT_PAGES)
+
+/* Image of run_skip, in the two sectors from there */
+#define SKIP_PAGE           (9u * THROUGHPUT_PAGES)
+#define SKIP_SIZE           (2u * SPI_EEPROM_SECTOR_SIZE)
+
+/* Store of run_kv, clear of the ranges above */
+#define KV_BASE             (0x40000u)
+#define KV_KEYS             (100u)
+#define KV_COUNTER_KEY      (7u)
+#define KV_COUNTER_UPDATES  (1500u)
+
+/* Log of run_log, one 64 KB block after the store. Records of that size
+ * fill a page exactly */
+#define LOG_BASE            (0x50000u)
+#define LOG_RECORD_SIZE     (30u)
+#define LOG_PAGE_RECORDS    ((EEPROM_PAGE_SIZE - SPI_EEPROM_LOG_PAGE_HEADER) / (LOG_RECORD_SIZE + 1u))
+#define LOG_RETRY_NS        (10000u)
+
+/* Range of run_crc, over the log written by run_log */
+#define CRC_ADDR            (LOG_BASE)
+#define CRC_SIZE            (0x8000u)
+
+/* Interrupt latency of run_crc, longer than two compare segments at 1 MHz */
+#define CRC_LATE_ISR_NS     (10000000u)
+
+/* Sector of run_verify, after the log */
+#define VERIFY_ADDR         (LOG_BASE + SPI_EEPROM_BLOCK_64K_SIZE)
+#define VERIFY_SIZE         (1000u)
+
+/* Sectors of run_trace, after the one of run_verify. Two sector erases take
+ * longer than a wrap of the 16-bit trace counter */
+#define TRACE_ADDR          (VERIFY_ADDR + SPI_EEPROM_SECTOR_SIZE)
+#define TRACE_READS         (4u)
+
+/* Range of run_devices on device 0, after the sectors of run_trace, while
+ * devices 1 and 2 get their own operations */
+#define DEVICES_ADDR        (TRACE_ADDR + 2u * SPI_EEPROM_SECTOR_SIZE)
+#define DEVICES_SIZE        (1000u)
+
+/* Striped volume of run_stripe from this address on devices 0 to 2, and
+ * its write: 48 pages, unaligned at both ends. The devices program a page
+ * in the write cycle time of a serial EEPROM, well above the page transfer */
+#define STRIPE_BASE         (0x70000u)
+#define STRIPE_DEVICES      (3u)
+#define STRIPE_OFFSET       (100u)
+#define STRIPE_SIZE         (48u * EEPROM_PAGE_SIZE - 2u * STRIPE_OFFSET)
+#define STRIPE_T_PP_US      (5000u)
+
+/* Parts of run_geometry on SS3: one known by RDID only, and one of 32 MB
+ * with 512-byte pages written above 16 MB, unaligned to its pages */
+#define GEOMETRY_SS         (3u)
+#define GEOMETRY_RDID       { 0xEFu, 0x40u, 0x17u }
+#define GEOMETRY_BIG_SIZE   (32u * 1024u * 1024u)
+#define GEOMETRY_BIG_PAGE   (512u)
+#define GEOMETRY_ADDR       (0x1200000u + 100u)
+#define GEOMETRY_SIZE       (1000u)
+
+/* Block of run_suspend erased while urgent reads of the log written by
+ * run_log are served, the first one right away, the second just after the
+ * resume. The part on SS3 does not suspend */
+#define SUSPEND_ERASE_ADDR  (0x80000u)
+#define SUSPEND_READ_ADDR   (LOG_BASE)
+#define SUSPEND_READ_SIZE   (EEPROM_PAGE_SIZE)
+#define SUSPEND_READS       (2u)
+#define SUSPEND_START_NS    (20000000u)
+#define SUSPEND_SS          (3u)
+#define SUSPEND_WRITE_PAGES (4u)
+
+/* Log-style write of run_priority after the block of run_suspend, and the
+ * critical reads of the log of run_log during it: one without deadline
+ * while pages are written, by suspend or between pages; the one with a
+ * deadline after a single page, whose transfer and program fit in it; those with the
+ * deadlines below during a sector erase, and a chain of them that a write
+ * and a read in the background sit out for SPI_EEPROM_STARVATION_LIMIT */
+#define PRIO_ADDR           (SUSPEND_ERASE_ADDR + SPI_EEPROM_BLOCK_64K_SIZE)
+#define PRIO_WRITE_PAGES    (16u)
+#define PRIO_READ_ADDR      (LOG_BASE)
+#define PRIO_READ_SIZE      (EEPROM_PAGE_SIZE)
+#define PRIO_START_NS       (2500000u)
+#define PRIO_DEADLINE_US    (5000u)
+#define PRIO_EDF_DEADLINES  { 9000u, 3000u, 6000u }
+#define PRIO_EDF_READS      (3u)
+#define PRIO_CHAIN          (20u)
+#define PRIO_SS             (3u)
+
+/* Range of run_erase: the last two sectors of the first 64 KB block, the
+ * second block, a 32 KB block and one more sector */
+#define ERASE_ADDR          (SPI_EEPROM_BLOCK_64K_SIZE - 2u * SPI_EEPROM_SECTOR_SIZE)
+#define ERASE_SIZE          (2u * SPI_EEPROM_SECTOR_SIZE + SPI_EEPROM_BLOCK_64K_SIZE + \
+                             SPI_EEPROM_BLOCK_32K_SIZE + SPI_EEPROM_SECTOR_SIZE)
+
+/* Size of each small write of run_queue */
+#define QUEUE_RECORD_SIZE   (24u)
+
+/* Upper bound for a single wait, in virtual time */
+#define WAIT_TIMEOUT_NS     (2000000000ull)
+
+/*******************************************************************************
+* Global Variables
+*******************************************************************************/
+static uint64_t step_start_ns;
+static sim_stats_t step_start_stats;
+
+/* Operations of run_async, each started from the callback of the previous */
+typedef struct
+{
+    uint32_t stage;
+    uint32_t addr;
+    uint8_t *data;
+    uint8_t *back;
+    uint32_t size;
+    eeprom_dma_status_t status;
+    cy_rslt_t error;
+    bool done;
+} async_chain_t;
+
+static async_chain_t chain;
+
+/* Completion order of the operations of run_queue */
+static struct
+{
+    uint32_t order[SPI_EEPROM_QUEUE_LEN];
+    uint32_t count;
+    bool failed;
+} queue_log;
+
+static bool eeprom_done(void)
+{
+    return spi_eeprom_done();
+}
+
+/* Busy-wait on spi_eeprom_done() as main.c does, with a virtual-time bound */
+static void wait_done(const char *what)
+{
+    if (!sim_run_until(eeprom_done, WAIT_TIMEOUT_NS))
+    {
+        printf("FAIL: timeout waiting for %s\n", what);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void step_begin(void)
+{
+    step_start_ns = sim_time_ns();
+    sim_get_stats(&step_start_stats);
+}
+
+static void step_end(const char *name)
+{
+    sim_stats_t s;
+
+    sim_get_stats(&s);
+    printf("%-28s %12.1f us %8llu bytes %6u txn %6u isr\n", name,
+           (double) (sim_time_ns() - step_start_ns) / 1000.0,
+           (unsigned long long) (s.bus_bytes - step_start_stats.bus_bytes),
+           (unsigned) (s.transactions - step_start_stats.transactions),
+           (unsigned) (s.isr_count - step_start_stats.isr_count));
+}
+
+static void check(bool ok, const char *message)
+{
+    if (!ok)
+    {
+        printf("FAIL: %s (error 0x%08X)\n", message, (unsigned) spi_transfer_get_error());
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*******************************************************************************
+* Function Name: run_example
+********************************************************************************
+* Summary:
+*  The flow of main.c: unprotect, erase, write DATA_SIZE bytes, read back and
+*  compare.
+*
+*******************************************************************************/
+static void run_example(void)
+{
+    uint8_t writeData[DATA_SIZE];
+    uint8_t readData[DATA_SIZE];
+    uint8_t EEPROM_status = 0xFF;
+    uint8_t EEPROM_status_counter = 0;
+    uint8_t data = 0;
+
+    for (uint32_t i = 0; i < DATA_SIZE; ++i)
+    {
+        if (data == 0)
+        {
+            data = 1;
+        }
+        writeData[i] = data;
+        data <<= 1;
+    }
+    memset(readData, 0, DATA_SIZE);
+
+    step_begin();
+    check(spi_eeprom_init() == INIT_SUCCESS, "spi_eeprom_init");
+    __enable_irq();
+    check(spi_eeprom_probe(0) == INIT_SUCCESS, "spi_eeprom_probe");
+    step_end("init");
+    printf("SPI clock %u bps\n", (unsigned) sim_spi_bitrate());
+
+    step_begin();
+    do
+    {
+        EEPROM_status_counter++;
+        spi_eeprom_write_status_reg(false, NULL, NULL);
+        wait_done("write status");
+        spi_eeprom_read_status_reg(&EEPROM_status, NULL, NULL);
+        wait_done("read status");
+    } while ((EEPROM_status_counter < RETRY_COUNT) && (EEPROM_status & SPI_EEPROM_PROT_ALL_BLOCKS));
+    check(EEPROM_status_counter < RETRY_COUNT, "spi_eeprom_write_status_reg");
+    step_end("unprotect");
+
+    step_begin();
+    spi_eeprom_write_enable(true, NULL, NULL);
+    wait_done("write enable");
+    spi_eeprom_4k_sector_erase(DATA_PAGE, NULL, NULL);
+    wait_done("sector erase");
+    check(spi_transfer_get_error() == 0u, "spi_eeprom_4k_sector_erase");
+    step_end("4k sector erase");
+
+    step_begin();
+    spi_eeprom_write_enable(true, NULL, NULL);
+    wait_done("write enable");
+    check(spi_eeprom_write_flash(writeData, DATA_SIZE, DATA_PAGE, NULL, NULL) == STATE_UNCONFIRMED_SUCCESS,
+          "spi_eeprom_write_flash");
+    wait_done("write");
+    step_end("page write (200 B)");
+
+    step_begin();
+    check(spi_eeprom_read_flash(readData, DATA_SIZE, DATA_PAGE, NULL, NULL) == STATE_UNCONFIRMED_SUCCESS,
+          "spi_eeprom_read_flash");
+    wait_done("read");
+    step_end("page read (200 B)");
+
+    check(memcmp(writeData, readData, DATA_SIZE) == 0, "data mismatch");
+    printf("Data matched\n");
+}
+
+/*******************************************************************************
+* Function Name: run_throughput
+********************************************************************************
+* Summary:
+*  Program and read back THROUGHPUT_PAGES full pages one call at a time, the
+*  only way the page API allows, and report the sustained rates.
+*
+*******************************************************************************/
+static void run_throughput(void)
+{
+    static uint8_t page[EEPROM_PAGE_SIZE];
+    static uint8_t back[EEPROM_PAGE_SIZE];
+    static uint8_t range[THROUGHPUT_PAGES * EEPROM_PAGE_SIZE];
+    uint32_t divider;
+    uint64_t t0;
+    double us;
+
+    for (uint32_t i = 0; i < EEPROM_PAGE_SIZE; i++)
+    {
+        page[i] = (uint8_t) (i * 7u + 3u);
+    }
+
+    spi_eeprom_write_enable(true, NULL, NULL);
+    wait_done("write enable");
+    spi_eeprom_4k_sector_erase(DATA_PAGE, NULL, NULL);
+    wait_done("sector erase");
+
+    step_begin();
+    t0 = sim_time_ns();
+    for (uint32_t p = 0; p < THROUGHPUT_PAGES; p++)
+    {
+        spi_eeprom_write_enable(true, NULL, NULL);
+        wait_done("write enable");
+        spi_eeprom_write_flash(page, EEPROM_PAGE_SIZE, DATA_PAGE + p, NULL, NULL);
+        wait_done("write");
+    }
+    us = (double) (sim_time_ns() - t0) / 1000.0;
+    step_end("page program x16");
+    printf("  program throughput: %.1f KB/s\n",
+           (double) (THROUGHPUT_PAGES * EEPROM_PAGE_SIZE) / us * 1000000.0 / 1024.0);
+
+    step_begin();
+    t0 = sim_time_ns();
+    for (uint32_t p = 0; p < THROUGHPUT_PAGES; p++)
+    {
+        spi_eeprom_read_flash(back, EEPROM_PAGE_SIZE, DATA_PAGE + p, NULL, NULL);
+        wait_done("read");
+        check(memcmp(page, back, EEPROM_PAGE_SIZE) == 0, "throughput read back");
+    }
+    us = (double) (sim_time_ns() - t0) / 1000.0;
+    step_end("page read x16");
+    printf("  read throughput:    %.1f KB/s\n",
+           (double) (THROUGHPUT_PAGES * EEPROM_PAGE_SIZE) / us * 1000000.0 / 1024.0);
+
+    step_begin();
+    t0 = sim_time_ns();
+    check(spi_eeprom_read_range(DATA_PAGE * EEPROM_PAGE_SIZE, range, sizeof(range), NULL, NULL) ==
+          STATE_UNCONFIRMED_SUCCESS, "spi_eeprom_read_range");
+    wait_done("read range");
+    us = (double) (sim_time_ns() - t0) / 1000.0;
+    for (uint32_t p = 0; p < THROUGHPUT_PAGES; p++)
+    {
+        check(memcmp(page, &range[p * EEPROM_PAGE_SIZE], EEPROM_PAGE_SIZE) == 0, "read range");
+    }
+    step_end("read range (4 KB)");
+    printf("  read throughput:    %.1f KB/s\n", (double) sizeof(range) / us * 1000000.0 / 1024.0);
+
+    /* Again with the read data rate found by calibration */
+    step_begin();
+    check(spi_eeprom_calibrate_clock(CALIBRATION_PAGE, &divider) == INIT_SUCCESS,
+          "spi_eeprom_calibrate_clock");
+    step_end("calibrate clock");
+    printf("  read divider %u: %u bps\n", (unsigned) divider, (unsigned) spi_eeprom_get_data_rate(divider));
+    memset(range, 0, sizeof(range));
+    step_begin();
+    t0 = sim_time_ns();
+    spi_eeprom_read_range(DATA_PAGE * EEPROM_PAGE_SIZE, range, sizeof(range), NULL, NULL);
+    wait_done("read range");
+    us = (double) (sim_time_ns() - t0) / 1000.0;
+    for (uint32_t p = 0; p < THROUGHPUT_PAGES; p++)
+    {
+        check(memcmp(page, &range[p * EEPROM_PAGE_SIZE], EEPROM_PAGE_SIZE) == 0, "fast read range");
+    }
+    step_end("read range (4 KB, calibrated)");
+    printf("  read throughput:    %.1f KB/s\n", (double) sizeof(range) / us * 1000000.0 / 1024.0);
+
+    /* Same data into the next sector, programmed by the interrupt-driven engine */
+    spi_eeprom_write_enable(true, NULL, NULL);
+    wait_done("write enable");
+    spi_eeprom_4k_sector_erase(DATA_PAGE + THROUGHPUT_PAGES, NULL, NULL);
+    wait_done("sector erase");
+
+    step_begin();
+    t0 = sim_time_ns();
+    check(spi_eeprom_write_range((DATA_PAGE + THROUGHPUT_PAGES) * EEPROM_PAGE_SIZE, range,
+          sizeof(range), NULL, NULL) == STATE_UNCONFIRMED_SUCCESS, "spi_eeprom_write_range");
+    wait_done("write range");
+    us = (double) (sim_time_ns() - t0) / 1000.0;
+    step_end("write range (4 KB)");
+    printf("  program throughput: %.1f KB/s\n", (double) sizeof(range) / us * 1000000.0 / 1024.0);
+
+    memset(range, 0, sizeof(range));
+    spi_eeprom_read_range((DATA_PAGE + THROUGHPUT_PAGES) * EEPROM_PAGE_SIZE, range, sizeof(range),
+                          NULL, NULL);
+    wait_done("read range");
+    for (uint32_t p = 0; p < THROUGHPUT_PAGES; p++)
+    {
+        check(memcmp(page, &range[p * EEPROM_PAGE_SIZE], EEPROM_PAGE_SIZE) == 0, "write range read back");
+    }
+}
+
+/*******************************************************************************
+* Function Name: calibration_transfer
+********************************************************************************
+* Summary:
+*  One transfer of run_calibration, failing or not, accounted by
+*  spi_eeprom_calibration_required.
+*
+*******************************************************************************/
+static bool calibration_transfer(bool fail)
+{
+    sim_cpu_config_t cpu;
+    sim_cpu_config_t late;
+
+    sim_cpu_get_config(&cpu);
+    late = cpu;
+    late.isr_latency_ns = CRC_LATE_ISR_NS;
+    if (fail)
+    {
+        sim_cpu_config(&late);
+    }
+    check(spi_eeprom_crc_range(CRC_ADDR, NULL, fail ? CALIBRATION_FAIL_SIZE : CALIBRATION_GOOD_SIZE, NULL,
+          NULL) == STATE_UNCONFIRMED_SUCCESS, "calibration transfer");
+    wait_done("calibration transfer");
+    if (fail)
+    {
+        sim_cpu_config(&cpu);
+        sim_advance_ns(CRC_LATE_ISR_NS);
+    }
+    return spi_eeprom_calibration_required();
+}
+
+/*******************************************************************************
+* Function Name: run_calibration
+********************************************************************************
+* Summary:
+*  Calibration of a part whose board limits SCLK just below a read data rate:
+*  the selected divider must keep SPI_CALIBRATION_MARGIN_PCT to the slowest
+*  failing rate, backing off from the fastest passing one. Then
+*  spi_eeprom_calibration_required over a sliding window: a failure counts
+*  once, two failures within the last SPI_CALIBRATION_ERROR_WINDOW transfers
+*  ask for calibration, two further apart do not.
+*
+*******************************************************************************/
+static void run_calibration(void)
+{
+    sim_flash_config_t cfg;
+    uint32_t cmd_div;
+    uint32_t read_div;
+    uint32_t fail_div;
+    uint32_t fail_rate;
+    uint32_t divider;
+    bool required;
+
+    spi_eeprom_get_clock_divider(&cmd_div, &read_div);
+    sim_flash_default_config(&cfg);
+    cfg.sclk_max_hz = CALIBRATION_SCLK_MAX_HZ;
+    check(sim_flash_attach(CALIBRATION_SS, &cfg), "attach part with SCLK limit");
+    spi_eeprom_set_clock_divider(CALIBRATION_CMD_DIVIDER, CALIBRATION_CMD_DIVIDER);
+    check(spi_eeprom_probe(CALIBRATION_SS) == INIT_SUCCESS, "probe part with SCLK limit");
+    spi_eeprom_set_device(CALIBRATION_SS);
+
+    step_begin();
+    check(spi_eeprom_calibrate_clock(CALIBRATION_PAGE, &divider) == INIT_SUCCESS,
+          "calibrate part with SCLK limit");
+    step_end("calibrate clock (SCLK limit)");
+    fail_div = CALIBRATION_CMD_DIVIDER;
+    while (spi_eeprom_get_data_rate(fail_div) <= CALIBRATION_SCLK_MAX_HZ)
+    {
+        fail_div--;
+    }
+    fail_rate = spi_eeprom_get_data_rate(fail_div);
+    printf("  read divider %u: %u bps, first failing %u bps\n", (unsigned) divider,
+           (unsigned) spi_eeprom_get_data_rate(divider), (unsigned) fail_rate);
+    check((uint64_t) spi_eeprom_get_data_rate(divider) * 100u <=
+          (uint64_t) fail_rate * (100u - SPI_CALIBRATION_MARGIN_PCT), "calibration margin");
+    check((divider > fail_div + 1u) && ((uint64_t) spi_eeprom_get_data_rate(divider - 1u) * 100u >
+          (uint64_t) fail_rate * (100u - SPI_CALIBRATION_MARGIN_PCT)), "fastest divider with margin");
+
+    spi_eeprom_set_device(0);
+    spi_eeprom_set_clock_divider(cmd_div, read_div);
+    sim_flash_detach(CALIBRATION_SS);
+
+    /* Failures at 60 and 70: in the window of the second one */
+    required = false;
+    for (uint32_t i = 1; i < 70u; i++)
+    {
+        required |= calibration_transfer(i == 60u);
+        if (i == 60u)
+        {
+            required |= spi_eeprom_calibration_required();
+        }
+    }
+    check(!required, "one failure in the window");
+    check(calibration_transfer(true), "two failures in the window");
+
+    /* Failures 64 transfers apart: the first has left the window */
+    required = calibration_transfer(true);
+    for (uint32_t i = 1; i < SPI_CALIBRATION_ERROR_WINDOW; i++)
+    {
+        required |= calibration_transfer(false);
+    }
+    required |= calibration_transfer(true);
+    check(!required, "failures further apart than the window");
+}
+
+/*******************************************************************************
+* Function Name: async_step
+********************************************************************************
+* Summary:
+*  Completion callback of run_async: starts the next operation of the chain
+*  from the DMA interrupt, or ends it on the last one or on an error.
+*
+*******************************************************************************/
+static void async_step(eeprom_dma_status_t status, cy_rslt_t error, void *ctx)
+{
+    async_chain_t *c = (async_chain_t *) ctx;
+
+    if (status != INIT_SUCCESS)
+    {
+        c->status = status;
+        c->error = error;
+        c->done = true;
+        return;
+    }
+
+    switch (c->stage++)
+    {
+        case 0:
+            spi_eeprom_4k_sector_erase(c->addr / EEPROM_PAGE_SIZE, async_step, c);
+            break;
+        case 1:
+            spi_eeprom_write_range(c->addr, c->data, c->size, async_step, c);
+            break;
+        case 2:
+            spi_eeprom_read_range(c->addr, c->back, c->size, async_step, c);
+            break;
+        default:
+            c->status = INIT_SUCCESS;
+            c->done = true;
+            break;
+    }
+}
+
+static bool async_done(void)
+{
+    return chain.done;
+}
+
+/*******************************************************************************
+* Function Name: run_async
+********************************************************************************
+* Summary:
+*  Write enable, erase, write and read back a sector as one chain of
+*  completion callbacks. The caller only waits for the flag set by the last
+*  callback; spi_eeprom_done is never polled.
+*
+*******************************************************************************/
+static void run_async(void)
+{
+    static uint8_t data[THROUGHPUT_PAGES * EEPROM_PAGE_SIZE];
+    static uint8_t back[THROUGHPUT_PAGES * EEPROM_PAGE_SIZE];
+
+    for (uint32_t i = 0; i < sizeof(data); i++)
+    {
+        data[i] = (uint8_t) (i ^ (i >> 8));
+    }
+
+    chain = (async_chain_t)
+    {
+        .addr = ASYNC_PAGE * EEPROM_PAGE_SIZE,
+        .data = data,
+        .back = back,
+        .size = sizeof(data),
+        .status = STATE_UNCONFIRMED_SUCCESS,
+    };
+
+    step_begin();
+    check(spi_eeprom_write_enable(true, async_step, &chain) == STATE_UNCONFIRMED_SUCCESS,
+          "spi_eeprom_write_enable");
+    if (!sim_run_until(async_done, WAIT_TIMEOUT_NS))
+    {
+        printf("FAIL: timeout waiting for callback chain\n");
+        exit(EXIT_FAILURE);
+    }
+    step_end("callback chain (4 KB)");
+    check((chain.status == INIT_SUCCESS) && (chain.stage == 4u), "callback chain status");
+    check(memcmp(data, back, sizeof(data)) == 0, "callback chain read back");
+}
+
+/*******************************************************************************
+* Function Name: queue_op_done
+********************************************************************************
+* Summary:
+*  Completion callback of run_queue: records the index passed as context.
+*
+*******************************************************************************/
+static void queue_op_done(eeprom_dma_status_t status, cy_rslt_t error, void *ctx)
+{
+    (void) error;
+
+    if ((status != INIT_SUCCESS) || (queue_log.count >= SPI_EEPROM_QUEUE_LEN))
+    {
+        queue_log.failed = true;
+        return;
+    }
+    queue_log.order[queue_log.count++] = (uint32_t) (uintptr_t) ctx;
+}
+
+static bool queue_empty(void)
+{
+    return spi_eeprom_queue_count() == 0u;
+}
+
+/* Take every entry of the operation queue with small reads */
+static void fill_queue(void)
+{
+    static uint8_t back[16];
+
+    for (uint32_t i = 0; i < SPI_EEPROM_QUEUE_LEN; i++)
+    {
+        check(spi_eeprom_submit(SPI_EEPROM_OP_READ, 0, back, sizeof(back), NULL, NULL) ==
+              STATE_UNCONFIRMED_SUCCESS, "fill queue");
+    }
+}
+
+static void wait_queue(const char *what)
+{
+    if (!sim_run_until(queue_empty, WAIT_TIMEOUT_NS))
+    {
+        printf("FAIL: timeout waiting for %s\n", what);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/* Completions of an operation that must be called back once or not at all */
+static uint32_t done_calls;
+static eeprom_dma_status_t done_status;
+
+static void count_done(eeprom_dma_status_t status, cy_rslt_t error, void *ctx)
+{
+    (void) error;
+    (void) ctx;
+    done_status = status;
+    done_calls++;
+}
+
+/*******************************************************************************
+* Function Name: run_queue
+********************************************************************************
+* Summary:
+*  Submit an erase, a burst of small writes and a read back in one go, without
+*  waiting in between. The queue must take all of them, refuse one more, run
+*  them in order from the DMA interrupt and leave the data in place. Direct
+*  calls made meanwhile must be refused without disturbing the queue.
+*
+*******************************************************************************/
+static void run_queue(void)
+{
+    static uint8_t records[SPI_EEPROM_QUEUE_LEN - 2u][QUEUE_RECORD_SIZE];
+    static uint8_t back[(SPI_EEPROM_QUEUE_LEN - 2u) * QUEUE_RECORD_SIZE];
+    static uint8_t direct[QUEUE_RECORD_SIZE];
+    const uint32_t addr = QUEUE_PAGE * EEPROM_PAGE_SIZE + EEPROM_PAGE_SIZE - QUEUE_RECORD_SIZE;
+    uint32_t n = 0;
+
+    memset(&queue_log, 0, sizeof(queue_log));
+    for (uint32_t r = 0; r < (SPI_EEPROM_QUEUE_LEN - 2u); r++)
+    {
+        for (uint32_t i = 0; i < QUEUE_RECORD_SIZE; i++)
+        {
+            records[r][i] = (uint8_t) (r * 31u + i);
+        }
+    }
+
+    step_begin();
+    check(spi_eeprom_submit(SPI_EEPROM_OP_ERASE_4K, QUEUE_PAGE * EEPROM_PAGE_SIZE, NULL, 0,
+          queue_op_done, (void *) (uintptr_t) n++) == STATE_UNCONFIRMED_SUCCESS, "submit erase");
+    for (uint32_t r = 0; r < (SPI_EEPROM_QUEUE_LEN - 2u); r++)
+    {
+        /* The first record ends at a page boundary, the second one crosses it */
+        check(spi_eeprom_submit(SPI_EEPROM_OP_WRITE, addr + r * QUEUE_RECORD_SIZE, records[r],
+              QUEUE_RECORD_SIZE, queue_op_done, (void *) (uintptr_t) n++) == STATE_UNCONFIRMED_SUCCESS,
+              "submit write");
+    }
+    check(spi_eeprom_submit(SPI_EEPROM_OP_READ, addr, back, sizeof(back),
+          queue_op_done, (void *) (uintptr_t) n++) == STATE_UNCONFIRMED_SUCCESS, "submit read");
+    check(spi_eeprom_submit(SPI_EEPROM_OP_READ, addr, back, sizeof(back), NULL, NULL) == STATE_QUEUE_FULL,
+          "submit beyond queue length");
+    check(spi_eeprom_read_range(addr, direct, sizeof(direct), NULL, NULL) == STATE_BUSY,
+          "direct read while queued");
+    check(spi_eeprom_read_flash(direct, sizeof(direct), QUEUE_PAGE, NULL, NULL) == STATE_BUSY,
+          "direct page read while queued");
+    check(spi_eeprom_write_enable(true, NULL, NULL) == STATE_BUSY, "direct write enable while queued");
+    check(spi_eeprom_4k_sector_erase(QUEUE_PAGE, NULL, NULL) == STATE_BUSY, "direct erase while queued");
+    check(spi_master_read_write_array(NULL, direct, 1u, direct, 1u, NULL, NULL) == STATE_BUSY,
+          "direct transfer while queued");
+
+    if (!sim_run_until(queue_empty, WAIT_TIMEOUT_NS))
+    {
+        printf("FAIL: timeout waiting for queue\n");
+        exit(EXIT_FAILURE);
+    }
+    wait_done("queue");
+    step_end("queue (erase, 6 writes, read)");
+
+    check(!queue_log.failed && (queue_log.count == n), "queue callbacks");
+    for (uint32_t i = 0; i < n; i++)
+    {
+        check(queue_log.order[i] == i, "queue order");
+    }
+    check(memcmp(records, back, sizeof(back)) == 0, "queue read back");
+
+    /* Once the queue is idle the direct calls run again */
+    check(!spi_eeprom_device_busy(0), "device idle after queue");
+    check(spi_eeprom_read_range(addr, direct, sizeof(direct), NULL, NULL) == STATE_UNCONFIRMED_SUCCESS,
+          "direct read after queue");
+    wait_done("direct read");
+    check(memcmp(records, direct, sizeof(direct)) == 0, "direct read back");
+}
+
+/*******************************************************************************
+* Function Name: run_cache
+********************************************************************************
+* Summary:
+*  Read a few pages over and over through spi_eeprom_read_flash: only the
+*  first read of each goes to the flash. A page program must show in the
+*  cached data, an erase must drop it, and reading more pages than the cache
+*  holds must evict.
+*
+*******************************************************************************/
+static void run_cache(void)
+{
+    static uint8_t data[CACHE_HOT_PAGES * EEPROM_PAGE_SIZE];
+    static uint8_t back[EEPROM_PAGE_SIZE];
+    static uint8_t zeros[16];
+    const uint8_t *cached;
+    spi_eeprom_cache_stats_t stats;
+
+    for (uint32_t i = 0; i < sizeof(data); i++)
+    {
+        data[i] = (uint8_t) (0xF0u ^ i ^ (i >> 8));
+    }
+    spi_eeprom_write_enable(true, NULL, NULL);
+    wait_done("write enable");
+    spi_eeprom_4k_sector_erase(CACHE_PAGE, NULL, NULL);
+    wait_done("sector erase");
+    spi_eeprom_write_range(CACHE_PAGE * EEPROM_PAGE_SIZE, data, sizeof(data), NULL, NULL);
+    wait_done("write range");
+
+    spi_eeprom_cache_reset_stats();
+    step_begin();
+    for (uint32_t round = 0; round < 4u; round++)
+    {
+        for (uint32_t p = 0; p < CACHE_HOT_PAGES; p++)
+        {
+            memset(back, 0, sizeof(back));
+            spi_eeprom_read_flash(back, EEPROM_PAGE_SIZE, CACHE_PAGE + p, NULL, NULL);
+            wait_done("read");
+            check(memcmp(back, &data[p * EEPROM_PAGE_SIZE], EEPROM_PAGE_SIZE) == 0, "cached read");
+        }
+    }
+    step_end("cached page read x16");
+    spi_eeprom_cache_get_stats(&stats);
+    check((stats.misses == CACHE_HOT_PAGES) && (stats.hits == 3u * CACHE_HOT_PAGES), "cache hit count");
+
+    /* Write through: the program clears bits of the cached page once it
+     * has succeeded, not while it runs */
+    spi_eeprom_write_enable(true, NULL, NULL);
+    wait_done("write enable");
+    spi_eeprom_write_flash(zeros, sizeof(zeros), CACHE_PAGE, NULL, NULL);
+    cached = spi_eeprom_cache_lookup(CACHE_PAGE);
+    check((cached != NULL) && (memcmp(cached, data, EEPROM_PAGE_SIZE) == 0), "cache kept during program");
+    wait_done("write");
+    memset(data, 0, sizeof(zeros));
+    spi_eeprom_read_flash(back, EEPROM_PAGE_SIZE, CACHE_PAGE, NULL, NULL);
+    wait_done("read");
+    check(memcmp(back, data, EEPROM_PAGE_SIZE) == 0, "write through");
+
+    /* Erase drops the sector, the next read goes to the flash */
+    spi_eeprom_write_enable(true, NULL, NULL);
+    wait_done("write enable");
+    spi_eeprom_4k_sector_erase(CACHE_PAGE, NULL, NULL);
+    wait_done("sector erase");
+    spi_eeprom_read_flash(back, EEPROM_PAGE_SIZE, CACHE_PAGE, NULL, NULL);
+    wait_done("read");
+    for (uint32_t i = 0; i < EEPROM_PAGE_SIZE; i++)
+    {
+        check(back[i] == 0xFFu, "read after erase");
+    }
+
+    /* More distinct pages than slots */
+    for (uint32_t p = 0; p < (SPI_EEPROM_CACHE_PAGES + CACHE_HOT_PAGES); p++)
+    {
+        spi_eeprom_read_flash(back, EEPROM_PAGE_SIZE, CACHE_PAGE + p, NULL, NULL);
+        wait_done("read");
+    }
+    spi_eeprom_cache_get_stats(&stats);
+    check(stats.evictions > 0u, "cache eviction");
+    printf("  cache: %u hits, %u misses, %u evictions\n", (unsigned) stats.hits,
+           (unsigned) stats.misses, (unsigned) stats.evictions);
+}
+
+static bool writeback_clean(void)
+{
+    return spi_eeprom_writeback_clean() && spi_eeprom_done();
+}
+
+static void wait_writeback(const char *what)
+{
+    if (!sim_run_until(writeback_clean, WAIT_TIMEOUT_NS))
+    {
+        printf("FAIL: timeout waiting for %s\n", what);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*******************************************************************************
+* Function Name: run_writeback
+********************************************************************************
+* Summary:
+*  Write WB_RECORDS small records, first with one write range each, then
+*  through the write-back buffer, which must program them with one page
+*  program. Buffered data must be readable before the flush, and the size
+*  threshold and the timeout must start a flush on their own. A flush the
+*  full queue refuses must not call its callback.
+*
+*******************************************************************************/
+static void run_writeback(void)
+{
+    static uint8_t records[WB_RECORDS * WB_RECORD_SIZE];
+    static uint8_t back[WB_RECORDS * WB_RECORD_SIZE];
+    static uint8_t page[SPI_EEPROM_WB_FLUSH_BYTES];
+    const uint32_t direct_addr = WB_PAGE * EEPROM_PAGE_SIZE;
+    const uint32_t addr = direct_addr + EEPROM_PAGE_SIZE;
+    const uint8_t *flash = sim_flash_memory(0);
+    spi_eeprom_wb_stats_t stats;
+
+    for (uint32_t i = 0; i < sizeof(records); i++)
+    {
+        records[i] = (uint8_t) (i * 13u + 5u);
+    }
+    spi_eeprom_writeback_init();
+    spi_eeprom_write_enable(true, NULL, NULL);
+    wait_done("write enable");
+    spi_eeprom_4k_sector_erase(WB_PAGE, NULL, NULL);
+    wait_done("sector erase");
+
+    step_begin();
+    for (uint32_t r = 0; r < WB_RECORDS; r++)
+    {
+        spi_eeprom_write_range(direct_addr + r * WB_RECORD_SIZE, &records[r * WB_RECORD_SIZE],
+                               WB_RECORD_SIZE, NULL, NULL);
+        wait_done("write range");
+    }
+    step_end("record write x10 (direct)");
+
+    step_begin();
+    for (uint32_t r = 0; r < WB_RECORDS; r++)
+    {
+        check(spi_eeprom_buffered_write(addr + r * WB_RECORD_SIZE, &records[r * WB_RECORD_SIZE],
+              WB_RECORD_SIZE) == INIT_SUCCESS, "spi_eeprom_buffered_write");
+    }
+    check(flash[addr] == 0xFFu, "buffered write reached the flash early");
+    check(spi_eeprom_buffered_read(addr, back, sizeof(back), NULL, NULL) == STATE_UNCONFIRMED_SUCCESS,
+          "spi_eeprom_buffered_read");
+    wait_done("buffered read");
+    check(memcmp(back, records, sizeof(back)) == 0, "read of buffered data");
+    check(spi_eeprom_flush(NULL, NULL) == STATE_UNCONFIRMED_SUCCESS, "spi_eeprom_flush");
+    wait_writeback("flush");
+    step_end("record write x10 (buffered)");
+    spi_eeprom_writeback_get_stats(&stats);
+    check(stats.programs == 1u, "one program for all records");
+    check(memcmp(&flash[addr], records, sizeof(records)) == 0, "flushed data");
+
+    /* Threshold: a full page of records flushes by itself */
+    for (uint32_t i = 0; i < sizeof(page); i++)
+    {
+        page[i] = (uint8_t) (i * 29u + 3u);
+    }
+    for (uint32_t offset = 0; offset < SPI_EEPROM_WB_FLUSH_BYTES; offset += 32u)
+    {
+        check(spi_eeprom_buffered_write(addr + EEPROM_PAGE_SIZE + offset, &page[offset], 32u) ==
+              INIT_SUCCESS, "spi_eeprom_buffered_write");
+    }
+    wait_writeback("size threshold");
+    check(memcmp(&flash[addr + EEPROM_PAGE_SIZE], page, SPI_EEPROM_WB_FLUSH_BYTES) == 0,
+          "threshold flush");
+
+    /* Timeout */
+    check(spi_eeprom_buffered_write(addr + 2u * EEPROM_PAGE_SIZE, records, WB_RECORD_SIZE) == INIT_SUCCESS,
+          "spi_eeprom_buffered_write");
+    spi_eeprom_writeback_tick(SPI_EEPROM_WB_TIMEOUT_MS - 1u);
+    check(!spi_eeprom_writeback_clean() && spi_eeprom_done(), "flush before timeout");
+    spi_eeprom_writeback_tick(1u);
+    wait_writeback("timeout");
+    check(memcmp(&flash[addr + 2u * EEPROM_PAGE_SIZE], records, WB_RECORD_SIZE) == 0, "timeout flush");
+
+    /* Refused flush: the callback is neither called nor kept */
+    done_calls = 0;
+    check(spi_eeprom_buffered_write(addr + 3u * EEPROM_PAGE_SIZE, records, WB_RECORD_SIZE) == INIT_SUCCESS,
+          "spi_eeprom_buffered_write");
+    fill_queue();
+    check(spi_eeprom_flush(count_done, NULL) == STATE_QUEUE_FULL, "flush with full queue");
+    wait_queue("queue");
+    check(done_calls == 0u, "refused flush called back");
+    check(spi_eeprom_flush(count_done, NULL) == STATE_UNCONFIRMED_SUCCESS, "flush after refusal");
+    wait_writeback("flush after refusal");
+    check((done_calls == 1u) && (done_status == INIT_SUCCESS), "flush callback");
+    check(memcmp(&flash[addr + 3u * EEPROM_PAGE_SIZE], records, WB_RECORD_SIZE) == 0, "flush after refusal");
+
+    spi_eeprom_writeback_get_stats(&stats);
+    printf("  write-back: %u writes, %u programs, %u flushes\n", (unsigned) stats.writes,
+           (unsigned) stats.programs, (unsigned) stats.flushes);
+}
+
+static bool update_idle(void)
+{
+    return !spi_eeprom_update_busy() && spi_eeprom_done();
+}
+
+/* Run one spi_eeprom_update and the same change on the expected image */
+static void update_range(uint8_t *image, uint32_t offset, const uint8_t *data, uint32_t size)
+{
+    check(spi_eeprom_update(UPDATE_PAGE * EEPROM_PAGE_SIZE + offset, data, size, NULL, NULL) ==
+          STATE_UNCONFIRMED_SUCCESS, "spi_eeprom_update");
+    check(spi_eeprom_update(UPDATE_PAGE * EEPROM_PAGE_SIZE + offset, data, size, NULL, NULL) ==
+          STATE_QUEUE_FULL, "second spi_eeprom_update");
+    if (!sim_run_until(update_idle, WAIT_TIMEOUT_NS))
+    {
+        printf("FAIL: timeout waiting for update\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(&image[offset], data, size);
+}
+
+/*******************************************************************************
+* Function Name: run_update
+********************************************************************************
+* Summary:
+*  Update a range whose new data only clears bits: only the page that differs
+*  may be programmed, without erase. Then set bits in the same range: the
+*  sector must be erased, and everything outside the range kept. Last, an
+*  update across a sector boundary onto blank flash.
+*
+*******************************************************************************/
+static void run_update(void)
+{
+    static uint8_t image[2u * SPI_EEPROM_UPDATE_SECTOR_SIZE];
+    static uint8_t data[3u * EEPROM_PAGE_SIZE];
+    const uint8_t *flash = sim_flash_memory(0) + UPDATE_PAGE * EEPROM_PAGE_SIZE;
+    const uint32_t offset = EEPROM_PAGE_SIZE / 2u;
+    spi_eeprom_update_stats_t stats;
+    sim_flash_stats_t before;
+    sim_flash_stats_t after;
+
+    memset(image, 0xFF, sizeof(image));
+    for (uint32_t i = 0; i < sizeof(data); i++)
+    {
+        data[i] = (uint8_t) (0x5Au ^ (i * 7u));
+    }
+    spi_eeprom_write_enable(true, NULL, NULL);
+    wait_done("write enable");
+    spi_eeprom_4k_sector_erase(UPDATE_PAGE, NULL, NULL);
+    wait_done("sector erase");
+    spi_eeprom_write_enable(true, NULL, NULL);
+    wait_done("write enable");
+    spi_eeprom_4k_sector_erase(UPDATE_PAGE + SPI_EEPROM_UPDATE_SECTOR_SIZE / EEPROM_PAGE_SIZE, NULL, NULL);
+    wait_done("sector erase");
+    update_range(image, 0, data, sizeof(data));
+
+    /* Clear bits in the second page only: one program, no erase */
+    memcpy(data, &image[offset], 2u * EEPROM_PAGE_SIZE);
+    data[EEPROM_PAGE_SIZE] &= 0x0Fu;
+    data[EEPROM_PAGE_SIZE + 9u] = 0;
+    sim_flash_get_stats(0, &before);
+    step_begin();
+    update_range(image, offset, data, 2u * EEPROM_PAGE_SIZE);
+    step_end("update (clear bits)");
+    sim_flash_get_stats(0, &after);
+    check(after.sector_erases == before.sector_erases, "erase skipped");
+    check(after.page_programs == before.page_programs + 1u, "only the page that differs programmed");
+    check(memcmp(flash, image, sizeof(image)) == 0, "update in place");
+
+    /* Set bits: erase, keep the rest of the sector */
+    data[3] = (uint8_t) ~data[3];
+    sim_flash_get_stats(0, &before);
+    step_begin();
+    update_range(image, offset, data, 2u * EEPROM_PAGE_SIZE);
+    step_end("update (set bits)");
+    sim_flash_get_stats(0, &after);
+    check(after.sector_erases == before.sector_erases + 1u, "erase for set bits");
+    check(memcmp(flash, image, sizeof(image)) == 0, "update with erase");
+
+    /* Across the sector boundary onto blank flash */
+    sim_flash_get_stats(0, &before);
+    update_range(image, SPI_EEPROM_UPDATE_SECTOR_SIZE - 100u, data, 300u);
+    sim_flash_get_stats(0, &after);
+    check(after.sector_erases == before.sector_erases, "erase skipped on blank flash");
+    check(memcmp(flash, image, sizeof(image)) == 0, "update across sectors");
+
+    /* Refused start: the error is returned, the callback is not called */
+    done_calls = 0;
+    fill_queue();
+    check(spi_eeprom_update(UPDATE_PAGE * EEPROM_PAGE_SIZE, data, EEPROM_PAGE_SIZE, count_done, NULL) ==
+          STATE_QUEUE_FULL, "update with full queue");
+    check(spi_eeprom_write_changed(UPDATE_PAGE * EEPROM_PAGE_SIZE, data, EEPROM_PAGE_SIZE, count_done, NULL) ==
+          STATE_QUEUE_FULL, "write changed with full queue");
+    check(!spi_eeprom_update_busy(), "refused update busy");
+    wait_queue("queue");
+    check(done_calls == 0u, "refused update called back");
+
+    spi_eeprom_update_get_stats(&stats);
+    printf("  update: %u sectors in place, %u erased, %u pages programmed, %u unchanged\n",
+           (unsigned) stats.sectors_in_place, (unsigned) stats.sectors_erased,
+           (unsigned) stats.pages_programmed, (unsigned) stats.pages_unchanged);
+}
+
+static bool erase_idle(void)
+{
+    return !spi_eeprom_erase_busy() && spi_eeprom_done();
+}
+
+/* Run one spi_eeprom_erase_range and check the range is blank afterwards */
+static void erase_range(bool blank_check)
+{
+    const uint8_t *flash = sim_flash_memory(0);
+
+    check(spi_eeprom_erase_range(ERASE_ADDR, ERASE_SIZE, blank_check, NULL, NULL) ==
+          STATE_UNCONFIRMED_SUCCESS, "spi_eeprom_erase_range");
+    check(spi_eeprom_erase_range(ERASE_ADDR, ERASE_SIZE, blank_check, NULL, NULL) ==
+          STATE_QUEUE_FULL, "second spi_eeprom_erase_range");
+    if (!sim_run_until(erase_idle, WAIT_TIMEOUT_NS))
+    {
+        printf("FAIL: timeout waiting for erase range\n");
+        exit(EXIT_FAILURE);
+    }
+    for (uint32_t i = ERASE_ADDR; i < (ERASE_ADDR + ERASE_SIZE); i++)
+    {
+        check(flash[i] == 0xFFu, "range erased");
+    }
+}
+
+/*******************************************************************************
+* Function Name: run_erase
+********************************************************************************
+* Summary:
+*  Erase a range of sectors and blocks: it must take one command per aligned
+*  block and a sector erase for the rest only. Then erase it again with the
+*  blank check after programming one sector in each block: the blocks must
+*  be erased whole and the blank sectors skipped.
+*
+*******************************************************************************/
+static void run_erase(void)
+{
+    static uint8_t data[16];
+    const uint32_t dirty_64k = SPI_EEPROM_BLOCK_64K_SIZE + 3u * SPI_EEPROM_SECTOR_SIZE;
+    const uint32_t dirty_32k = 2u * SPI_EEPROM_BLOCK_64K_SIZE + 5u * SPI_EEPROM_SECTOR_SIZE;
+    spi_eeprom_erase_stats_t before;
+    spi_eeprom_erase_stats_t after;
+
+    memset(data, 0x3C, sizeof(data));
+    check(spi_eeprom_erase_range(ERASE_ADDR + 1u, ERASE_SIZE, false, NULL, NULL) == STATE_INVALID_ARGUMENT,
+          "unaligned erase range");
+    for (uint32_t a = ERASE_ADDR; a < (ERASE_ADDR + ERASE_SIZE); a += SPI_EEPROM_SECTOR_SIZE)
+    {
+        spi_eeprom_write_range(a + SPI_EEPROM_SECTOR_SIZE - sizeof(data), data, sizeof(data), NULL, NULL);
+        wait_done("write range");
+    }
+
+    spi_eeprom_erase_get_stats(&before);
+    step_begin();
+    erase_range(false);
+    step_end("erase range 108 KB");
+    spi_eeprom_erase_get_stats(&after);
+    check((after.erase_64k - before.erase_64k) == 1u, "one 64 KB block erase");
+    check((after.erase_32k - before.erase_32k) == 1u, "one 32 KB block erase");
+    check((after.erase_4k - before.erase_4k) == 3u, "three sector erases");
+
+    /* One programmed sector in each block: the blocks are erased whole */
+    spi_eeprom_write_range(dirty_64k, data, sizeof(data), NULL, NULL);
+    wait_done("write range");
+    spi_eeprom_write_range(dirty_32k, data, sizeof(data), NULL, NULL);
+    wait_done("write range");
+    before = after;
+    step_begin();
+    erase_range(true);
+    step_end("erase range 108 KB (check)");
+    spi_eeprom_erase_get_stats(&after);
+    check((after.erase_64k - before.erase_64k) == 1u, "64 KB block erase after blank check");
+    check((after.erase_32k - before.erase_32k) == 1u, "32 KB block erase after blank check");
+    check(after.erase_4k == before.erase_4k, "no sector erase after blank check");
+    check((after.sectors_blank - before.sectors_blank) == 3u, "blank sectors skipped");
+    check((sim_flash_memory(0)[dirty_64k] == 0xFFu) && (sim_flash_memory(0)[dirty_32k] == 0xFFu),
+          "programmed sectors erased");
+
+    /* Refused start: the error is returned, the callback is not called */
+    done_calls = 0;
+    fill_queue();
+    check(spi_eeprom_erase_range(ERASE_ADDR, ERASE_SIZE, true, count_done, NULL) == STATE_QUEUE_FULL,
+          "erase range with full queue");
+    check(!spi_eeprom_erase_busy(), "refused erase range busy");
+    wait_queue("queue");
+    check(done_calls == 0u, "refused erase range called back");
+}
+
+static eeprom_dma_status_t compare_status;
+
+static void compare_done(eeprom_dma_status_t status, cy_rslt_t error, void *ctx)
+{
+    (void) error;
+    (void) ctx;
+    compare_status = status;
+}
+
+/* Compare a range of the EEPROM with spi_eeprom_compare_range */
+static eeprom_dma_status_t compare_range(uint32_t addr, const uint8_t *data, uint32_t size)
+{
+    compare_status = OTHER_FAILURE;
+    check(spi_eeprom_compare_range(addr, data, size, compare_done, NULL) == STATE_UNCONFIRMED_SUCCESS,
+          "spi_eeprom_compare_range");
+    wait_done("compare");
+    return compare_status;
+}
+
+/* Run spi_eeprom_write_changed for the image of run_skip */
+static void write_changed(const uint8_t *image)
+{
+    check(spi_eeprom_write_changed(SKIP_PAGE * EEPROM_PAGE_SIZE, image, SKIP_SIZE, NULL, NULL) ==
+          STATE_UNCONFIRMED_SUCCESS, "spi_eeprom_write_changed");
+    if (!sim_run_until(update_idle, WAIT_TIMEOUT_NS))
+    {
+        printf("FAIL: timeout waiting for write changed\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*******************************************************************************
+* Function Name: run_skip
+********************************************************************************
+* Summary:
+*  Compare ranges against data and blank without a read buffer, then write
+*  an image and write it again unchanged: the second write must not program
+*  a single page. A changed image is written after erasing with the blank
+*  check, which must skip the sector that holds no data.
+*
+*******************************************************************************/
+static void run_skip(void)
+{
+    static uint8_t image[SKIP_SIZE];
+    const uint32_t addr = SKIP_PAGE * EEPROM_PAGE_SIZE;
+    const uint8_t *flash = sim_flash_memory(0) + addr;
+    spi_eeprom_update_stats_t update;
+    spi_eeprom_erase_stats_t erase;
+    sim_flash_stats_t before;
+    sim_flash_stats_t after;
+    uint32_t blank;
+
+    for (uint32_t i = 0; i < SKIP_SIZE; i++)
+    {
+        image[i] = (uint8_t) (i ^ (i >> 7));
+    }
+    check(spi_eeprom_erase_range(addr, SKIP_SIZE, false, NULL, NULL) == STATE_UNCONFIRMED_SUCCESS,
+          "spi_eeprom_erase_range");
+    if (!sim_run_until(erase_idle, WAIT_TIMEOUT_NS))
+    {
+        printf("FAIL: timeout waiting for erase range\n");
+        exit(EXIT_FAILURE);
+    }
+    check(compare_range(addr, NULL, SKIP_SIZE) == INIT_SUCCESS, "blank check of erased range");
+
+    step_begin();
+    write_changed(image);
+    step_end("write changed 8 KB (blank)");
+    check(memcmp(flash, image, SKIP_SIZE) == 0, "write changed");
+
+    /* Streaming compare, ending within a segment */
+    check(compare_range(addr, image, SKIP_SIZE - 5u) == INIT_SUCCESS, "compare equal");
+    check(compare_range(addr, NULL, SKIP_SIZE) == STATE_COMPARE_MISMATCH, "blank check of data");
+    image[SKIP_SIZE - 7u] ^= 0x10u;
+    check(compare_range(addr, image, SKIP_SIZE - 5u) == STATE_COMPARE_MISMATCH, "compare last segment");
+    image[SKIP_SIZE - 7u] ^= 0x10u;
+
+    sim_flash_get_stats(0, &before);
+    step_begin();
+    write_changed(image);
+    step_end("write changed 8 KB (same)");
+    sim_flash_get_stats(0, &after);
+    check(after.page_programs == before.page_programs, "unchanged pages skipped");
+
+    /* New image with an empty first sector */
+    memset(image, 0xFF, SPI_EEPROM_SECTOR_SIZE);
+    spi_eeprom_write_enable(true, NULL, NULL);
+    wait_done("write enable");
+    spi_eeprom_4k_sector_erase(SKIP_PAGE, NULL, NULL);
+    wait_done("sector erase");
+    spi_eeprom_erase_get_stats(&erase);
+    blank = erase.sectors_blank;
+    check(spi_eeprom_erase_range(addr, SKIP_SIZE, true, NULL, NULL) == STATE_UNCONFIRMED_SUCCESS,
+          "spi_eeprom_erase_range");
+    if (!sim_run_until(erase_idle, WAIT_TIMEOUT_NS))
+    {
+        printf("FAIL: timeout waiting for erase range\n");
+        exit(EXIT_FAILURE);
+    }
+    spi_eeprom_erase_get_stats(&erase);
+    check(erase.sectors_blank == (blank + 1u), "blank sector skipped");
+    write_changed(image);
+    check(memcmp(flash, image, SKIP_SIZE) == 0, "write changed after erase");
+
+    spi_eeprom_update_get_stats(&update);
+    printf("  write changed: %u bytes skipped, %.1f ms\n", (unsigned) update.bytes_skipped,
+           (double) update.us_skipped / 1000.0);
+    spi_eeprom_erase_get_stats(&erase);
+    printf("  erase range: %u bytes skipped, %.1f ms\n", (unsigned) erase.bytes_skipped,
+           (double) erase.us_skipped / 1000.0);
+}
+
+/* Value of a key of run_kv */
+static void kv_value(uint16_t key, uint8_t *value)
+{
+    for (uint32_t i = 0; i < 8u; i++)
+    {
+        value[i] = (uint8_t) (key * 17u + i);
+    }
+}
+
+/* Check the keys of run_kv after the updates and deletes */
+static void kv_check_keys(uint32_t deleted_from)
+{
+    uint8_t expect[8];
+    uint8_t value[SPI_EEPROM_KV_VALUE_MAX];
+    uint8_t len;
+    uint32_t counter = 0;
+
+    for (uint16_t key = 0; key < KV_KEYS; key++)
+    {
+        eeprom_dma_status_t status = spi_eeprom_kv_get(key, value, sizeof(value), &len);
+
+        if (key >= deleted_from)
+        {
+            check(status == STATE_NOT_FOUND, "deleted key");
+        }
+        else if (key == KV_COUNTER_KEY)
+        {
+            check((status == INIT_SUCCESS) && (len == sizeof(counter)), "counter");
+            memcpy(&counter, value, sizeof(counter));
+            check(counter == KV_COUNTER_UPDATES, "counter value");
+        }
+        else
+        {
+            kv_value(key, expect);
+            check((status == INIT_SUCCESS) && (len == sizeof(expect)) && (memcmp(value, expect, len) == 0),
+                  "key value");
+        }
+    }
+}
+
+/*******************************************************************************
+* Function Name: run_kv
+********************************************************************************
+* Summary:
+*  Format a key-value store, set KV_KEYS keys, update one of them many times
+*  and delete a few. The updates must cost a record program each and only
+*  occasionally an erase, spread evenly over the sectors. After a new mount
+*  from the summaries, all values must be the same.
+*
+*******************************************************************************/
+static void run_kv(void)
+{
+    uint8_t value[8];
+    spi_eeprom_kv_stats_t stats;
+    sim_flash_stats_t before;
+    sim_flash_stats_t after;
+
+    check(spi_eeprom_kv_mount(KV_BASE) == INIT_FAILURE, "mount of blank flash");
+    check(spi_eeprom_kv_format(KV_BASE) == INIT_SUCCESS, "spi_eeprom_kv_format");
+    for (uint16_t key = 0; key < KV_KEYS; key++)
+    {
+        kv_value(key, value);
+        check(spi_eeprom_kv_set(key, value, sizeof(value)) == INIT_SUCCESS, "spi_eeprom_kv_set");
+    }
+
+    sim_flash_get_stats(0, &before);
+    step_begin();
+    for (uint32_t counter = 1; counter <= KV_COUNTER_UPDATES; counter++)
+    {
+        check(spi_eeprom_kv_set(KV_COUNTER_KEY, (const uint8_t *) &counter, sizeof(counter)) == INIT_SUCCESS,
+              "counter update");
+    }
+    step_end("kv update x1500");
+    sim_flash_get_stats(0, &after);
+    check((after.sector_erases - before.sector_erases) < (KV_COUNTER_UPDATES / 100u), "erases per update");
+
+    for (uint16_t key = KV_KEYS - 10u; key < KV_KEYS; key++)
+    {
+        check(spi_eeprom_kv_delete(key) == INIT_SUCCESS, "spi_eeprom_kv_delete");
+    }
+    check(spi_eeprom_kv_delete(KV_KEYS - 1u) == STATE_NOT_FOUND, "delete of deleted key");
+    kv_check_keys(KV_KEYS - 10u);
+
+    spi_eeprom_kv_get_stats(&stats);
+    check(stats.gc_runs > 0u, "sectors reclaimed");
+    check((stats.erase_max - stats.erase_min) <= 1u, "erases spread over the sectors");
+    printf("  kv: %u keys, %u reclaims, %u records moved, %u..%u erases per sector\n", (unsigned) stats.keys,
+           (unsigned) stats.gc_runs, (unsigned) stats.records_moved, (unsigned) stats.erase_min,
+           (unsigned) stats.erase_max);
+
+    step_begin();
+    check(spi_eeprom_kv_mount(KV_BASE) == INIT_SUCCESS, "spi_eeprom_kv_mount");
+    step_end("kv mount");
+    spi_eeprom_kv_get_stats(&stats);
+    check(stats.keys == (KV_KEYS - 10u), "keys after mount");
+    kv_check_keys(KV_KEYS - 10u);
+}
+
+static void log_record(uint32_t n, uint8_t *record)
+{
+    for (uint32_t i = 0; i < LOG_RECORD_SIZE; i++)
+    {
+        record[i] = (uint8_t) (n * 7u + i);
+    }
+    record[0] = (uint8_t) n;
+    record[1] = (uint8_t) (n >> 8);
+}
+
+/* Append records until the log holds pages full pages, waiting for a page
+ * buffer whenever all are queued */
+static void log_fill(uint32_t pages)
+{
+    uint8_t record[LOG_RECORD_SIZE];
+    uint32_t first;
+    uint32_t next;
+    uint64_t start = sim_time_ns();
+
+    spi_eeprom_log_bounds(&first, &next);
+    for (uint32_t n = next * LOG_PAGE_RECORDS; n < pages * LOG_PAGE_RECORDS; n++)
+    {
+        eeprom_dma_status_t status;
+
+        log_record(n, record);
+        while ((status = spi_eeprom_log_append(record, sizeof(record))) == STATE_QUEUE_FULL)
+        {
+            check((sim_time_ns() - start) < WAIT_TIMEOUT_NS * 4u, "log append timeout");
+            sim_advance_ns(LOG_RETRY_NS);
+        }
+        check(status == INIT_SUCCESS, "spi_eeprom_log_append");
+    }
+    if (!sim_run_until(spi_eeprom_log_idle, WAIT_TIMEOUT_NS))
+    {
+        check(false, "log programs");
+    }
+}
+
+/* Mount and check the bounds of the log and the records of its first and
+ * last page */
+static void log_check(uint32_t first_expected, uint32_t next_expected)
+{
+    static uint8_t page[EEPROM_PAGE_SIZE];
+    uint8_t record[LOG_RECORD_SIZE];
+    spi_eeprom_log_stats_t stats;
+    uint32_t first;
+    uint32_t next;
+    uint32_t seqs[2];
+
+    check(spi_eeprom_log_mount(LOG_BASE) == INIT_SUCCESS, "spi_eeprom_log_mount");
+    spi_eeprom_log_get_stats(&stats);
+    spi_eeprom_log_bounds(&first, &next);
+    check((first == first_expected) && (next == next_expected), "log bounds after mount");
+    check(stats.mount_reads <= 12u, "log mount reads");
+
+    seqs[0] = first;
+    seqs[1] = next - 1u;
+    for (uint32_t i = 0; (next > 0) && (i < 2u); i++)
+    {
+        uint32_t offset = 0;
+        uint32_t count = 0;
+        const uint8_t *data;
+        uint8_t len;
+
+        check(spi_eeprom_log_read_page(seqs[i], page, NULL, NULL) == STATE_UNCONFIRMED_SUCCESS,
+              "spi_eeprom_log_read_page");
+        wait_done("log page read");
+        while ((data = spi_eeprom_log_record(page, &offset, &len)) != NULL)
+        {
+            log_record(seqs[i] * LOG_PAGE_RECORDS + count, record);
+            check((len == LOG_RECORD_SIZE) && (memcmp(data, record, len) == 0), "log record");
+            count++;
+        }
+        check(count == LOG_PAGE_RECORDS, "log records per page");
+    }
+    check(spi_eeprom_log_read_page(next, page, NULL, NULL) == STATE_INVALID_ARGUMENT, "read past the head");
+}
+
+/*******************************************************************************
+* Function Name: run_log
+********************************************************************************
+* Summary:
+*  Fill the log to its last sector, whose erase ahead blanks page 0, and
+*  then around past page 0. Mount must find the bounds each time with a
+*  few header reads, and erase the sector ahead of the head if a reset
+*  kept it from being erased.
+*
+*******************************************************************************/
+static void run_log(void)
+{
+    const uint32_t sector_pages = SPI_EEPROM_SECTOR_SIZE / EEPROM_PAGE_SIZE;
+    const uint32_t log_pages = SPI_EEPROM_LOG_SECTORS * sector_pages;
+    static uint8_t pattern[SPI_EEPROM_SECTOR_SIZE];
+    uint8_t *ahead;
+    spi_eeprom_log_stats_t stats;
+    sim_flash_stats_t before;
+    sim_flash_stats_t after;
+    uint64_t start;
+    double log_rate;
+    double program_rate;
+
+    check(spi_eeprom_log_format(LOG_BASE) == INIT_SUCCESS, "spi_eeprom_log_format");
+    log_check(0, 0);
+    log_fill(5u);
+    log_check(0, 5u);
+
+    /* Bandwidth of the device for a sector: erase and page programs */
+    memset(pattern, 0x5A, sizeof(pattern));
+    step_begin();
+    check(spi_eeprom_submit(SPI_EEPROM_OP_ERASE_4K, LOG_BASE + SPI_EEPROM_SECTOR_SIZE, NULL, 0, NULL, NULL) ==
+          STATE_UNCONFIRMED_SUCCESS, "sector erase");
+    check(spi_eeprom_submit(SPI_EEPROM_OP_WRITE, LOG_BASE + SPI_EEPROM_SECTOR_SIZE, pattern, sizeof(pattern),
+                            NULL, NULL) == STATE_UNCONFIRMED_SUCCESS, "write range");
+    wait_done("sector program");
+    program_rate = (double) sizeof(pattern) / ((double) (sim_time_ns() - step_start_ns) / 1e9);
+    step_end("log reference sector");
+    check(spi_eeprom_log_format(LOG_BASE) == INIT_SUCCESS, "spi_eeprom_log_format");
+
+    sim_flash_get_stats(0, &before);
+    start = sim_time_ns();
+    step_begin();
+    log_fill(log_pages - 6u);
+    step_end("log append 250 pages");
+    log_rate = ((double) (log_pages - 6u) * EEPROM_PAGE_SIZE) / ((double) (sim_time_ns() - start) / 1e9);
+    sim_flash_get_stats(0, &after);
+    check((after.page_programs - before.page_programs) == (log_pages - 6u), "one program per page");
+    spi_eeprom_log_get_stats(&stats);
+    printf("  log: %.1f KB/s appending, %.1f KB/s sector erase and program, %u erases ahead\n", log_rate / 1024.0,
+           program_rate / 1024.0, (unsigned) stats.erases);
+    check(log_rate > 0.9 * program_rate, "log throughput");
+
+    step_begin();
+    log_check(sector_pages, log_pages - 6u);
+    step_end("log mount");
+
+    log_fill(log_pages + 144u);
+    log_check(10u * sector_pages, log_pages + 144u);
+
+    /* The sector ahead of the head programmed as if its erase was lost */
+    ahead = sim_flash_memory(0) + LOG_BASE + 9u * SPI_EEPROM_SECTOR_SIZE;
+    memset(ahead + 100u, 0, 8u);
+    log_check(10u * sector_pages, log_pages + 144u);
+    spi_eeprom_log_get_stats(&stats);
+    check((stats.erases == 1u) && (ahead[100] == 0xFFu), "erase ahead at mount");
+    log_fill(log_pages + 160u);
+    log_check(11u * sector_pages, log_pages + 160u);
+}
+
+static uint32_t crc_result;
+static cy_rslt_t crc_error;
+
+static void crc_done(eeprom_dma_status_t status, cy_rslt_t error, void *ctx)
+{
+    (void) ctx;
+
+    compare_status = status;
+    crc_error = error;
+    crc_result = spi_eeprom_get_crc();
+}
+
+/*******************************************************************************
+* Function Name: run_crc
+********************************************************************************
+* Summary:
+*  Compute the CRC-32 of CRC_SIZE bytes while reading them, with and without
+*  a buffer and through the queue, and compare it with the CRC of the flash
+*  content. The CRC read must take about as long as the plain read. With
+*  interrupts too late to reload the DMA descriptors in time the slave select
+*  goes inactive between segments; the read must then fail rather than
+*  succeed with the bytes clocked in after the EEPROM ended the command.
+*
+*******************************************************************************/
+static void run_crc(void)
+{
+    static uint8_t back[CRC_SIZE];
+    const uint8_t *flash = sim_flash_memory(0) + CRC_ADDR;
+    uint32_t expected = crc32_update(0, flash, CRC_SIZE);
+    sim_cpu_config_t cpu;
+    sim_cpu_config_t late;
+    uint64_t read_ns;
+    uint64_t crc_ns;
+
+    check(crc32_update(0, (const uint8_t *) "123456789", 9u) == 0xCBF43926u, "crc32 check value");
+    check(crc32_update(crc32_update(0, flash, 1000u), &flash[1000], CRC_SIZE - 1000u) == expected,
+          "crc32 in two parts");
+
+    step_begin();
+    check(spi_eeprom_read_range(CRC_ADDR, back, CRC_SIZE, NULL, NULL) == STATE_UNCONFIRMED_SUCCESS,
+          "spi_eeprom_read_range");
+    wait_done("read range");
+    read_ns = sim_time_ns() - step_start_ns;
+    step_end("read range 32 KB");
+
+    memset(back, 0, sizeof(back));
+    compare_status = STATE_UNCONFIRMED_SUCCESS;
+    step_begin();
+    check(spi_eeprom_crc_range(CRC_ADDR, back, CRC_SIZE, crc_done, NULL) == STATE_UNCONFIRMED_SUCCESS,
+          "spi_eeprom_crc_range");
+    wait_done("crc range");
+    crc_ns = sim_time_ns() - step_start_ns;
+    step_end("crc range 32 KB");
+    check((compare_status == INIT_SUCCESS) && (crc_result == expected), "crc of read");
+    check(memcmp(back, flash, CRC_SIZE) == 0, "data of crc read");
+    check(crc_ns < read_ns + read_ns / 20u, "crc read time");
+
+    compare_status = STATE_UNCONFIRMED_SUCCESS;
+    step_begin();
+    check(spi_eeprom_crc_range(CRC_ADDR, NULL, CRC_SIZE, crc_done, NULL) == STATE_UNCONFIRMED_SUCCESS,
+          "spi_eeprom_crc_range");
+    wait_done("crc range");
+    step_end("crc range 32 KB (no buffer)");
+    check((compare_status == INIT_SUCCESS) && (crc_result == expected), "crc without buffer");
+
+    compare_status = STATE_UNCONFIRMED_SUCCESS;
+    check(spi_eeprom_submit(SPI_EEPROM_OP_CRC, CRC_ADDR + 77u, NULL, 1000u, crc_done, NULL) ==
+          STATE_UNCONFIRMED_SUCCESS, "submit crc");
+    wait_done("queued crc");
+    check((compare_status == INIT_SUCCESS) && (crc_result == crc32_update(0, &flash[77], 1000u)),
+          "queued crc");
+
+    sim_cpu_get_config(&cpu);
+    late = cpu;
+    late.isr_latency_ns = CRC_LATE_ISR_NS;
+    sim_cpu_config(&late);
+    compare_status = STATE_UNCONFIRMED_SUCCESS;
+    check(spi_eeprom_crc_range(CRC_ADDR, back, CRC_SIZE, crc_done, NULL) == STATE_UNCONFIRMED_SUCCESS,
+          "spi_eeprom_crc_range");
+    wait_done("crc range with late interrupts");
+    check(compare_status == STATE_TRANSFER_ERROR, "broken chip select reported");
+    check((crc_error & DMA_ERROR_STREAM_SPLIT) != 0u, "broken chip select cause");
+    check(spi_transfer_get_error() != 0u, "broken chip select error");
+    sim_cpu_config(&cpu);
+    sim_advance_ns(CRC_LATE_ISR_NS);
+    spi_state_reset();
+
+    compare_status = STATE_UNCONFIRMED_SUCCESS;
+    check(spi_eeprom_crc_range(CRC_ADDR, NULL, CRC_SIZE, crc_done, NULL) == STATE_UNCONFIRMED_SUCCESS,
+          "spi_eeprom_crc_range");
+    wait_done("crc range");
+    check((compare_status == INIT_SUCCESS) && (crc_result == expected), "crc after the reset");
+}
+
+/*******************************************************************************
+* Function Name: run_verify
+********************************************************************************
+* Summary:
+*  Verified writes: to an erased range it must succeed at the cost of one
+*  read of the range; over data it must report the mismatch, and cached
+*  pages must then show what the flash holds. Through the queue as well.
+*
+*******************************************************************************/
+static void run_verify(void)
+{
+    static uint8_t data[VERIFY_SIZE];
+    static uint8_t back[EEPROM_PAGE_SIZE];
+    const uint8_t *flash = sim_flash_memory(0) + VERIFY_ADDR;
+
+    for (uint32_t i = 0; i < VERIFY_SIZE; i++)
+    {
+        data[i] = (uint8_t) (i * 13u + 1u);
+    }
+    check(spi_eeprom_submit(SPI_EEPROM_OP_ERASE_4K, VERIFY_ADDR, NULL, 0, NULL, NULL) ==
+          STATE_UNCONFIRMED_SUCCESS, "sector erase");
+    wait_done("sector erase");
+
+    compare_status = STATE_UNCONFIRMED_SUCCESS;
+    step_begin();
+    check(spi_eeprom_write_verify(VERIFY_ADDR + 16u, data, VERIFY_SIZE, compare_done, NULL) ==
+          STATE_UNCONFIRMED_SUCCESS, "spi_eeprom_write_verify");
+    wait_done("verified write");
+    step_end("write verify 1000 bytes");
+    check((compare_status == INIT_SUCCESS) && (memcmp(&flash[16], data, VERIFY_SIZE) == 0), "verified write");
+
+    /* Programming can only clear bits, so the old data shows through. The
+     * page read first is in the cache */
+    spi_eeprom_read_flash(back, EEPROM_PAGE_SIZE, (VERIFY_ADDR / EEPROM_PAGE_SIZE) + 2u, NULL, NULL);
+    wait_done("read");
+    data[500] = (uint8_t) ~data[500];
+    compare_status = STATE_UNCONFIRMED_SUCCESS;
+    check(spi_eeprom_submit(SPI_EEPROM_OP_WRITE_VERIFY, VERIFY_ADDR + 16u, data, VERIFY_SIZE, compare_done,
+                            NULL) == STATE_UNCONFIRMED_SUCCESS, "submit verified write");
+    wait_done("verified write");
+    check(compare_status == STATE_COMPARE_MISMATCH, "verify over data");
+
+    spi_eeprom_read_flash(back, EEPROM_PAGE_SIZE, (VERIFY_ADDR / EEPROM_PAGE_SIZE) + 2u, NULL, NULL);
+    wait_done("read");
+    check(memcmp(back, &flash[2u * EEPROM_PAGE_SIZE], EEPROM_PAGE_SIZE) == 0, "cache after mismatch");
+}
+
+static void trace_print(const char *text)
+{
+    fputs(text, stdout);
+}
+
+static uint32_t trace_sum(spi_eeprom_trace_class_t cls, spi_eeprom_trace_interval_t interval)
+{
+    spi_eeprom_trace_hist_t h;
+
+    spi_eeprom_trace_get(cls, interval, &h);
+    return (uint32_t) h.sum;
+}
+
+/*******************************************************************************
+* Function Name: run_trace
+********************************************************************************
+* Summary:
+*  Queue two sector erases, a page program and page reads at once, then
+*  check the latency trace against virtual time: the phases of each
+*  operation add up to its total, the erases spend their time busy and the
+*  others wait for them in the queue.
+*
+*******************************************************************************/
+static void run_trace(void)
+{
+    static uint8_t data[EEPROM_PAGE_SIZE];
+    static uint8_t back[TRACE_READS][EEPROM_PAGE_SIZE];
+    spi_eeprom_trace_hist_t h;
+    uint64_t t0;
+    uint32_t elapsed_us;
+
+    for (uint32_t i = 0; i < EEPROM_PAGE_SIZE; i++)
+    {
+        data[i] = (uint8_t) (i ^ 0x5Au);
+    }
+    spi_eeprom_trace_reset();
+
+    t0 = sim_time_ns();
+    check(spi_eeprom_submit(SPI_EEPROM_OP_ERASE_4K, TRACE_ADDR, NULL, 0, NULL, NULL) ==
+          STATE_UNCONFIRMED_SUCCESS, "submit erase");
+    check(spi_eeprom_submit(SPI_EEPROM_OP_ERASE_4K, TRACE_ADDR + SPI_EEPROM_SECTOR_SIZE, NULL, 0, NULL, NULL) ==
+          STATE_UNCONFIRMED_SUCCESS, "submit erase");
+    check(spi_eeprom_submit(SPI_EEPROM_OP_WRITE, TRACE_ADDR, data, EEPROM_PAGE_SIZE, NULL, NULL) ==
+          STATE_UNCONFIRMED_SUCCESS, "submit write");
+    for (uint32_t i = 0; i < TRACE_READS; i++)
+    {
+        check(spi_eeprom_submit(SPI_EEPROM_OP_READ, TRACE_ADDR, back[i], EEPROM_PAGE_SIZE, NULL, NULL) ==
+              STATE_UNCONFIRMED_SUCCESS, "submit read");
+    }
+    wait_done("traced operations");
+    elapsed_us = (uint32_t) ((sim_time_ns() - t0) / 1000u);
+    check(memcmp(back[TRACE_READS - 1u], data, EEPROM_PAGE_SIZE) == 0, "traced read");
+
+    for (uint32_t c = 0; c < SPI_EEPROM_TRACE_CLASSES; c++)
+    {
+        uint32_t phases = 0;
+
+        for (uint32_t i = 0; i < SPI_EEPROM_TRACE_TOTAL; i++)
+        {
+            phases += trace_sum((spi_eeprom_trace_class_t) c, (spi_eeprom_trace_interval_t) i);
+        }
+        check(phases == trace_sum((spi_eeprom_trace_class_t) c, SPI_EEPROM_TRACE_TOTAL), "phases add up to total");
+    }
+
+    spi_eeprom_trace_get(SPI_EEPROM_TRACE_ERASE, SPI_EEPROM_TRACE_BUSY, &h);
+    check((h.count == 2u) && (h.sum >= 2u * 45000u), "erase busy");
+    spi_eeprom_trace_get(SPI_EEPROM_TRACE_PROGRAM, SPI_EEPROM_TRACE_QUEUE, &h);
+    check((h.count == 1u) && (h.max >= 90000u), "program waits for the erases");
+    spi_eeprom_trace_get(SPI_EEPROM_TRACE_PROGRAM, SPI_EEPROM_TRACE_BUSY, &h);
+    check((h.max >= 400u) && (h.max < 2000u), "program busy");
+    spi_eeprom_trace_get(SPI_EEPROM_TRACE_READ, SPI_EEPROM_TRACE_TRANSFER, &h);
+    check((h.count == TRACE_READS) && (spi_eeprom_trace_percentile(&h, 50u) >= (EEPROM_PAGE_SIZE * 8u) / 4u),
+          "read transfer");
+    spi_eeprom_trace_get(SPI_EEPROM_TRACE_READ, SPI_EEPROM_TRACE_TOTAL, &h);
+    check((h.max <= elapsed_us) && (h.max + 5u >= elapsed_us), "read total against virtual time");
+
+    spi_eeprom_trace_dump(trace_print);
+}
+
+static bool device0_idle(void)
+{
+    return !spi_eeprom_device_busy(0);
+}
+
+static bool device2_idle(void)
+{
+    return !spi_eeprom_device_busy(2);
+}
+
+/*******************************************************************************
+* Function Name: run_devices
+********************************************************************************
+* Summary:
+*  Three flash devices on SS0 to SS2. While device 1 erases a 64 KB block,
+*  device 0 erases, writes and reads back a range and device 2 programs a
+*  page and answers RDID: all of that must complete before the erase does,
+*  each device on its own data.
+*
+*******************************************************************************/
+static void run_devices(void)
+{
+    static uint8_t data[DEVICES_SIZE];
+    static uint8_t back[DEVICES_SIZE];
+    static uint8_t back2[EEPROM_PAGE_SIZE];
+    sim_flash_config_t cfg;
+    uint8_t id[3] = {0};
+    uint8_t *flash1;
+
+    sim_flash_default_config(&cfg);
+    check(sim_flash_attach(1, &cfg) && sim_flash_attach(2, &cfg), "attach devices");
+    flash1 = sim_flash_memory(1);
+    memset(flash1, 0x00, SPI_EEPROM_BLOCK_64K_SIZE);
+    for (uint32_t i = 0; i < DEVICES_SIZE; i++)
+    {
+        data[i] = (uint8_t) (i * 7u + 3u);
+    }
+
+    check(spi_eeprom_set_device(SPI_EEPROM_DEVICES) == STATE_INVALID_ARGUMENT, "set unknown device");
+    check(spi_eeprom_submit_to(SPI_EEPROM_DEVICES, SPI_EEPROM_OP_READ, 0, back, 1, NULL, NULL) ==
+          STATE_INVALID_ARGUMENT, "submit to unknown device");
+
+    step_begin();
+    check(spi_eeprom_submit_to(1, SPI_EEPROM_OP_ERASE_64K, 0, NULL, 0, NULL, NULL) ==
+          STATE_UNCONFIRMED_SUCCESS, "submit erase to device 1");
+    check(spi_eeprom_submit_to(2, SPI_EEPROM_OP_WRITE, 0, data, EEPROM_PAGE_SIZE, NULL, NULL) ==
+          STATE_UNCONFIRMED_SUCCESS, "submit write to device 2");
+    check(spi_eeprom_submit_to(0, SPI_EEPROM_OP_ERASE_4K, DEVICES_ADDR, NULL, 0, NULL, NULL) ==
+          STATE_UNCONFIRMED_SUCCESS, "submit erase to device 0");
+    check(spi_eeprom_submit_to(0, SPI_EEPROM_OP_WRITE, DEVICES_ADDR, data, DEVICES_SIZE, NULL, NULL) ==
+          STATE_UNCONFIRMED_SUCCESS, "submit write to device 0");
+    check(spi_eeprom_submit_to(0, SPI_EEPROM_OP_READ, DEVICES_ADDR, back, DEVICES_SIZE, NULL, NULL) ==
+          STATE_UNCONFIRMED_SUCCESS, "submit read to device 0");
+    if (!sim_run_until(device0_idle, WAIT_TIMEOUT_NS) || !sim_run_until(device2_idle, WAIT_TIMEOUT_NS))
+    {
+        printf("FAIL: timeout waiting for devices 0 and 2\n");
+        exit(EXIT_FAILURE);
+    }
+    check(sim_flash_is_busy(1) && spi_eeprom_device_busy(1), "device 0 and 2 done during the erase");
+    check(memcmp(back, data, DEVICES_SIZE) == 0, "device 0 read back");
+
+    /* Direct calls address the selected device */
+    check(spi_eeprom_set_device(2) == INIT_SUCCESS, "set device 2");
+    check(spi_eeprom_rdid_reg(id, sizeof(id), NULL, NULL) == STATE_UNCONFIRMED_SUCCESS, "RDID device 2");
+    sim_run_until(device2_idle, WAIT_TIMEOUT_NS);
+    check(spi_eeprom_read_range(0, back2, EEPROM_PAGE_SIZE, NULL, NULL) == STATE_UNCONFIRMED_SUCCESS,
+          "read device 2");
+    sim_run_until(device2_idle, WAIT_TIMEOUT_NS);
+    check(spi_eeprom_set_device(0) == INIT_SUCCESS, "set device 0");
+    check(memcmp(id, cfg.jedec_id, sizeof(id)) == 0, "device 2 RDID");
+    check(memcmp(back2, data, EEPROM_PAGE_SIZE) == 0, "device 2 read back");
+    check(sim_flash_is_busy(1), "device 2 done during the erase");
+
+    wait_done("device 1 erase");
+    step_end("3 devices, 64K erase on one");
+    for (uint32_t i = 0; i < SPI_EEPROM_BLOCK_64K_SIZE; i++)
+    {
+        check(flash1[i] == 0xFFu, "device 1 erased");
+    }
+    check(sim_flash_memory(2)[EEPROM_PAGE_SIZE] == 0xFFu, "device 2 beyond its page");
+
+    sim_flash_detach(1);
+    sim_flash_detach(2);
+}
+
+static bool stripe_idle(void)
+{
+    return !spi_eeprom_stripe_busy();
+}
+
+/* Completion of a striped range: its status, and whether every device had
+ * finished its lane by then */
+static struct
+{
+    uint32_t calls;
+    eeprom_dma_status_t status;
+    bool lanes_idle;
+} stripe_log;
+
+static void stripe_done(eeprom_dma_status_t status, cy_rslt_t error, void *ctx)
+{
+    (void) error;
+    (void) ctx;
+    stripe_log.calls++;
+    stripe_log.status = status;
+    stripe_log.lanes_idle = true;
+    for (uint32_t k = 0; k < STRIPE_DEVICES; k++)
+    {
+        stripe_log.lanes_idle = stripe_log.lanes_idle && !spi_eeprom_device_busy(k);
+    }
+}
+
+/*******************************************************************************
+* Function Name: stripe_write
+********************************************************************************
+* Summary:
+*  Erase the first stripe of sectors of a volume over devices, write data
+*  into it and read it back.
+*
+* Return:
+*  Virtual time of the write in ns.
+*
+*******************************************************************************/
+static uint64_t stripe_write(uint32_t devices, uint32_t base, uint8_t *data, uint8_t *back)
+{
+    uint64_t start;
+
+    check(spi_eeprom_stripe_init(devices, base) == INIT_SUCCESS, "stripe init");
+    check(spi_eeprom_stripe_erase_range(0, devices * SPI_EEPROM_SECTOR_SIZE, NULL, NULL) ==
+          STATE_UNCONFIRMED_SUCCESS, "stripe erase");
+    check(sim_run_until(stripe_idle, WAIT_TIMEOUT_NS), "stripe erase done");
+
+    start = sim_time_ns();
+    check(spi_eeprom_stripe_write_range(STRIPE_OFFSET, data, STRIPE_SIZE, NULL, NULL) ==
+          STATE_UNCONFIRMED_SUCCESS, "stripe write");
+    check(spi_eeprom_stripe_write_range(STRIPE_OFFSET, data, STRIPE_SIZE, NULL, NULL) ==
+          STATE_QUEUE_FULL, "second stripe range");
+    check(sim_run_until(stripe_idle, WAIT_TIMEOUT_NS), "stripe write done");
+    start = sim_time_ns() - start;
+
+    memset(back, 0, STRIPE_SIZE);
+    check(spi_eeprom_stripe_read_range(STRIPE_OFFSET, back, STRIPE_SIZE, NULL, NULL) ==
+          STATE_UNCONFIRMED_SUCCESS, "stripe read");
+    check(sim_run_until(stripe_idle, WAIT_TIMEOUT_NS), "stripe read done");
+    check(memcmp(back, data, STRIPE_SIZE) == 0, "stripe read back");
+    return start;
+}
+
+/*******************************************************************************
+* Function Name: run_stripe
+********************************************************************************
+* Summary:
+*  A volume striped over 3 devices: erase, write and read back a range that
+*  starts and ends within a page, check that page n landed on device n % 3,
+*  and that the write takes well under half the time of the same write on
+*  a single device. Device 0 is attached again for it, blank. A range the
+*  queue has no room for must not start on any device, and a lane that
+*  fails must stop the range only once the other lanes are idle.
+*
+*******************************************************************************/
+static void run_stripe(void)
+{
+    static uint8_t data[STRIPE_SIZE];
+    static uint8_t back[STRIPE_SIZE];
+    sim_flash_config_t cfg;
+    uint64_t striped;
+    uint64_t single;
+
+    sim_flash_default_config(&cfg);
+    cfg.t_pp_typ_us = STRIPE_T_PP_US;
+    cfg.t_pp_max_us = STRIPE_T_PP_US;
+    sim_flash_detach(0);
+    for (uint32_t k = 0; k < STRIPE_DEVICES; k++)
+    {
+        check(sim_flash_attach(k, &cfg), "attach stripe device");
+        memset(sim_flash_memory(k) + STRIPE_BASE, 0x00, SPI_EEPROM_SECTOR_SIZE);
+        check(spi_eeprom_probe(k) == INIT_SUCCESS, "probe stripe device");
+    }
+    for (uint32_t i = 0; i < STRIPE_SIZE; i++)
+    {
+        data[i] = (uint8_t) (i * 13u + (i >> 8));
+    }
+
+    check(spi_eeprom_stripe_init(SPI_EEPROM_DEVICES + 1u, STRIPE_BASE) == STATE_INVALID_ARGUMENT,
+          "stripe over too many devices");
+    check(spi_eeprom_stripe_init(STRIPE_DEVICES, STRIPE_BASE + 1u) == STATE_INVALID_ARGUMENT,
+          "unaligned stripe base");
+    check(spi_eeprom_stripe_init(STRIPE_DEVICES, STRIPE_BASE) == INIT_SUCCESS, "stripe init");
+    check(spi_eeprom_stripe_size() == STRIPE_DEVICES * (EEPROM_NUM_PAGES * EEPROM_PAGE_SIZE - STRIPE_BASE),
+          "stripe size");
+    check(spi_eeprom_stripe_erase_range(SPI_EEPROM_SECTOR_SIZE, STRIPE_DEVICES * SPI_EEPROM_SECTOR_SIZE,
+          NULL, NULL) == STATE_INVALID_ARGUMENT, "unaligned stripe erase");
+    check(spi_eeprom_stripe_read_range(spi_eeprom_stripe_size() - 1u, back, 2, NULL, NULL) ==
+          STATE_INVALID_PAGE, "stripe read past the end");
+
+    step_begin();
+    striped = stripe_write(STRIPE_DEVICES, STRIPE_BASE, data, back);
+    step_end("stripe, 3 devices");
+    for (uint32_t i = 0; i < STRIPE_SIZE; i++)
+    {
+        uint32_t addr = STRIPE_OFFSET + i;
+        uint32_t page = addr / EEPROM_PAGE_SIZE;
+        const uint8_t *flash = sim_flash_memory(page % STRIPE_DEVICES);
+
+        check(flash[STRIPE_BASE + (page / STRIPE_DEVICES) * EEPROM_PAGE_SIZE + addr % EEPROM_PAGE_SIZE] == data[i],
+              "stripe page on its device");
+    }
+    check(sim_flash_memory(0)[STRIPE_BASE] == 0xFFu, "stripe erased before the range");
+
+    step_begin();
+    single = stripe_write(1, STRIPE_BASE + SPI_EEPROM_SECTOR_SIZE, data, back);
+    step_end("stripe, 1 device");
+    printf("  stripe write speedup: %.2f\n", (double) single / (double) striped);
+    check((2u * striped) < single, "striped write overlaps the page programs");
+
+    /* Refused start: the error is returned, the callback is not called */
+    done_calls = 0;
+    fill_queue();
+    check(spi_eeprom_stripe_read_range(0, back, EEPROM_PAGE_SIZE, count_done, NULL) == STATE_QUEUE_FULL,
+          "stripe read with full queue");
+    check(!spi_eeprom_stripe_busy(), "refused stripe busy");
+    wait_queue("queue");
+    check(done_calls == 0u, "refused stripe called back");
+
+    /* Room for two of three lanes: nothing is queued */
+    check(spi_eeprom_stripe_init(STRIPE_DEVICES, STRIPE_BASE) == INIT_SUCCESS, "stripe init");
+    for (uint32_t i = 0; i < (SPI_EEPROM_QUEUE_LEN - STRIPE_DEVICES + 1u); i++)
+    {
+        check(spi_eeprom_submit(SPI_EEPROM_OP_READ, 0, back, 16u, NULL, NULL) == STATE_UNCONFIRMED_SUCCESS,
+              "fill queue");
+    }
+    check(spi_eeprom_stripe_read_range(0, back, STRIPE_DEVICES * EEPROM_PAGE_SIZE, NULL, NULL) ==
+          STATE_QUEUE_FULL, "stripe read without room for all lanes");
+    check(spi_eeprom_queue_count() == (SPI_EEPROM_QUEUE_LEN - STRIPE_DEVICES + 1u), "no lane started");
+    wait_queue("queue");
+
+    /* Device 2 programs slower than probed: its lane times out while the
+     * others are programming */
+    cfg.t_pp_typ_us = 4u * STRIPE_T_PP_US;
+    cfg.t_pp_max_us = cfg.t_pp_typ_us;
+    check(sim_flash_attach(2, &cfg), "attach slow stripe device");
+    memset(&stripe_log, 0, sizeof(stripe_log));
+    check(spi_eeprom_stripe_write_range(STRIPE_OFFSET, data, STRIPE_SIZE, stripe_done, NULL) ==
+          STATE_UNCONFIRMED_SUCCESS, "stripe write with slow device");
+    check(sim_run_until(stripe_idle, WAIT_TIMEOUT_NS), "stripe write with slow device done");
+    check((stripe_log.calls == 1u) && (stripe_log.status == STATE_TIMEOUT), "stripe lane timeout");
+    check(stripe_log.lanes_idle, "stripe ended with lanes running");
+
+    sim_flash_detach(0);
+    sim_flash_detach(1);
+    sim_flash_detach(2);
+    sim_flash_default_config(&cfg);
+    check(sim_flash_attach(0, &cfg), "attach device 0");
+    check(spi_eeprom_probe(0) == INIT_SUCCESS, "probe device 0");
+}
+
+static bool geometry_idle(void)
+{
+    return !spi_eeprom_device_busy(GEOMETRY_SS);
+}
+
+static bool geometry_flash_idle(void)
+{
+    return !sim_flash_is_busy(GEOMETRY_SS);
+}
+
+/*******************************************************************************
+* Function Name: run_geometry
+********************************************************************************
+* Summary:
+*  Geometry from SFDP for device 0, from the RDID table for a part without
+*  SFDP and the defaults for an unknown one. A 32 MB part with 512-byte
+*  pages gets 4-byte addresses and is programmed page by page of its own.
+*  A part slower than its probed geometry fails with STATE_TIMEOUT until
+*  probed again; an absent one is not found.
+*
+*******************************************************************************/
+static void run_geometry(void)
+{
+    static const uint8_t rdid[3] = GEOMETRY_RDID;
+    static uint8_t data[GEOMETRY_SIZE];
+    static uint8_t back[GEOMETRY_SIZE];
+    const spi_eeprom_geometry_t *geo = spi_eeprom_get_geometry(0);
+    sim_flash_config_t cfg;
+    sim_flash_stats_t before;
+    sim_flash_stats_t after;
+
+    check(spi_eeprom_get_geometry(SPI_EEPROM_DEVICES) == NULL, "geometry of unknown device");
+    check(spi_eeprom_probe(SPI_EEPROM_DEVICES) == STATE_INVALID_ARGUMENT, "probe unknown device");
+    check((geo->source == SPI_EEPROM_GEOMETRY_SFDP) && (geo->size == 8u * 1024u * 1024u) &&
+          (geo->page_size == 256u) && (geo->addr_bytes == 3u), "SFDP geometry");
+    check((geo->erase_4k_cmd == 0x20u) && (geo->erase_32k_cmd == 0x52u) && (geo->erase_64k_cmd == 0xD8u),
+          "SFDP erase opcodes");
+    check((geo->t_typ_us[SPI_EEPROM_TIME_PP] >= 400u) && (geo->t_typ_us[SPI_EEPROM_TIME_PP] <= 500u) &&
+          (geo->t_max_us[SPI_EEPROM_TIME_PP] >= 1350u) && (geo->t_max_us[SPI_EEPROM_TIME_BE64] >= 1150000u),
+          "SFDP times");
+
+    /* Without SFDP: known and unknown RDID */
+    sim_flash_default_config(&cfg);
+    cfg.sfdp = false;
+    memcpy(cfg.jedec_id, rdid, sizeof(rdid));
+    check(sim_flash_attach(GEOMETRY_SS, &cfg), "attach RDID part");
+    check(spi_eeprom_probe(GEOMETRY_SS) == INIT_SUCCESS, "probe RDID part");
+    geo = spi_eeprom_get_geometry(GEOMETRY_SS);
+    check((geo->source == SPI_EEPROM_GEOMETRY_RDID) && (memcmp(geo->jedec_id, rdid, sizeof(rdid)) == 0) &&
+          (geo->t_typ_us[SPI_EEPROM_TIME_BE64] == 150000u), "RDID geometry");
+    cfg.jedec_id[0] = 0x12u;
+    check(sim_flash_attach(GEOMETRY_SS, &cfg), "attach unknown part");
+    check(spi_eeprom_probe(GEOMETRY_SS) == INIT_SUCCESS, "probe unknown part");
+    check((geo->source == SPI_EEPROM_GEOMETRY_DEFAULT) && (geo->size == EEPROM_NUM_PAGES * EEPROM_PAGE_SIZE),
+          "default geometry");
+
+    /* 32 MB, 512-byte pages */
+    sim_flash_default_config(&cfg);
+    cfg.size_bytes = GEOMETRY_BIG_SIZE;
+    cfg.page_size = GEOMETRY_BIG_PAGE;
+    check(sim_flash_attach(GEOMETRY_SS, &cfg), "attach 32 MB part");
+    check(spi_eeprom_probe(GEOMETRY_SS) == INIT_SUCCESS, "probe 32 MB part");
+    check((geo->size == GEOMETRY_BIG_SIZE) && (geo->page_size == GEOMETRY_BIG_PAGE) && (geo->addr_bytes == 4u),
+          "32 MB geometry");
+    for (uint32_t i = 0; i < GEOMETRY_SIZE; i++)
+    {
+        data[i] = (uint8_t) (i * 5u + 1u);
+    }
+    sim_flash_get_stats(GEOMETRY_SS, &before);
+    check(spi_eeprom_submit_to(GEOMETRY_SS, SPI_EEPROM_OP_WRITE, GEOMETRY_ADDR, data, GEOMETRY_SIZE,
+          NULL, NULL) == STATE_UNCONFIRMED_SUCCESS, "write above 16 MB");
+    check(spi_eeprom_submit_to(GEOMETRY_SS, SPI_EEPROM_OP_READ, GEOMETRY_ADDR, back, GEOMETRY_SIZE,
+          NULL, NULL) == STATE_UNCONFIRMED_SUCCESS, "read above 16 MB");
+    check(sim_run_until(geometry_idle, WAIT_TIMEOUT_NS), "32 MB part done");
+    sim_flash_get_stats(GEOMETRY_SS, &after);
+    check(memcmp(sim_flash_memory(GEOMETRY_SS) + GEOMETRY_ADDR, data, GEOMETRY_SIZE) == 0, "data above 16 MB");
+    check(memcmp(back, data, GEOMETRY_SIZE) == 0, "read back above 16 MB");
+    check((after.page_programs - before.page_programs) ==
+          ((GEOMETRY_ADDR + GEOMETRY_SIZE - 1u) / GEOMETRY_BIG_PAGE - GEOMETRY_ADDR / GEOMETRY_BIG_PAGE + 1u),
+          "programs of 512-byte pages");
+
+    /* 32 MB parts entering 4-byte mode after WREN, or only by a method the
+     * driver does not use */
+    cfg.en4b = SIM_FLASH_EN4B_WREN;
+    check(sim_flash_attach(GEOMETRY_SS, &cfg), "attach 32 MB part with WREN before EN4B");
+    check(spi_eeprom_probe(GEOMETRY_SS) == INIT_SUCCESS, "probe 32 MB part with WREN before EN4B");
+    check((geo->size == GEOMETRY_BIG_SIZE) && (geo->addr_bytes == 4u), "geometry with WREN before EN4B");
+    memset(back, 0, sizeof(back));
+    check(spi_eeprom_submit_to(GEOMETRY_SS, SPI_EEPROM_OP_WRITE, GEOMETRY_ADDR, data, GEOMETRY_SIZE,
+          NULL, NULL) == STATE_UNCONFIRMED_SUCCESS, "write above 16 MB after WREN and EN4B");
+    check(spi_eeprom_submit_to(GEOMETRY_SS, SPI_EEPROM_OP_READ, GEOMETRY_ADDR, back, GEOMETRY_SIZE,
+          NULL, NULL) == STATE_UNCONFIRMED_SUCCESS, "read above 16 MB after WREN and EN4B");
+    check(sim_run_until(geometry_idle, WAIT_TIMEOUT_NS), "32 MB part with WREN before EN4B done");
+    check(memcmp(back, data, GEOMETRY_SIZE) == 0, "read back after WREN and EN4B");
+    cfg.en4b = SIM_FLASH_EN4B_BANK;
+    check(sim_flash_attach(GEOMETRY_SS, &cfg), "attach 32 MB part with bank register");
+    check(spi_eeprom_probe(GEOMETRY_SS) == INIT_SUCCESS, "probe 32 MB part with bank register");
+    check((geo->size == 16u * 1024u * 1024u) && (geo->addr_bytes == 3u), "3-byte fallback geometry");
+
+    /* Page programs slower than the maximum of the probed part */
+    sim_flash_default_config(&cfg);
+    check(sim_flash_attach(GEOMETRY_SS, &cfg), "attach default part");
+    check(spi_eeprom_probe(GEOMETRY_SS) == INIT_SUCCESS, "probe default part");
+    cfg.t_pp_typ_us = 4u * geo->t_max_us[SPI_EEPROM_TIME_PP];
+    cfg.t_pp_max_us = cfg.t_pp_typ_us;
+    check(sim_flash_attach(GEOMETRY_SS, &cfg), "attach slow part");
+    compare_status = OTHER_FAILURE;
+    check(spi_eeprom_submit_to(GEOMETRY_SS, SPI_EEPROM_OP_WRITE, 0, data, 16u, compare_done, NULL) ==
+          STATE_UNCONFIRMED_SUCCESS, "write slow part");
+    check(sim_run_until(geometry_idle, WAIT_TIMEOUT_NS), "slow part done");
+    check(compare_status == STATE_TIMEOUT, "program timeout");
+    check(sim_run_until(geometry_flash_idle, WAIT_TIMEOUT_NS), "slow part idle");
+    check(spi_eeprom_probe(GEOMETRY_SS) == INIT_SUCCESS, "probe slow part");
+    compare_status = OTHER_FAILURE;
+    check(spi_eeprom_submit_to(GEOMETRY_SS, SPI_EEPROM_OP_WRITE, 16u, data, 16u, compare_done, NULL) ==
+          STATE_UNCONFIRMED_SUCCESS, "write slow part again");
+    check(sim_run_until(geometry_idle, WAIT_TIMEOUT_NS), "slow part done again");
+    check(compare_status == INIT_SUCCESS, "program within probed time");
+
+    sim_flash_detach(GEOMETRY_SS);
+    check(spi_eeprom_probe(GEOMETRY_SS) == STATE_NOT_FOUND, "probe absent part");
+}
+
+/* Completion times of the reads of run_suspend, urgent ones first */
+static struct
+{
+    uint64_t done_ns[SUSPEND_READS + 1u];
+    uint32_t count;
+    uint32_t expected;
+    bool failed;
+} suspend_log;
+
+static void suspend_read_done(eeprom_dma_status_t status, cy_rslt_t error, void *ctx)
+{
+    (void) error;
+    suspend_log.done_ns[(uintptr_t) ctx] = sim_time_ns();
+    suspend_log.count++;
+    suspend_log.failed |= (status != INIT_SUCCESS);
+}
+
+static bool suspend_read_seen(void)
+{
+    return suspend_log.count >= suspend_log.expected;
+}
+
+/*******************************************************************************
+* Function Name: run_suspend
+********************************************************************************
+* Summary:
+*  Urgent reads during a 64 KB erase: the first one suspends the erase and
+*  completes within the suspend latency plus its transfer, the second one,
+*  submitted right after, also waits for the resume to suspend interval. A
+*  read queued before them completes with the erase, which succeeds. An
+*  urgent read during a page program of a multi-page write leaves the rest
+*  of the write to go on after the resume. A part without suspend, per its
+*  SFDP, finishes the erase first.
+*
+*******************************************************************************/
+static void run_suspend(void)
+{
+    static uint8_t back[SUSPEND_READS + 1u][SUSPEND_READ_SIZE];
+    static uint8_t data[SUSPEND_WRITE_PAGES * EEPROM_PAGE_SIZE];
+    const spi_eeprom_geometry_t *geo = spi_eeprom_get_geometry(0);
+    const uint8_t *flash = sim_flash_memory(0);
+    spi_eeprom_suspend_stats_t stats;
+    spi_eeprom_trace_hist_t h;
+    sim_flash_config_t cfg;
+    sim_flash_stats_t before;
+    sim_flash_stats_t after;
+    uint64_t submit_ns[SUSPEND_READS];
+    uint32_t bound_us;
+    uint64_t t0;
+
+    check((geo->suspend_cmd == 0x75u) && (geo->resume_cmd == 0x7Au) && (geo->t_suspend_us == 40u) &&
+          (geo->t_resume_us == 128u), "SFDP suspend");
+    memset(sim_flash_memory(0) + SUSPEND_ERASE_ADDR, 0x00, SPI_EEPROM_BLOCK_64K_SIZE);
+    memset(&suspend_log, 0, sizeof(suspend_log));
+    sim_flash_get_stats(0, &before);
+    spi_eeprom_trace_reset();
+
+    step_begin();
+    t0 = sim_time_ns();
+    compare_status = OTHER_FAILURE;
+    check(spi_eeprom_submit(SPI_EEPROM_OP_ERASE_64K, SUSPEND_ERASE_ADDR, NULL, 0, compare_done, NULL) ==
+          STATE_UNCONFIRMED_SUCCESS, "submit erase");
+    check(spi_eeprom_submit(SPI_EEPROM_OP_READ, SUSPEND_READ_ADDR, back[SUSPEND_READS], SUSPEND_READ_SIZE,
+          suspend_read_done, (void *) (uintptr_t) SUSPEND_READS) == STATE_UNCONFIRMED_SUCCESS,
+          "submit read");
+    sim_advance_ns(SUSPEND_START_NS);
+    check(sim_flash_is_busy(0), "erase in progress");
+
+    for (uint32_t i = 0; i < SUSPEND_READS; i++)
+    {
+        submit_ns[i] = sim_time_ns();
+        check(spi_eeprom_read_urgent(0, SUSPEND_READ_ADDR, back[i], SUSPEND_READ_SIZE, suspend_read_done,
+              (void *) (uintptr_t) i) == STATE_UNCONFIRMED_SUCCESS, "submit urgent read");
+        suspend_log.expected = i + 1u;
+        check(sim_run_until(suspend_read_seen, WAIT_TIMEOUT_NS) && !suspend_log.failed &&
+              (compare_status == OTHER_FAILURE), "urgent read during the erase");
+    }
+    wait_done("suspended erase");
+    step_end("erase with 2 urgent reads");
+    sim_flash_get_stats(0, &after);
+    spi_eeprom_get_suspend_stats(0, &stats);
+
+    for (uint32_t i = 0; i < SUSPEND_READS; i++)
+    {
+        uint32_t latency_us = (uint32_t) ((suspend_log.done_ns[i] - submit_ns[i]) / 1000u);
+
+        /* Suspend latency and two polls, then the read at no less than
+         * 1 MHz; the second read also waits for the resume */
+        bound_us = geo->t_suspend_us + 2u * EEPROM_POLL_MIN_US + SUSPEND_READ_SIZE * 8u + 50u;
+        if (i > 0u)
+        {
+            bound_us += geo->t_resume_us;
+        }
+        printf("  urgent read %u: %u us\n", (unsigned) i, (unsigned) latency_us);
+        check(latency_us < bound_us, "urgent read latency");
+        check(memcmp(back[i], flash + SUSPEND_READ_ADDR, SUSPEND_READ_SIZE) == 0, "urgent read data");
+    }
+    check((compare_status == INIT_SUCCESS) && (suspend_log.count == SUSPEND_READS + 1u), "erase completed");
+    check(suspend_log.done_ns[SUSPEND_READS] - t0 >= 220000000u, "queued read after the erase");
+    check(memcmp(back[SUSPEND_READS], flash + SUSPEND_READ_ADDR, SUSPEND_READ_SIZE) == 0, "queued read data");
+    for (uint32_t i = 0; i < SPI_EEPROM_BLOCK_64K_SIZE; i++)
+    {
+        check(flash[SUSPEND_ERASE_ADDR + i] == 0xFFu, "erased while suspended");
+    }
+    check(((after.suspends - before.suspends) == SUSPEND_READS) && (stats.suspends == SUSPEND_READS) &&
+          (stats.urgent_reads == SUSPEND_READS) && (stats.suspend_max_us <= geo->t_suspend_us + EEPROM_POLL_MIN_US),
+          "suspend stats");
+    spi_eeprom_trace_get(SPI_EEPROM_TRACE_URGENT, SPI_EEPROM_TRACE_TOTAL, &h);
+    check((h.count == SUSPEND_READS) && (h.max < bound_us), "urgent read trace");
+    spi_eeprom_trace_get(SPI_EEPROM_TRACE_ERASE, SPI_EEPROM_TRACE_TOTAL, &h);
+    check((h.count == 1u) && (h.max >= 220000u), "suspended erase trace");
+
+    /* Urgent read during the first page program of a write to the erased
+     * block: the write goes on with its next pages after the resume */
+    for (uint32_t i = 0; i < sizeof(data); i++)
+    {
+        data[i] = (uint8_t) (i * 5u + 1u);
+    }
+    memset(&suspend_log, 0, sizeof(suspend_log));
+    compare_status = OTHER_FAILURE;
+    check(spi_eeprom_submit(SPI_EEPROM_OP_WRITE, SUSPEND_ERASE_ADDR, data, sizeof(data), compare_done, NULL) ==
+          STATE_UNCONFIRMED_SUCCESS, "submit multi-page write");
+    while (!sim_flash_is_busy(0))
+    {
+        sim_advance_ns(EEPROM_POLL_MIN_US * 1000u);
+    }
+    submit_ns[0] = sim_time_ns();
+    check(spi_eeprom_read_urgent(0, SUSPEND_READ_ADDR, back[0], SUSPEND_READ_SIZE, suspend_read_done, NULL) ==
+          STATE_UNCONFIRMED_SUCCESS, "submit urgent read during the write");
+    suspend_log.expected = 1u;
+    check(sim_run_until(suspend_read_seen, WAIT_TIMEOUT_NS) && !suspend_log.failed &&
+          (compare_status == OTHER_FAILURE), "urgent read during the write");
+    bound_us = geo->t_suspend_us + 2u * EEPROM_POLL_MIN_US + SUSPEND_READ_SIZE * 8u + 50u;
+    check((suspend_log.done_ns[0] - submit_ns[0]) / 1000u < bound_us, "urgent read latency during the write");
+    check(memcmp(back[0], flash + SUSPEND_READ_ADDR, SUSPEND_READ_SIZE) == 0, "urgent read data during the write");
+    wait_done("suspended write");
+    check((compare_status == INIT_SUCCESS) && (memcmp(flash + SUSPEND_ERASE_ADDR, data, sizeof(data)) == 0),
+          "write around the suspend");
+
+    /* No suspend: the read waits for the sector erase */
+    sim_flash_default_config(&cfg);
+    cfg.t_sus_us = 0;
+    check(sim_flash_attach(SUSPEND_SS, &cfg), "attach part without suspend");
+    check(spi_eeprom_probe(SUSPEND_SS) == INIT_SUCCESS, "probe part without suspend");
+    check(spi_eeprom_get_geometry(SUSPEND_SS)->suspend_cmd == 0u, "SFDP without suspend");
+    memset(&suspend_log, 0, sizeof(suspend_log));
+    t0 = sim_time_ns();
+    check(spi_eeprom_submit_to(SUSPEND_SS, SPI_EEPROM_OP_ERASE_4K, 0, NULL, 0, NULL, NULL) ==
+          STATE_UNCONFIRMED_SUCCESS, "submit erase without suspend");
+    sim_advance_ns(SUSPEND_START_NS / 4u);
+    check(spi_eeprom_read_urgent(SUSPEND_SS, 0, back[0], SUSPEND_READ_SIZE, suspend_read_done, NULL) ==
+          STATE_UNCONFIRMED_SUCCESS, "urgent read without suspend");
+    wait_done("erase without suspend");
+    check((suspend_log.done_ns[0] - t0) >= 50000000u, "urgent read after the erase");
+    sim_flash_detach(SUSPEND_SS);
+}
+
+/* Completions of run_priority: the reads by their index, then the
+ * background write and read */
+#define PRIO_LOG_WRITE      (PRIO_CHAIN)
+#define PRIO_LOG_READ       (PRIO_CHAIN + 1u)
+
+static struct
+{
+    uint32_t order[PRIO_CHAIN + 2u];
+    uint64_t done_ns[PRIO_CHAIN + 2u];
+    uint32_t count;
+    uint32_t chained;
+    bool failed;
+} prio_log;
+
+static uint8_t prio_back[PRIO_CHAIN + 2u][PRIO_READ_SIZE];
+
+static void prio_done(eeprom_dma_status_t status, cy_rslt_t error, void *ctx)
+{
+    uint32_t id = (uint32_t) (uintptr_t) ctx;
+
+    (void) error;
+    prio_log.done_ns[id] = sim_time_ns();
+    prio_log.order[prio_log.count++] = id;
+    prio_log.failed |= (status != INIT_SUCCESS);
+}
+
+/* Completion of a read of the chain, which submits the next one */
+static void prio_chain_done(eeprom_dma_status_t status, cy_rslt_t error, void *ctx)
+{
+    prio_done(status, error, ctx);
+    if (++prio_log.chained < PRIO_CHAIN)
+    {
+        prio_log.failed |= (spi_eeprom_submit_prio(0, SPI_EEPROM_OP_READ, SPI_EEPROM_PRIO_CRITICAL, 0,
+                PRIO_READ_ADDR, prio_back[prio_log.chained], PRIO_READ_SIZE, prio_chain_done,
+                (void *) (uintptr_t) prio_log.chained) != STATE_UNCONFIRMED_SUCCESS);
+    }
+}
+
+static bool prio_read_seen(void)
+{
+    return prio_log.count > 0u;
+}
+
+/*******************************************************************************
+* Function Name: prio_log_write
+********************************************************************************
+* Summary:
+*  Write PRIO_WRITE_PAGES pages in the background on a device and read
+*  PRIO_READ_SIZE bytes at read_addr as critical operation while it is in
+*  progress. The read completes within bound_us, long before the write.
+*
+*******************************************************************************/
+static void prio_log_write(uint32_t device, uint32_t read_addr, uint32_t bound_us)
+{
+    static uint8_t data[PRIO_WRITE_PAGES * EEPROM_PAGE_SIZE];
+    uint32_t latency_us;
+    uint64_t submit_ns;
+
+    for (uint32_t i = 0; i < sizeof(data); i++)
+    {
+        data[i] = (uint8_t) (i * 7u + device);
+    }
+    memset(sim_flash_memory(device) + PRIO_ADDR, 0xFF, sizeof(data));
+    memset(&prio_log, 0, sizeof(prio_log));
+
+    check(spi_eeprom_submit_to(device, SPI_EEPROM_OP_WRITE, PRIO_ADDR, data, sizeof(data), prio_done,
+          (void *) (uintptr_t) PRIO_LOG_WRITE) == STATE_UNCONFIRMED_SUCCESS, "submit log write");
+    sim_advance_ns(PRIO_START_NS);
+    submit_ns = sim_time_ns();
+    check(spi_eeprom_submit_prio(device, SPI_EEPROM_OP_READ, SPI_EEPROM_PRIO_CRITICAL, 0, read_addr, prio_back[0],
+          PRIO_READ_SIZE, prio_done, NULL) == STATE_UNCONFIRMED_SUCCESS, "submit critical read");
+    check(sim_run_until(prio_read_seen, WAIT_TIMEOUT_NS) && (prio_log.order[0] == 0u), "critical read first");
+    latency_us = (uint32_t) ((prio_log.done_ns[0] - submit_ns) / 1000u);
+    printf("  critical read on SS%u: %u us\n", (unsigned) device, (unsigned) latency_us);
+    check(latency_us < bound_us, "critical read latency");
+    check(memcmp(prio_back[0], sim_flash_memory(device) + read_addr, PRIO_READ_SIZE) == 0, "critical read data");
+
+    wait_done("log write");
+    check(!prio_log.failed && (prio_log.count == 2u), "log write completed");
+    check(memcmp(sim_flash_memory(device) + PRIO_ADDR, data, sizeof(data)) == 0, "log write data");
+}
+
+/*******************************************************************************
+* Function Name: run_priority
+********************************************************************************
+* Summary:
+*  Critical reads, as for USB-PD policy, next to background writes and
+*  erases: a read during a bulk log write does not wait for the write, with
+*  suspend or, on a part without, parked after the page in progress; a read
+*  whose deadline allows it lets a page program finish unsuspended; reads
+*  queued together run earliest deadline first; a chain of critical reads
+*  lets a background write and read go after SPI_EEPROM_STARVATION_LIMIT.
+*
+*******************************************************************************/
+static void run_priority(void)
+{
+    static const uint32_t deadlines[PRIO_EDF_READS] = PRIO_EDF_DEADLINES;
+    static uint8_t chain_data[8u * EEPROM_PAGE_SIZE];
+    const spi_eeprom_geometry_t *geo = spi_eeprom_get_geometry(0);
+    spi_eeprom_suspend_stats_t before;
+    spi_eeprom_suspend_stats_t stats;
+    sim_flash_config_t cfg;
+    uint8_t page[EEPROM_PAGE_SIZE];
+    uint64_t submit_ns;
+
+    /* Page transfer of the write and of the read at no less than 1 MHz */
+    step_begin();
+    spi_eeprom_get_suspend_stats(0, &before);
+    prio_log_write(0, PRIO_READ_ADDR,
+            geo->t_suspend_us + 2u * EEPROM_POLL_MIN_US + 2u * EEPROM_PAGE_SIZE * 8u + 50u);
+    spi_eeprom_get_suspend_stats(0, &stats);
+    check((stats.suspends + stats.parks) == (before.suspends + before.parks + 1u), "log write set aside once");
+
+    sim_flash_default_config(&cfg);
+    cfg.t_sus_us = 0;
+    check(sim_flash_attach(PRIO_SS, &cfg), "attach part without suspend");
+    check(spi_eeprom_probe(PRIO_SS) == INIT_SUCCESS, "probe part without suspend");
+    prio_log_write(PRIO_SS, 0, cfg.t_pp_max_us + 2u * EEPROM_PAGE_SIZE * 8u + 200u);
+    spi_eeprom_get_suspend_stats(PRIO_SS, &stats);
+    check((stats.parks == 1u) && (stats.suspends == 0u), "log write parked");
+    sim_flash_detach(PRIO_SS);
+    step_end("log writes with PD reads");
+
+    /* The page program completes before the deadline needs the suspend */
+    step_begin();
+    memset(&prio_log, 0, sizeof(prio_log));
+    memset(page, 0x5A, sizeof(page));
+    memset(sim_flash_memory(0) + PRIO_ADDR, 0xFF, SPI_EEPROM_SECTOR_SIZE);
+    spi_eeprom_get_suspend_stats(0, &before);
+    check(spi_eeprom_submit_to(0, SPI_EEPROM_OP_WRITE, PRIO_ADDR, page, sizeof(page), prio_done,
+          (void *) (uintptr_t) PRIO_LOG_WRITE) == STATE_UNCONFIRMED_SUCCESS, "submit page write");
+    sim_advance_ns(100000u);
+    submit_ns = sim_time_ns();
+    check(spi_eeprom_submit_prio(0, SPI_EEPROM_OP_READ, SPI_EEPROM_PRIO_CRITICAL, PRIO_DEADLINE_US,
+          PRIO_READ_ADDR, prio_back[0], PRIO_READ_SIZE, prio_done, NULL) == STATE_UNCONFIRMED_SUCCESS,
+          "submit read with deadline");
+    wait_done("page write and read");
+    spi_eeprom_get_suspend_stats(0, &stats);
+    check(!prio_log.failed && (prio_log.order[0] == PRIO_LOG_WRITE) && (prio_log.order[1] == 0u),
+          "page program not suspended");
+    check((stats.suspends == before.suspends) && (stats.late == before.late) &&
+          ((prio_log.done_ns[0] - submit_ns) < (PRIO_DEADLINE_US + PRIO_READ_SIZE * 8u) * 1000ull),
+          "read within deadline");
+    step_end("page write, read by deadline");
+
+    /* Reads by deadline, all served in one suspend of the erase */
+    step_begin();
+    memset(&prio_log, 0, sizeof(prio_log));
+    spi_eeprom_get_suspend_stats(0, &before);
+    check(spi_eeprom_submit_to(0, SPI_EEPROM_OP_ERASE_4K, PRIO_ADDR, NULL, 0, prio_done,
+          (void *) (uintptr_t) PRIO_LOG_WRITE) == STATE_UNCONFIRMED_SUCCESS, "submit erase");
+    sim_advance_ns(4u * PRIO_START_NS);
+    for (uint32_t i = 0; i < PRIO_EDF_READS; i++)
+    {
+        check(spi_eeprom_submit_prio(0, SPI_EEPROM_OP_READ, SPI_EEPROM_PRIO_CRITICAL, deadlines[i], PRIO_READ_ADDR,
+              prio_back[i], PRIO_READ_SIZE, prio_done, (void *) (uintptr_t) i) == STATE_UNCONFIRMED_SUCCESS,
+              "submit read by deadline");
+    }
+    wait_done("erase with reads by deadline");
+    spi_eeprom_get_suspend_stats(0, &stats);
+    check(!prio_log.failed && (prio_log.order[0] == 1u) && (prio_log.order[1] == 2u) &&
+          (prio_log.order[2] == 0u) && (prio_log.order[3] == PRIO_LOG_WRITE), "earliest deadline first");
+    check((stats.suspends == before.suspends + 1u) && (stats.late == before.late), "one suspend in time");
+    step_end("erase, reads by deadline");
+
+    /* Critical reads back to back: the write set aside and the read queued
+     * behind them go once SPI_EEPROM_STARVATION_LIMIT have passed */
+    step_begin();
+    memset(&prio_log, 0, sizeof(prio_log));
+    memset(chain_data, 0xC3, sizeof(chain_data));
+    memset(sim_flash_memory(0) + PRIO_ADDR, 0xFF, SPI_EEPROM_SECTOR_SIZE);
+    spi_eeprom_get_suspend_stats(0, &before);
+    check(spi_eeprom_submit_to(0, SPI_EEPROM_OP_WRITE, PRIO_ADDR, chain_data, sizeof(chain_data), prio_done,
+          (void *) (uintptr_t) PRIO_LOG_WRITE) == STATE_UNCONFIRMED_SUCCESS, "submit background write");
+    check(spi_eeprom_submit_to(0, SPI_EEPROM_OP_READ, PRIO_READ_ADDR, prio_back[PRIO_LOG_READ], PRIO_READ_SIZE,
+          prio_done, (void *) (uintptr_t) PRIO_LOG_READ) == STATE_UNCONFIRMED_SUCCESS, "submit background read");
+    sim_advance_ns(PRIO_START_NS / 4u);
+    check(spi_eeprom_submit_prio(0, SPI_EEPROM_OP_READ, SPI_EEPROM_PRIO_CRITICAL, 0, PRIO_READ_ADDR, prio_back[0],
+          PRIO_READ_SIZE, prio_chain_done, NULL) == STATE_UNCONFIRMED_SUCCESS, "submit read chain");
+    wait_done("read chain");
+    spi_eeprom_get_suspend_stats(0, &stats);
+    check(!prio_log.failed && (prio_log.count == PRIO_CHAIN + 2u), "read chain completed");
+    for (uint32_t i = 0; i < SPI_EEPROM_STARVATION_LIMIT; i++)
+    {
+        check(prio_log.order[i] == i, "critical reads first");
+    }
+    check((prio_log.order[SPI_EEPROM_STARVATION_LIMIT] == PRIO_LOG_WRITE) &&
+          (prio_log.order[SPI_EEPROM_STARVATION_LIMIT + 1u] == PRIO_LOG_READ), "background not starved");
+    check(stats.starved == before.starved + 1u, "starved stats");
+    check(memcmp(sim_flash_memory(0) + PRIO_ADDR, chain_data, sizeof(chain_data)) == 0, "background write data");
+    step_end("read chain, background");
+}
+
+int main(void)
+{
+    sim_init();
+
+    run_example();
+    run_throughput();
+    run_calibration();
+    run_async();
+    run_queue();
+    run_cache();
+    run_writeback();
+    run_update();
+    run_erase();
+    run_skip();
+    run_kv();
+    run_log();
+    run_crc();
+    run_verify();
+    run_trace();
+    run_devices();
+    run_stripe();
+    run_geometry();
+    run_suspend();
+    run_priority();
+
+    printf("PASS\n");
+    return EXIT_SUCCESS;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,389 @@
+/******************************************************************************
+ * File Name: cy_pdl.h
+ *
+ * Description: Host stand-in for the PMG1 peripheral driver library. Declares
+ *              the subset of the DMAC, SCB SPI, SysInt, SysClk and SysLib
+ *              API used by the flash driver. The functions are implemented by
+ *              the simulation models in host/sim.
+ *
+ * Related Document: See README.md
+ *
+ *******************************************************************************
+ * Copyright 2023, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+#ifndef HOST_CY_PDL_H_
+#define HOST_CY_PDL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+/*******************************************************************************
+* Result / assert
+*******************************************************************************/
+typedef uint32_t cy_rslt_t;
+
+#define CY_RSLT_SUCCESS                 ((cy_rslt_t)0x00000000U)
+
+void sim_assert_failed(const char *file, int line);
+#define CY_ASSERT(x)                    do { if (!(x)) { sim_assert_failed(__FILE__, __LINE__); } } while (0)
+
+/*******************************************************************************
+* Interrupts (NVIC / SysInt)
+*******************************************************************************/
+typedef enum
+{
+    cpuss_interrupt_dma_IRQn = 10,
+    tcpwm_interrupts_0_IRQn  = 17,
+    tcpwm_interrupts_1_IRQn  = 18,
+    tcpwm_interrupts_2_IRQn  = 19,
+    tcpwm_interrupts_3_IRQn  = 20,
+    SIM_IRQ_COUNT            = 32
+} IRQn_Type;
+
+typedef void (* cy_israddress)(void);
+
+typedef struct
+{
+    IRQn_Type       intrSrc;
+    uint32_t        intrPriority;
+} cy_stc_sysint_t;
+
+typedef enum
+{
+    CY_SYSINT_SUCCESS   = 0x00U,
+    CY_SYSINT_BAD_PARAM = 0x01U
+} cy_en_sysint_status_t;
+
+cy_en_sysint_status_t Cy_SysInt_Init(const cy_stc_sysint_t *config, cy_israddress userIsr);
+void NVIC_EnableIRQ(IRQn_Type IRQn);
+void NVIC_DisableIRQ(IRQn_Type IRQn);
+void NVIC_ClearPendingIRQ(IRQn_Type IRQn);
+void __enable_irq(void);
+void __disable_irq(void);
+
+/*******************************************************************************
+* SysLib
+*******************************************************************************/
+uint32_t Cy_SysLib_EnterCriticalSection(void);
+void Cy_SysLib_ExitCriticalSection(uint32_t savedIntrStatus);
+void Cy_SysLib_Delay(uint32_t milliseconds);
+void Cy_SysLib_DelayUs(uint16_t microseconds);
+
+/*******************************************************************************
+* DMAC
+*******************************************************************************/
+typedef struct sim_dmac DMAC_Type;
+
+#define CY_DMAC_INTR_CHAN_0             (1UL << 0)
+#define CY_DMAC_INTR_CHAN_1             (1UL << 1)
+#define CY_DMAC_INTR_CHAN_2             (1UL << 2)
+#define CY_DMAC_INTR_CHAN_3             (1UL << 3)
+
+typedef enum
+{
+    CY_DMAC_SUCCESS   = 0x0UL,
+    CY_DMAC_BAD_PARAM = 0x1UL
+} cy_en_dmac_status_t;
+
+typedef enum
+{
+    CY_DMAC_DESCRIPTOR_PING = 0,
+    CY_DMAC_DESCRIPTOR_PONG = 1
+} cy_en_dmac_descriptor_t;
+
+typedef enum
+{
+    CY_DMAC_NO_ERROR      = 0x0U,
+    CY_DMAC_DONE          = 0x1U,
+    CY_DMAC_SRC_BUS_ERROR = 0x2U,
+    CY_DMAC_DST_BUS_ERROR = 0x3U,
+    CY_DMAC_SRC_MISAL     = 0x4U,
+    CY_DMAC_DST_MISAL     = 0x5U,
+    CY_DMAC_INVALID_DESCR = 0x6U
+} cy_en_dmac_response_t;
+
+typedef enum
+{
+    CY_DMAC_BYTE        = 0,
+    CY_DMAC_HALFWORD    = 1,
+    CY_DMAC_WORD        = 2,
+    CY_DMAC_BYTE_TO_WORD,
+    CY_DMAC_WORD_TO_BYTE
+} cy_en_dmac_data_transfer_width_t;
+
+typedef enum
+{
+    CY_DMAC_SINGLE_ELEMENT = 0,
+    CY_DMAC_SINGLE_DESCR   = 1
+} cy_en_dmac_trigger_type_t;
+
+typedef enum
+{
+    CY_DMAC_RETRIG_IM      = 0,
+    CY_DMAC_RETRIG_4CYC    = 1,
+    CY_DMAC_RETRIG_16CYC   = 2,
+    CY_DMAC_WAIT_FOR_REACT = 3
+} cy_en_dmac_retrigger_t;
+
+typedef struct
+{
+    void *                              srcAddress;
+    void *                              dstAddress;
+    uint32_t                            dataCount;
+    cy_en_dmac_data_transfer_width_t    dataTransferWidth;
+    bool                                srcAddrIncrement;
+    bool                                dstAddrIncrement;
+    cy_en_dmac_retrigger_t              retrigger;
+    bool                                cpltState;
+    bool                                interrupt;
+    bool                                preemptable;
+    bool                                flipping;
+    cy_en_dmac_trigger_type_t           triggerType;
+} cy_stc_dmac_descriptor_config_t;
+
+typedef struct
+{
+    cy_en_dmac_descriptor_t             descriptor;
+    uint32_t                            priority;
+    bool                                enable;
+} cy_stc_dmac_channel_config_t;
+
+cy_en_dmac_status_t Cy_DMAC_Descriptor_Init(DMAC_Type *base, uint32_t channel,
+        cy_en_dmac_descriptor_t descriptor, const cy_stc_dmac_descriptor_config_t *config);
+cy_en_dmac_status_t Cy_DMAC_Channel_Init(DMAC_Type *base, uint32_t channel,
+        const cy_stc_dmac_channel_config_t *config);
+void Cy_DMAC_Descriptor_SetSrcAddress(DMAC_Type *base, uint32_t channel,
+        cy_en_dmac_descriptor_t descriptor, const void *srcAddress);
+void Cy_DMAC_Descriptor_SetDstAddress(DMAC_Type *base, uint32_t channel,
+        cy_en_dmac_descriptor_t descriptor, const void *dstAddress);
+void Cy_DMAC_Descriptor_SetDataCount(DMAC_Type *base, uint32_t channel,
+        cy_en_dmac_descriptor_t descriptor, uint32_t dataCount);
+void Cy_DMAC_Descriptor_SetSrcIncrement(DMAC_Type *base, uint32_t channel,
+        cy_en_dmac_descriptor_t descriptor, bool srcAddrIncrement);
+void Cy_DMAC_Descriptor_SetDstIncrement(DMAC_Type *base, uint32_t channel,
+        cy_en_dmac_descriptor_t descriptor, bool dstAddrIncrement);
+void Cy_DMAC_Descriptor_SetInterrupt(DMAC_Type *base, uint32_t channel,
+        cy_en_dmac_descriptor_t descriptor, bool interrupt);
+void Cy_DMAC_Descriptor_SetFlipping(DMAC_Type *base, uint32_t channel,
+        cy_en_dmac_descriptor_t descriptor, bool flipping);
+void Cy_DMAC_Descriptor_SetState(DMAC_Type *base, uint32_t channel,
+        cy_en_dmac_descriptor_t descriptor, bool valid);
+cy_en_dmac_response_t Cy_DMAC_Descriptor_GetResponse(DMAC_Type const *base, uint32_t channel,
+        cy_en_dmac_descriptor_t descriptor);
+void Cy_DMAC_Channel_SetCurrentDescriptor(DMAC_Type *base, uint32_t channel,
+        cy_en_dmac_descriptor_t descriptor);
+cy_en_dmac_descriptor_t Cy_DMAC_Channel_GetCurrentDescriptor(DMAC_Type const *base, uint32_t channel);
+void Cy_DMAC_Channel_Enable(DMAC_Type *base, uint32_t channel);
+void Cy_DMAC_Channel_Disable(DMAC_Type *base, uint32_t channel);
+void Cy_DMAC_Enable(DMAC_Type *base);
+void Cy_DMAC_Disable(DMAC_Type *base);
+uint32_t Cy_DMAC_GetInterruptStatus(DMAC_Type const *base);
+uint32_t Cy_DMAC_GetInterruptStatusMasked(DMAC_Type const *base);
+void Cy_DMAC_ClearInterrupt(DMAC_Type *base, uint32_t interrupt);
+void Cy_DMAC_SetInterrupt(DMAC_Type *base, uint32_t interrupt);
+uint32_t Cy_DMAC_GetInterruptMask(DMAC_Type const *base);
+void Cy_DMAC_SetInterruptMask(DMAC_Type *base, uint32_t interrupt);
+
+/*******************************************************************************
+* SCB SPI
+*******************************************************************************/
+typedef struct
+{
+    volatile uint32_t CTRL;
+    volatile uint32_t TX_FIFO_WR;
+    volatile uint32_t RX_FIFO_RD;
+} CySCB_Type;
+
+#define CY_SCB_SPI_DEFAULT_TX           (0x0000FFFFUL)
+#define CY_SCB_SPI_MASTER_DONE          (1UL << 9)
+
+typedef enum
+{
+    CY_SCB_SPI_SUCCESS   = 0x00U,
+    CY_SCB_SPI_BAD_PARAM = 0x01U
+} cy_en_scb_spi_status_t;
+
+typedef enum
+{
+    CY_SCB_SPI_SLAVE_SELECT0 = 0U,
+    CY_SCB_SPI_SLAVE_SELECT1 = 1U,
+    CY_SCB_SPI_SLAVE_SELECT2 = 2U,
+    CY_SCB_SPI_SLAVE_SELECT3 = 3U
+} cy_en_scb_spi_slave_select_t;
+
+typedef struct
+{
+    uint32_t    spiMode;
+    uint32_t    subMode;
+    uint32_t    sclkMode;
+    uint32_t    oversample;
+    uint32_t    rxDataWidth;
+    uint32_t    txDataWidth;
+    bool        enableMsbFirst;
+    bool        enableFreeRunSclk;
+    bool        enableTransferSeperation;
+    uint32_t    rxFifoTriggerLevel;
+    uint32_t    txFifoTriggerLevel;
+} cy_stc_scb_spi_config_t;
+
+typedef struct
+{
+    uint32_t    status;
+} cy_stc_scb_spi_context_t;
+
+cy_en_scb_spi_status_t Cy_SCB_SPI_Init(CySCB_Type *base, cy_stc_scb_spi_config_t const *config,
+        cy_stc_scb_spi_context_t *context);
+void Cy_SCB_SPI_Enable(CySCB_Type *base);
+void Cy_SCB_SPI_Disable(CySCB_Type *base, cy_stc_scb_spi_context_t *context);
+bool Cy_SCB_SPI_IsTxComplete(CySCB_Type const *base);
+bool Cy_SCB_SPI_IsBusBusy(CySCB_Type const *base);
+uint32_t Cy_SCB_SPI_GetSlaveMasterStatus(CySCB_Type const *base);
+void Cy_SCB_SPI_ClearSlaveMasterStatus(CySCB_Type *base, uint32_t clearMask);
+void Cy_SCB_SPI_ClearRxFifo(CySCB_Type *base);
+void Cy_SCB_SPI_ClearTxFifo(CySCB_Type *base);
+uint32_t Cy_SCB_SPI_GetNumInTxFifo(CySCB_Type const *base);
+uint32_t Cy_SCB_SPI_GetNumInRxFifo(CySCB_Type const *base);
+void Cy_SCB_SPI_SetActiveSlaveSelect(CySCB_Type *base, cy_en_scb_spi_slave_select_t slaveSelect);
+
+/*******************************************************************************
+* SysClk peripheral dividers
+*******************************************************************************/
+typedef enum
+{
+    CY_SYSCLK_DIV_8_BIT     = 0U,
+    CY_SYSCLK_DIV_16_BIT    = 1U,
+    CY_SYSCLK_DIV_16_5_BIT  = 2U,
+    CY_SYSCLK_DIV_24_5_BIT  = 3U
+} cy_en_divider_types_t;
+
+typedef enum
+{
+    CY_SYSCLK_SUCCESS   = 0x0UL,
+    CY_SYSCLK_BAD_PARAM = 0x1UL
+} cy_en_sysclk_status_t;
+
+/* Peripheral clock destinations (subset) */
+typedef enum
+{
+    PCLK_SCB0_CLOCK         = 0U,
+    PCLK_TCPWM_CLOCKS0      = 8U,
+    PCLK_TCPWM_CLOCKS1      = 9U,
+    PCLK_TCPWM_CLOCKS2      = 10U,
+    PCLK_TCPWM_CLOCKS3      = 11U
+} en_clk_dst_t;
+
+cy_en_sysclk_status_t Cy_SysClk_PeriphSetDivider(cy_en_divider_types_t dividerType,
+        uint32_t dividerNum, uint32_t dividerValue);
+uint32_t Cy_SysClk_PeriphGetDivider(cy_en_divider_types_t dividerType, uint32_t dividerNum);
+cy_en_sysclk_status_t Cy_SysClk_PeriphEnableDivider(cy_en_divider_types_t dividerType,
+        uint32_t dividerNum);
+cy_en_sysclk_status_t Cy_SysClk_PeriphDisableDivider(cy_en_divider_types_t dividerType,
+        uint32_t dividerNum);
+uint32_t Cy_SysClk_ClkPeriGetFrequency(void);
+cy_en_sysclk_status_t Cy_SysClk_PeriphAssignDivider(en_clk_dst_t ipBlock,
+        cy_en_divider_types_t dividerType, uint32_t dividerNum);
+
+/*******************************************************************************
+* TCPWM counter
+*******************************************************************************/
+typedef struct sim_tcpwm TCPWM_Type;
+
+extern TCPWM_Type sim_tcpwm0;
+#define TCPWM                               (&sim_tcpwm0)
+
+#define CY_TCPWM_INT_NONE                   (0UL)
+#define CY_TCPWM_INT_ON_TC                  (1UL)
+#define CY_TCPWM_INT_ON_CC                  (2UL)
+#define CY_TCPWM_INT_ON_CC_OR_TC            (3UL)
+
+#define CY_TCPWM_COUNTER_PRESCALER_DIVBY_1  (0UL)
+
+#define CY_TCPWM_COUNTER_CONTINUOUS         (0UL)
+#define CY_TCPWM_COUNTER_ONESHOT            (1UL)
+
+#define CY_TCPWM_COUNTER_COUNT_UP           (0UL)
+
+#define CY_TCPWM_COUNTER_MODE_CAPTURE       (2UL)
+#define CY_TCPWM_COUNTER_MODE_COMPARE       (0UL)
+
+#define CY_TCPWM_INPUT_RISINGEDGE           (0UL)
+#define CY_TCPWM_INPUT_LEVEL                (3UL)
+#define CY_TCPWM_INPUT_0                    (0UL)
+#define CY_TCPWM_INPUT_1                    (1UL)
+
+typedef enum
+{
+    CY_TCPWM_SUCCESS    = 0x00U,
+    CY_TCPWM_BAD_PARAM  = 0x01U
+} cy_en_tcpwm_status_t;
+
+typedef struct
+{
+    uint32_t    period;
+    uint32_t    clockPrescaler;
+    uint32_t    runMode;
+    uint32_t    countDirection;
+    uint32_t    compareOrCapture;
+    uint32_t    compare0;
+    uint32_t    compare1;
+    bool        enableCompareSwap;
+    uint32_t    interruptSources;
+    uint32_t    captureInputMode;
+    uint32_t    captureInput;
+    uint32_t    reloadInputMode;
+    uint32_t    reloadInput;
+    uint32_t    startInputMode;
+    uint32_t    startInput;
+    uint32_t    stopInputMode;
+    uint32_t    stopInput;
+    uint32_t    countInputMode;
+    uint32_t    countInput;
+} cy_stc_tcpwm_counter_config_t;
+
+cy_en_tcpwm_status_t Cy_TCPWM_Counter_Init(TCPWM_Type *base, uint32_t cntNum,
+        cy_stc_tcpwm_counter_config_t const *config);
+void Cy_TCPWM_Counter_Enable(TCPWM_Type *base, uint32_t cntNum);
+void Cy_TCPWM_Counter_Disable(TCPWM_Type *base, uint32_t cntNum);
+void Cy_TCPWM_TriggerStart(TCPWM_Type *base, uint32_t counters);
+void Cy_TCPWM_TriggerStopOrKill(TCPWM_Type *base, uint32_t counters);
+void Cy_TCPWM_Counter_SetCounter(TCPWM_Type *base, uint32_t cntNum, uint32_t count);
+uint32_t Cy_TCPWM_Counter_GetCounter(TCPWM_Type const *base, uint32_t cntNum);
+void Cy_TCPWM_Counter_SetPeriod(TCPWM_Type *base, uint32_t cntNum, uint32_t period);
+uint32_t Cy_TCPWM_GetInterruptStatusMasked(TCPWM_Type const *base, uint32_t cntNum);
+void Cy_TCPWM_ClearInterrupt(TCPWM_Type *base, uint32_t cntNum, uint32_t source);
+
+#endif /* HOST_CY_PDL_H_ */
+
+/* [] END OF FILE */
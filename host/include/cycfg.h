@@ -0,0 +1,88 @@
+/******************************************************************************
+ * File Name: cycfg.h
+ *
+ * Description: Host stand-in for the generated device configuration. Mirrors
+ *              the DMA, SCB and clock settings of
+ *              templates/TARGET_PMG1-CY7113/config/design.modus so the flash
+ *              driver sees the same resources as on the board.
+ *
+ * Related Document: See README.md
+ *
+ *******************************************************************************
+ * Copyright 2023, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+
+#ifndef HOST_CYCFG_H_
+#define HOST_CYCFG_H_
+
+#include "cy_pdl.h"
+
+/*******************************************************************************
+* DMA (cycfg_dmas.h)
+*******************************************************************************/
+extern DMAC_Type sim_dmac0;
+
+#define rxDma_ENABLED       1U
+#define rxDma_HW            (&sim_dmac0)
+#define rxDma_CHANNEL       0U
+#define txDma_ENABLED       1U
+#define txDma_HW            (&sim_dmac0)
+#define txDma_CHANNEL       1U
+
+extern const cy_stc_dmac_descriptor_config_t rxDma_ping_config;
+extern const cy_stc_dmac_descriptor_config_t rxDma_pong_config;
+extern const cy_stc_dmac_channel_config_t rxDma_channel_config;
+extern const cy_stc_dmac_descriptor_config_t txDma_ping_config;
+extern const cy_stc_dmac_descriptor_config_t txDma_pong_config;
+extern const cy_stc_dmac_channel_config_t txDma_channel_config;
+
+/*******************************************************************************
+* SCB (cycfg_peripherals.h)
+*******************************************************************************/
+extern CySCB_Type sim_scb0;
+
+#define FLASH_SPI_ENABLED   1U
+#define FLASH_SPI_HW        (&sim_scb0)
+
+extern const cy_stc_scb_spi_config_t FLASH_SPI_config;
+
+/*******************************************************************************
+* Clocks (cycfg_clocks.h)
+*******************************************************************************/
+#define CYBSP_CLK_SPI_ENABLED   1U
+#define CYBSP_CLK_SPI_HW        CY_SYSCLK_DIV_16_BIT
+#define CYBSP_CLK_SPI_NUM       0U
+
+#endif /* HOST_CYCFG_H_ */
+
+/* [] END OF FILE */
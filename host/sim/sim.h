@@ -0,0 +1,172 @@
+/******************************************************************************
+ * File Name: sim.h
+ *
+ * Description: Control interface of the host simulation. Host programs use it
+ *              to reset the simulated PMG1 peripherals, attach flash models
+ *              to the slave select lines, advance virtual time and read bus
+ *              and interrupt statistics.
+ *
+ * Related Document: See README.md
+ *
+ *******************************************************************************
+ * Copyright 2023, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+
+#ifndef HOST_SIM_H_
+#define HOST_SIM_H_
+
+/*******************************************************************************
+ * Include header files
+ ******************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Number of slave select lines of the simulated SCB (Ss0 - Ss3) */
+#define SIM_SPI_SS_COUNT            (4u)
+
+/* Peripheral clock feeding the SCB dividers (CLK_PERI in design.modus) */
+#define SIM_CLK_PERI_HZ             (48000000u)
+
+/* Virtual time value meaning "never" */
+#define SIM_TIME_NEVER              (UINT64_MAX)
+
+/******************************************************************************
+ * Structure/Enum type declaration
+ ******************************************************************************/
+/* CPU cost model applied to interrupt handlers and main-loop polling */
+typedef struct
+{
+    uint32_t    isr_latency_ns;     /* Interrupt raised until handler runs */
+    uint32_t    isr_cost_ns;        /* CPU time charged per handler invocation */
+    uint32_t    poll_ns;            /* Virtual time consumed by one status poll */
+} sim_cpu_config_t;
+
+/* Program/erase time selection of the flash model */
+typedef enum
+{
+    SIM_FLASH_TIMING_TYP = 0,       /* Always use the typical datasheet time */
+    SIM_FLASH_TIMING_MAX,           /* Always use the maximum datasheet time */
+    SIM_FLASH_TIMING_SPREAD         /* Random between typical and maximum, skewed to typical */
+} sim_flash_timing_t;
+
+/* Methods to enter 4-byte addressing, as in SFDP BFPT DWORD16 bits 31:24 */
+#define SIM_FLASH_EN4B          (1u << 0)   /* EN4B (0xB7) */
+#define SIM_FLASH_EN4B_WREN     (1u << 1)   /* WREN, then EN4B */
+#define SIM_FLASH_EN4B_BANK     (1u << 3)   /* Bank register (0x17), not modeled */
+
+/* Behavioral description of one serial NOR flash device */
+typedef struct
+{
+    uint32_t            size_bytes;     /* Array size */
+    uint32_t            page_size;      /* Page program buffer size */
+    uint8_t             jedec_id[3];    /* RDID (0x9F) response */
+    uint8_t             status_init;    /* Status register 1 after power-up */
+    uint32_t            t_pp_typ_us;    /* Page program */
+    uint32_t            t_pp_max_us;
+    uint32_t            t_se_typ_us;    /* 4 KB sector erase */
+    uint32_t            t_se_max_us;
+    uint32_t            t_be32_typ_us;  /* 32 KB block erase */
+    uint32_t            t_be32_max_us;
+    uint32_t            t_be64_typ_us;  /* 64 KB block erase */
+    uint32_t            t_be64_max_us;
+    uint32_t            t_ce_typ_ms;    /* Chip erase */
+    uint32_t            t_ce_max_ms;
+    uint32_t            t_w_typ_us;     /* Write status register */
+    uint32_t            t_w_max_us;
+    uint32_t            t_sus_us;       /* Program/erase suspend latency, 0 without suspend */
+    uint32_t            t_rs_us;        /* Resume to the next suspend with progress */
+    uint32_t            read_max_hz;    /* SCLK limit of READ (0x03) */
+    uint32_t            fast_read_max_hz; /* SCLK limit of FAST_READ (0x0B) */
+    uint32_t            sclk_max_hz;    /* Board limit for MISO of any command, 0 for none */
+    bool                sfdp;           /* Answer RDSFDP (0x5A) with tables built from this config */
+    uint8_t             en4b;           /* Above 16 MB: SIM_FLASH_EN4B_* methods entering 4-byte mode */
+    sim_flash_timing_t  timing;
+    uint32_t            seed;           /* Seed for SIM_FLASH_TIMING_SPREAD */
+} sim_flash_config_t;
+
+/* Accumulated bus, DMA and CPU statistics */
+typedef struct
+{
+    uint64_t    bus_busy_ns;        /* Time with a slave select asserted */
+    uint64_t    bus_bytes;          /* Bytes shifted on the bus */
+    uint32_t    transactions;       /* Slave select assertions */
+    uint32_t    isr_count;          /* Interrupt handler invocations */
+    uint64_t    isr_ns;             /* CPU time charged to interrupt handlers */
+    uint32_t    polls;              /* Main-loop status polls */
+    uint32_t    rx_overflows;       /* Bytes dropped because the RX FIFO was full */
+} sim_stats_t;
+
+/* Per-device operation counters of the flash model */
+typedef struct
+{
+    uint32_t    commands;           /* Accepted commands */
+    uint32_t    ignored;            /* Commands ignored while busy or not write enabled */
+    uint32_t    page_programs;
+    uint32_t    sector_erases;
+    uint32_t    block_erases;
+    uint32_t    chip_erases;
+    uint32_t    status_polls;       /* RDSR transactions */
+    uint32_t    suspends;           /* Program/erase suspended */
+    uint64_t    busy_ns;            /* Time spent with WIP set */
+} sim_flash_stats_t;
+
+/******************************************************************************
+ * Global function declaration
+ ******************************************************************************/
+void sim_init(void);
+void sim_cpu_config(const sim_cpu_config_t *config);
+void sim_cpu_get_config(sim_cpu_config_t *config);
+
+uint64_t sim_time_ns(void);
+void sim_advance_ns(uint64_t ns);
+void sim_poll(void);
+bool sim_run_until(bool (*cond)(void), uint64_t timeout_ns);
+
+void sim_get_stats(sim_stats_t *stats);
+void sim_reset_stats(void);
+
+void sim_flash_default_config(sim_flash_config_t *config);
+bool sim_flash_attach(uint32_t ss, const sim_flash_config_t *config);
+void sim_flash_detach(uint32_t ss);
+uint8_t *sim_flash_memory(uint32_t ss);
+bool sim_flash_is_busy(uint32_t ss);
+void sim_flash_get_stats(uint32_t ss, sim_flash_stats_t *stats);
+
+uint32_t sim_spi_bitrate(void);
+
+#endif /* HOST_SIM_H_ */
+
+/* [] END OF FILE */
@@ -0,0 +1,539 @@
+/******************************************************************************
+ * File Name: sim_core.c
+ *
+ * Description: Virtual time scheduler, interrupt controller, SysLib and
+ *              SysClk models of the host simulation. Peripheral activity is
+ *              advanced event by event whenever the driver polls or a host
+ *              program advances time; interrupt handlers run at their
+ *              modelled entry time.
+ *
+ * Related Document: See README.md
+ *
+ *******************************************************************************
+ * Copyright 2023, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+
+/*******************************************************************************
+ * Include header files
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include "sim_internal.h"
+#include "cycfg.h"
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+/* Defaults of the CPU cost model (Cortex-M0 at 48 MHz) */
+#define SIM_DEFAULT_ISR_LATENCY_NS      (500u)
+#define SIM_DEFAULT_ISR_COST_NS         (4000u)
+#define SIM_DEFAULT_POLL_NS             (1000u)
+
+/* Number of 16-bit peripheral clock dividers */
+#define SIM_CLK_DIV16_COUNT             (8u)
+
+/* Number of peripheral clock destinations */
+#define SIM_CLK_DST_COUNT               (16u)
+
+/* Handler invocations without virtual time progress before a stuck
+ * interrupt is reported */
+#define SIM_ISR_STORM_LIMIT             (100000u)
+
+/*******************************************************************************
+ * Global variables declaration
+ ******************************************************************************/
+static uint64_t now_ns;
+static uint64_t cpu_busy_until_ns;
+static sim_cpu_config_t cpu_cfg;
+
+static struct
+{
+    cy_israddress   isr;
+    bool            enabled;
+    bool            asserted;
+    uint64_t        raise_ns;
+} irq_line[SIM_IRQ_COUNT];
+
+static bool irq_global_enable;
+static bool in_isr;
+
+static uint32_t isr_count;
+static uint64_t isr_ns;
+static uint32_t poll_count;
+
+static uint32_t clk_div16[SIM_CLK_DIV16_COUNT];
+
+/* 16-bit divider assigned to each peripheral clock, +1 (0: none) */
+static uint32_t clk_assign[SIM_CLK_DST_COUNT];
+
+/*******************************************************************************
+* Function Name: sim_init
+********************************************************************************
+*
+* Summary:
+*  Reset all models to their power-up state and attach one flash device with
+*  the default configuration to slave select 0.
+*
+*******************************************************************************/
+void sim_init(void)
+{
+    sim_flash_config_t flash_cfg;
+
+    now_ns = 0;
+    cpu_busy_until_ns = 0;
+    cpu_cfg = (sim_cpu_config_t)
+    {
+        .isr_latency_ns = SIM_DEFAULT_ISR_LATENCY_NS,
+        .isr_cost_ns    = SIM_DEFAULT_ISR_COST_NS,
+        .poll_ns        = SIM_DEFAULT_POLL_NS,
+    };
+    memset(irq_line, 0, sizeof(irq_line));
+    irq_global_enable = true;
+    in_isr = false;
+
+    sim_clk_reset();
+    sim_dmac_reset();
+    sim_scb_reset();
+    sim_tcpwm_reset();
+    sim_flash_reset();
+    sim_reset_stats();
+
+    sim_flash_default_config(&flash_cfg);
+    (void) sim_flash_attach(0u, &flash_cfg);
+}
+
+void sim_cpu_config(const sim_cpu_config_t *config)
+{
+    cpu_cfg = *config;
+}
+
+void sim_cpu_get_config(sim_cpu_config_t *config)
+{
+    *config = cpu_cfg;
+}
+
+uint64_t sim_now(void)
+{
+    return now_ns;
+}
+
+uint64_t sim_time_ns(void)
+{
+    return now_ns;
+}
+
+bool sim_in_isr(void)
+{
+    return in_isr;
+}
+
+void sim_assert_failed(const char *file, int line)
+{
+    fprintf(stderr, "CY_ASSERT failed at %s:%d (t=%llu ns)\n", file, line,
+            (unsigned long long) now_ns);
+    abort();
+}
+
+/*******************************************************************************
+* Function Name: sim_irq_raise
+********************************************************************************
+*
+* Summary:
+*  Called by a peripheral model when it sets an interrupt cause. The entry time
+*  of the handler is measured from the first raise of a not yet asserted line.
+*
+*******************************************************************************/
+void sim_irq_raise(IRQn_Type irq)
+{
+    if (!irq_line[irq].asserted)
+    {
+        irq_line[irq].asserted = true;
+        irq_line[irq].raise_ns = now_ns;
+    }
+}
+
+/* Returns true while the peripheral still requests the interrupt */
+static bool irq_level(IRQn_Type irq)
+{
+    if (irq == cpuss_interrupt_dma_IRQn)
+    {
+        return Cy_DMAC_GetInterruptStatusMasked(&sim_dmac0) != 0u;
+    }
+    if ((irq >= tcpwm_interrupts_0_IRQn) && (irq < (tcpwm_interrupts_0_IRQn + SIM_TCPWM_COUNTERS)))
+    {
+        return Cy_TCPWM_GetInterruptStatusMasked(TCPWM, (uint32_t) (irq - tcpwm_interrupts_0_IRQn)) != 0u;
+    }
+    return false;
+}
+
+/* Entry time of the next deliverable handler and its line */
+static uint64_t irq_next_entry(IRQn_Type *irq)
+{
+    uint64_t best = SIM_TIME_NEVER;
+
+    if (!irq_global_enable || in_isr)
+    {
+        return SIM_TIME_NEVER;
+    }
+
+    for (uint32_t i = 0; i < SIM_IRQ_COUNT; i++)
+    {
+        if (!irq_line[i].asserted)
+        {
+            continue;
+        }
+        if (!irq_level((IRQn_Type) i))
+        {
+            irq_line[i].asserted = false;
+            continue;
+        }
+        if (!irq_line[i].enabled || irq_line[i].isr == NULL)
+        {
+            continue;
+        }
+
+        uint64_t entry = irq_line[i].raise_ns + cpu_cfg.isr_latency_ns;
+        if (entry < cpu_busy_until_ns)
+        {
+            entry = cpu_busy_until_ns;
+        }
+        if (entry < now_ns)
+        {
+            entry = now_ns;
+        }
+        if (entry < best)
+        {
+            best = entry;
+            *irq = (IRQn_Type) i;
+        }
+    }
+    return best;
+}
+
+static void run_isr(IRQn_Type irq)
+{
+    in_isr = true;
+    irq_line[irq].isr();
+    in_isr = false;
+
+    isr_count++;
+    isr_ns += cpu_cfg.isr_cost_ns;
+    cpu_busy_until_ns = now_ns + cpu_cfg.isr_cost_ns;
+
+    /* A handler that does not clear its cause is entered again after the
+     * handler cost, as on the NVIC. */
+    irq_line[irq].asserted = false;
+    if (irq_level(irq))
+    {
+        sim_irq_raise(irq);
+    }
+}
+
+/*******************************************************************************
+* Function Name: sim_advance_to
+********************************************************************************
+*
+* Summary:
+*  Process all hardware events and interrupt handlers up to virtual time
+*  t_end. Does nothing when called from an interrupt handler: handlers are
+*  atomic with respect to the models.
+*
+*******************************************************************************/
+static void sim_advance_to(uint64_t t_end)
+{
+    uint32_t storm = 0;
+
+    if (in_isr)
+    {
+        return;
+    }
+
+    for (;;)
+    {
+        IRQn_Type irq = cpuss_interrupt_dma_IRQn;
+        uint64_t t_hw;
+        uint64_t t_irq;
+
+        uint64_t t_timer;
+
+        sim_dmac_service();
+        t_hw = sim_scb_next_event();
+        t_timer = sim_tcpwm_next_event();
+        t_irq = irq_next_entry(&irq);
+
+        if ((t_timer < t_hw) && (t_timer <= t_irq) && (t_timer <= t_end))
+        {
+            if (t_timer > now_ns)
+            {
+                now_ns = t_timer;
+            }
+            sim_tcpwm_event();
+            storm = 0;
+            continue;
+        }
+
+        if ((t_hw > t_end) && (t_irq > t_end))
+        {
+            break;
+        }
+
+        if (t_hw <= t_irq)
+        {
+            if (t_hw > now_ns)
+            {
+                now_ns = t_hw;
+            }
+            sim_scb_event();
+            storm = 0;
+        }
+        else
+        {
+            if (t_irq > now_ns)
+            {
+                now_ns = t_irq;
+                storm = 0;
+            }
+            else if (++storm > SIM_ISR_STORM_LIMIT)
+            {
+                fprintf(stderr, "interrupt %d never cleared (t=%llu ns)\n", (int) irq,
+                        (unsigned long long) now_ns);
+                abort();
+            }
+            run_isr(irq);
+        }
+    }
+
+    if (now_ns < t_end)
+    {
+        now_ns = t_end;
+    }
+}
+
+void sim_advance_ns(uint64_t ns)
+{
+    sim_advance_to(now_ns + ns);
+}
+
+/*******************************************************************************
+* Function Name: sim_poll
+********************************************************************************
+*
+* Summary:
+*  One iteration of a main-loop busy wait. Called by the status functions the
+*  driver polls (Cy_SCB_SPI_IsTxComplete) so that unchanged polling loops make
+*  virtual time progress.
+*
+*******************************************************************************/
+void sim_poll(void)
+{
+    if (in_isr)
+    {
+        return;
+    }
+    poll_count++;
+    sim_advance_to(now_ns + cpu_cfg.poll_ns);
+}
+
+bool sim_run_until(bool (*cond)(void), uint64_t timeout_ns)
+{
+    uint64_t deadline = now_ns + timeout_ns;
+
+    while (!cond())
+    {
+        if (now_ns >= deadline)
+        {
+            return false;
+        }
+        sim_poll();
+    }
+    return true;
+}
+
+void sim_get_stats(sim_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    sim_scb_get_stats(stats);
+    stats->isr_count = isr_count;
+    stats->isr_ns = isr_ns;
+    stats->polls = poll_count;
+}
+
+void sim_reset_stats(void)
+{
+    isr_count = 0;
+    isr_ns = 0;
+    poll_count = 0;
+    sim_scb_reset_stats();
+}
+
+/*******************************************************************************
+* SysInt / NVIC
+*******************************************************************************/
+cy_en_sysint_status_t Cy_SysInt_Init(const cy_stc_sysint_t *config, cy_israddress userIsr)
+{
+    if ((config == NULL) || ((uint32_t) config->intrSrc >= SIM_IRQ_COUNT))
+    {
+        return CY_SYSINT_BAD_PARAM;
+    }
+    irq_line[config->intrSrc].isr = userIsr;
+    return CY_SYSINT_SUCCESS;
+}
+
+void NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+    irq_line[IRQn].enabled = true;
+}
+
+void NVIC_DisableIRQ(IRQn_Type IRQn)
+{
+    irq_line[IRQn].enabled = false;
+}
+
+void NVIC_ClearPendingIRQ(IRQn_Type IRQn)
+{
+    irq_line[IRQn].asserted = false;
+}
+
+void __enable_irq(void)
+{
+    irq_global_enable = true;
+}
+
+void __disable_irq(void)
+{
+    irq_global_enable = false;
+}
+
+/*******************************************************************************
+* SysLib
+*******************************************************************************/
+uint32_t Cy_SysLib_EnterCriticalSection(void)
+{
+    uint32_t saved = irq_global_enable ? 0u : 1u;
+
+    irq_global_enable = false;
+    return saved;
+}
+
+void Cy_SysLib_ExitCriticalSection(uint32_t savedIntrStatus)
+{
+    irq_global_enable = (savedIntrStatus == 0u);
+}
+
+void Cy_SysLib_Delay(uint32_t milliseconds)
+{
+    sim_advance_to(now_ns + (uint64_t) milliseconds * 1000000u);
+}
+
+void Cy_SysLib_DelayUs(uint16_t microseconds)
+{
+    sim_advance_to(now_ns + (uint64_t) microseconds * 1000u);
+}
+
+/*******************************************************************************
+* SysClk peripheral dividers
+*******************************************************************************/
+void sim_clk_reset(void)
+{
+    /* CYBSP_CLK_SPI: 48 MHz / 3 = 16 MHz, 1 Mbps with oversample 16 */
+    memset(clk_div16, 0, sizeof(clk_div16));
+    clk_div16[0] = 2u;
+    memset(clk_assign, 0, sizeof(clk_assign));
+    clk_assign[PCLK_SCB0_CLOCK] = 1u;
+}
+
+/* Division factor of the divider feeding a peripheral, 0 if none assigned */
+uint32_t sim_clk_divider(en_clk_dst_t ip_block)
+{
+    if (((uint32_t) ip_block >= SIM_CLK_DST_COUNT) || (clk_assign[ip_block] == 0u))
+    {
+        return 0u;
+    }
+    return clk_div16[clk_assign[ip_block] - 1u] + 1u;
+}
+
+cy_en_sysclk_status_t Cy_SysClk_PeriphAssignDivider(en_clk_dst_t ipBlock,
+        cy_en_divider_types_t dividerType, uint32_t dividerNum)
+{
+    if (((uint32_t) ipBlock >= SIM_CLK_DST_COUNT) || (dividerType != CY_SYSCLK_DIV_16_BIT) ||
+        (dividerNum >= SIM_CLK_DIV16_COUNT))
+    {
+        return CY_SYSCLK_BAD_PARAM;
+    }
+    clk_assign[ipBlock] = dividerNum + 1u;
+    return CY_SYSCLK_SUCCESS;
+}
+
+cy_en_sysclk_status_t Cy_SysClk_PeriphSetDivider(cy_en_divider_types_t dividerType,
+        uint32_t dividerNum, uint32_t dividerValue)
+{
+    if ((dividerType != CY_SYSCLK_DIV_16_BIT) || (dividerNum >= SIM_CLK_DIV16_COUNT) ||
+        (dividerValue > 0xFFFFu))
+    {
+        return CY_SYSCLK_BAD_PARAM;
+    }
+    clk_div16[dividerNum] = dividerValue;
+    return CY_SYSCLK_SUCCESS;
+}
+
+uint32_t Cy_SysClk_PeriphGetDivider(cy_en_divider_types_t dividerType, uint32_t dividerNum)
+{
+    if ((dividerType != CY_SYSCLK_DIV_16_BIT) || (dividerNum >= SIM_CLK_DIV16_COUNT))
+    {
+        return 0u;
+    }
+    return clk_div16[dividerNum];
+}
+
+cy_en_sysclk_status_t Cy_SysClk_PeriphEnableDivider(cy_en_divider_types_t dividerType,
+        uint32_t dividerNum)
+{
+    (void) dividerType;
+    (void) dividerNum;
+    return CY_SYSCLK_SUCCESS;
+}
+
+cy_en_sysclk_status_t Cy_SysClk_PeriphDisableDivider(cy_en_divider_types_t dividerType,
+        uint32_t dividerNum)
+{
+    (void) dividerType;
+    (void) dividerNum;
+    return CY_SYSCLK_SUCCESS;
+}
+
+uint32_t Cy_SysClk_ClkPeriGetFrequency(void)
+{
+    return SIM_CLK_PERI_HZ;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,151 @@
+/******************************************************************************
+ * File Name: sim_cycfg.c
+ *
+ * Description: Host copy of the generated configuration structures for the
+ *              DMA channels and FLASH_SPI, with the values set in
+ *              templates/TARGET_PMG1-CY7113/config/design.modus.
+ *
+ * Related Document: See README.md
+ *
+ *******************************************************************************
+ * Copyright 2023, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+
+/*******************************************************************************
+ * Include header files
+ ******************************************************************************/
+#include "cycfg.h"
+
+/*******************************************************************************
+* rxDma: cpuss[0].dmac[0].chan[0], triggered by scb[0].tr_rx_req
+*******************************************************************************/
+const cy_stc_dmac_descriptor_config_t rxDma_ping_config =
+{
+    .srcAddress         = NULL,
+    .dstAddress         = NULL,
+    .dataCount          = 4u,
+    .dataTransferWidth  = CY_DMAC_WORD_TO_BYTE,
+    .srcAddrIncrement   = false,
+    .dstAddrIncrement   = true,
+    .retrigger          = CY_DMAC_RETRIG_IM,
+    .cpltState          = true,
+    .interrupt          = false,
+    .preemptable        = true,
+    .flipping           = true,
+    .triggerType        = CY_DMAC_SINGLE_ELEMENT,
+};
+
+const cy_stc_dmac_descriptor_config_t rxDma_pong_config =
+{
+    .srcAddress         = NULL,
+    .dstAddress         = NULL,
+    .dataCount          = 1u,
+    .dataTransferWidth  = CY_DMAC_WORD_TO_BYTE,
+    .srcAddrIncrement   = false,
+    .dstAddrIncrement   = true,
+    .retrigger          = CY_DMAC_RETRIG_IM,
+    .cpltState          = true,
+    .interrupt          = true,
+    .preemptable        = true,
+    .flipping           = false,
+    .triggerType        = CY_DMAC_SINGLE_ELEMENT,
+};
+
+const cy_stc_dmac_channel_config_t rxDma_channel_config =
+{
+    .descriptor         = CY_DMAC_DESCRIPTOR_PING,
+    .priority           = 3u,
+    .enable             = false,
+};
+
+/*******************************************************************************
+* txDma: cpuss[0].dmac[0].chan[1], triggered by scb[0].tr_tx_req
+*******************************************************************************/
+const cy_stc_dmac_descriptor_config_t txDma_ping_config =
+{
+    .srcAddress         = NULL,
+    .dstAddress         = NULL,
+    .dataCount          = 4u,
+    .dataTransferWidth  = CY_DMAC_BYTE_TO_WORD,
+    .srcAddrIncrement   = true,
+    .dstAddrIncrement   = false,
+    .retrigger          = CY_DMAC_RETRIG_IM,
+    .cpltState          = true,
+    .interrupt          = false,
+    .preemptable        = true,
+    .flipping           = true,
+    .triggerType        = CY_DMAC_SINGLE_ELEMENT,
+};
+
+const cy_stc_dmac_descriptor_config_t txDma_pong_config =
+{
+    .srcAddress         = NULL,
+    .dstAddress         = NULL,
+    .dataCount          = 1u,
+    .dataTransferWidth  = CY_DMAC_BYTE_TO_WORD,
+    .srcAddrIncrement   = true,
+    .dstAddrIncrement   = false,
+    .retrigger          = CY_DMAC_RETRIG_IM,
+    .cpltState          = true,
+    .interrupt          = true,
+    .preemptable        = true,
+    .flipping           = false,
+    .triggerType        = CY_DMAC_SINGLE_ELEMENT,
+};
+
+const cy_stc_dmac_channel_config_t txDma_channel_config =
+{
+    .descriptor         = CY_DMAC_DESCRIPTOR_PING,
+    .priority           = 3u,
+    .enable             = false,
+};
+
+/*******************************************************************************
+* FLASH_SPI: scb[0], master, 1000 kbps, oversample 16
+*******************************************************************************/
+const cy_stc_scb_spi_config_t FLASH_SPI_config =
+{
+    .spiMode                    = 1u,
+    .subMode                    = 0u,
+    .sclkMode                   = 0u,
+    .oversample                 = 16u,
+    .rxDataWidth                = 8u,
+    .txDataWidth                = 8u,
+    .enableMsbFirst             = true,
+    .enableFreeRunSclk          = false,
+    .enableTransferSeperation   = false,
+    .rxFifoTriggerLevel         = 0u,
+    .txFifoTriggerLevel         = 15u,
+};
+
+/* [] END OF FILE */
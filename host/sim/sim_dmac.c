@@ -0,0 +1,390 @@
+/******************************************************************************
+ * File Name: sim_dmac.c
+ *
+ * Description: Model of the PMG1 DMAC: per-channel PING/PONG descriptors with
+ *              validity, flipping, invalidate-on-completion and completion
+ *              interrupt, single element triggers from the SCB FIFOs, and the
+ *              response codes the driver evaluates.
+ *
+ * Related Document: See README.md
+ *
+ *******************************************************************************
+ * Copyright 2023, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+
+/*******************************************************************************
+ * Include header files
+ ******************************************************************************/
+#include "sim_internal.h"
+
+/*******************************************************************************
+ * Structure/Enum type declaration
+ ******************************************************************************/
+typedef struct
+{
+    const uint8_t *                     src;
+    uint8_t *                           dst;
+    uint32_t                            count;
+    bool                                src_inc;
+    bool                                dst_inc;
+    bool                                invalidate;     /* cpltState */
+    bool                                interrupt;
+    bool                                flipping;
+    bool                                valid;
+    cy_en_dmac_response_t               response;
+    uint32_t                            index;          /* CURR_DATA_NR */
+} sim_dmac_descr_t;
+
+typedef struct
+{
+    sim_dmac_descr_t                    descr[2];
+    cy_en_dmac_descriptor_t             current;
+    uint32_t                            priority;
+    bool                                enabled;
+    bool                                (*trigger)(void);
+} sim_dmac_chan_t;
+
+struct sim_dmac
+{
+    sim_dmac_chan_t                     chan[SIM_DMAC_CHANNELS];
+    bool                                enabled;
+    uint32_t                            intr;
+    uint32_t                            intr_mask;
+};
+
+/*******************************************************************************
+ * Global variables declaration
+ ******************************************************************************/
+DMAC_Type sim_dmac0;
+
+void sim_dmac_reset(void)
+{
+    for (uint32_t ch = 0; ch < SIM_DMAC_CHANNELS; ch++)
+    {
+        bool (*trigger)(void) = sim_dmac0.chan[ch].trigger;
+
+        memset(&sim_dmac0.chan[ch], 0, sizeof(sim_dmac0.chan[ch]));
+        sim_dmac0.chan[ch].trigger = trigger;
+    }
+    sim_dmac0.enabled = false;
+    sim_dmac0.intr = 0;
+    sim_dmac0.intr_mask = 0;
+}
+
+void sim_dmac_set_trigger(uint32_t channel, bool (*trigger)(void))
+{
+    sim_dmac0.chan[channel].trigger = trigger;
+}
+
+static void dmac_raise(uint32_t channel)
+{
+    sim_dmac0.intr |= (1UL << channel);
+    if ((sim_dmac0.intr_mask & (1UL << channel)) != 0u)
+    {
+        sim_irq_raise(cpuss_interrupt_dma_IRQn);
+    }
+}
+
+/* Move one element of the current descriptor of a triggered channel */
+static void dmac_transfer_element(uint32_t channel)
+{
+    sim_dmac_chan_t *ch = &sim_dmac0.chan[channel];
+    sim_dmac_descr_t *d = &ch->descr[ch->current];
+    uint8_t data;
+
+    if (!d->valid)
+    {
+        /* The channel fetched an invalid descriptor: report it and stop */
+        d->response = CY_DMAC_INVALID_DESCR;
+        ch->enabled = false;
+        if (d->interrupt)
+        {
+            dmac_raise(channel);
+        }
+        return;
+    }
+
+    if (sim_scb_is_rx_fifo(d->src))
+    {
+        data = sim_scb_rx_pop();
+    }
+    else
+    {
+        data = d->src[d->src_inc ? d->index : 0u];
+    }
+
+    if (sim_scb_is_tx_fifo(d->dst))
+    {
+        (void) sim_scb_tx_push(data);
+    }
+    else
+    {
+        d->dst[d->dst_inc ? d->index : 0u] = data;
+    }
+
+    if (++d->index >= d->count)
+    {
+        d->index = 0;
+        d->response = CY_DMAC_DONE;
+        if (d->invalidate)
+        {
+            d->valid = false;
+        }
+        if (d->interrupt)
+        {
+            dmac_raise(channel);
+        }
+        if (d->flipping)
+        {
+            ch->current = (ch->current == CY_DMAC_DESCRIPTOR_PING) ?
+                    CY_DMAC_DESCRIPTOR_PONG : CY_DMAC_DESCRIPTOR_PING;
+        }
+    }
+}
+
+/*******************************************************************************
+* Function Name: sim_dmac_service
+********************************************************************************
+*
+* Summary:
+*  Serve all active triggers until none is left. Element transfers take no
+*  virtual time: the DMAC is much faster than the SPI bus it feeds. Channels
+*  are arbitrated by priority, then by channel number.
+*
+*******************************************************************************/
+void sim_dmac_service(void)
+{
+    bool progress;
+
+    if (!sim_dmac0.enabled)
+    {
+        return;
+    }
+
+    do
+    {
+        int32_t best = -1;
+
+        for (uint32_t ch = 0; ch < SIM_DMAC_CHANNELS; ch++)
+        {
+            sim_dmac_chan_t *c = &sim_dmac0.chan[ch];
+
+            if (!c->enabled || (c->trigger == NULL) || !c->trigger())
+            {
+                continue;
+            }
+            if ((best < 0) || (c->priority < sim_dmac0.chan[best].priority))
+            {
+                best = (int32_t) ch;
+            }
+        }
+
+        progress = (best >= 0);
+        if (progress)
+        {
+            dmac_transfer_element((uint32_t) best);
+        }
+    } while (progress);
+}
+
+/*******************************************************************************
+* Register interface
+*******************************************************************************/
+cy_en_dmac_status_t Cy_DMAC_Descriptor_Init(DMAC_Type *base, uint32_t channel,
+        cy_en_dmac_descriptor_t descriptor, const cy_stc_dmac_descriptor_config_t *config)
+{
+    if ((channel >= SIM_DMAC_CHANNELS) || (config == NULL) ||
+        (config->dataCount == 0u) || (config->dataCount > SIM_DMAC_MAX_DATA_COUNT))
+    {
+        return CY_DMAC_BAD_PARAM;
+    }
+
+    base->chan[channel].descr[descriptor] = (sim_dmac_descr_t)
+    {
+        .src        = (const uint8_t *) config->srcAddress,
+        .dst        = (uint8_t *) config->dstAddress,
+        .count      = config->dataCount,
+        .src_inc    = config->srcAddrIncrement,
+        .dst_inc    = config->dstAddrIncrement,
+        .invalidate = config->cpltState,
+        .interrupt  = config->interrupt,
+        .flipping   = config->flipping,
+        .valid      = false,
+        .response   = CY_DMAC_NO_ERROR,
+    };
+    return CY_DMAC_SUCCESS;
+}
+
+cy_en_dmac_status_t Cy_DMAC_Channel_Init(DMAC_Type *base, uint32_t channel,
+        const cy_stc_dmac_channel_config_t *config)
+{
+    if ((channel >= SIM_DMAC_CHANNELS) || (config == NULL))
+    {
+        return CY_DMAC_BAD_PARAM;
+    }
+
+    base->chan[channel].current = config->descriptor;
+    base->chan[channel].priority = config->priority;
+    base->chan[channel].enabled = config->enable;
+    return CY_DMAC_SUCCESS;
+}
+
+void Cy_DMAC_Descriptor_SetSrcAddress(DMAC_Type *base, uint32_t channel,
+        cy_en_dmac_descriptor_t descriptor, const void *srcAddress)
+{
+    base->chan[channel].descr[descriptor].src = (const uint8_t *) srcAddress;
+}
+
+void Cy_DMAC_Descriptor_SetDstAddress(DMAC_Type *base, uint32_t channel,
+        cy_en_dmac_descriptor_t descriptor, const void *dstAddress)
+{
+    base->chan[channel].descr[descriptor].dst = (uint8_t *) dstAddress;
+}
+
+void Cy_DMAC_Descriptor_SetDataCount(DMAC_Type *base, uint32_t channel,
+        cy_en_dmac_descriptor_t descriptor, uint32_t dataCount)
+{
+    CY_ASSERT((dataCount > 0u) && (dataCount <= SIM_DMAC_MAX_DATA_COUNT));
+    base->chan[channel].descr[descriptor].count = dataCount;
+}
+
+void Cy_DMAC_Descriptor_SetSrcIncrement(DMAC_Type *base, uint32_t channel,
+        cy_en_dmac_descriptor_t descriptor, bool srcAddrIncrement)
+{
+    base->chan[channel].descr[descriptor].src_inc = srcAddrIncrement;
+}
+
+void Cy_DMAC_Descriptor_SetDstIncrement(DMAC_Type *base, uint32_t channel,
+        cy_en_dmac_descriptor_t descriptor, bool dstAddrIncrement)
+{
+    base->chan[channel].descr[descriptor].dst_inc = dstAddrIncrement;
+}
+
+void Cy_DMAC_Descriptor_SetInterrupt(DMAC_Type *base, uint32_t channel,
+        cy_en_dmac_descriptor_t descriptor, bool interrupt)
+{
+    base->chan[channel].descr[descriptor].interrupt = interrupt;
+}
+
+void Cy_DMAC_Descriptor_SetFlipping(DMAC_Type *base, uint32_t channel,
+        cy_en_dmac_descriptor_t descriptor, bool flipping)
+{
+    base->chan[channel].descr[descriptor].flipping = flipping;
+}
+
+/* Writes the descriptor status word: VALID as given, RESPONSE and
+ * CURR_DATA_NR cleared */
+void Cy_DMAC_Descriptor_SetState(DMAC_Type *base, uint32_t channel,
+        cy_en_dmac_descriptor_t descriptor, bool valid)
+{
+    base->chan[channel].descr[descriptor].valid = valid;
+    base->chan[channel].descr[descriptor].response = CY_DMAC_NO_ERROR;
+    base->chan[channel].descr[descriptor].index = 0;
+}
+
+cy_en_dmac_response_t Cy_DMAC_Descriptor_GetResponse(DMAC_Type const *base, uint32_t channel,
+        cy_en_dmac_descriptor_t descriptor)
+{
+    return base->chan[channel].descr[descriptor].response;
+}
+
+void Cy_DMAC_Channel_SetCurrentDescriptor(DMAC_Type *base, uint32_t channel,
+        cy_en_dmac_descriptor_t descriptor)
+{
+    base->chan[channel].current = descriptor;
+}
+
+cy_en_dmac_descriptor_t Cy_DMAC_Channel_GetCurrentDescriptor(DMAC_Type const *base, uint32_t channel)
+{
+    return base->chan[channel].current;
+}
+
+void Cy_DMAC_Channel_Enable(DMAC_Type *base, uint32_t channel)
+{
+    base->chan[channel].enabled = true;
+}
+
+void Cy_DMAC_Channel_Disable(DMAC_Type *base, uint32_t channel)
+{
+    base->chan[channel].enabled = false;
+}
+
+void Cy_DMAC_Enable(DMAC_Type *base)
+{
+    base->enabled = true;
+}
+
+void Cy_DMAC_Disable(DMAC_Type *base)
+{
+    base->enabled = false;
+}
+
+uint32_t Cy_DMAC_GetInterruptStatus(DMAC_Type const *base)
+{
+    return base->intr;
+}
+
+uint32_t Cy_DMAC_GetInterruptStatusMasked(DMAC_Type const *base)
+{
+    return base->intr & base->intr_mask;
+}
+
+void Cy_DMAC_ClearInterrupt(DMAC_Type *base, uint32_t interrupt)
+{
+    base->intr &= ~interrupt;
+}
+
+void Cy_DMAC_SetInterrupt(DMAC_Type *base, uint32_t interrupt)
+{
+    base->intr |= interrupt;
+    if ((base->intr & base->intr_mask) != 0u)
+    {
+        sim_irq_raise(cpuss_interrupt_dma_IRQn);
+    }
+}
+
+uint32_t Cy_DMAC_GetInterruptMask(DMAC_Type const *base)
+{
+    return base->intr_mask;
+}
+
+void Cy_DMAC_SetInterruptMask(DMAC_Type *base, uint32_t interrupt)
+{
+    base->intr_mask = interrupt;
+    if ((base->intr & base->intr_mask) != 0u)
+    {
+        sim_irq_raise(cpuss_interrupt_dma_IRQn);
+    }
+}
+
+/* [] END OF FILE */
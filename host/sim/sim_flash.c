@@ -0,0 +1,847 @@
+/******************************************************************************
+ * File Name: sim_flash.c
+ *
+ * Description: Behavioral model of a serial NOR flash on one slave select
+ *              line: status registers with WIP/WEL and block protection,
+ *              READ and FAST_READ with their SCLK limits, page program with
+ *              in-page wrap, 4K/32K/64K/chip erase, RDID, program/erase
+ *              suspend and resume, and busy times taken from the device
+ *              configuration.
+ *
+ * Related Document: See README.md
+ *
+ *******************************************************************************
+ * Copyright 2023, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+
+/*******************************************************************************
+ * Include header files
+ ******************************************************************************/
+#include <stdlib.h>
+#include "sim_internal.h"
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+#define SR1_WIP                 (1u << 0)
+#define SR1_WEL                 (1u << 1)
+#define SR1_BP_MASK             (0xFu << 2)
+#define SR2_PS                  (1u << 0)
+#define SR2_ES                  (1u << 1)
+
+/* Address bytes after power-up; parts above 16 MB switch with EN4B/EX4B */
+#define ADDR_BYTES              (3u)
+#define ADDR_3BYTE_LIMIT        (16u * 1024u * 1024u)
+
+/* SFDP image: header, one parameter header, basic flash parameter table of
+ * JESD216B (16 DWORDs) */
+#define SFDP_BFPT_OFFSET        (0x30u)
+#define SFDP_BFPT_DWORDS        (16u)
+#define SFDP_SIZE               (SFDP_BFPT_OFFSET + 4u * SFDP_BFPT_DWORDS)
+
+/* Opcodes understood by the model */
+#define OP_WRSR                 (0x01u)
+#define OP_PP                   (0x02u)
+#define OP_READ                 (0x03u)
+#define OP_WRDI                 (0x04u)
+#define OP_RDSR                 (0x05u)
+#define OP_WREN                 (0x06u)
+#define OP_RDSR2                (0x07u)
+#define OP_FAST_READ            (0x0Bu)
+#define OP_SE                   (0x20u)
+#define OP_RDCR                 (0x35u)
+#define OP_BE32                 (0x52u)
+#define OP_CE                   (0x60u)
+#define OP_RDID                 (0x9Fu)
+#define OP_CE_ALT               (0xC7u)
+#define OP_BE64                 (0xD8u)
+#define OP_RDSFDP               (0x5Au)
+#define OP_EN4B                 (0xB7u)
+#define OP_EX4B                 (0xE9u)
+#define OP_SUSPEND              (0x75u)
+#define OP_RESUME               (0x7Au)
+
+/*******************************************************************************
+ * Structure/Enum type declaration
+ ******************************************************************************/
+typedef struct
+{
+    bool                present;
+    sim_flash_config_t  cfg;
+    uint8_t *           mem;
+    uint8_t *           page_buf;
+
+    uint8_t             sr1;
+    uint8_t             sr2;
+    uint8_t             cr;
+    uint32_t            addr_bytes;
+    uint8_t             sfdp[SFDP_SIZE];
+    uint64_t            busy_until_ns;
+    uint64_t            busy_start_ns;
+    uint8_t             busy_cmd;       /* Command of the internal operation */
+    uint32_t            rng;
+
+    /* Program or erase suspended (its opcode, 0 if none), its remaining
+     * time, and the last resume with the time remaining then */
+    uint8_t             suspended;
+    uint64_t            suspend_left_ns;
+    uint64_t            resume_ns;
+    uint64_t            resume_left_ns;
+
+    /* State of the transaction in progress */
+    bool                selected;
+    bool                ignored;
+    uint8_t             cmd;
+    uint32_t            count;          /* Bytes received including opcode */
+    uint32_t            addr;
+    uint8_t             wr_data[2];
+    bool                too_fast;       /* SCLK above the limit of the read command */
+    uint8_t             last_miso;
+
+    sim_flash_stats_t   stats;
+} sim_flash_t;
+
+/*******************************************************************************
+ * Global variables declaration
+ ******************************************************************************/
+static sim_flash_t flash[SIM_SPI_SS_COUNT];
+
+/*******************************************************************************
+* Function Name: sim_flash_default_config
+********************************************************************************
+*
+* Summary:
+*  Representative 64-Mbit serial NOR part with 256-byte pages. Program and
+*  erase times are typical/maximum values in the range published for this
+*  class of device.
+*
+*******************************************************************************/
+void sim_flash_default_config(sim_flash_config_t *config)
+{
+    *config = (sim_flash_config_t)
+    {
+        .size_bytes     = 8u * 1024u * 1024u,
+        .page_size      = 256u,
+        .jedec_id       = { 0x01u, 0x60u, 0x17u },
+        .status_init    = 0x00u,
+        .t_pp_typ_us    = 450u,
+        .t_pp_max_us    = 1350u,
+        .t_se_typ_us    = 50000u,
+        .t_se_max_us    = 300000u,
+        .t_be32_typ_us  = 150000u,
+        .t_be32_max_us  = 600000u,
+        .t_be64_typ_us  = 220000u,
+        .t_be64_max_us  = 1150000u,
+        .t_ce_typ_ms    = 20000u,
+        .t_ce_max_ms    = 80000u,
+        .t_w_typ_us     = 2000u,
+        .t_w_max_us     = 15000u,
+        .t_sus_us       = 40u,
+        .t_rs_us        = 128u,
+        .read_max_hz    = 50000000u,
+        .fast_read_max_hz = 108000000u,
+        .sclk_max_hz    = 0u,
+        .sfdp           = true,
+        .en4b           = SIM_FLASH_EN4B,
+        .timing         = SIM_FLASH_TIMING_TYP,
+        .seed           = 1u,
+    };
+}
+
+/* Count and unit of an SFDP time field: the unit of the list that encodes
+ * value_us (rounded) in at most count_max + 1 units */
+static uint32_t sfdp_time(uint32_t value_us, const uint32_t *units_us, uint32_t n_units,
+        uint32_t count_bits, uint32_t *encoded_us)
+{
+    uint32_t count_max = (1u << count_bits) - 1u;
+    uint32_t u = 0;
+    uint32_t count;
+
+    while ((u < (n_units - 1u)) && (value_us > (count_max + 1u) * units_us[u]))
+    {
+        u++;
+    }
+    count = (value_us + units_us[u] / 2u) / units_us[u];
+    count = (count == 0u) ? 0u : ((count > (count_max + 1u)) ? count_max : count - 1u);
+    *encoded_us = (count + 1u) * units_us[u];
+    return count | (u << count_bits);
+}
+
+/* Multiplier field from typical to maximum time: max = 2 * (n + 1) * typ */
+static uint32_t sfdp_max_factor(uint32_t typ_us, uint32_t max_us)
+{
+    uint32_t n = (max_us + 2u * typ_us - 1u) / (2u * typ_us);
+
+    n = (n == 0u) ? 0u : n - 1u;
+    return (n > 15u) ? 15u : n;
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    for (uint32_t i = 0; i < 4u; i++)
+    {
+        p[i] = (uint8_t) (v >> (8u * i));
+    }
+}
+
+/*******************************************************************************
+* Function Name: sfdp_build
+********************************************************************************
+*
+* Summary:
+*  SFDP tables of a part as described by its config: density, page size,
+*  4 KB / 32 KB / 64 KB erase types and the typical times of JESD216B, with
+*  the maximum time multipliers rounded up so that the maxima of the config
+*  stay within the declared ones, and the suspend latency, resume to
+*  suspend interval and opcodes if the part suspends. Parts above 16 MB
+*  declare 3- or 4-byte addressing and how they enter 4-byte mode.
+*
+*******************************************************************************/
+static void sfdp_build(sim_flash_t *f)
+{
+    static const uint32_t erase_units_us[] = { 1000u, 16000u, 128000u, 1000000u };
+    static const uint32_t pp_units_us[] = { 8u, 64u };
+    static const uint32_t ce_units_us[] = { 16000u, 256000u, 4000000u, 64000000u };
+    static const uint32_t sus_units_ns[] = { 128u, 1000u, 8000u, 64000u };
+    static const uint32_t rs_units_us[] = { 64u };
+    const sim_flash_config_t *c = &f->cfg;
+    uint8_t *bfpt = &f->sfdp[SFDP_BFPT_OFFSET];
+    uint32_t typ_us[3];
+    uint32_t max_factor = 0;
+    uint32_t dword;
+    uint32_t pp_us;
+    uint32_t ce_us;
+    uint32_t unused;
+    uint32_t page_n = 0;
+
+    memset(f->sfdp, 0xFF, sizeof(f->sfdp));
+    /* Header: signature, revision 1.6, one parameter header, 1-1-1 protocol */
+    memcpy(f->sfdp, "SFDP", 4u);
+    f->sfdp[4] = 6u;
+    f->sfdp[5] = 1u;
+    f->sfdp[6] = 0u;
+    f->sfdp[7] = 0xFFu;
+    /* Parameter header of the BFPT */
+    f->sfdp[8] = 0x00u;
+    f->sfdp[9] = 6u;
+    f->sfdp[10] = 1u;
+    f->sfdp[11] = SFDP_BFPT_DWORDS;
+    f->sfdp[12] = SFDP_BFPT_OFFSET;
+    f->sfdp[13] = 0u;
+    f->sfdp[14] = 0u;
+    f->sfdp[15] = 0xFFu;
+
+    /* 1: 4 KB erase with its opcode, 3 or 3/4 address bytes */
+    dword = 0xFF800000u | ((uint32_t) OP_SE << 8) | 0x1u;
+    if (c->size_bytes > ADDR_3BYTE_LIMIT)
+    {
+        dword |= 1u << 17;
+    }
+    put32(&bfpt[0], dword);
+    /* 2: density in bits - 1 */
+    put32(&bfpt[4], c->size_bytes * 8u - 1u);
+    /* 3..7: no fast read modes beyond 1-1-1 */
+    put32(&bfpt[8], 0u);
+    put32(&bfpt[12], 0u);
+    put32(&bfpt[16], 0xFFFFFFEEu);
+    put32(&bfpt[20], 0x0000FFFFu);
+    put32(&bfpt[24], 0x0000FFFFu);
+    /* 8, 9: erase types 4 KB, 32 KB, 64 KB */
+    put32(&bfpt[28], 12u | ((uint32_t) OP_SE << 8) | (15u << 16) | ((uint32_t) OP_BE32 << 24));
+    put32(&bfpt[32], 16u | ((uint32_t) OP_BE64 << 8));
+    /* 10: typical erase times and the common maximum multiplier */
+    dword = 0;
+    dword |= sfdp_time(c->t_se_typ_us, erase_units_us, 4u, 5u, &typ_us[0]) << 4;
+    dword |= sfdp_time(c->t_be32_typ_us, erase_units_us, 4u, 5u, &typ_us[1]) << 11;
+    dword |= sfdp_time(c->t_be64_typ_us, erase_units_us, 4u, 5u, &typ_us[2]) << 18;
+    if (sfdp_max_factor(typ_us[0], c->t_se_max_us) > max_factor)
+    {
+        max_factor = sfdp_max_factor(typ_us[0], c->t_se_max_us);
+    }
+    if (sfdp_max_factor(typ_us[1], c->t_be32_max_us) > max_factor)
+    {
+        max_factor = sfdp_max_factor(typ_us[1], c->t_be32_max_us);
+    }
+    if (sfdp_max_factor(typ_us[2], c->t_be64_max_us) > max_factor)
+    {
+        max_factor = sfdp_max_factor(typ_us[2], c->t_be64_max_us);
+    }
+    put32(&bfpt[36], dword | max_factor);
+    /* 11: page size, typical page program and chip erase times */
+    while ((1u << page_n) < c->page_size)
+    {
+        page_n++;
+    }
+    dword = page_n << 4;
+    dword |= sfdp_time(c->t_pp_typ_us, pp_units_us, 2u, 5u, &pp_us) << 8;
+    dword |= sfdp_time(c->t_ce_typ_ms * 1000u, ce_units_us, 4u, 5u, &ce_us) << 24;
+    max_factor = sfdp_max_factor(pp_us, c->t_pp_max_us);
+    if (sfdp_max_factor(ce_us, c->t_ce_max_ms * 1000u) > max_factor)
+    {
+        max_factor = sfdp_max_factor(ce_us, c->t_ce_max_ms * 1000u);
+    }
+    put32(&bfpt[40], dword | max_factor);
+    /* 12: suspend latency and resume to suspend interval, the same for
+     * erase and program; bit 31 set without suspend. 13: their opcodes */
+    if (c->t_sus_us != 0u)
+    {
+        uint32_t latency = sfdp_time(c->t_sus_us * 1000u, sus_units_ns, 4u, 5u, &unused);
+        uint32_t interval = sfdp_time(c->t_rs_us, rs_units_us, 1u, 4u, &unused);
+
+        put32(&bfpt[44], (latency << 24) | (interval << 20) | (latency << 13) | (interval << 9) | (1u << 8));
+        put32(&bfpt[48], ((uint32_t) OP_SUSPEND << 24) | ((uint32_t) OP_RESUME << 16) |
+                ((uint32_t) OP_SUSPEND << 8) | OP_RESUME);
+    }
+    else
+    {
+        put32(&bfpt[44], 0x80000100u);
+        put32(&bfpt[48], 0u);
+    }
+    /* 14, 15: deep power down, quad enable not described */
+    put32(&bfpt[52], 0u);
+    put32(&bfpt[56], 0u);
+    /* 16: methods to enter 4-byte addressing */
+    put32(&bfpt[60], (c->size_bytes > ADDR_3BYTE_LIMIT) ? ((uint32_t) c->en4b << 24) : 0u);
+}
+
+void sim_flash_reset(void)
+{
+    for (uint32_t ss = 0; ss < SIM_SPI_SS_COUNT; ss++)
+    {
+        sim_flash_detach(ss);
+    }
+}
+
+bool sim_flash_attach(uint32_t ss, const sim_flash_config_t *config)
+{
+    sim_flash_t *f;
+
+    if ((ss >= SIM_SPI_SS_COUNT) || (config->page_size == 0u) ||
+        ((config->size_bytes % config->page_size) != 0u))
+    {
+        return false;
+    }
+
+    sim_flash_detach(ss);
+    f = &flash[ss];
+    f->mem = malloc(config->size_bytes);
+    f->page_buf = malloc(config->page_size);
+    if ((f->mem == NULL) || (f->page_buf == NULL))
+    {
+        sim_flash_detach(ss);
+        return false;
+    }
+
+    memset(f->mem, 0xFF, config->size_bytes);
+    f->cfg = *config;
+    f->sr1 = config->status_init & (uint8_t) ~(SR1_WIP | SR1_WEL);
+    f->rng = (config->seed != 0u) ? config->seed : 1u;
+    f->addr_bytes = ADDR_BYTES;
+    sfdp_build(f);
+    f->present = true;
+    return true;
+}
+
+void sim_flash_detach(uint32_t ss)
+{
+    if (ss >= SIM_SPI_SS_COUNT)
+    {
+        return;
+    }
+    free(flash[ss].mem);
+    free(flash[ss].page_buf);
+    memset(&flash[ss], 0, sizeof(flash[ss]));
+}
+
+bool sim_flash_present(uint32_t ss)
+{
+    return (ss < SIM_SPI_SS_COUNT) && flash[ss].present;
+}
+
+uint8_t *sim_flash_memory(uint32_t ss)
+{
+    return sim_flash_present(ss) ? flash[ss].mem : NULL;
+}
+
+void sim_flash_get_stats(uint32_t ss, sim_flash_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    if (sim_flash_present(ss))
+    {
+        *stats = flash[ss].stats;
+    }
+}
+
+static bool is_busy(const sim_flash_t *f, uint64_t t)
+{
+    return t < f->busy_until_ns;
+}
+
+bool sim_flash_is_busy(uint32_t ss)
+{
+    return sim_flash_present(ss) && is_busy(&flash[ss], sim_now());
+}
+
+/* Pick the busy time of one operation according to the timing mode */
+static uint64_t op_time_ns(sim_flash_t *f, uint32_t typ_us, uint32_t max_us)
+{
+    uint64_t typ = (uint64_t) typ_us * 1000u;
+    uint64_t max = (uint64_t) max_us * 1000u;
+
+    switch (f->cfg.timing)
+    {
+        case SIM_FLASH_TIMING_MAX:
+            return max;
+
+        case SIM_FLASH_TIMING_SPREAD:
+        {
+            /* xorshift32, cubed to put most samples near typical */
+            double u;
+
+            f->rng ^= f->rng << 13;
+            f->rng ^= f->rng >> 17;
+            f->rng ^= f->rng << 5;
+            u = (double) f->rng / 4294967296.0;
+            return typ + (uint64_t) ((double) (max - typ) * u * u * u);
+        }
+
+        case SIM_FLASH_TIMING_TYP:
+        default:
+            return typ;
+    }
+}
+
+/* Refresh WIP/WEL of a device whose internal operation has finished */
+static void update_status(sim_flash_t *f, uint64_t t)
+{
+    if (((f->sr1 & SR1_WIP) != 0u) && !is_busy(f, t))
+    {
+        f->sr1 &= (uint8_t) ~(SR1_WIP | SR1_WEL);
+        f->stats.busy_ns += f->busy_until_ns - f->busy_start_ns;
+    }
+}
+
+static void start_busy(sim_flash_t *f, uint64_t t, uint64_t duration_ns)
+{
+    f->sr1 |= SR1_WIP;
+    f->busy_cmd = f->cmd;
+    f->busy_start_ns = t;
+    f->busy_until_ns = t + duration_ns;
+    f->resume_left_ns = 0;
+}
+
+/* Suspend the program or erase in progress: WIP stays set for the suspend
+ * latency, then reads are served. Suspended again within t_rs of its
+ * resume, the operation has made no progress; one that would finish within
+ * the latency just completes */
+static void suspend(sim_flash_t *f, uint64_t t)
+{
+    uint64_t left = f->busy_until_ns - t;
+    uint64_t latency = (uint64_t) f->cfg.t_sus_us * 1000u;
+
+    if ((f->resume_left_ns != 0u) && ((t - f->resume_ns) < (uint64_t) f->cfg.t_rs_us * 1000u))
+    {
+        left = f->resume_left_ns;
+    }
+    if (left <= latency)
+    {
+        return;
+    }
+    f->suspended = f->busy_cmd;
+    f->suspend_left_ns = left;
+    f->sr2 |= (f->busy_cmd == OP_PP) ? SR2_PS : SR2_ES;
+    f->busy_until_ns = t + latency;
+    f->stats.suspends++;
+}
+
+static void resume(sim_flash_t *f, uint64_t t)
+{
+    start_busy(f, t, f->suspend_left_ns);
+    f->busy_cmd = f->suspended;
+    f->resume_ns = t;
+    f->resume_left_ns = f->suspend_left_ns;
+    f->suspended = 0;
+    f->sr2 &= (uint8_t) ~(SR2_PS | SR2_ES);
+}
+
+static bool is_protected(const sim_flash_t *f)
+{
+    return (f->sr1 & SR1_BP_MASK) != 0u;
+}
+
+/* Programs and erases need WEL, no protection and nothing suspended */
+static bool write_allowed(sim_flash_t *f)
+{
+    if (((f->sr1 & SR1_WEL) == 0u) || is_protected(f) || (f->suspended != 0u))
+    {
+        f->sr1 &= (uint8_t) ~SR1_WEL;
+        f->stats.ignored++;
+        return false;
+    }
+    return true;
+}
+
+static void erase(sim_flash_t *f, uint32_t addr, uint32_t size, uint64_t t,
+        uint32_t typ_us, uint32_t max_us)
+{
+    uint32_t base = (addr % f->cfg.size_bytes) & ~(size - 1u);
+
+    memset(&f->mem[base], 0xFF, size);
+    start_busy(f, t, op_time_ns(f, typ_us, max_us));
+}
+
+void sim_flash_select(uint32_t ss, uint64_t t)
+{
+    sim_flash_t *f;
+
+    if (!sim_flash_present(ss))
+    {
+        return;
+    }
+    f = &flash[ss];
+    update_status(f, t);
+    f->selected = true;
+    f->ignored = false;
+    f->count = 0;
+    f->addr = 0;
+    f->last_miso = 0xFFu;
+}
+
+/* MISO as sampled by the master: one bit late if SCLK exceeds the limit of
+ * the command or of the board */
+static uint8_t sample_miso(sim_flash_t *f, uint8_t data)
+{
+    uint8_t late = (uint8_t) ((data >> 1) | (uint8_t) (f->last_miso << 7));
+
+    f->last_miso = data;
+    return f->too_fast ? late : data;
+}
+
+static uint8_t read_data(sim_flash_t *f)
+{
+    uint8_t data = f->mem[f->addr % f->cfg.size_bytes];
+
+    f->addr = (f->addr + 1u) % f->cfg.size_bytes;
+    return data;
+}
+
+/*******************************************************************************
+* Function Name: sim_flash_exchange
+********************************************************************************
+*
+* Summary:
+*  One byte of a transaction: consume MOSI, return MISO. Commands other than
+*  the status reads and suspend are ignored while an internal operation is
+*  in progress.
+*  An absent device returns 0xFF (pulled-up MISO).
+*
+*******************************************************************************/
+uint8_t sim_flash_exchange(uint32_t ss, uint8_t mosi, uint64_t t)
+{
+    sim_flash_t *f;
+    uint32_t n;
+    uint8_t miso = 0xFFu;
+
+    if (!sim_flash_present(ss) || !flash[ss].selected)
+    {
+        return 0xFFu;
+    }
+    f = &flash[ss];
+    update_status(f, t);
+
+    n = f->count++;
+    if (n == 0u)
+    {
+        f->cmd = mosi;
+        f->too_fast = ((mosi == OP_READ) && (sim_spi_bitrate() > f->cfg.read_max_hz)) ||
+                ((mosi == OP_FAST_READ) && (sim_spi_bitrate() > f->cfg.fast_read_max_hz)) ||
+                ((f->cfg.sclk_max_hz != 0u) && (sim_spi_bitrate() > f->cfg.sclk_max_hz));
+        if (is_busy(f, t) && (mosi != OP_RDSR) && (mosi != OP_RDSR2) && (mosi != OP_SUSPEND))
+        {
+            f->ignored = true;
+            f->stats.ignored++;
+        }
+        return 0xFFu;
+    }
+
+    if (f->ignored)
+    {
+        return 0xFFu;
+    }
+
+    switch (f->cmd)
+    {
+        case OP_RDSR:
+            miso = f->sr1;
+            break;
+
+        case OP_RDSR2:
+            miso = f->sr2;
+            break;
+
+        case OP_RDCR:
+            miso = f->cr;
+            break;
+
+        case OP_RDID:
+            miso = (n <= 3u) ? f->cfg.jedec_id[n - 1u] : 0xFFu;
+            break;
+
+        case OP_RDSFDP:
+            /* Always 3 address bytes and one dummy byte */
+            if (n <= 3u)
+            {
+                f->addr = (f->addr << 8) | mosi;
+            }
+            else if ((n > 4u) && f->cfg.sfdp)
+            {
+                miso = (f->addr < SFDP_SIZE) ? f->sfdp[f->addr] : 0xFFu;
+                f->addr++;
+            }
+            break;
+
+        case OP_WRSR:
+            if (n <= 2u)
+            {
+                f->wr_data[n - 1u] = mosi;
+            }
+            break;
+
+        case OP_READ:
+            if (n <= f->addr_bytes)
+            {
+                f->addr = (f->addr << 8) | mosi;
+            }
+            else
+            {
+                miso = read_data(f);
+            }
+            break;
+
+        case OP_FAST_READ:
+            if (n <= f->addr_bytes)
+            {
+                f->addr = (f->addr << 8) | mosi;
+            }
+            else if (n > f->addr_bytes + 1u)
+            {
+                /* One dummy byte after the address */
+                miso = read_data(f);
+            }
+            break;
+
+        case OP_PP:
+            if (n <= f->addr_bytes)
+            {
+                f->addr = (f->addr << 8) | mosi;
+                if (n == f->addr_bytes)
+                {
+                    memset(f->page_buf, 0xFF, f->cfg.page_size);
+                    f->addr %= f->cfg.size_bytes;
+                }
+            }
+            else
+            {
+                /* Data beyond the end of the page wraps to its start */
+                uint32_t offset = (f->addr + (n - f->addr_bytes - 1u)) % f->cfg.page_size;
+
+                f->page_buf[offset] &= mosi;
+            }
+            break;
+
+        case OP_SE:
+        case OP_BE32:
+        case OP_BE64:
+            if (n <= f->addr_bytes)
+            {
+                f->addr = (f->addr << 8) | mosi;
+            }
+            break;
+
+        default:
+            break;
+    }
+    return sample_miso(f, miso);
+}
+
+/*******************************************************************************
+* Function Name: sim_flash_deselect
+********************************************************************************
+*
+* Summary:
+*  End of a transaction. Write, program and erase commands are executed on
+*  the rising edge of the select line, as on real parts.
+*
+*******************************************************************************/
+void sim_flash_deselect(uint32_t ss, uint64_t t)
+{
+    sim_flash_t *f;
+
+    if (!sim_flash_present(ss) || !flash[ss].selected)
+    {
+        return;
+    }
+    f = &flash[ss];
+    f->selected = false;
+    update_status(f, t);
+
+    if (f->ignored || (f->count == 0u))
+    {
+        return;
+    }
+    f->stats.commands++;
+
+    switch (f->cmd)
+    {
+        case OP_WREN:
+            f->sr1 |= SR1_WEL;
+            break;
+
+        case OP_WRDI:
+            f->sr1 &= (uint8_t) ~SR1_WEL;
+            break;
+
+        case OP_RDSR:
+        case OP_RDSR2:
+            f->stats.status_polls++;
+            break;
+
+        case OP_WRSR:
+            if ((f->count >= 2u) && ((f->sr1 & SR1_WEL) != 0u) && (f->suspended == 0u))
+            {
+                f->sr1 = (uint8_t) ((f->sr1 & (SR1_WIP | SR1_WEL)) |
+                        (f->wr_data[0] & (uint8_t) ~(SR1_WIP | SR1_WEL)));
+                if (f->count >= 3u)
+                {
+                    f->cr = f->wr_data[1];
+                }
+                start_busy(f, t, op_time_ns(f, f->cfg.t_w_typ_us, f->cfg.t_w_max_us));
+            }
+            else
+            {
+                f->stats.ignored++;
+            }
+            break;
+
+        case OP_PP:
+            if ((f->count > f->addr_bytes + 1u) && write_allowed(f))
+            {
+                uint32_t page = f->addr - (f->addr % f->cfg.page_size);
+
+                for (uint32_t i = 0; i < f->cfg.page_size; i++)
+                {
+                    f->mem[page + i] &= f->page_buf[i];
+                }
+                f->stats.page_programs++;
+                start_busy(f, t, op_time_ns(f, f->cfg.t_pp_typ_us, f->cfg.t_pp_max_us));
+            }
+            break;
+
+        case OP_SE:
+            if ((f->count == f->addr_bytes + 1u) && write_allowed(f))
+            {
+                f->stats.sector_erases++;
+                erase(f, f->addr, 4096u, t, f->cfg.t_se_typ_us, f->cfg.t_se_max_us);
+            }
+            break;
+
+        case OP_BE32:
+            if ((f->count == f->addr_bytes + 1u) && write_allowed(f))
+            {
+                f->stats.block_erases++;
+                erase(f, f->addr, 32768u, t, f->cfg.t_be32_typ_us, f->cfg.t_be32_max_us);
+            }
+            break;
+
+        case OP_BE64:
+            if ((f->count == f->addr_bytes + 1u) && write_allowed(f))
+            {
+                f->stats.block_erases++;
+                erase(f, f->addr, 65536u, t, f->cfg.t_be64_typ_us, f->cfg.t_be64_max_us);
+            }
+            break;
+
+        case OP_SUSPEND:
+            if ((f->count == 1u) && (f->cfg.t_sus_us != 0u) && is_busy(f, t) && (f->suspended == 0u) &&
+                ((f->busy_cmd == OP_PP) || (f->busy_cmd == OP_SE) ||
+                 (f->busy_cmd == OP_BE32) || (f->busy_cmd == OP_BE64)))
+            {
+                suspend(f, t);
+            }
+            break;
+
+        case OP_RESUME:
+            if ((f->count == 1u) && (f->suspended != 0u))
+            {
+                resume(f, t);
+            }
+            break;
+
+        case OP_EN4B:
+            /* A part that needs WREN first clears WEL with EN4B */
+            if ((f->count == 1u) && (f->cfg.size_bytes > ADDR_3BYTE_LIMIT) &&
+                (((f->cfg.en4b & SIM_FLASH_EN4B) != 0u) ||
+                 (((f->cfg.en4b & SIM_FLASH_EN4B_WREN) != 0u) && ((f->sr1 & SR1_WEL) != 0u))))
+            {
+                f->addr_bytes = 4u;
+                if ((f->cfg.en4b & SIM_FLASH_EN4B) == 0u)
+                {
+                    f->sr1 &= (uint8_t) ~SR1_WEL;
+                }
+            }
+            break;
+
+        case OP_EX4B:
+            if ((f->count == 1u) && (f->cfg.size_bytes > ADDR_3BYTE_LIMIT))
+            {
+                f->addr_bytes = ADDR_BYTES;
+            }
+            break;
+
+        case OP_CE:
+        case OP_CE_ALT:
+            if ((f->count == 1u) && write_allowed(f))
+            {
+                f->stats.chip_erases++;
+                memset(f->mem, 0xFF, f->cfg.size_bytes);
+                start_busy(f, t, op_time_ns(f, f->cfg.t_ce_typ_ms * 1000u,
+                        f->cfg.t_ce_max_ms * 1000u));
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,109 @@
+/******************************************************************************
+ * File Name: sim_internal.h
+ *
+ * Description: Interfaces between the models of the host simulation (core
+ *              scheduler, DMAC, SCB and flash). Not for use by host programs.
+ *
+ * Related Document: See README.md
+ *
+ *******************************************************************************
+ * Copyright 2023, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+
+#ifndef HOST_SIM_INTERNAL_H_
+#define HOST_SIM_INTERNAL_H_
+
+/*******************************************************************************
+ * Include header files
+ ******************************************************************************/
+#include "cy_pdl.h"
+#include "sim.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* SCB FIFO depth in byte mode */
+#define SIM_SCB_FIFO_DEPTH          (16u)
+
+/* DMAC channels modelled */
+#define SIM_DMAC_CHANNELS           (4u)
+
+/* TCPWM counters modelled (16 bit) */
+#define SIM_TCPWM_COUNTERS          (4u)
+
+/* Maximum elements per descriptor (16-bit DATA_CNT field holds count - 1) */
+#define SIM_DMAC_MAX_DATA_COUNT     (65536u)
+
+/******************************************************************************
+ * Global function declaration
+ ******************************************************************************/
+/* Core */
+uint64_t sim_now(void);
+void sim_irq_raise(IRQn_Type irq);
+bool sim_in_isr(void);
+
+/* DMAC */
+void sim_dmac_reset(void);
+void sim_dmac_service(void);
+void sim_dmac_set_trigger(uint32_t channel, bool (*trigger)(void));
+
+/* SCB */
+void sim_scb_reset(void);
+uint64_t sim_scb_next_event(void);
+void sim_scb_event(void);
+bool sim_scb_is_tx_fifo(const volatile void *addr);
+bool sim_scb_is_rx_fifo(const volatile void *addr);
+bool sim_scb_tx_push(uint8_t data);
+uint8_t sim_scb_rx_pop(void);
+void sim_scb_get_stats(sim_stats_t *stats);
+void sim_scb_reset_stats(void);
+
+/* TCPWM */
+void sim_tcpwm_reset(void);
+uint64_t sim_tcpwm_next_event(void);
+void sim_tcpwm_event(void);
+
+/* Flash */
+void sim_flash_reset(void);
+bool sim_flash_present(uint32_t ss);
+void sim_flash_select(uint32_t ss, uint64_t t);
+uint8_t sim_flash_exchange(uint32_t ss, uint8_t mosi, uint64_t t);
+void sim_flash_deselect(uint32_t ss, uint64_t t);
+
+/* Clocks */
+void sim_clk_reset(void);
+uint32_t sim_clk_divider(en_clk_dst_t ip_block);
+
+#endif /* HOST_SIM_INTERNAL_H_ */
+
+/* [] END OF FILE */
@@ -0,0 +1,400 @@
+/******************************************************************************
+ * File Name: sim_scb.c
+ *
+ * Description: Model of the SCB in SPI master mode: byte-mode TX and RX FIFOs
+ *              with DMA trigger levels, a shifter clocked from the peripheral
+ *              divider and oversample factor, and a slave select that stays
+ *              asserted while the TX FIFO has data (DeassertSelectLine =
+ *              false).
+ *
+ * Related Document: See README.md
+ *
+ *******************************************************************************
+ * Copyright 2023, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+
+/*******************************************************************************
+ * Include header files
+ ******************************************************************************/
+#include "sim_internal.h"
+#include "cycfg.h"
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+/* Slave select setup and hold, in SCLK periods */
+#define SIM_SCB_SS_SETUP_BITS       (1u)
+#define SIM_SCB_SS_HOLD_BITS        (1u)
+
+/*******************************************************************************
+ * Global variables declaration
+ ******************************************************************************/
+CySCB_Type sim_scb0;
+
+static struct
+{
+    bool        initialized;
+    bool        enabled;
+    uint32_t    oversample;
+    uint32_t    rx_trigger_level;
+    uint32_t    tx_trigger_level;
+
+    uint8_t     tx_fifo[SIM_SCB_FIFO_DEPTH];
+    uint32_t    tx_head;
+    uint32_t    tx_count;
+    uint8_t     rx_fifo[SIM_SCB_FIFO_DEPTH];
+    uint32_t    rx_head;
+    uint32_t    rx_count;
+
+    bool        shifting;
+    uint8_t     shift_data;
+    uint64_t    shift_end_ns;
+    bool        releasing;          /* Slave select hold after the last byte */
+    uint64_t    release_ns;
+
+    bool        selected;
+    uint32_t    active_ss;
+    uint64_t    select_ns;
+    uint32_t    master_status;
+
+    uint64_t    bus_busy_ns;
+    uint64_t    bus_bytes;
+    uint32_t    transactions;
+    uint32_t    rx_overflows;
+} scb;
+
+/*******************************************************************************
+* Triggers towards the DMAC (tr_rx_req -> channel 0, tr_tx_req -> channel 1)
+*******************************************************************************/
+static bool scb_rx_trigger(void)
+{
+    return scb.enabled && (scb.rx_count > scb.rx_trigger_level);
+}
+
+static bool scb_tx_trigger(void)
+{
+    return scb.enabled && (scb.tx_count < scb.tx_trigger_level);
+}
+
+void sim_scb_reset(void)
+{
+    memset(&scb, 0, sizeof(scb));
+    memset(&sim_scb0, 0, sizeof(sim_scb0));
+    sim_dmac_set_trigger(rxDma_CHANNEL, scb_rx_trigger);
+    sim_dmac_set_trigger(txDma_CHANNEL, scb_tx_trigger);
+}
+
+/* Time of one SCLK period in picoseconds for the current divider */
+static uint64_t bit_ps(void)
+{
+    uint64_t div = (uint64_t) Cy_SysClk_PeriphGetDivider(CYBSP_CLK_SPI_HW, CYBSP_CLK_SPI_NUM) + 1u;
+
+    return (div * scb.oversample * 1000000000000ull) / SIM_CLK_PERI_HZ;
+}
+
+uint32_t sim_spi_bitrate(void)
+{
+    uint64_t div = (uint64_t) Cy_SysClk_PeriphGetDivider(CYBSP_CLK_SPI_HW, CYBSP_CLK_SPI_NUM) + 1u;
+
+    if (scb.oversample == 0u)
+    {
+        return 0u;
+    }
+    return (uint32_t) (SIM_CLK_PERI_HZ / (div * scb.oversample));
+}
+
+bool sim_scb_is_tx_fifo(const volatile void *addr)
+{
+    return addr == (const volatile void *) &sim_scb0.TX_FIFO_WR;
+}
+
+bool sim_scb_is_rx_fifo(const volatile void *addr)
+{
+    return addr == (const volatile void *) &sim_scb0.RX_FIFO_RD;
+}
+
+bool sim_scb_tx_push(uint8_t data)
+{
+    if (scb.tx_count >= SIM_SCB_FIFO_DEPTH)
+    {
+        return false;
+    }
+    scb.tx_fifo[(scb.tx_head + scb.tx_count) % SIM_SCB_FIFO_DEPTH] = data;
+    scb.tx_count++;
+    return true;
+}
+
+uint8_t sim_scb_rx_pop(void)
+{
+    uint8_t data = 0xFFu;
+
+    if (scb.rx_count > 0u)
+    {
+        data = scb.rx_fifo[scb.rx_head];
+        scb.rx_head = (scb.rx_head + 1u) % SIM_SCB_FIFO_DEPTH;
+        scb.rx_count--;
+    }
+    return data;
+}
+
+static void rx_push(uint8_t data)
+{
+    if (scb.rx_count >= SIM_SCB_FIFO_DEPTH)
+    {
+        scb.rx_overflows++;
+        return;
+    }
+    scb.rx_fifo[(scb.rx_head + scb.rx_count) % SIM_SCB_FIFO_DEPTH] = data;
+    scb.rx_count++;
+}
+
+static void start_byte(void)
+{
+    uint64_t bit = bit_ps();
+    uint64_t start = sim_now();
+
+    if (!scb.selected)
+    {
+        scb.selected = true;
+        scb.select_ns = start;
+        scb.transactions++;
+        sim_flash_select(scb.active_ss, start);
+        start += (SIM_SCB_SS_SETUP_BITS * bit) / 1000u;
+    }
+
+    scb.shift_data = scb.tx_fifo[scb.tx_head];
+    scb.tx_head = (scb.tx_head + 1u) % SIM_SCB_FIFO_DEPTH;
+    scb.tx_count--;
+    scb.shifting = true;
+    scb.shift_end_ns = start + (8u * bit) / 1000u;
+}
+
+/*******************************************************************************
+* Function Name: sim_scb_next_event
+********************************************************************************
+*
+* Summary:
+*  Time of the next state change of the SPI master: end of the byte being
+*  shifted, release of the slave select, or start of a new byte.
+*
+*******************************************************************************/
+uint64_t sim_scb_next_event(void)
+{
+    if (!scb.enabled)
+    {
+        return SIM_TIME_NEVER;
+    }
+    if (scb.shifting)
+    {
+        return scb.shift_end_ns;
+    }
+    if (scb.releasing)
+    {
+        return scb.release_ns;
+    }
+    if (scb.tx_count > 0u)
+    {
+        return sim_now();
+    }
+    return SIM_TIME_NEVER;
+}
+
+void sim_scb_event(void)
+{
+    uint64_t t = sim_now();
+
+    if (scb.shifting && (t >= scb.shift_end_ns))
+    {
+        uint8_t miso = sim_flash_exchange(scb.active_ss, scb.shift_data, scb.shift_end_ns);
+
+        scb.shifting = false;
+        scb.bus_bytes++;
+        rx_push(miso);
+
+        /* Let the DMA refill the FIFO before deciding on the slave select */
+        sim_dmac_service();
+        if (scb.tx_count > 0u)
+        {
+            start_byte();
+        }
+        else
+        {
+            scb.releasing = true;
+            scb.release_ns = t + (SIM_SCB_SS_HOLD_BITS * bit_ps()) / 1000u;
+        }
+        return;
+    }
+
+    if (scb.releasing)
+    {
+        /* The FIFO ran empty at the end of a byte: the select line goes
+         * inactive and data written since then starts a new transaction */
+        if (t >= scb.release_ns)
+        {
+            scb.releasing = false;
+            scb.selected = false;
+            scb.bus_busy_ns += t - scb.select_ns;
+            scb.master_status |= CY_SCB_SPI_MASTER_DONE;
+            sim_flash_deselect(scb.active_ss, t);
+        }
+        return;
+    }
+
+    if (scb.tx_count > 0u)
+    {
+        start_byte();
+    }
+}
+
+void sim_scb_get_stats(sim_stats_t *stats)
+{
+    stats->bus_busy_ns = scb.bus_busy_ns;
+    stats->bus_bytes = scb.bus_bytes;
+    stats->transactions = scb.transactions;
+    stats->rx_overflows = scb.rx_overflows;
+}
+
+void sim_scb_reset_stats(void)
+{
+    scb.bus_busy_ns = 0;
+    scb.bus_bytes = 0;
+    scb.transactions = 0;
+    scb.rx_overflows = 0;
+}
+
+/*******************************************************************************
+* Register interface
+*******************************************************************************/
+cy_en_scb_spi_status_t Cy_SCB_SPI_Init(CySCB_Type *base, cy_stc_scb_spi_config_t const *config,
+        cy_stc_scb_spi_context_t *context)
+{
+    if ((base != &sim_scb0) || (config == NULL) || (config->oversample < 4u))
+    {
+        return CY_SCB_SPI_BAD_PARAM;
+    }
+
+    scb.initialized = true;
+    scb.oversample = config->oversample;
+    scb.rx_trigger_level = config->rxFifoTriggerLevel;
+    scb.tx_trigger_level = config->txFifoTriggerLevel;
+    if (context != NULL)
+    {
+        context->status = 0u;
+    }
+    return CY_SCB_SPI_SUCCESS;
+}
+
+void Cy_SCB_SPI_Enable(CySCB_Type *base)
+{
+    (void) base;
+    scb.enabled = scb.initialized;
+}
+
+void Cy_SCB_SPI_Disable(CySCB_Type *base, cy_stc_scb_spi_context_t *context)
+{
+    (void) base;
+    (void) context;
+    scb.enabled = false;
+}
+
+/*******************************************************************************
+* Function Name: Cy_SCB_SPI_IsTxComplete
+********************************************************************************
+*
+* Summary:
+*  True when the TX FIFO and the shifter are empty. This is the register the
+*  driver busy-waits on, so every call also consumes one poll quantum of
+*  virtual time.
+*
+*******************************************************************************/
+bool Cy_SCB_SPI_IsTxComplete(CySCB_Type const *base)
+{
+    (void) base;
+    sim_poll();
+    return (scb.tx_count == 0u) && !scb.shifting;
+}
+
+bool Cy_SCB_SPI_IsBusBusy(CySCB_Type const *base)
+{
+    (void) base;
+    /* Slave select is still asserted */
+    return scb.selected;
+}
+
+uint32_t Cy_SCB_SPI_GetSlaveMasterStatus(CySCB_Type const *base)
+{
+    (void) base;
+    return scb.master_status;
+}
+
+void Cy_SCB_SPI_ClearSlaveMasterStatus(CySCB_Type *base, uint32_t clearMask)
+{
+    (void) base;
+    scb.master_status &= ~clearMask;
+}
+
+void Cy_SCB_SPI_ClearRxFifo(CySCB_Type *base)
+{
+    (void) base;
+    scb.rx_head = 0;
+    scb.rx_count = 0;
+}
+
+void Cy_SCB_SPI_ClearTxFifo(CySCB_Type *base)
+{
+    (void) base;
+    scb.tx_head = 0;
+    scb.tx_count = 0;
+}
+
+uint32_t Cy_SCB_SPI_GetNumInTxFifo(CySCB_Type const *base)
+{
+    (void) base;
+    return scb.tx_count;
+}
+
+uint32_t Cy_SCB_SPI_GetNumInRxFifo(CySCB_Type const *base)
+{
+    (void) base;
+    return scb.rx_count;
+}
+
+void Cy_SCB_SPI_SetActiveSlaveSelect(CySCB_Type *base, cy_en_scb_spi_slave_select_t slaveSelect)
+{
+    (void) base;
+    /* The hardware ignores the change while a transaction is running */
+    CY_ASSERT(!scb.selected);
+    scb.active_ss = (uint32_t) slaveSelect;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,270 @@
+/******************************************************************************
+ * File Name: sim_tcpwm.c
+ *
+ * Description: Model of the TCPWM block in counter mode: 16-bit up counters
+ *              clocked from their assigned peripheral divider, continuous or
+ *              one-shot, with the terminal count interrupt on one line per
+ *              counter.
+ *
+ * Related Document: See README.md
+ *
+ *******************************************************************************
+ * Copyright 2023, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+
+
+#include "sim_internal.h"
+
+/*******************************************************************************
+* Macros
+*******************************************************************************/
+#define TCPWM_COUNTER_MAX       (0xFFFFu)
+
+/*******************************************************************************
+* Types
+*******************************************************************************/
+typedef struct
+{
+    cy_stc_tcpwm_counter_config_t   cfg;
+    bool                            enabled;
+    bool                            running;
+    uint32_t                        count;          /* Counter at start_ns */
+    uint64_t                        start_ns;
+    uint32_t                        intr;
+} sim_tcpwm_cnt_t;
+
+struct sim_tcpwm
+{
+    sim_tcpwm_cnt_t                 cnt[SIM_TCPWM_COUNTERS];
+};
+
+/*******************************************************************************
+* Global Variables
+*******************************************************************************/
+TCPWM_Type sim_tcpwm0;
+
+static const IRQn_Type tcpwm_irq[SIM_TCPWM_COUNTERS] =
+{
+    tcpwm_interrupts_0_IRQn, tcpwm_interrupts_1_IRQn,
+    tcpwm_interrupts_2_IRQn, tcpwm_interrupts_3_IRQn
+};
+
+void sim_tcpwm_reset(void)
+{
+    memset(&sim_tcpwm0, 0, sizeof(sim_tcpwm0));
+}
+
+/* Length of one counter clock in picoseconds, 0 without a clock */
+static uint64_t tick_ps(uint32_t cnt_num)
+{
+    uint32_t div = sim_clk_divider((en_clk_dst_t) (PCLK_TCPWM_CLOCKS0 + cnt_num));
+
+    return (div == 0u) ? 0u : ((uint64_t) div * 1000000000000ull) / SIM_CLK_PERI_HZ;
+}
+
+/* Counter value at time t */
+static uint32_t count_at(uint32_t cnt_num, uint64_t t)
+{
+    const sim_tcpwm_cnt_t *c = &sim_tcpwm0.cnt[cnt_num];
+    uint64_t tick = tick_ps(cnt_num);
+
+    if (!c->running || (tick == 0u))
+    {
+        return c->count;
+    }
+    return (uint32_t) ((c->count + ((t - c->start_ns) * 1000u) / tick) & TCPWM_COUNTER_MAX);
+}
+
+/* Time at which a running counter reaches its period */
+static uint64_t tc_time(uint32_t cnt_num)
+{
+    const sim_tcpwm_cnt_t *c = &sim_tcpwm0.cnt[cnt_num];
+    uint64_t tick = tick_ps(cnt_num);
+    uint32_t ticks;
+
+    if (!c->running || (tick == 0u))
+    {
+        return SIM_TIME_NEVER;
+    }
+    ticks = (c->cfg.period >= c->count) ? (c->cfg.period - c->count) :
+            (TCPWM_COUNTER_MAX - c->count + 1u + c->cfg.period);
+    return c->start_ns + ((uint64_t) ticks * tick + 999u) / 1000u;
+}
+
+uint64_t sim_tcpwm_next_event(void)
+{
+    uint64_t next = SIM_TIME_NEVER;
+
+    for (uint32_t i = 0; i < SIM_TCPWM_COUNTERS; i++)
+    {
+        uint64_t t = tc_time(i);
+
+        if (t < next)
+        {
+            next = t;
+        }
+    }
+    return next;
+}
+
+/*******************************************************************************
+* Function Name: sim_tcpwm_event
+********************************************************************************
+*
+* Summary:
+*  Terminal count of every counter due now: raise the interrupt, then stop
+*  (one-shot) or wrap to 0 (continuous).
+*
+*******************************************************************************/
+void sim_tcpwm_event(void)
+{
+    uint64_t t = sim_now();
+
+    for (uint32_t i = 0; i < SIM_TCPWM_COUNTERS; i++)
+    {
+        sim_tcpwm_cnt_t *c = &sim_tcpwm0.cnt[i];
+
+        if (tc_time(i) > t)
+        {
+            continue;
+        }
+
+        c->intr |= CY_TCPWM_INT_ON_TC;
+        if ((c->cfg.interruptSources & CY_TCPWM_INT_ON_TC) != 0u)
+        {
+            sim_irq_raise(tcpwm_irq[i]);
+        }
+
+        if (c->cfg.runMode == CY_TCPWM_COUNTER_ONESHOT)
+        {
+            c->running = false;
+            c->count = c->cfg.period;
+        }
+        else
+        {
+            /* The wrap to 0 takes one more clock */
+            c->count = 0u;
+            c->start_ns = tc_time(i) + tick_ps(i) / 1000u;
+        }
+    }
+}
+
+/*******************************************************************************
+* Register interface
+*******************************************************************************/
+cy_en_tcpwm_status_t Cy_TCPWM_Counter_Init(TCPWM_Type *base, uint32_t cntNum,
+        cy_stc_tcpwm_counter_config_t const *config)
+{
+    if ((cntNum >= SIM_TCPWM_COUNTERS) || (config == NULL) ||
+        (config->period > TCPWM_COUNTER_MAX) || (config->countDirection != CY_TCPWM_COUNTER_COUNT_UP))
+    {
+        return CY_TCPWM_BAD_PARAM;
+    }
+
+    base->cnt[cntNum] = (sim_tcpwm_cnt_t)
+    {
+        .cfg = *config,
+    };
+    return CY_TCPWM_SUCCESS;
+}
+
+void Cy_TCPWM_Counter_Enable(TCPWM_Type *base, uint32_t cntNum)
+{
+    base->cnt[cntNum].enabled = true;
+}
+
+void Cy_TCPWM_Counter_Disable(TCPWM_Type *base, uint32_t cntNum)
+{
+    base->cnt[cntNum].count = count_at(cntNum, sim_now());
+    base->cnt[cntNum].enabled = false;
+    base->cnt[cntNum].running = false;
+}
+
+void Cy_TCPWM_TriggerStart(TCPWM_Type *base, uint32_t counters)
+{
+    for (uint32_t i = 0; i < SIM_TCPWM_COUNTERS; i++)
+    {
+        sim_tcpwm_cnt_t *c = &base->cnt[i];
+
+        if (((counters & (1UL << i)) != 0u) && c->enabled && !c->running)
+        {
+            c->running = true;
+            c->start_ns = sim_now();
+        }
+    }
+}
+
+void Cy_TCPWM_TriggerStopOrKill(TCPWM_Type *base, uint32_t counters)
+{
+    for (uint32_t i = 0; i < SIM_TCPWM_COUNTERS; i++)
+    {
+        sim_tcpwm_cnt_t *c = &base->cnt[i];
+
+        if ((counters & (1UL << i)) != 0u)
+        {
+            c->count = count_at(i, sim_now());
+            c->running = false;
+        }
+    }
+}
+
+void Cy_TCPWM_Counter_SetCounter(TCPWM_Type *base, uint32_t cntNum, uint32_t count)
+{
+    base->cnt[cntNum].count = count & TCPWM_COUNTER_MAX;
+    base->cnt[cntNum].start_ns = sim_now();
+}
+
+uint32_t Cy_TCPWM_Counter_GetCounter(TCPWM_Type const *base, uint32_t cntNum)
+{
+    (void) base;
+    return count_at(cntNum, sim_now());
+}
+
+void Cy_TCPWM_Counter_SetPeriod(TCPWM_Type *base, uint32_t cntNum, uint32_t period)
+{
+    base->cnt[cntNum].count = count_at(cntNum, sim_now());
+    base->cnt[cntNum].start_ns = sim_now();
+    base->cnt[cntNum].cfg.period = period & TCPWM_COUNTER_MAX;
+}
+
+uint32_t Cy_TCPWM_GetInterruptStatusMasked(TCPWM_Type const *base, uint32_t cntNum)
+{
+    return base->cnt[cntNum].intr & base->cnt[cntNum].cfg.interruptSources;
+}
+
+void Cy_TCPWM_ClearInterrupt(TCPWM_Type *base, uint32_t cntNum, uint32_t source)
+{
+    base->cnt[cntNum].intr &= ~source;
+}
+
+/* [] END OF FILE */
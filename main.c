@@ -47,6 +47,7 @@
 #include "cycfg.h"
 #include "cybsp.h"
 #include "spi_eeprom_master.h"
+#include "spi_eeprom_trace.h"
 #include <stdio.h>
 
 /*******************************************************************************
@@ -74,6 +75,16 @@
 /*******************************************************************************
 * Global Variables
 *******************************************************************************/
+/* Result of an EEPROM operation, filled by its completion callback */
+typedef struct
+{
+    volatile bool done;
+    eeprom_dma_status_t status;
+    cy_rslt_t error;
+} flash_op_t;
+
+static flash_op_t erase_op;
+
 #if DEBUG_PRINT
 /* Variable used for tracking the print status */
 volatile bool ENTER_LOOP = true;
@@ -107,8 +118,53 @@ void check_status(char *message, cy_rslt_t status)
     Cy_SCB_UART_PutString(CYBSP_UART_HW, error_msg);
     Cy_SCB_UART_PutString(CYBSP_UART_HW, "\r\n=====================================================\r\n");
 }
+
+#if SPI_EEPROM_TRACE
+/*******************************************************************************
+* Function Name: uart_print
+********************************************************************************
+* Summary:
+*  Output of spi_eeprom_trace_dump.
+*
+* Parameters:
+*  text - string to print.
+*
+* Return:
+*  void
+*
+*******************************************************************************/
+static void uart_print(const char *text)
+{
+    Cy_SCB_UART_PutString(CYBSP_UART_HW, text);
+}
+#endif
 #endif
 
+/*******************************************************************************
+* Function Name: flash_op_done
+********************************************************************************
+* Summary:
+*  Completion callback of an EEPROM operation, executed as part of the DMA
+*  interrupt. Stores the result in the flash_op_t passed as context.
+*
+* Parameters:
+*  status - INIT_SUCCESS or STATE_TRANSFER_ERROR.
+*  error - cause of the error.
+*  ctx - flash_op_t of the operation.
+*
+* Return:
+*  void
+*
+*******************************************************************************/
+static void flash_op_done(eeprom_dma_status_t status, cy_rslt_t error, void *ctx)
+{
+    flash_op_t *op = (flash_op_t *) ctx;
+
+    op->status = status;
+    op->error = error;
+    op->done = true;
+}
+
 /*******************************************************************************
 * Function Name: main
 ********************************************************************************
@@ -198,15 +254,25 @@ int main(void)
     /* Enable global interrupts */
     __enable_irq();
 
+    /* Size, page size, erase opcodes and timing from SFDP or RDID */
+    eeprom_result = spi_eeprom_probe(0);
+    if (eeprom_result != INIT_SUCCESS)
+    {
+#if DEBUG_PRINT
+        check_status("API spi_eeprom_probe failed with error code", eeprom_result);
+#endif
+        CY_ASSERT(CY_ASSERT_FAILED);
+    }
+
     /* See if we have write access by reading BP1/BP0 */
     do
     {
         EEPROM_status_counter++;
 
-        spi_eeprom_write_status_reg(false);
+        spi_eeprom_write_status_reg(false, NULL, NULL);
         while(!spi_eeprom_done());
 
-        spi_eeprom_read_status_reg(&EEPROM_status);
+        spi_eeprom_read_status_reg(&EEPROM_status, NULL, NULL);
         while(!spi_eeprom_done());
     } while((EEPROM_status_counter < RETRY_COUNT) && (EEPROM_status & SPI_EEPROM_PROT_ALL_BLOCKS));
 
@@ -219,33 +285,43 @@ int main(void)
     }
 
     /* Enable write enable */
-    spi_eeprom_write_enable(true);
+    spi_eeprom_write_enable(true, NULL, NULL);
 
     /* Wait for all operations to finish. */
     while(!spi_eeprom_done());
 
-    /* Sector Erase */
-    spi_eeprom_4k_sector_erase(DATA_PAGE);
+    /* Sector Erase: the callback reports completion, the CPU is free meanwhile */
+    erase_op.done = false;
+    eeprom_result = spi_eeprom_4k_sector_erase(DATA_PAGE, flash_op_done, &erase_op);
+    if(eeprom_result != STATE_UNCONFIRMED_SUCCESS)
+    {
+#if DEBUG_PRINT
+        check_status("API spi_eeprom_4k_sector_erase failed with error code", eeprom_result);
+#endif
+        CY_ASSERT(CY_ASSERT_FAILED);
+    }
 
-    /* Wait for all operations to finish. */
-    while(!spi_eeprom_done());
+    while(!erase_op.done)
+    {
+        /* Other application work can run here */
+    }
 
-    if(spi_transfer_get_error())
+    if(erase_op.status != INIT_SUCCESS)
     {
 #if DEBUG_PRINT
-        check_status("API spi_eeprom_4k_sector_erase failed with error code", spi_transfer_get_error());
+        check_status("API spi_eeprom_4k_sector_erase failed with error code", erase_op.error);
 #endif
         CY_ASSERT(CY_ASSERT_FAILED);
     }
 
     /* Enable write enable */
-    spi_eeprom_write_enable(true);
+    spi_eeprom_write_enable(true, NULL, NULL);
 
     /* Wait for all operations to finish. */
     while(!spi_eeprom_done());
 
     /* Write data to EEPROM */
-    eeprom_result = spi_eeprom_write_flash(writeData, DATA_SIZE, DATA_PAGE);
+    eeprom_result = spi_eeprom_write_flash(writeData, DATA_SIZE, DATA_PAGE, NULL, NULL);
     if(eeprom_result != STATE_UNCONFIRMED_SUCCESS)
     {
 #if DEBUG_PRINT
@@ -264,7 +340,7 @@ int main(void)
     while(!spi_eeprom_done());      
 
     /* Read data from EEPROM */
-    eeprom_result = spi_eeprom_read_flash(readData, DATA_SIZE, DATA_PAGE);
+    eeprom_result = spi_eeprom_read_flash(readData, DATA_SIZE, DATA_PAGE, NULL, NULL);
     if(eeprom_result != STATE_UNCONFIRMED_SUCCESS)
     {
 #if DEBUG_PRINT
@@ -311,6 +387,12 @@ int main(void)
 #endif
     }
 
+#if DEBUG_PRINT && SPI_EEPROM_TRACE
+    /* Latency of the operations above, in microseconds */
+    Cy_SCB_UART_PutString(CYBSP_UART_HW, "\r\n");
+    spi_eeprom_trace_dump(uart_print);
+#endif
+
     /* Blink otherwise */
     for (;;)
     {
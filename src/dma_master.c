@@ -65,16 +65,64 @@ volatile bool extern_done = false;
 volatile bool rx_dma_error = false;
 volatile bool tx_dma_done= false;
 
-static bool cb_dma_dummy(void)
+/* Error of the current transfer has been passed to cb_dma */
+static bool error_reported = false;
+
+static bool cb_dma_dummy(bool error)
 {
+    (void)error;
     return true;
 }
 callback_dma_completion cb_dma = cb_dma_dummy;
 
+/* Dummy source/sink for packets without TX or RX buffer */
+static const uint8_t tx_default = CY_SCB_SPI_DEFAULT_TX&0xFF;
+static uint8_t rx_default;
+
+/* Per channel state of a packet stream */
+typedef struct
+{
+    DMAC_Type*                  hw;
+    uint32_t                    channel;
+    bool                        is_tx;
+    bool                        loaded[2];      /* Descriptor holds a packet in flight */
+    cy_en_dmac_descriptor_t     expect;         /* Descriptor completing next */
+    cy_en_dmac_descriptor_t     load;           /* Descriptor to be loaded next */
+    uint32_t                    num_loaded;     /* Packets loaded so far */
+    uint32_t                    num_done;       /* Packets completed so far */
+} dma_stream_chan_t;
+
+/* Packet stream: PING and PONG alternate, and the interrupt reloads the
+ * descriptor that just went idle while the other one is transferring */
+static struct
+{
+    bool                        active;
+    callback_dma_stream         next;
+    bool                        more;           /* Callback may return more packets */
+    bool                        split;          /* Slave select went inactive early */
+    uint32_t                    num_fetched;    /* Packets taken from callback */
+    dma_master_packet_t         queue[DMA_STREAM_QUEUE_LEN];
+    dma_stream_chan_t           tx;
+    dma_stream_chan_t           rx;
+} stream;
+
+/* Descriptors are set up for streaming (interrupt and flipping on both) */
+static bool descr_stream_mode = false;
+
+/* Packets of the ring served by send_packet_ring */
+static dma_master_packet_t *ring_packets;
+static uint32_t ring_count;
+static uint32_t ring_index;
+
 /* Internal functions */
 static void send_packet_internal(uint8_t* tx_ping, uint8_t* rx_ping,
         uint32_t num_bytes_ping, uint8_t* tx_pong, uint8_t* rx_pong, uint32_t num_bytes_pong);
+static void load_tx_descriptor(cy_en_dmac_descriptor_t descr, uint8_t* src, uint32_t num_bytes);
+static void load_rx_descriptor(cy_en_dmac_descriptor_t descr, uint8_t* dst, uint32_t num_bytes);
+static void set_stream_mode(bool enable);
+static bool stream_service(void);
 static void tx_dma_complete(void);
+static void report_error(void);
 
 /******************************************************************************
 * Function Name: init_dma_master
@@ -120,6 +168,7 @@ uint32_t dma_init(void *wr, void *rd, callback_dma_completion cb)
 
     if (dmac_init_status!=CY_DMAC_SUCCESS)
         return INIT_FAILURE;
+    descr_stream_mode = false;
 
     /* Initialize channels */
     dmac_init_status = Cy_DMAC_Channel_Init(txDma_HW, txDma_CHANNEL, &txDma_channel_config);
@@ -170,6 +219,8 @@ void send_packet(dma_master_packet_t *pong)
         return;
     }
 
+    set_stream_mode(false);
+
     /* Set PING descriptor as current descriptor for TxDma and RxDma channel  */
     Cy_DMAC_Channel_SetCurrentDescriptor(txDma_HW, txDma_CHANNEL,
                                          CY_DMAC_DESCRIPTOR_PONG);
@@ -212,6 +263,8 @@ void send_packet_multi(dma_master_packet_t *ping, dma_master_packet_t *pong)
         return;
     }
 
+    set_stream_mode(false);
+
     /* Set PING descriptor as current descriptor for TxDma and RxDma channel  */
     Cy_DMAC_Channel_SetCurrentDescriptor(txDma_HW, txDma_CHANNEL,
                                          CY_DMAC_DESCRIPTOR_PING);
@@ -256,62 +309,384 @@ void send_packet_multi(dma_master_packet_t *ping, dma_master_packet_t *pong)
 static void send_packet_internal(uint8_t* tx_ping, uint8_t* rx_ping,
         uint32_t num_bytes_ping, uint8_t* tx_pong, uint8_t* rx_pong, uint32_t num_bytes_pong)
 {
-    rx_dma_done = false;
+    tx_dma_done = false;
     rx_dma_done = false;
     extern_done = false;
-    const static uint8_t tx_default = CY_SCB_SPI_DEFAULT_TX&0xFF;
-    static uint8_t rx_default;
+    error_reported = false;
+
+    /* Set source, destination and number of bytes for all descriptors */
+    load_tx_descriptor(CY_DMAC_DESCRIPTOR_PING, tx_ping, num_bytes_ping);
+    load_tx_descriptor(CY_DMAC_DESCRIPTOR_PONG, tx_pong, num_bytes_pong);
+    load_rx_descriptor(CY_DMAC_DESCRIPTOR_PING, rx_ping, num_bytes_ping);
+    load_rx_descriptor(CY_DMAC_DESCRIPTOR_PONG, rx_pong, num_bytes_pong);
+
+    /* Enable DMA channel to transfer bytes */
+    Cy_DMAC_Channel_Enable(rxDma_HW, rxDma_CHANNEL);
+    Cy_DMAC_Enable(rxDma_HW);
+    Cy_DMAC_Channel_Enable(txDma_HW, txDma_CHANNEL);
+    Cy_DMAC_Enable(txDma_HW);
+}
 
-    /* Set source and destination for all descriptors */
-    if(tx_ping != NULL)
+/******************************************************************************
+* Function Name: load_tx_descriptor
+*******************************************************************************
+*
+* Summary:
+*  Set source and number of bytes of one TxDma descriptor. Without a source
+*  buffer the descriptor repeats CY_SCB_SPI_DEFAULT_TX.
+*
+* Parameters:
+*  descr: descriptor to load
+*  src: pointer to data to send, or NULL
+*  num_bytes: number of bytes to send
+*
+* Return:
+*  None
+*
+******************************************************************************/
+static void load_tx_descriptor(cy_en_dmac_descriptor_t descr, uint8_t* src, uint32_t num_bytes)
+{
+    if(src != NULL)
     {
-        Cy_DMAC_Descriptor_SetSrcAddress(txDma_HW, txDma_CHANNEL, CY_DMAC_DESCRIPTOR_PING, (void *) tx_ping);
-        Cy_DMAC_Descriptor_SetSrcIncrement(txDma_HW, txDma_CHANNEL, CY_DMAC_DESCRIPTOR_PING, true);
+        Cy_DMAC_Descriptor_SetSrcAddress(txDma_HW, txDma_CHANNEL, descr, (void *) src);
+        Cy_DMAC_Descriptor_SetSrcIncrement(txDma_HW, txDma_CHANNEL, descr, true);
     }
     else
     {
-        Cy_DMAC_Descriptor_SetSrcAddress(txDma_HW, txDma_CHANNEL, CY_DMAC_DESCRIPTOR_PING, (void *) &tx_default);
-        Cy_DMAC_Descriptor_SetSrcIncrement(txDma_HW, txDma_CHANNEL, CY_DMAC_DESCRIPTOR_PING, false);
+        Cy_DMAC_Descriptor_SetSrcAddress(txDma_HW, txDma_CHANNEL, descr, (void *) &tx_default);
+        Cy_DMAC_Descriptor_SetSrcIncrement(txDma_HW, txDma_CHANNEL, descr, false);
     }
+    Cy_DMAC_Descriptor_SetDataCount(txDma_HW, txDma_CHANNEL, descr, num_bytes);
+}
 
-    if(tx_pong != NULL)
+/******************************************************************************
+* Function Name: load_rx_descriptor
+*******************************************************************************
+*
+* Summary:
+*  Set destination and number of bytes of one RxDma descriptor. Without a
+*  destination buffer the received bytes are discarded.
+*
+* Parameters:
+*  descr: descriptor to load
+*  dst: pointer to buffer for received data, or NULL
+*  num_bytes: number of bytes to receive
+*
+* Return:
+*  None
+*
+******************************************************************************/
+static void load_rx_descriptor(cy_en_dmac_descriptor_t descr, uint8_t* dst, uint32_t num_bytes)
+{
+    if(dst != NULL)
     {
-        Cy_DMAC_Descriptor_SetSrcAddress(txDma_HW, txDma_CHANNEL, CY_DMAC_DESCRIPTOR_PONG, (void *) tx_pong);
-        Cy_DMAC_Descriptor_SetSrcIncrement(txDma_HW, txDma_CHANNEL, CY_DMAC_DESCRIPTOR_PONG, true);
+        Cy_DMAC_Descriptor_SetDstAddress(rxDma_HW, rxDma_CHANNEL, descr, (void *) dst);
+        Cy_DMAC_Descriptor_SetDstIncrement(rxDma_HW, rxDma_CHANNEL, descr, true);
     }
     else
     {
-        Cy_DMAC_Descriptor_SetSrcAddress(txDma_HW, txDma_CHANNEL, CY_DMAC_DESCRIPTOR_PONG, (void *) &tx_default);
-        Cy_DMAC_Descriptor_SetSrcIncrement(txDma_HW, txDma_CHANNEL, CY_DMAC_DESCRIPTOR_PONG, false);
+        Cy_DMAC_Descriptor_SetDstAddress(rxDma_HW, rxDma_CHANNEL, descr, (void *) &rx_default);
+        Cy_DMAC_Descriptor_SetDstIncrement(rxDma_HW, rxDma_CHANNEL, descr, false);
     }
+    Cy_DMAC_Descriptor_SetDataCount(rxDma_HW, rxDma_CHANNEL, descr, num_bytes);
+}
 
-    if(rx_ping != NULL)
+/******************************************************************************
+* Function Name: set_stream_mode
+*******************************************************************************
+*
+* Summary:
+*  Switch the descriptor attributes between the design.modus configuration
+*  (PING flips to PONG, only PONG interrupts) and streaming (both descriptors
+*  flip to each other and interrupt on completion).
+*
+* Parameters:
+*  enable: true for streaming, false for single/multi packets
+*
+* Return:
+*  None
+*
+******************************************************************************/
+static void set_stream_mode(bool enable)
+{
+    if(enable == descr_stream_mode)
     {
-        Cy_DMAC_Descriptor_SetDstAddress(rxDma_HW, rxDma_CHANNEL, CY_DMAC_DESCRIPTOR_PING,(void *) rx_ping);
-        Cy_DMAC_Descriptor_SetDstIncrement(rxDma_HW, rxDma_CHANNEL, CY_DMAC_DESCRIPTOR_PING, true);
+        return;
     }
-    else
+
+    Cy_DMAC_Descriptor_SetInterrupt(txDma_HW, txDma_CHANNEL, CY_DMAC_DESCRIPTOR_PING, enable);
+    Cy_DMAC_Descriptor_SetInterrupt(rxDma_HW, rxDma_CHANNEL, CY_DMAC_DESCRIPTOR_PING, enable);
+    Cy_DMAC_Descriptor_SetFlipping(txDma_HW, txDma_CHANNEL, CY_DMAC_DESCRIPTOR_PONG, enable);
+    Cy_DMAC_Descriptor_SetFlipping(rxDma_HW, rxDma_CHANNEL, CY_DMAC_DESCRIPTOR_PONG, enable);
+
+    descr_stream_mode = enable;
+}
+
+/******************************************************************************
+* Function Name: ring_next
+*******************************************************************************
+*
+* Summary:
+*  Stream callback serving the packets handed to send_packet_ring in order.
+*
+******************************************************************************/
+static bool ring_next(dma_master_packet_t *next)
+{
+    if(ring_index >= ring_count)
     {
-        Cy_DMAC_Descriptor_SetDstAddress(rxDma_HW, rxDma_CHANNEL, CY_DMAC_DESCRIPTOR_PING,(void *) &rx_default);
-        Cy_DMAC_Descriptor_SetDstIncrement(rxDma_HW, rxDma_CHANNEL, CY_DMAC_DESCRIPTOR_PING, false);
+        return false;
     }
 
-    if(rx_pong != NULL)
+    *next = ring_packets[ring_index++];
+    return true;
+}
+
+/******************************************************************************
+* Function Name: send_packet_ring
+*******************************************************************************
+*
+* Summary:
+*  Public function to send any number of packets as one continuous DMA
+*  transfer (one chip select assertion when used with SPI). The first two
+*  packets are loaded into PING and PONG; every further packet is loaded by
+*  the DMA interrupt into the descriptor that just completed, while the other
+*  descriptor is still transferring.
+*
+*  The ring must stay valid until dma_state_done() returns true.
+*
+* Parameters:
+*  ring: array of packets to send
+*  count: number of packets in ring
+*
+* Return:
+*  None
+*
+******************************************************************************/
+void send_packet_ring(dma_master_packet_t *ring, uint32_t count)
+{
+    if(!is_init || !tx_dma_done || !rx_dma_done || (ring == NULL) || (count == 0))
     {
-        Cy_DMAC_Descriptor_SetDstAddress(rxDma_HW, rxDma_CHANNEL, CY_DMAC_DESCRIPTOR_PONG,(void *) rx_pong);
-        Cy_DMAC_Descriptor_SetDstIncrement(rxDma_HW, rxDma_CHANNEL, CY_DMAC_DESCRIPTOR_PONG, true);
+        return;
+    }
+
+    ring_packets = ring;
+    ring_count = count;
+    ring_index = 0;
+
+    send_packet_stream(ring_next);
+}
+
+/******************************************************************************
+* Function Name: stream_packet
+*******************************************************************************
+*
+* Summary:
+*  Return the stream packet with the given sequence number, fetching it from
+*  the stream callback if it is the next new one. Returns NULL if the stream
+*  has ended or the queue is full (the RX channel lags behind).
+*
+******************************************************************************/
+static dma_master_packet_t *stream_packet(uint32_t index)
+{
+    if(index == stream.num_fetched)
+    {
+        dma_master_packet_t *entry = &stream.queue[index % DMA_STREAM_QUEUE_LEN];
+
+        if(!stream.more || ((stream.num_fetched - stream.rx.num_done) >= DMA_STREAM_QUEUE_LEN))
+        {
+            return NULL;
+        }
+        if(!stream.next(entry) || (entry->num_bytes == 0))
+        {
+            stream.more = false;
+            return NULL;
+        }
+        stream.num_fetched++;
+    }
+    return &stream.queue[index % DMA_STREAM_QUEUE_LEN];
+}
+
+/******************************************************************************
+* Function Name: stream_load
+*******************************************************************************
+*
+* Summary:
+*  Load the next packet into the idle descriptor of one channel, if there is
+*  one, and validate it. The channel is (re-)enabled in case it reached the
+*  descriptor before it was loaded and stopped with CY_DMAC_INVALID_DESCR.
+*
+* Return:
+*  (bool) true if a descriptor was loaded
+*
+******************************************************************************/
+static bool stream_load(dma_stream_chan_t *c)
+{
+    dma_master_packet_t *packet;
+
+    if(c->loaded[c->load])
+    {
+        return false;
+    }
+
+    packet = stream_packet(c->num_loaded);
+    if(packet == NULL)
+    {
+        return false;
+    }
+
+    if(c->is_tx)
+    {
+        load_tx_descriptor(c->load, packet->src, packet->num_bytes);
     }
     else
     {
-        Cy_DMAC_Descriptor_SetDstAddress(rxDma_HW, rxDma_CHANNEL, CY_DMAC_DESCRIPTOR_PONG,(void *) &rx_default);
-        Cy_DMAC_Descriptor_SetDstIncrement(rxDma_HW, rxDma_CHANNEL, CY_DMAC_DESCRIPTOR_PONG, false);
+        load_rx_descriptor(c->load, packet->dst, packet->num_bytes);
+    }
+    Cy_DMAC_Descriptor_SetState(c->hw, c->channel, c->load, true);
+
+    c->loaded[c->load] = true;
+    c->load = (c->load == CY_DMAC_DESCRIPTOR_PING) ? CY_DMAC_DESCRIPTOR_PONG : CY_DMAC_DESCRIPTOR_PING;
+    c->num_loaded++;
+
+    if(stream.active)
+    {
+        Cy_DMAC_Channel_Enable(c->hw, c->channel);
+        if(c->is_tx &&
+           ((Cy_SCB_SPI_GetSlaveMasterStatus(FLASH_SPI_HW) & CY_SCB_SPI_MASTER_DONE) != 0u))
+        {
+            /* The TX FIFO ran empty before this packet: the slave select
+             * went inactive and the EEPROM ended the command */
+            stream.split = true;
+        }
+    }
+    return true;
+}
+
+/******************************************************************************
+* Function Name: stream_retire
+*******************************************************************************
+*
+* Summary:
+*  Check whether the descriptor expected to complete next on one channel has
+*  completed. Its response is CY_DMAC_DONE, or CY_DMAC_INVALID_DESCR if the
+*  channel already came back to it before it was reloaded.
+*
+* Return:
+*  (bool) true if a packet completed, false otherwise. Sets the channel error
+*  flag on a bus error response.
+*
+******************************************************************************/
+static bool stream_retire(dma_stream_chan_t *c)
+{
+    cy_en_dmac_response_t response;
+
+    if(!c->loaded[c->expect])
+    {
+        return false;
+    }
+
+    response = Cy_DMAC_Descriptor_GetResponse(c->hw, c->channel, c->expect);
+    if(response == CY_DMAC_NO_ERROR)
+    {
+        return false;
+    }
+    if((response != CY_DMAC_DONE) && (response != CY_DMAC_INVALID_DESCR))
+    {
+        if(c->is_tx)
+        {
+            tx_dma_error = true;
+        }
+        else
+        {
+            rx_dma_error = true;
+        }
+        return false;
     }
 
-    /* Set number of bytes we want to read/write */
-    Cy_DMAC_Descriptor_SetDataCount(txDma_HW, txDma_CHANNEL, CY_DMAC_DESCRIPTOR_PING, num_bytes_ping);
-    Cy_DMAC_Descriptor_SetDataCount(rxDma_HW, rxDma_CHANNEL, CY_DMAC_DESCRIPTOR_PING, num_bytes_ping);
-    Cy_DMAC_Descriptor_SetDataCount(txDma_HW, txDma_CHANNEL, CY_DMAC_DESCRIPTOR_PONG, num_bytes_pong);
-    Cy_DMAC_Descriptor_SetDataCount(rxDma_HW, rxDma_CHANNEL, CY_DMAC_DESCRIPTOR_PONG, num_bytes_pong);
+    c->loaded[c->expect] = false;
+    c->expect = (c->expect == CY_DMAC_DESCRIPTOR_PING) ? CY_DMAC_DESCRIPTOR_PONG : CY_DMAC_DESCRIPTOR_PING;
+    c->num_done++;
+    return true;
+}
+
+/******************************************************************************
+* Function Name: send_packet_stream
+*******************************************************************************
+*
+* Summary:
+*  Public function to send a stream of packets provided one at a time by a
+*  callback, as one continuous DMA transfer. The callback is first called
+*  twice from this function, then from the DMA interrupt each time a
+*  descriptor becomes idle. Buffers of a packet must stay valid until the
+*  transfer completes.
+*
+*  The interrupt has to reload a descriptor before the FIFO on that side runs
+*  empty (TX) or full (RX); packets that are short compared to the interrupt
+*  latency may therefore break the chip select assertion in two. The SPI done
+*  status tells when this happened: the stream is stopped and reported to
+*  cb_dma as an error, as the EEPROM has ended the command. The slave select
+*  has to be inactive when the stream starts.
+*
+* Parameters:
+*  next: callback providing the packets
+*
+* Return:
+*  None
+*
+******************************************************************************/
+void send_packet_stream(callback_dma_stream next)
+{
+    if(!is_init || !tx_dma_done || !rx_dma_done || (next == NULL))
+    {
+        return;
+    }
+
+    stream.active = false;
+    stream.next = next;
+    stream.more = true;
+    stream.split = false;
+    stream.num_fetched = 0;
+    stream.tx = (dma_stream_chan_t)
+    {
+        .hw = txDma_HW,
+        .channel = txDma_CHANNEL,
+        .is_tx = true,
+        .expect = CY_DMAC_DESCRIPTOR_PING,
+        .load = CY_DMAC_DESCRIPTOR_PING,
+    };
+    stream.rx = (dma_stream_chan_t)
+    {
+        .hw = rxDma_HW,
+        .channel = rxDma_CHANNEL,
+        .is_tx = false,
+        .expect = CY_DMAC_DESCRIPTOR_PING,
+        .load = CY_DMAC_DESCRIPTOR_PING,
+    };
+
+    set_stream_mode(true);
+    Cy_DMAC_Channel_SetCurrentDescriptor(txDma_HW, txDma_CHANNEL, CY_DMAC_DESCRIPTOR_PING);
+    Cy_DMAC_Channel_SetCurrentDescriptor(rxDma_HW, rxDma_CHANNEL, CY_DMAC_DESCRIPTOR_PING);
+    Cy_DMAC_Descriptor_SetState(txDma_HW, txDma_CHANNEL, CY_DMAC_DESCRIPTOR_PING, false);
+    Cy_DMAC_Descriptor_SetState(txDma_HW, txDma_CHANNEL, CY_DMAC_DESCRIPTOR_PONG, false);
+    Cy_DMAC_Descriptor_SetState(rxDma_HW, rxDma_CHANNEL, CY_DMAC_DESCRIPTOR_PING, false);
+    Cy_DMAC_Descriptor_SetState(rxDma_HW, rxDma_CHANNEL, CY_DMAC_DESCRIPTOR_PONG, false);
+
+    /* Load PING and PONG of both channels, as far as there are packets */
+    while(stream_load(&stream.rx) | stream_load(&stream.tx))
+    {
+    }
+
+    if(stream.num_fetched == 0)
+    {
+        return;
+    }
+
+    stream.active = true;
+    tx_dma_done = false;
+    rx_dma_done = false;
+    extern_done = false;
+    error_reported = false;
+    Cy_SCB_SPI_ClearSlaveMasterStatus(FLASH_SPI_HW, CY_SCB_SPI_MASTER_DONE);
 
     /* Enable DMA channel to transfer bytes */
     Cy_DMAC_Channel_Enable(rxDma_HW, rxDma_CHANNEL);
@@ -320,6 +695,80 @@ static void send_packet_internal(uint8_t* tx_ping, uint8_t* rx_ping,
     Cy_DMAC_Enable(txDma_HW);
 }
 
+/******************************************************************************
+* Function Name: dma_stream_received
+*******************************************************************************
+*
+* Summary:
+*  Number of packets of the current stream the RX channel has completed, so
+*  that the stream callback can work on received data while later packets
+*  are still transferring.
+*
+* Parameters:
+*  None
+*
+* Return:
+*  (uint32_t) Packets received so far, including the command packets.
+*
+******************************************************************************/
+uint32_t dma_stream_received(void)
+{
+    return stream.rx.num_done;
+}
+
+/******************************************************************************
+* Function Name: stream_service
+*******************************************************************************
+*
+* Summary:
+*  DMA interrupt part of a stream: retire completed descriptors and reload
+*  them with the next packets until neither channel makes progress. Marks the
+*  channels done when every packet has completed. A stream whose slave select
+*  went inactive early is stopped with the TX channel in error.
+*
+* Return:
+*  (bool) true if the stream has completed on both channels
+*
+******************************************************************************/
+static bool stream_service(void)
+{
+    bool progress;
+
+    do
+    {
+        progress = stream_retire(&stream.tx);
+        progress |= stream_retire(&stream.rx);
+        progress |= stream_load(&stream.rx);
+        progress |= stream_load(&stream.tx);
+    } while(progress && !stream.split);
+
+    if(stream.split)
+    {
+        Cy_DMAC_Channel_Disable(txDma_HW, txDma_CHANNEL);
+        Cy_DMAC_Channel_Disable(rxDma_HW, rxDma_CHANNEL);
+        /* Both channels are stopped; dma_state_reset need not wait */
+        rx_dma_done = true;
+        tx_dma_error = true;
+        return false;
+    }
+
+    if(!stream.more && (stream.tx.num_done == stream.num_fetched))
+    {
+        tx_dma_done = true;
+    }
+    if(!stream.more && (stream.rx.num_done == stream.num_fetched))
+    {
+        rx_dma_done = true;
+    }
+
+    if(tx_dma_done && rx_dma_done)
+    {
+        stream.active = false;
+        return true;
+    }
+    return false;
+}
+
 /******************************************************************************
 * Function Name: tx_dma_complete
 *******************************************************************************
@@ -327,8 +776,8 @@ static void send_packet_internal(uint8_t* tx_ping, uint8_t* rx_ping,
 * Summary:
 *  Interrupt callback on DMA completion. Executed once for TX- and
 *  once for RX-transfer. After both transfers complete successfully,
-*  internal state changes to true and cb_dma_dummy is called for
-*  eventual further processing.
+*  internal state changes to true and cb_dma is called for eventual
+*  further processing. On a bus error cb_dma is called with error set.
 *
 * Parameters:
 *  None
@@ -341,6 +790,21 @@ void tx_dma_complete(void)
 {
     cy_en_dmac_response_t dmac_response;
 
+    if (stream.active)
+    {
+        /* Clear first: a completion during the service raises it again */
+        Cy_DMAC_ClearInterrupt(txDma_HW, TXDMA_CHANNEL_INT_MASK | RXDMA_CHANNEL_INT_MASK);
+        if (stream_service())
+        {
+            extern_done = cb_dma(false);
+        }
+        else if (dma_has_error())
+        {
+            report_error();
+        }
+        return;
+    }
+
     if ((Cy_DMAC_GetInterruptStatusMasked(txDma_HW) & TXDMA_CHANNEL_INT_MASK) != 0)
     {
         dmac_response = Cy_DMAC_Descriptor_GetResponse(txDma_HW, txDma_CHANNEL,
@@ -383,10 +847,41 @@ void tx_dma_complete(void)
     /* User callback */
     if(rx_dma_done & tx_dma_done)
     {
-        extern_done = cb_dma();
+        extern_done = cb_dma(false);
+    }
+    else if (dma_has_error())
+    {
+        report_error();
     }
 }
 
+/*******************************************************************************
+* Function Name: report_error
+********************************************************************************
+*
+* Summary:
+*  Pass a bus error of the current transfer to the user callback, once. The
+*  transfer is not continued; dma_state_reset has to be called before the
+*  next one.
+*
+* Parameters:
+*  None
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+static void report_error(void)
+{
+    if (error_reported)
+    {
+        return;
+    }
+    error_reported = true;
+    stream.active = false;
+    (void)cb_dma(true);
+}
+
 /*******************************************************************************
 * Function Name: DMA_is_done
 ********************************************************************************
@@ -426,7 +921,7 @@ bool dma_has_error(void)
 }
 
 /*******************************************************************************
-* Function Name: dma_has_error
+* Function Name: dma_get_error
 ********************************************************************************
 *
 * Summary:
@@ -436,15 +931,17 @@ bool dma_has_error(void)
 *  None
 *
 * Return:
-*  (cy_rslt_t) The cause from Cy_DMAC_Descriptor_GetResponse of the interrupt.
+*  (cy_rslt_t) The cause from Cy_DMAC_Descriptor_GetResponse of the interrupt,
+*  with DMA_ERROR_STREAM_SPLIT set for a stream stopped by stream_service.
 *
 *******************************************************************************/
 cy_rslt_t dma_get_error(void)
 {
     /* CY_DMAC_DONE and CY_DMAC_INVALID_DESCR are always set after a transmission, we ignore them */
-    return (Cy_DMAC_Descriptor_GetResponse(rxDma_HW, rxDma_CHANNEL, CY_DMAC_DESCRIPTOR_PONG) |
-            Cy_DMAC_Descriptor_GetResponse(txDma_HW, txDma_CHANNEL, CY_DMAC_DESCRIPTOR_PONG)
-            ) & ~(CY_DMAC_DONE | CY_DMAC_INVALID_DESCR);
+    return ((Cy_DMAC_Descriptor_GetResponse(rxDma_HW, rxDma_CHANNEL, CY_DMAC_DESCRIPTOR_PONG) |
+             Cy_DMAC_Descriptor_GetResponse(txDma_HW, txDma_CHANNEL, CY_DMAC_DESCRIPTOR_PONG)
+             ) & ~(CY_DMAC_DONE | CY_DMAC_INVALID_DESCR)) |
+           (stream.split ? DMA_ERROR_STREAM_SPLIT : 0u);
 }
 
 /*******************************************************************************
@@ -469,6 +966,7 @@ void dma_state_reset(void)
     tx_dma_done = true;
     rx_dma_error = false;
     tx_dma_error = false;
+    stream.split = false;
 }
 
 /* [] END OF FILE */
@@ -54,6 +54,18 @@
 #define RXDMA_CHANNEL_INT_MASK    (CY_DMAC_INTR_CHAN_0)
 #define TXDMA_CHANNEL_INT_MASK    (CY_DMAC_INTR_CHAN_1)
 
+/* Largest number of bytes a single packet (one descriptor) can move */
+#define DMA_PACKET_MAX_BYTES      (UINT16_MAX)
+
+/* Number of stream packets held between loading into a TX descriptor and
+ * completion by the RX channel. When the stream callback is asked for packet
+ * n, packet n - DMA_STREAM_QUEUE_LEN has completed on both channels. */
+#define DMA_STREAM_QUEUE_LEN      (4u)
+
+/* Cause from dma_get_error of a stream stopped because the slave select went
+ * inactive early. Clear of the DMAC responses and the SCB status bits. */
+#define DMA_ERROR_STREAM_SPLIT    (1UL << 16)
+
 /******************************************************************************
  * Structure/Enum type declaration
  ******************************************************************************/
@@ -73,8 +85,14 @@ typedef struct
 } dma_master_packet_t;
 
 /* Type for callback function exectued as part of DMA interrupt after
- * completion. */
-typedef bool (*callback_dma_completion)(void);
+ * completion, or once with error set when a channel reports a bus error.
+ * Returns true if nothing more is to be transferred. */
+typedef bool (*callback_dma_completion)(bool error);
+
+/* Type for callback function providing the next packet of a stream. Executed
+ * as part of DMA interrupt whenever a descriptor becomes idle. Fills *next
+ * and returns true, or returns false when the stream has no more packets. */
+typedef bool (*callback_dma_stream)(dma_master_packet_t *next);
 
 /******************************************************************************
  * Global function declaration
@@ -82,6 +100,9 @@ typedef bool (*callback_dma_completion)(void);
 uint32_t dma_init(void *wr, void *rd, callback_dma_completion cb);
 void send_packet(dma_master_packet_t *pong);
 void send_packet_multi(dma_master_packet_t *ping, dma_master_packet_t *pong);
+void send_packet_ring(dma_master_packet_t *ring, uint32_t count);
+void send_packet_stream(callback_dma_stream next);
+uint32_t dma_stream_received(void);
 bool dma_state_done(void);
 bool dma_has_error(void);
 void dma_state_reset(void);
@@ -0,0 +1,362 @@
+/******************************************************************************
+ * File Name: spi_eeprom_cache.c
+ *
+ * Description: Source file for the RAM page cache of the EEPROM interface.
+ *              Holds recently read pages with CLOCK replacement, updated by
+ *              page programs and invalidated by erases.
+ *
+ * Related Document: See README.md
+ *
+ *******************************************************************************
+ * Copyright 2023, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+
+
+/*******************************************************************************
+ * Include header files
+ ******************************************************************************/
+#include <string.h>
+#include "spi_eeprom_cache.h"
+#include "spi_eeprom_master.h"
+
+#if (SPI_EEPROM_CACHE_PAGES > 0)
+
+/*******************************************************************************
+* Global variables declaration
+*******************************************************************************/
+/* One cached page */
+typedef struct
+{
+    uint32_t page_addr;
+    bool valid;             /* data holds the page */
+    bool filling;           /* Read into data in progress */
+    bool referenced;        /* Hit since the clock hand passed */
+    uint8_t data[EEPROM_PAGE_SIZE];
+} cache_slot_t;
+
+static cache_slot_t slots[SPI_EEPROM_CACHE_PAGES];
+
+/* Next slot examined for replacement */
+static uint32_t clock_hand;
+
+static spi_eeprom_cache_stats_t cache_stats;
+
+/*******************************************************************************
+ * Function Name: find_slot
+ *******************************************************************************
+ *
+ * Summary:
+ *  Slot holding or filling page_addr, NULL if there is none.
+ *
+ ******************************************************************************/
+static cache_slot_t *find_slot(uint32_t page_addr)
+{
+    for (uint32_t i = 0; i < SPI_EEPROM_CACHE_PAGES; i++)
+    {
+        if ((slots[i].valid || slots[i].filling) && (slots[i].page_addr == page_addr))
+        {
+            return &slots[i];
+        }
+    }
+    return NULL;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_cache_lookup
+ *******************************************************************************
+ *
+ * Summary:
+ *  Look up a page for spi_eeprom_read_flash and count the hit or miss.
+ *
+ * Parameters:
+ *  page_addr Page to be read.
+ *
+ * Return:
+ *  (uint8_t *) Cached content of the page, NULL on a miss.
+ *
+ ******************************************************************************/
+uint8_t *spi_eeprom_cache_lookup(uint32_t page_addr)
+{
+    cache_slot_t *slot = find_slot(page_addr);
+
+    if ((slot == NULL) || !slot->valid)
+    {
+        cache_stats.misses++;
+        return NULL;
+    }
+    slot->referenced = true;
+    cache_stats.hits++;
+    return slot->data;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_cache_fill_begin
+ *******************************************************************************
+ *
+ * Summary:
+ *  Select a slot to read a missed page into. The clock hand skips slots hit
+ *  since it last passed, clearing their reference, and takes the first one
+ *  that was not. The slot counts as valid only after
+ *  spi_eeprom_cache_fill_end.
+ *
+ * Parameters:
+ *  page_addr Page to be read.
+ *
+ * Return:
+ *  (uint8_t *) Buffer of EEPROM_PAGE_SIZE bytes for the page.
+ *
+ ******************************************************************************/
+uint8_t *spi_eeprom_cache_fill_begin(uint32_t page_addr)
+{
+    cache_slot_t *slot = find_slot(page_addr);
+
+    while (slot == NULL)
+    {
+        cache_slot_t *candidate = &slots[clock_hand];
+
+        clock_hand = (clock_hand + 1u) % SPI_EEPROM_CACHE_PAGES;
+        if (candidate->valid && candidate->referenced)
+        {
+            candidate->referenced = false;
+            continue;
+        }
+        if (candidate->valid)
+        {
+            cache_stats.evictions++;
+        }
+        slot = candidate;
+    }
+
+    slot->page_addr = page_addr;
+    slot->valid = false;
+    slot->filling = true;
+    slot->referenced = false;
+    return slot->data;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_cache_fill_end
+ *******************************************************************************
+ *
+ * Summary:
+ *  Complete the read started with spi_eeprom_cache_fill_begin.
+ *
+ * Parameters:
+ *  page_addr Page that was read.
+ *  valid True if the read succeeded, false to drop the slot.
+ *
+ ******************************************************************************/
+void spi_eeprom_cache_fill_end(uint32_t page_addr, bool valid)
+{
+    cache_slot_t *slot = find_slot(page_addr);
+
+    if ((slot != NULL) && slot->filling)
+    {
+        slot->filling = false;
+        slot->valid = valid;
+    }
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_cache_write
+ *******************************************************************************
+ *
+ * Summary:
+ *  Write through: apply a page program to the cached pages it touches. As in
+ *  the NOR array, programming only clears bits, so the cached data becomes
+ *  old AND new.
+ *
+ * Parameters:
+ *  addr Byte address of the program.
+ *  data Data programmed.
+ *  size Number of bytes programmed.
+ *
+ ******************************************************************************/
+void spi_eeprom_cache_write(uint32_t addr, const uint8_t *data, uint32_t size)
+{
+    for (uint32_t i = 0; i < SPI_EEPROM_CACHE_PAGES; i++)
+    {
+        cache_slot_t *slot = &slots[i];
+        uint32_t page_start = slot->page_addr * EEPROM_PAGE_SIZE;
+        uint32_t from, to;
+
+        if (!slot->valid && !slot->filling)
+        {
+            continue;
+        }
+        from = (addr > page_start) ? addr : page_start;
+        to = ((addr + size) < (page_start + EEPROM_PAGE_SIZE)) ? (addr + size) : (page_start + EEPROM_PAGE_SIZE);
+        if (from >= to)
+        {
+            continue;
+        }
+        if (slot->filling)
+        {
+            /* The read may already have passed the programmed bytes */
+            slot->filling = false;
+            continue;
+        }
+        for (uint32_t a = from; a < to; a++)
+        {
+            slot->data[a - page_start] &= data[a - addr];
+        }
+    }
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_cache_invalidate
+ *******************************************************************************
+ *
+ * Summary:
+ *  Drop all cached pages overlapping a byte range, e.g. of an erase.
+ *
+ * Parameters:
+ *  addr Byte address of the range.
+ *  size Number of bytes of the range.
+ *
+ ******************************************************************************/
+void spi_eeprom_cache_invalidate(uint32_t addr, uint32_t size)
+{
+    uint32_t first = addr / EEPROM_PAGE_SIZE;
+    uint32_t last = (addr + size - 1u) / EEPROM_PAGE_SIZE;
+
+    if (size == 0)
+    {
+        return;
+    }
+    for (uint32_t i = 0; i < SPI_EEPROM_CACHE_PAGES; i++)
+    {
+        if ((slots[i].page_addr >= first) && (slots[i].page_addr <= last))
+        {
+            slots[i].valid = false;
+            slots[i].filling = false;
+        }
+    }
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_cache_clear
+ *******************************************************************************
+ *
+ * Summary:
+ *  Drop all cached pages, e.g. after a chip erase or a failed transfer.
+ *
+ ******************************************************************************/
+void spi_eeprom_cache_clear(void)
+{
+    for (uint32_t i = 0; i < SPI_EEPROM_CACHE_PAGES; i++)
+    {
+        slots[i].valid = false;
+        slots[i].filling = false;
+    }
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_cache_get_stats
+ *******************************************************************************
+ *
+ * Summary:
+ *  Hit, miss and eviction counters, to size SPI_EEPROM_CACHE_PAGES against
+ *  the RAM budget.
+ *
+ * Parameters:
+ *  stats Filled with the counters.
+ *
+ ******************************************************************************/
+void spi_eeprom_cache_get_stats(spi_eeprom_cache_stats_t *stats)
+{
+    *stats = cache_stats;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_cache_reset_stats
+ *******************************************************************************
+ *
+ * Summary:
+ *  Reset the counters of spi_eeprom_cache_get_stats.
+ *
+ ******************************************************************************/
+void spi_eeprom_cache_reset_stats(void)
+{
+    memset(&cache_stats, 0, sizeof(cache_stats));
+}
+
+#else /* SPI_EEPROM_CACHE_PAGES == 0: every read goes to the EEPROM */
+
+uint8_t *spi_eeprom_cache_lookup(uint32_t page_addr)
+{
+    (void) page_addr;
+    return NULL;
+}
+
+uint8_t *spi_eeprom_cache_fill_begin(uint32_t page_addr)
+{
+    (void) page_addr;
+    return NULL;
+}
+
+void spi_eeprom_cache_fill_end(uint32_t page_addr, bool valid)
+{
+    (void) page_addr;
+    (void) valid;
+}
+
+void spi_eeprom_cache_write(uint32_t addr, const uint8_t *data, uint32_t size)
+{
+    (void) addr;
+    (void) data;
+    (void) size;
+}
+
+void spi_eeprom_cache_invalidate(uint32_t addr, uint32_t size)
+{
+    (void) addr;
+    (void) size;
+}
+
+void spi_eeprom_cache_clear(void)
+{
+}
+
+void spi_eeprom_cache_get_stats(spi_eeprom_cache_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+}
+
+void spi_eeprom_cache_reset_stats(void)
+{
+}
+
+#endif /* SPI_EEPROM_CACHE_PAGES */
+
+/* [] END OF FILE */
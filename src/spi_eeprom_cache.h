@@ -0,0 +1,86 @@
+/******************************************************************************
+ * File Name: spi_eeprom_cache.h
+ *
+ * Description: Header file for the RAM page cache of the EEPROM interface.
+ *
+ * Related Document: See README.md
+ *
+ *******************************************************************************
+ * Copyright 2023, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+
+
+#ifndef SOURCE_SPI_EEPROM_CACHE_H_
+#define SOURCE_SPI_EEPROM_CACHE_H_
+
+/*******************************************************************************
+ * Include header files
+ ******************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Number of EEPROM pages held in RAM in front of spi_eeprom_read_flash, each
+ * costing EEPROM_PAGE_SIZE bytes; 0 disables the cache */
+#ifndef SPI_EEPROM_CACHE_PAGES
+#define SPI_EEPROM_CACHE_PAGES          (0u)
+#endif
+
+/******************************************************************************
+ * Structure/Enum type declaration
+ ******************************************************************************/
+/* Counters of the page cache since the last reset */
+typedef struct
+{
+    uint32_t    hits;           /* Reads served from RAM */
+    uint32_t    misses;         /* Reads that went to the EEPROM */
+    uint32_t    evictions;      /* Valid pages replaced by a miss */
+} spi_eeprom_cache_stats_t;
+
+/******************************************************************************
+ * Global function declaration
+ ******************************************************************************/
+uint8_t *spi_eeprom_cache_lookup(uint32_t page_addr);
+uint8_t *spi_eeprom_cache_fill_begin(uint32_t page_addr);
+void spi_eeprom_cache_fill_end(uint32_t page_addr, bool valid);
+void spi_eeprom_cache_write(uint32_t addr, const uint8_t *data, uint32_t size);
+void spi_eeprom_cache_invalidate(uint32_t addr, uint32_t size);
+void spi_eeprom_cache_clear(void);
+void spi_eeprom_cache_get_stats(spi_eeprom_cache_stats_t *stats);
+void spi_eeprom_cache_reset_stats(void);
+
+#endif /* SOURCE_SPI_EEPROM_CACHE_H_ */
+
+/* [] END OF FILE */
@@ -0,0 +1,324 @@
+/******************************************************************************
+ * File Name: spi_eeprom_calibration.c
+ *
+ * Description: Source file for SPI clock calibration of the EEPROM interface.
+ *              Finds the fastest SCB clock divider at which a training
+ *              pattern and the RDID read back correctly.
+ *
+ * Related Document: See README.md
+ *
+ *******************************************************************************
+ * Copyright 2023, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+
+
+/*******************************************************************************
+ * Include header files
+ ******************************************************************************/
+#include <string.h>
+#include "spi_eeprom_calibration.h"
+#include "dma_master.h"
+
+/*******************************************************************************
+ * Macros
+ *******************************************************************************/
+/* RDID bytes compared during calibration */
+#define CALIBRATION_RDID_LEN            (3u)
+
+/* Pages in a 4 KB sector */
+#define CALIBRATION_SECTOR_PAGES        (4096u / EEPROM_PAGE_SIZE)
+
+/*******************************************************************************
+* Global variables declaration
+*******************************************************************************/
+/* Training pattern and buffer for read back */
+static uint8_t pattern[EEPROM_PAGE_SIZE];
+static uint8_t readback[EEPROM_PAGE_SIZE];
+
+/* Results of the last SPI_CALIBRATION_ERROR_WINDOW transfers of
+ * spi_eeprom_calibration_required, one bit each set for a failure */
+static uint32_t window[(SPI_CALIBRATION_ERROR_WINDOW + 31u) / 32u];
+static uint32_t window_next;
+static uint32_t window_errors;
+
+/*******************************************************************************
+ * Function Name: window_clear
+ *******************************************************************************
+ *
+ * Summary:
+ *  Forget the transfers accounted by spi_eeprom_calibration_required.
+ *
+ ******************************************************************************/
+static void window_clear(void)
+{
+    memset(window, 0, sizeof(window));
+    window_next = 0;
+    window_errors = 0;
+}
+
+/*******************************************************************************
+ * Function Name: fill_pattern
+ *******************************************************************************
+ *
+ * Summary:
+ *  Training pattern: alternating bits, all-zero/all-one transitions, walking
+ *  ones and walking zeros, then a counter.
+ *
+ ******************************************************************************/
+static void fill_pattern(void)
+{
+    for (uint32_t i = 0; i < EEPROM_PAGE_SIZE; i++)
+    {
+        switch ((i * 4u) / EEPROM_PAGE_SIZE)
+        {
+            case 0:
+                pattern[i] = (i & 1u) ? 0xAAu : 0x55u;
+                break;
+            case 1:
+                pattern[i] = (i & 1u) ? 0xFFu : 0x00u;
+                break;
+            case 2:
+                pattern[i] = (uint8_t) (1u << (i % 8u));
+                pattern[i] = (i & 8u) ? (uint8_t) ~pattern[i] : pattern[i];
+                break;
+            default:
+                pattern[i] = (uint8_t) i;
+                break;
+        }
+    }
+}
+
+/*******************************************************************************
+ * Function Name: read_matches
+ *******************************************************************************
+ *
+ * Summary:
+ *  Read the training page and compare it to the pattern.
+ *
+ ******************************************************************************/
+static bool read_matches(uint32_t page_addr)
+{
+    memset(readback, 0, sizeof(readback));
+    if (!spi_eeprom_wait(spi_eeprom_read_range(page_addr * EEPROM_PAGE_SIZE, readback, sizeof(readback),
+            NULL, NULL)))
+    {
+        return false;
+    }
+    return memcmp(readback, pattern, sizeof(pattern)) == 0;
+}
+
+/*******************************************************************************
+ * Function Name: rdid_matches
+ *******************************************************************************
+ *
+ * Summary:
+ *  Read RDID and compare it to the reference.
+ *
+ ******************************************************************************/
+static bool rdid_matches(const uint8_t *rdid_ref)
+{
+    uint8_t rdid[CALIBRATION_RDID_LEN] = {0};
+
+    if (!spi_eeprom_wait(spi_eeprom_rdid_reg(rdid, CALIBRATION_RDID_LEN, NULL, NULL)))
+    {
+        return false;
+    }
+    return memcmp(rdid, rdid_ref, CALIBRATION_RDID_LEN) == 0;
+}
+
+/*******************************************************************************
+ * Function Name: write_pattern
+ *******************************************************************************
+ *
+ * Summary:
+ *  Erase the sector of the training page and program the pattern.
+ *
+ ******************************************************************************/
+static bool write_pattern(uint32_t page_addr)
+{
+    uint32_t sector_page = page_addr - (page_addr % CALIBRATION_SECTOR_PAGES);
+
+    return spi_eeprom_wait(spi_eeprom_write_enable(true, NULL, NULL)) &&
+           spi_eeprom_wait(spi_eeprom_4k_sector_erase(sector_page, NULL, NULL)) &&
+           spi_eeprom_wait(spi_eeprom_write_range(page_addr * EEPROM_PAGE_SIZE, pattern, sizeof(pattern),
+                    NULL, NULL));
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_calibrate_clock
+ *******************************************************************************
+ *
+ * Summary:
+ *  Find the fastest read data rate the EEPROM and board support. Starting
+ *  from the command divider, which is assumed to be safe, the divider is
+ *  decreased one step at a time. At each step RDID and SPI_CALIBRATION_PASSES
+ *  reads of a training page must match. The fastest divider that passed and
+ *  whose data rate is SPI_CALIBRATION_MARGIN_PCT below the first failing rate
+ *  is set as read divider.
+ *
+ *  The training page is programmed at the command rate if it does not hold
+ *  the pattern; this erases the 4 KB sector containing it, which must be
+ *  reserved for calibration. The function blocks until calibration is done.
+ *
+ * Parameters:
+ *  page_addr Page of the training pattern.
+ *  divider Selected read divider, may be NULL.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) INIT_SUCCESS, STATE_INVALID_PAGE for an invalid
+ *  page, OTHER_FAILURE if the device does not respond at the command rate.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_calibrate_clock(uint32_t page_addr, uint32_t *divider)
+{
+    uint8_t rdid_ref[CALIBRATION_RDID_LEN] = {0};
+    uint32_t safe_div;
+    uint32_t best_div;
+    uint32_t fail_rate = 0;
+
+    if (page_addr >= (spi_eeprom_get_geometry(spi_eeprom_get_device())->size / EEPROM_PAGE_SIZE))
+    {
+        return STATE_INVALID_PAGE;
+    }
+
+    /* Reference RDID and pattern at the command rate */
+    spi_eeprom_get_clock_divider(&safe_div, NULL);
+    spi_eeprom_set_clock_divider(safe_div, safe_div);
+    fill_pattern();
+
+    if (!spi_eeprom_wait(spi_eeprom_rdid_reg(rdid_ref, CALIBRATION_RDID_LEN, NULL, NULL)) ||
+        ((rdid_ref[0] == 0x00u) || (rdid_ref[0] == 0xFFu)))
+    {
+        return OTHER_FAILURE;
+    }
+    if (!read_matches(page_addr))
+    {
+        if (!write_pattern(page_addr) || !read_matches(page_addr))
+        {
+            return OTHER_FAILURE;
+        }
+    }
+
+    /* Step to faster rates until a check fails */
+    best_div = safe_div;
+    for (uint32_t div = safe_div - 1u; div >= 1u; div--)
+    {
+        bool pass;
+
+        spi_eeprom_set_clock_divider(div, div);
+        pass = rdid_matches(rdid_ref);
+        for (uint32_t i = 0; pass && (i < SPI_CALIBRATION_PASSES); i++)
+        {
+            pass = read_matches(page_addr);
+        }
+        if (!pass)
+        {
+            fail_rate = spi_eeprom_get_data_rate(div);
+            break;
+        }
+        best_div = div;
+    }
+
+    /* Back off until the margin to the failing rate is kept */
+    while ((fail_rate != 0) && (best_div < safe_div) &&
+           ((uint64_t) spi_eeprom_get_data_rate(best_div) * 100u >
+            (uint64_t) fail_rate * (100u - SPI_CALIBRATION_MARGIN_PCT)))
+    {
+        best_div++;
+    }
+
+    spi_eeprom_set_clock_divider(safe_div, best_div);
+    window_clear();
+
+    if (divider != NULL)
+    {
+        *divider = best_div;
+    }
+    return INIT_SUCCESS;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_calibration_required
+ *******************************************************************************
+ *
+ * Summary:
+ *  Account the result of a completed transfer, as reported by
+ *  spi_transfer_get_error and dma_has_error. To be called once after each
+ *  transfer; a failure is cleared with spi_state_reset so that it is counted
+ *  once. Returns true when SPI_CALIBRATION_ERROR_LIMIT transfers of the last
+ *  SPI_CALIBRATION_ERROR_WINDOW failed, so spi_eeprom_calibrate_clock should
+ *  run again.
+ *
+ * Parameters:
+ *  None
+ *
+ * Return:
+ *  (bool) true if calibration should be repeated.
+ *
+ ******************************************************************************/
+bool spi_eeprom_calibration_required(void)
+{
+    uint32_t *word = &window[window_next / 32u];
+    uint32_t bit = 1UL << (window_next % 32u);
+    bool failed = dma_has_error() || (spi_transfer_get_error() != 0);
+
+    if (failed)
+    {
+        spi_state_reset();
+    }
+
+    /* The oldest transfer leaves the window as this one enters it */
+    if ((*word & bit) != 0u)
+    {
+        window_errors--;
+    }
+    if (failed)
+    {
+        *word |= bit;
+        window_errors++;
+    }
+    else
+    {
+        *word &= ~bit;
+    }
+    window_next = (window_next + 1u) % SPI_CALIBRATION_ERROR_WINDOW;
+
+    if (window_errors >= SPI_CALIBRATION_ERROR_LIMIT)
+    {
+        window_clear();
+        return true;
+    }
+    return false;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,75 @@
+/******************************************************************************
+ * File Name: spi_eeprom_calibration.h
+ *
+ * Description: Header file for SPI clock calibration of the EEPROM interface.
+ *
+ * Related Document: See README.md
+ *
+ *******************************************************************************
+ * Copyright 2023, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+
+
+#ifndef SOURCE_SPI_EEPROM_CALIBRATION_H_
+#define SOURCE_SPI_EEPROM_CALIBRATION_H_
+
+/*******************************************************************************
+ * Include header files
+ ******************************************************************************/
+#include "spi_eeprom_master.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Reads of the training pattern per divider, all must pass */
+#define SPI_CALIBRATION_PASSES          (4u)
+
+/* Required headroom in percent between the selected data rate and the
+ * slowest data rate that failed */
+#define SPI_CALIBRATION_MARGIN_PCT      (20u)
+
+/* Transfers per window of spi_eeprom_calibration_required */
+#define SPI_CALIBRATION_ERROR_WINDOW    (64u)
+
+/* Failed transfers within a window that request a new calibration */
+#define SPI_CALIBRATION_ERROR_LIMIT     (2u)
+
+/******************************************************************************
+ * Global function declaration
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_calibrate_clock(uint32_t page_addr, uint32_t *divider);
+bool spi_eeprom_calibration_required(void);
+
+#endif /* SOURCE_SPI_EEPROM_CALIBRATION_H_ */
+
+/* [] END OF FILE */
@@ -0,0 +1,421 @@
+/******************************************************************************
+ * File Name: spi_eeprom_erase.c
+ *
+ * Description: Source file for erasing a range of the EEPROM with the fewest
+ *              erase commands, optionally skipping sectors that are blank.
+ *
+ * Related Document: See README.md
+ *
+ *******************************************************************************
+ * Copyright 2023, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+
+
+/*******************************************************************************
+ * Include header files
+ ******************************************************************************/
+#include "spi_eeprom_erase.h"
+
+/*******************************************************************************
+* Global variables declaration
+*******************************************************************************/
+/* Steps of an erase range */
+typedef enum
+{
+    ERASE_IDLE,
+    ERASE_CHECK,            /* Blank check of a sector of the unit planned next */
+    ERASE_RUN               /* Erase command in progress */
+} erase_state_t;
+
+/* Erase range in progress. With the blank check, addr..checked has been
+ * found blank, and dirty is set if the unit at addr is known not to be */
+static struct
+{
+    volatile erase_state_t state;
+    uint32_t addr;
+    uint32_t end;
+    uint32_t unit;          /* Size of the erase unit planned at addr */
+    uint32_t checked;
+    bool blank_check;
+    bool dirty;
+    spi_eeprom_callback_t cb;
+    void *ctx;
+} erase;
+
+static spi_eeprom_erase_stats_t erase_stats;
+
+/* Internal functions */
+static void erase_step(eeprom_dma_status_t status, cy_rslt_t error, void *ctx);
+
+/*******************************************************************************
+ * Function Name: erase_finish
+ *******************************************************************************
+ *
+ * Summary:
+ *  End the erase range and call its callback.
+ *
+ ******************************************************************************/
+static void erase_finish(eeprom_dma_status_t status, cy_rslt_t error)
+{
+    erase.state = ERASE_IDLE;
+    if (erase.cb != NULL)
+    {
+        erase.cb(status, error, erase.ctx);
+    }
+}
+
+/*******************************************************************************
+ * Function Name: submit
+ *******************************************************************************
+ *
+ * Summary:
+ *  Queue the next operation of the erase range, entering state. Ends the
+ *  erase range if the queue refuses it.
+ *
+ ******************************************************************************/
+static void submit(erase_state_t state, spi_eeprom_op_t op, uint32_t addr, uint8_t *buffer, uint32_t size)
+{
+    eeprom_dma_status_t status;
+
+    erase.state = state;
+    status = spi_eeprom_submit(op, addr, buffer, size, erase_step, NULL);
+    if (status != STATE_UNCONFIRMED_SUCCESS)
+    {
+        erase_finish(status, CY_RSLT_SUCCESS);
+    }
+}
+
+/*******************************************************************************
+ * Function Name: erase_plan
+ *******************************************************************************
+ *
+ * Summary:
+ *  Largest erase unit of the EEPROM aligned at addr that does not exceed the
+ *  range.
+ *
+ ******************************************************************************/
+static uint32_t erase_plan(uint32_t addr, uint32_t end)
+{
+    const spi_eeprom_geometry_t *geo = spi_eeprom_get_geometry(spi_eeprom_get_device());
+
+    if ((geo->erase_64k_cmd != 0) &&
+        ((addr & (SPI_EEPROM_BLOCK_64K_SIZE - 1u)) == 0) && ((end - addr) >= SPI_EEPROM_BLOCK_64K_SIZE))
+    {
+        return SPI_EEPROM_BLOCK_64K_SIZE;
+    }
+    if ((geo->erase_32k_cmd != 0) &&
+        ((addr & (SPI_EEPROM_BLOCK_32K_SIZE - 1u)) == 0) && ((end - addr) >= SPI_EEPROM_BLOCK_32K_SIZE))
+    {
+        return SPI_EEPROM_BLOCK_32K_SIZE;
+    }
+    return SPI_EEPROM_SECTOR_SIZE;
+}
+
+/*******************************************************************************
+ * Function Name: erase_skip
+ *******************************************************************************
+ *
+ * Summary:
+ *  Count size bytes from addr as skipped by the blank check, in sectors or
+ *  one block, and move addr past them.
+ *
+ ******************************************************************************/
+static void erase_skip(uint32_t size)
+{
+    const uint32_t *t_typ_us = spi_eeprom_get_geometry(spi_eeprom_get_device())->t_typ_us;
+
+    switch (size)
+    {
+        case SPI_EEPROM_BLOCK_64K_SIZE:
+            erase_stats.us_skipped += t_typ_us[SPI_EEPROM_TIME_BE64];
+            break;
+        case SPI_EEPROM_BLOCK_32K_SIZE:
+            erase_stats.us_skipped += t_typ_us[SPI_EEPROM_TIME_BE32];
+            break;
+        default:
+            erase_stats.us_skipped += (size / SPI_EEPROM_SECTOR_SIZE) * t_typ_us[SPI_EEPROM_TIME_SE];
+            break;
+    }
+    erase_stats.sectors_blank += size / SPI_EEPROM_SECTOR_SIZE;
+    erase_stats.bytes_skipped += size;
+    erase.addr += size;
+}
+
+/*******************************************************************************
+ * Function Name: erase_issue
+ *******************************************************************************
+ *
+ * Summary:
+ *  Queue the erase command for the unit planned at addr.
+ *
+ ******************************************************************************/
+static void erase_issue(void)
+{
+    spi_eeprom_op_t op;
+
+    switch (erase.unit)
+    {
+        case SPI_EEPROM_BLOCK_64K_SIZE:
+            op = SPI_EEPROM_OP_ERASE_64K;
+            erase_stats.erase_64k++;
+            break;
+        case SPI_EEPROM_BLOCK_32K_SIZE:
+            op = SPI_EEPROM_OP_ERASE_32K;
+            erase_stats.erase_32k++;
+            break;
+        default:
+            op = SPI_EEPROM_OP_ERASE_4K;
+            erase_stats.erase_4k++;
+            break;
+    }
+    submit(ERASE_RUN, op, erase.addr, NULL, 0);
+}
+
+/*******************************************************************************
+ * Function Name: erase_next
+ *******************************************************************************
+ *
+ * Summary:
+ *  Plan the unit at addr, then blank check its next sector or erase it.
+ *  Finishes the erase range once the whole range is done.
+ *
+ ******************************************************************************/
+static void erase_next(void)
+{
+    if (erase.addr >= erase.end)
+    {
+        erase_finish(INIT_SUCCESS, CY_RSLT_SUCCESS);
+        return;
+    }
+
+    erase.unit = erase_plan(erase.addr, erase.end);
+    if (!erase.blank_check || erase.dirty)
+    {
+        erase.dirty = false;
+        erase_issue();
+        return;
+    }
+    if (erase.checked < (erase.addr + erase.unit))
+    {
+        submit(ERASE_CHECK, SPI_EEPROM_OP_COMPARE, erase.checked, NULL, SPI_EEPROM_SECTOR_SIZE);
+        return;
+    }
+
+    /* The whole unit is blank */
+    erase_skip(erase.unit);
+    erase_next();
+}
+
+/*******************************************************************************
+ * Function Name: erase_check_done
+ *******************************************************************************
+ *
+ * Summary:
+ *  Evaluate the blank check of a sector. At the first sector that is not
+ *  blank, the whole unit planned is erased without checking the rest of it,
+ *  so the plan keeps its block alignment; only units found blank entirely
+ *  are skipped.
+ *
+ ******************************************************************************/
+static void erase_check_done(bool blank)
+{
+    if (!blank)
+    {
+        erase.dirty = true;
+        erase_next();
+        return;
+    }
+    erase.checked += SPI_EEPROM_SECTOR_SIZE;
+    erase_next();
+}
+
+/*******************************************************************************
+ * Function Name: erase_step
+ *******************************************************************************
+ *
+ * Summary:
+ *  Completion callback of every operation of the erase range, executed as
+ *  part of the DMA interrupt; queues the next one.
+ *
+ ******************************************************************************/
+static void erase_step(eeprom_dma_status_t status, cy_rslt_t error, void *ctx)
+{
+    (void) ctx;
+
+    if ((erase.state == ERASE_CHECK) && (status == STATE_COMPARE_MISMATCH))
+    {
+        erase_check_done(false);
+        return;
+    }
+    if (status != INIT_SUCCESS)
+    {
+        erase_finish(status, error);
+        return;
+    }
+
+    if (erase.state == ERASE_CHECK)
+    {
+        erase_check_done(true);
+    }
+    else
+    {
+        erase.addr += erase.unit;
+        if (erase.checked < erase.addr)
+        {
+            erase.checked = erase.addr;
+        }
+        erase_next();
+    }
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_erase_range
+ *******************************************************************************
+ *
+ * Summary:
+ *  Erase a range of whole sectors with the fewest erase commands: 64 KB and
+ *  32 KB block erases where the range covers aligned blocks, sector erases
+ *  for the rest, or one chip erase for the whole EEPROM. Optionally blank
+ *  checks each unit first with spi_eeprom_compare_range and skips it if it
+ *  is blank already, which pays off when reading a unit is faster than
+ *  erasing it.
+ *
+ *  Runs as a chain of spi_eeprom_submit operations from the DMA interrupt.
+ *  One erase range at a time.
+ *
+ * Parameters:
+ *  addr Byte address of the first sector, aligned to SPI_EEPROM_SECTOR_SIZE.
+ *  size Number of bytes, a multiple of SPI_EEPROM_SECTOR_SIZE.
+ *  blank_check Skip sectors that are blank.
+ *  cb Called as part of the DMA interrupt when the erase range has
+ *     completed, may be NULL.
+ *  ctx User context passed to cb.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) STATE_UNCONFIRMED_SUCCESS if the erase range was
+ *  started, STATE_QUEUE_FULL if one is in progress or the queue is full,
+ *  STATE_INVALID_ARGUMENT for an unaligned range and STATE_INVALID_PAGE if
+ *  the range exceeds the EEPROM.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_erase_range(uint32_t addr, uint32_t size, bool blank_check,
+        spi_eeprom_callback_t cb, void *ctx)
+{
+    const uint32_t eeprom_size = spi_eeprom_get_geometry(spi_eeprom_get_device())->size;
+    uint32_t intr;
+    bool started;
+
+    if ((size == 0) || (((addr | size) & (SPI_EEPROM_SECTOR_SIZE - 1u)) != 0))
+    {
+        return STATE_INVALID_ARGUMENT;
+    }
+    if ((addr >= eeprom_size) || (size > (eeprom_size - addr)))
+    {
+        return STATE_INVALID_PAGE;
+    }
+
+    intr = Cy_SysLib_EnterCriticalSection();
+    if (erase.state != ERASE_IDLE)
+    {
+        Cy_SysLib_ExitCriticalSection(intr);
+        return STATE_QUEUE_FULL;
+    }
+    erase.addr = addr;
+    erase.end = addr + size;
+    erase.checked = addr;
+    erase.blank_check = blank_check;
+    erase.dirty = false;
+
+    /* If the queue refuses the first operation, the erase range ends
+     * without a callback and the caller gets the error instead */
+    erase.cb = NULL;
+    if (!blank_check && (size == eeprom_size))
+    {
+        erase.unit = size;
+        erase_stats.erase_chip++;
+        submit(ERASE_RUN, SPI_EEPROM_OP_ERASE_CHIP, 0, NULL, 0);
+    }
+    else
+    {
+        erase_next();
+    }
+    started = (erase.state != ERASE_IDLE);
+    if (started)
+    {
+        erase.cb = cb;
+        erase.ctx = ctx;
+    }
+    Cy_SysLib_ExitCriticalSection(intr);
+
+    return started ? STATE_UNCONFIRMED_SUCCESS : STATE_QUEUE_FULL;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_erase_busy
+ *******************************************************************************
+ *
+ * Summary:
+ *  Return whether an erase range is in progress.
+ *
+ * Parameters:
+ *  None
+ *
+ * Return:
+ *  (bool) true while an erase range is in progress.
+ *
+ ******************************************************************************/
+bool spi_eeprom_erase_busy(void)
+{
+    return erase.state != ERASE_IDLE;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_erase_get_stats
+ *******************************************************************************
+ *
+ * Summary:
+ *  Counters of erase commands issued and sectors skipped as blank.
+ *
+ * Parameters:
+ *  stats Filled with the counters.
+ *
+ * Return:
+ *  None
+ *
+ ******************************************************************************/
+void spi_eeprom_erase_get_stats(spi_eeprom_erase_stats_t *stats)
+{
+    *stats = erase_stats;
+}
+
+/* [] END OF FILE */
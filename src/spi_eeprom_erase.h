@@ -0,0 +1,84 @@
+/******************************************************************************
+ * File Name: spi_eeprom_erase.h
+ *
+ * Description: Header file for erasing a range of the EEPROM.
+ *
+ * Related Document: See README.md
+ *
+ *******************************************************************************
+ * Copyright 2023, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+
+
+#ifndef SOURCE_SPI_EEPROM_ERASE_H_
+#define SOURCE_SPI_EEPROM_ERASE_H_
+
+/*******************************************************************************
+ * Include header files
+ ******************************************************************************/
+#include "spi_eeprom_master.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Erase units of the EEPROM */
+#define SPI_EEPROM_SECTOR_SIZE          (0x1000u)
+#define SPI_EEPROM_BLOCK_32K_SIZE       (0x8000u)
+#define SPI_EEPROM_BLOCK_64K_SIZE       (0x10000u)
+
+/******************************************************************************
+ * Structure/Enum type declaration
+ ******************************************************************************/
+/* Counters of spi_eeprom_erase_range since initialization */
+typedef struct
+{
+    uint32_t    erase_4k;           /* Sector erase commands */
+    uint32_t    erase_32k;          /* 32 KB block erase commands */
+    uint32_t    erase_64k;          /* 64 KB block erase commands */
+    uint32_t    erase_chip;         /* Chip erase commands */
+    uint32_t    sectors_blank;      /* Sectors skipped by the blank check */
+    uint32_t    bytes_skipped;      /* Bytes of the sectors skipped */
+    uint32_t    us_skipped;         /* Typical erase time of the sectors skipped */
+} spi_eeprom_erase_stats_t;
+
+/******************************************************************************
+ * Global function declaration
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_erase_range(uint32_t addr, uint32_t size, bool blank_check,
+        spi_eeprom_callback_t cb, void *ctx);
+bool spi_eeprom_erase_busy(void);
+void spi_eeprom_erase_get_stats(spi_eeprom_erase_stats_t *stats);
+
+#endif /* SOURCE_SPI_EEPROM_ERASE_H_ */
+
+/* [] END OF FILE */
@@ -0,0 +1,1042 @@
+/******************************************************************************
+ * File Name: spi_eeprom_kv.c
+ *
+ * Description: Source file for a log-structured key-value store in the EEPROM.
+ *              Records are appended to a ring of sectors, found through a RAM
+ *              hash index, and live records of the oldest sector are moved
+ *              before it is erased, which spreads the erases over all sectors.
+ *
+ * Related Document: See README.md
+ *
+ *******************************************************************************
+ * Copyright 2023, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+
+
+/*******************************************************************************
+ * Include header files
+ ******************************************************************************/
+#include <string.h>
+#include "spi_eeprom_kv.h"
+#include "spi_eeprom_erase.h"
+
+/*******************************************************************************
+ * Macros
+ *******************************************************************************/
+/* Sector header: magic, sequence number and erase count, little endian */
+#define KV_SECTOR_MAGIC         (0x3153564Bu)
+#define KV_HEADER_SIZE          (16u)
+#define KV_HEADER_USED          (12u)
+
+/* Sequence number of an erased sector, programmed when it is taken */
+#define KV_SEQ_FREE             (0xFFFFFFFFu)
+
+/* Record: key (little endian), value length or KV_TOMBSTONE, CRC-8, value */
+#define KV_RECORD_HEADER_SIZE   (4u)
+#define KV_RECORD_MAX           (KV_RECORD_HEADER_SIZE + SPI_EEPROM_KV_VALUE_MAX)
+#define KV_TOMBSTONE            (0x80u)
+
+/* Records fill a sector up to the summary, which holds key and offset of
+ * each record and ends with a trailer of magic and number of entries */
+#define KV_RECORDS_END          (SPI_EEPROM_SECTOR_SIZE - SPI_EEPROM_KV_SUMMARY_SIZE)
+#define KV_SUMMARY_MAGIC        (0x5553u)
+#define KV_SUMMARY_ENTRIES      ((SPI_EEPROM_KV_SUMMARY_SIZE - 4u) / 4u)
+#define KV_SUMMARY_TOMBSTONE    (0x8000u)
+
+/* Summary entries read per transfer */
+#define KV_SCAN_ENTRIES         (16u)
+
+/* Index slot without key */
+#define KV_EMPTY_KEY            (0xFFFFu)
+
+/* Location of a record: sector of the store and offset within it */
+#define KV_LOC(sector, offset)  ((uint16_t) (((sector) << 12) | (offset)))
+#define KV_LOC_SECTOR(loc)      ((uint32_t) (loc) >> 12)
+#define KV_LOC_OFFSET(loc)      ((uint32_t) (loc) & 0xFFFu)
+
+#if (SPI_EEPROM_KV_SECTORS < 3u) || (SPI_EEPROM_KV_SECTORS > 16u)
+#error "SPI_EEPROM_KV_SECTORS must be 3 to 16"
+#endif
+
+/*******************************************************************************
+* Global variables declaration
+*******************************************************************************/
+/* Index slot: key and location of its latest record */
+typedef struct
+{
+    uint16_t key;
+    uint16_t loc;
+} kv_slot_t;
+
+/* Store. Sectors tail..head (as a ring) hold records, the others are erased */
+static struct
+{
+    bool mounted;
+    uint32_t base;
+    uint32_t seq;           /* Sequence number of head */
+    uint32_t head;          /* Sector records are appended to */
+    uint32_t tail;          /* Oldest sector holding records */
+    uint32_t free;          /* Erased sectors */
+    uint32_t write_off;     /* Offset of the next record in head */
+    uint32_t count;         /* Summary entries of head */
+    bool sealed;            /* Summary of head is programmed */
+    uint32_t keys;
+} kv;
+
+/* State of each sector of the store */
+static struct
+{
+    bool used;
+    uint32_t seq;
+    uint32_t erases;
+} sectors[SPI_EEPROM_KV_SECTORS];
+
+static kv_slot_t index_slots[SPI_EEPROM_KV_INDEX_SIZE];
+
+/* Summary of head, laid out as in the EEPROM */
+static uint8_t summary[SPI_EEPROM_KV_SUMMARY_SIZE];
+
+/* Record being written or read, and summary entries being read */
+static uint8_t record[KV_RECORD_MAX];
+static uint8_t scan[KV_SCAN_ENTRIES * 4u];
+
+static spi_eeprom_kv_stats_t kv_stats;
+
+/*******************************************************************************
+ * Function Name: kv_read / kv_program / kv_erase
+ *******************************************************************************
+ *
+ * Summary:
+ *  Blocking read, program and sector erase at a byte address.
+ *
+ ******************************************************************************/
+static bool kv_read(uint32_t addr, uint8_t *buf, uint32_t size)
+{
+    return spi_eeprom_wait(spi_eeprom_read_range(addr, buf, size, NULL, NULL));
+}
+
+static bool kv_program(uint32_t addr, uint8_t *buf, uint32_t size)
+{
+    return spi_eeprom_wait(spi_eeprom_write_range(addr, buf, size, NULL, NULL));
+}
+
+static bool kv_erase(uint32_t addr)
+{
+    return spi_eeprom_wait(spi_eeprom_write_enable(true, NULL, NULL)) &&
+           spi_eeprom_wait(spi_eeprom_4k_sector_erase(addr / EEPROM_PAGE_SIZE, NULL, NULL));
+}
+
+static uint32_t sector_addr(uint32_t sector)
+{
+    return kv.base + sector * SPI_EEPROM_SECTOR_SIZE;
+}
+
+static uint16_t get16(const uint8_t *p)
+{
+    return (uint16_t) (p[0] | (p[1] << 8));
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+    return (uint32_t) get16(p) | ((uint32_t) get16(&p[2]) << 16);
+}
+
+static void put16(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t) v;
+    p[1] = (uint8_t) (v >> 8);
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    put16(p, v);
+    put16(&p[2], v >> 16);
+}
+
+/*******************************************************************************
+ * Function Name: crc8
+ *******************************************************************************
+ *
+ * Summary:
+ *  CRC-8 (polynomial 0x07) of a record without its CRC byte.
+ *
+ ******************************************************************************/
+static uint8_t crc8(const uint8_t *rec, uint32_t value_len)
+{
+    uint8_t crc = 0;
+
+    for (uint32_t i = 0; i < (KV_RECORD_HEADER_SIZE + value_len); i++)
+    {
+        if (i == 3u)
+        {
+            continue;
+        }
+        crc ^= rec[i];
+        for (uint32_t bit = 0; bit < 8u; bit++)
+        {
+            crc = (uint8_t) ((crc & 0x80u) ? (((uint32_t) crc << 1) ^ 0x07u) : ((uint32_t) crc << 1));
+        }
+    }
+    return crc;
+}
+
+/*******************************************************************************
+ * Function Name: record_value_len
+ *******************************************************************************
+ *
+ * Summary:
+ *  Length of the value of the record in the first size bytes of record[],
+ *  or -1 if the record is not valid.
+ *
+ ******************************************************************************/
+static int32_t record_value_len(uint32_t size)
+{
+    uint32_t len = (record[2] == KV_TOMBSTONE) ? 0 : record[2];
+
+    if ((len > SPI_EEPROM_KV_VALUE_MAX) || ((KV_RECORD_HEADER_SIZE + len) > size) ||
+        (crc8(record, len) != record[3]))
+    {
+        return -1;
+    }
+    return (int32_t) len;
+}
+
+/*******************************************************************************
+ * Function Name: index_find
+ *******************************************************************************
+ *
+ * Summary:
+ *  Slot of key in the index (linear probing), or -1.
+ *
+ ******************************************************************************/
+static uint32_t index_home(uint16_t key)
+{
+    return ((uint32_t) key * 40503u) & (SPI_EEPROM_KV_INDEX_SIZE - 1u);
+}
+
+static int32_t index_find(uint16_t key)
+{
+    uint32_t i = index_home(key);
+
+    while (index_slots[i].key != KV_EMPTY_KEY)
+    {
+        if (index_slots[i].key == key)
+        {
+            return (int32_t) i;
+        }
+        i = (i + 1u) & (SPI_EEPROM_KV_INDEX_SIZE - 1u);
+    }
+    return -1;
+}
+
+/*******************************************************************************
+ * Function Name: index_put
+ *******************************************************************************
+ *
+ * Summary:
+ *  Set the location of key, adding it if it is new.
+ *
+ * Return:
+ *  (bool) false if the key is new and SPI_EEPROM_KV_MAX_KEYS are held.
+ *
+ ******************************************************************************/
+static bool index_put(uint16_t key, uint16_t loc)
+{
+    uint32_t i = index_home(key);
+
+    while ((index_slots[i].key != KV_EMPTY_KEY) && (index_slots[i].key != key))
+    {
+        i = (i + 1u) & (SPI_EEPROM_KV_INDEX_SIZE - 1u);
+    }
+    if (index_slots[i].key == KV_EMPTY_KEY)
+    {
+        if (kv.keys >= SPI_EEPROM_KV_MAX_KEYS)
+        {
+            return false;
+        }
+        kv.keys++;
+        index_slots[i].key = key;
+    }
+    index_slots[i].loc = loc;
+    return true;
+}
+
+/*******************************************************************************
+ * Function Name: index_remove
+ *******************************************************************************
+ *
+ * Summary:
+ *  Remove key from the index, shifting back the slots of its probe sequence.
+ *
+ ******************************************************************************/
+static void index_remove(uint16_t key)
+{
+    int32_t found = index_find(key);
+    uint32_t i;
+    uint32_t j;
+
+    if (found < 0)
+    {
+        return;
+    }
+    i = (uint32_t) found;
+    j = i;
+    index_slots[i].key = KV_EMPTY_KEY;
+    kv.keys--;
+
+    for (;;)
+    {
+        uint32_t home;
+
+        j = (j + 1u) & (SPI_EEPROM_KV_INDEX_SIZE - 1u);
+        if (index_slots[j].key == KV_EMPTY_KEY)
+        {
+            return;
+        }
+        /* The entry at j stays if its home lies cyclically in (i, j] */
+        home = index_home(index_slots[j].key);
+        if (((j > i) && ((home <= i) || (home > j))) || ((j < i) && (home <= i) && (home > j)))
+        {
+            index_slots[i] = index_slots[j];
+            index_slots[j].key = KV_EMPTY_KEY;
+            i = j;
+        }
+    }
+}
+
+/*******************************************************************************
+ * Function Name: index_apply
+ *******************************************************************************
+ *
+ * Summary:
+ *  Enter a record into the index: its key now lives there, or is deleted.
+ *
+ ******************************************************************************/
+static bool index_apply(uint16_t key, uint16_t loc, bool tombstone)
+{
+    if (tombstone)
+    {
+        index_remove(key);
+        return true;
+    }
+    return index_put(key, loc);
+}
+
+/*******************************************************************************
+ * Function Name: write_header
+ *******************************************************************************
+ *
+ * Summary:
+ *  Program the header of a sector. Programming the sequence number of an
+ *  erased sector's header later only clears bits.
+ *
+ ******************************************************************************/
+static bool write_header(uint32_t sector, uint32_t seq)
+{
+    uint8_t header[KV_HEADER_USED];
+
+    put32(&header[0], KV_SECTOR_MAGIC);
+    put32(&header[4], seq);
+    put32(&header[8], sectors[sector].erases);
+    return kv_program(sector_addr(sector), header, sizeof(header));
+}
+
+/*******************************************************************************
+ * Function Name: head_seal
+ *******************************************************************************
+ *
+ * Summary:
+ *  Program the summary of head.
+ *
+ ******************************************************************************/
+static bool head_seal(void)
+{
+    if (kv.sealed)
+    {
+        return true;
+    }
+    put16(&summary[SPI_EEPROM_KV_SUMMARY_SIZE - 4u], KV_SUMMARY_MAGIC);
+    put16(&summary[SPI_EEPROM_KV_SUMMARY_SIZE - 2u], kv.count);
+    kv.sealed = true;
+    return kv_program(sector_addr(kv.head) + KV_RECORDS_END, summary, sizeof(summary));
+}
+
+/*******************************************************************************
+ * Function Name: head_open
+ *******************************************************************************
+ *
+ * Summary:
+ *  Take the erased sector as head.
+ *
+ ******************************************************************************/
+static bool head_open(uint32_t sector)
+{
+    kv.seq++;
+    sectors[sector].used = true;
+    sectors[sector].seq = kv.seq;
+    kv.free--;
+    kv.head = sector;
+    kv.write_off = KV_HEADER_SIZE;
+    kv.count = 0;
+    kv.sealed = false;
+    memset(summary, 0xFF, sizeof(summary));
+    return write_header(sector, kv.seq);
+}
+
+/*******************************************************************************
+ * Function Name: head_fits
+ *******************************************************************************
+ *
+ * Summary:
+ *  Check whether a record of size bytes fits into head.
+ *
+ ******************************************************************************/
+static bool head_fits(uint32_t size)
+{
+    return !kv.sealed && ((kv.write_off + size) <= KV_RECORDS_END) && (kv.count < KV_SUMMARY_ENTRIES);
+}
+
+/*******************************************************************************
+ * Function Name: head_append
+ *******************************************************************************
+ *
+ * Summary:
+ *  Program the record in record[] at the end of head and enter it into the
+ *  summary and the index.
+ *
+ ******************************************************************************/
+static bool head_append(uint32_t value_len)
+{
+    uint16_t key = get16(record);
+    bool tombstone = (record[2] == KV_TOMBSTONE);
+    uint32_t size = KV_RECORD_HEADER_SIZE + value_len;
+
+    if (!kv_program(sector_addr(kv.head) + kv.write_off, record, size))
+    {
+        return false;
+    }
+    put16(&summary[kv.count * 4u], key);
+    put16(&summary[kv.count * 4u + 2u], kv.write_off | (tombstone ? KV_SUMMARY_TOMBSTONE : 0));
+    kv.count++;
+    index_apply(key, KV_LOC(kv.head, kv.write_off), tombstone);
+    kv.write_off += size;
+    return true;
+}
+
+/*******************************************************************************
+ * Function Name: read_summary
+ *******************************************************************************
+ *
+ * Summary:
+ *  Number of entries of the programmed summary of a sector, or -1 if it has
+ *  none.
+ *
+ ******************************************************************************/
+static int32_t read_summary(uint32_t sector)
+{
+    uint8_t trailer[4];
+
+    if (!kv_read(sector_addr(sector) + SPI_EEPROM_SECTOR_SIZE - sizeof(trailer), trailer, sizeof(trailer)) ||
+        (get16(trailer) != KV_SUMMARY_MAGIC) || (get16(&trailer[2]) > KV_SUMMARY_ENTRIES))
+    {
+        return -1;
+    }
+    return get16(&trailer[2]);
+}
+
+/*******************************************************************************
+ * Function Name: read_record
+ *******************************************************************************
+ *
+ * Summary:
+ *  Read the record at offset of a sector into record[].
+ *
+ * Return:
+ *  (int32_t) Length of its value, -1 if it is not valid, -2 if it could
+ *  not be read.
+ *
+ ******************************************************************************/
+static int32_t read_record(uint32_t sector, uint32_t offset)
+{
+    uint32_t size = KV_RECORDS_END - offset;
+
+    if (size > KV_RECORD_MAX)
+    {
+        size = KV_RECORD_MAX;
+    }
+    if (!kv_read(sector_addr(sector) + offset, record, size))
+    {
+        return -2;
+    }
+    return record_value_len(size);
+}
+
+/*******************************************************************************
+ * Function Name: reclaim
+ *******************************************************************************
+ *
+ * Summary:
+ *  Move the records of tail that are still the latest of their key to head,
+ *  then erase tail. Deleted keys have no older records left once tail, the
+ *  oldest sector, is erased, so their tombstones are dropped.
+ *
+ ******************************************************************************/
+static bool reclaim(void)
+{
+    const uint32_t t = kv.tail;
+    int32_t count = read_summary(t);
+
+    if (count < 0)
+    {
+        return false;
+    }
+    for (int32_t i = 0; i < count; i += KV_SCAN_ENTRIES)
+    {
+        uint32_t n = ((uint32_t) (count - i) < KV_SCAN_ENTRIES) ? (uint32_t) (count - i) : KV_SCAN_ENTRIES;
+
+        if (!kv_read(sector_addr(t) + KV_RECORDS_END + (uint32_t) i * 4u, scan, n * 4u))
+        {
+            return false;
+        }
+        for (uint32_t e = 0; e < n; e++)
+        {
+            uint16_t key = get16(&scan[e * 4u]);
+            uint16_t offset = get16(&scan[e * 4u + 2u]);
+            int32_t slot = index_find(key);
+            int32_t len;
+
+            if ((offset & KV_SUMMARY_TOMBSTONE) || (slot < 0) || (index_slots[slot].loc != KV_LOC(t, offset)))
+            {
+                continue;
+            }
+            len = read_record(t, offset);
+            if ((len < 0) || !head_append((uint32_t) len))
+            {
+                return false;
+            }
+            kv_stats.records_moved++;
+        }
+    }
+
+    if (!kv_erase(sector_addr(t)))
+    {
+        return false;
+    }
+    sectors[t].erases++;
+    sectors[t].used = false;
+    kv.free++;
+    kv.tail = (t + 1u) % SPI_EEPROM_KV_SECTORS;
+    kv_stats.gc_runs++;
+    return write_header(t, KV_SEQ_FREE);
+}
+
+/*******************************************************************************
+ * Function Name: head_next
+ *******************************************************************************
+ *
+ * Summary:
+ *  Seal head and take the next sector of the ring. If that was the last
+ *  erased sector, reclaim tail right away, so that there is always one.
+ *
+ ******************************************************************************/
+static eeprom_dma_status_t head_next(void)
+{
+    uint32_t next = (kv.head + 1u) % SPI_EEPROM_KV_SECTORS;
+
+    if (sectors[next].used)
+    {
+        return STATE_NO_SPACE;
+    }
+    if (!head_seal() || !head_open(next) || ((kv.free == 0) && !reclaim()))
+    {
+        return STATE_TRANSFER_ERROR;
+    }
+    return INIT_SUCCESS;
+}
+
+/*******************************************************************************
+ * Function Name: write_record
+ *******************************************************************************
+ *
+ * Summary:
+ *  Append a record, moving on to the next sector if it does not fit.
+ *
+ ******************************************************************************/
+static eeprom_dma_status_t write_record(uint16_t key, const uint8_t *value, uint8_t len, bool tombstone)
+{
+    const uint32_t size = KV_RECORD_HEADER_SIZE + len;
+
+    for (uint32_t i = 0; !head_fits(size); i++)
+    {
+        eeprom_dma_status_t status;
+
+        if (i == SPI_EEPROM_KV_SECTORS)
+        {
+            return STATE_NO_SPACE;
+        }
+        status = head_next();
+        if (status != INIT_SUCCESS)
+        {
+            return status;
+        }
+    }
+
+    /* Reclaiming may have used record[] */
+    put16(record, key);
+    record[2] = tombstone ? KV_TOMBSTONE : len;
+    if (len > 0)
+    {
+        memcpy(&record[KV_RECORD_HEADER_SIZE], value, len);
+    }
+    record[3] = crc8(record, len);
+    return head_append(len) ? INIT_SUCCESS : STATE_TRANSFER_ERROR;
+}
+
+/*******************************************************************************
+ * Function Name: scan_records
+ *******************************************************************************
+ *
+ * Summary:
+ *  Read the records of a sector without summary one by one, entering them
+ *  into the index and the summary of head. Stops at blank flash or at a
+ *  record cut short by a reset.
+ *
+ * Return:
+ *  (bool) false if a record was not valid, true if the records end at
+ *  blank flash.
+ *
+ ******************************************************************************/
+static bool scan_records(uint32_t sector)
+{
+    kv.write_off = KV_HEADER_SIZE;
+    kv.count = 0;
+    memset(summary, 0xFF, sizeof(summary));
+
+    while (((kv.write_off + KV_RECORD_HEADER_SIZE) <= KV_RECORDS_END) && (kv.count < KV_SUMMARY_ENTRIES))
+    {
+        int32_t len = read_record(sector, kv.write_off);
+        uint16_t key = get16(record);
+
+        if ((key == KV_EMPTY_KEY) && (record[2] == 0xFFu) && (record[3] == 0xFFu))
+        {
+            return true;
+        }
+        if (len < 0)
+        {
+            return false;
+        }
+        put16(&summary[kv.count * 4u], key);
+        put16(&summary[kv.count * 4u + 2u], kv.write_off |
+              ((record[2] == KV_TOMBSTONE) ? KV_SUMMARY_TOMBSTONE : 0));
+        kv.count++;
+        index_apply(key, KV_LOC(sector, kv.write_off), record[2] == KV_TOMBSTONE);
+        kv.write_off += KV_RECORD_HEADER_SIZE + (uint32_t) len;
+    }
+    return false;
+}
+
+/*******************************************************************************
+ * Function Name: load_summary
+ *******************************************************************************
+ *
+ * Summary:
+ *  Enter the records listed in the summary of a sector into the index.
+ *
+ ******************************************************************************/
+static bool load_summary(uint32_t sector, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i += KV_SCAN_ENTRIES)
+    {
+        uint32_t n = ((count - i) < KV_SCAN_ENTRIES) ? (count - i) : KV_SCAN_ENTRIES;
+
+        if (!kv_read(sector_addr(sector) + KV_RECORDS_END + i * 4u, scan, n * 4u))
+        {
+            return false;
+        }
+        for (uint32_t e = 0; e < n; e++)
+        {
+            uint16_t offset = get16(&scan[e * 4u + 2u]);
+
+            if (!index_apply(get16(&scan[e * 4u]), KV_LOC(sector, offset & ~KV_SUMMARY_TOMBSTONE),
+                             (offset & KV_SUMMARY_TOMBSTONE) != 0))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_kv_format
+ *******************************************************************************
+ *
+ * Summary:
+ *  Erase the sectors of the store, keeping their erase counts, and mount
+ *  the empty store. Blocks until done.
+ *
+ * Parameters:
+ *  base_addr Byte address of the store, aligned to SPI_EEPROM_SECTOR_SIZE.
+ *            The store takes SPI_EEPROM_KV_SECTORS sectors from there.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) INIT_SUCCESS, STATE_INVALID_ARGUMENT for an invalid
+ *  base_addr or STATE_TRANSFER_ERROR.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_kv_format(uint32_t base_addr)
+{
+    const uint32_t eeprom_size = spi_eeprom_get_geometry(spi_eeprom_get_device())->size;
+    uint8_t header[KV_HEADER_USED];
+
+    if (((base_addr & (SPI_EEPROM_SECTOR_SIZE - 1u)) != 0) ||
+        ((base_addr + SPI_EEPROM_KV_SECTORS * SPI_EEPROM_SECTOR_SIZE) > eeprom_size))
+    {
+        return STATE_INVALID_ARGUMENT;
+    }
+
+    kv.mounted = false;
+    kv.base = base_addr;
+    for (uint32_t s = 0; s < SPI_EEPROM_KV_SECTORS; s++)
+    {
+        if (!kv_read(sector_addr(s), header, sizeof(header)))
+        {
+            return STATE_TRANSFER_ERROR;
+        }
+        sectors[s].erases = (get32(header) == KV_SECTOR_MAGIC) ? get32(&header[8]) : 0;
+        if (!kv_erase(sector_addr(s)))
+        {
+            return STATE_TRANSFER_ERROR;
+        }
+        sectors[s].erases++;
+        if (!write_header(s, KV_SEQ_FREE))
+        {
+            return STATE_TRANSFER_ERROR;
+        }
+    }
+    return spi_eeprom_kv_mount(base_addr);
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_kv_mount
+ *******************************************************************************
+ *
+ * Summary:
+ *  Build the index from the EEPROM. Reads the header of each sector, the
+ *  summary of each sector holding records, and the records themselves only
+ *  of head, which has no summary yet. A sector other than head left without
+ *  summary by a reset gets it now. Blocks until done.
+ *
+ * Parameters:
+ *  base_addr Byte address of the store given to spi_eeprom_kv_format.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) INIT_SUCCESS, INIT_FAILURE if there is no store
+ *  at base_addr, STATE_NO_SPACE if it holds more keys than the index,
+ *  STATE_INVALID_ARGUMENT for an invalid base_addr or STATE_TRANSFER_ERROR.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_kv_mount(uint32_t base_addr)
+{
+    const uint32_t eeprom_size = spi_eeprom_get_geometry(spi_eeprom_get_device())->size;
+    uint8_t header[KV_HEADER_USED];
+    bool found = false;
+    uint32_t used = 0;
+
+    if (((base_addr & (SPI_EEPROM_SECTOR_SIZE - 1u)) != 0) ||
+        ((base_addr + SPI_EEPROM_KV_SECTORS * SPI_EEPROM_SECTOR_SIZE) > eeprom_size))
+    {
+        return STATE_INVALID_ARGUMENT;
+    }
+
+    memset(&kv, 0, sizeof(kv));
+    memset(&kv_stats, 0, sizeof(kv_stats));
+    memset(index_slots, 0xFF, sizeof(index_slots));
+    kv.base = base_addr;
+
+    for (uint32_t s = 0; s < SPI_EEPROM_KV_SECTORS; s++)
+    {
+        if (!kv_read(sector_addr(s), header, sizeof(header)))
+        {
+            return STATE_TRANSFER_ERROR;
+        }
+        sectors[s].used = false;
+        sectors[s].seq = KV_SEQ_FREE;
+        sectors[s].erases = 0;
+        if (get32(header) != KV_SECTOR_MAGIC)
+        {
+            continue;
+        }
+        found = true;
+        sectors[s].erases = get32(&header[8]);
+        if (get32(&header[4]) == KV_SEQ_FREE)
+        {
+            continue;
+        }
+        sectors[s].used = true;
+        sectors[s].seq = get32(&header[4]);
+        if (!used || (sectors[s].seq > kv.seq))
+        {
+            kv.seq = sectors[s].seq;
+            kv.head = s;
+        }
+        used++;
+    }
+    if (!found)
+    {
+        return INIT_FAILURE;
+    }
+    kv.free = SPI_EEPROM_KV_SECTORS - used;
+
+    if (used == 0)
+    {
+        kv.mounted = head_open(0);
+        return kv.mounted ? INIT_SUCCESS : STATE_TRANSFER_ERROR;
+    }
+
+    /* Sectors in use are contiguous in the ring, ending at head */
+    kv.tail = kv.head;
+    for (uint32_t i = 1; i < used; i++)
+    {
+        kv.tail = (kv.tail + SPI_EEPROM_KV_SECTORS - 1u) % SPI_EEPROM_KV_SECTORS;
+    }
+
+    for (uint32_t i = 0, s = kv.tail; i < used; i++, s = (s + 1u) % SPI_EEPROM_KV_SECTORS)
+    {
+        int32_t count = read_summary(s);
+        bool complete;
+
+        if (count >= 0)
+        {
+            if (!load_summary(s, (uint32_t) count))
+            {
+                return STATE_NO_SPACE;
+            }
+            if (s == kv.head)
+            {
+                kv.sealed = true;
+            }
+            continue;
+        }
+
+        complete = scan_records(s);
+        if (s != kv.head)
+        {
+            /* Repair: the reset came between the last record and the summary */
+            kv.head = s;
+            if (!head_seal())
+            {
+                return STATE_TRANSFER_ERROR;
+            }
+            kv.head = (kv.tail + used - 1u) % SPI_EEPROM_KV_SECTORS;
+            kv.sealed = false;
+        }
+        else if (!complete)
+        {
+            /* No more records after one that is cut short */
+            kv.write_off = KV_RECORDS_END;
+        }
+    }
+
+    /* The reset came between taking the last erased sector and reclaiming */
+    if ((kv.free == 0) && !reclaim())
+    {
+        return STATE_TRANSFER_ERROR;
+    }
+    kv.mounted = true;
+    return INIT_SUCCESS;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_kv_get
+ *******************************************************************************
+ *
+ * Summary:
+ *  Read the value of a key: one index lookup and one read. Blocks until
+ *  done.
+ *
+ * Parameters:
+ *  key Key.
+ *  value Buffer for the value.
+ *  size Size of value; a longer value is cut.
+ *  len Set to the length of the value, may be NULL.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) INIT_SUCCESS, STATE_NOT_FOUND if the key is not
+ *  set, INIT_FAILURE if the store is not mounted, OTHER_FAILURE if the
+ *  record is corrupt or STATE_TRANSFER_ERROR.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_kv_get(uint16_t key, uint8_t *value, uint8_t size, uint8_t *len)
+{
+    int32_t slot;
+    int32_t value_len;
+
+    if (!kv.mounted)
+    {
+        return INIT_FAILURE;
+    }
+    slot = index_find(key);
+    if (slot < 0)
+    {
+        return STATE_NOT_FOUND;
+    }
+
+    value_len = read_record(KV_LOC_SECTOR(index_slots[slot].loc), KV_LOC_OFFSET(index_slots[slot].loc));
+    if (value_len == -2)
+    {
+        return STATE_TRANSFER_ERROR;
+    }
+    if ((value_len < 0) || (get16(record) != key))
+    {
+        return OTHER_FAILURE;
+    }
+    if (len != NULL)
+    {
+        *len = (uint8_t) value_len;
+    }
+    memcpy(value, &record[KV_RECORD_HEADER_SIZE], ((uint32_t) value_len < size) ? (uint32_t) value_len : size);
+    return INIT_SUCCESS;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_kv_set
+ *******************************************************************************
+ *
+ * Summary:
+ *  Set the value of a key by appending a record: a program of a few bytes,
+ *  without erase. When head is full, its summary is programmed and the
+ *  next sector taken; when that was the last erased one, the oldest sector
+ *  is reclaimed. Blocks until done.
+ *
+ * Parameters:
+ *  key Key, up to SPI_EEPROM_KV_KEY_MAX.
+ *  value Value.
+ *  len Length of value, up to SPI_EEPROM_KV_VALUE_MAX.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) INIT_SUCCESS, STATE_INVALID_ARGUMENT, INIT_FAILURE
+ *  if the store is not mounted, STATE_NO_SPACE if the key is new and
+ *  SPI_EEPROM_KV_MAX_KEYS are held or STATE_TRANSFER_ERROR.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_kv_set(uint16_t key, const uint8_t *value, uint8_t len)
+{
+    eeprom_dma_status_t status;
+
+    if ((key > SPI_EEPROM_KV_KEY_MAX) || (len > SPI_EEPROM_KV_VALUE_MAX) || ((value == NULL) && (len > 0)))
+    {
+        return STATE_INVALID_ARGUMENT;
+    }
+    if (!kv.mounted)
+    {
+        return INIT_FAILURE;
+    }
+    if ((index_find(key) < 0) && (kv.keys >= SPI_EEPROM_KV_MAX_KEYS))
+    {
+        return STATE_NO_SPACE;
+    }
+
+    status = write_record(key, value, len, false);
+    if (status == INIT_SUCCESS)
+    {
+        kv_stats.sets++;
+    }
+    return status;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_kv_delete
+ *******************************************************************************
+ *
+ * Summary:
+ *  Delete a key by appending a record without value. Blocks until done.
+ *
+ * Parameters:
+ *  key Key.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) INIT_SUCCESS, STATE_NOT_FOUND if the key is not
+ *  set, INIT_FAILURE if the store is not mounted or STATE_TRANSFER_ERROR.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_kv_delete(uint16_t key)
+{
+    eeprom_dma_status_t status;
+
+    if (!kv.mounted)
+    {
+        return INIT_FAILURE;
+    }
+    if (index_find(key) < 0)
+    {
+        return STATE_NOT_FOUND;
+    }
+
+    status = write_record(key, NULL, 0, true);
+    if (status == INIT_SUCCESS)
+    {
+        kv_stats.deletes++;
+    }
+    return status;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_kv_get_stats
+ *******************************************************************************
+ *
+ * Summary:
+ *  Counters of the store since mount, and the spread of erases over its
+ *  sectors.
+ *
+ * Parameters:
+ *  stats Filled with the counters.
+ *
+ * Return:
+ *  None
+ *
+ ******************************************************************************/
+void spi_eeprom_kv_get_stats(spi_eeprom_kv_stats_t *stats)
+{
+    *stats = kv_stats;
+    stats->keys = kv.keys;
+    stats->erase_min = UINT32_MAX;
+    stats->erase_max = 0;
+    for (uint32_t s = 0; s < SPI_EEPROM_KV_SECTORS; s++)
+    {
+        stats->erase_min = (sectors[s].erases < stats->erase_min) ? sectors[s].erases : stats->erase_min;
+        stats->erase_max = (sectors[s].erases > stats->erase_max) ? sectors[s].erases : stats->erase_max;
+    }
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,103 @@
+/******************************************************************************
+ * File Name: spi_eeprom_kv.h
+ *
+ * Description: Header file for the key-value store in the EEPROM.
+ *
+ * Related Document: See README.md
+ *
+ *******************************************************************************
+ * Copyright 2023, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+
+
+#ifndef SOURCE_SPI_EEPROM_KV_H_
+#define SOURCE_SPI_EEPROM_KV_H_
+
+/*******************************************************************************
+ * Include header files
+ ******************************************************************************/
+#include "spi_eeprom_master.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Sectors of the store, used as a ring; at least 3, at most 16 */
+#ifndef SPI_EEPROM_KV_SECTORS
+#define SPI_EEPROM_KV_SECTORS           (8u)
+#endif
+
+/* Keys held at the same time, and slots of the RAM index (power of two,
+ * twice the keys for short probe sequences) */
+#ifndef SPI_EEPROM_KV_MAX_KEYS
+#define SPI_EEPROM_KV_MAX_KEYS          (256u)
+#endif
+#define SPI_EEPROM_KV_INDEX_SIZE        (2u * SPI_EEPROM_KV_MAX_KEYS)
+
+/* Largest value in bytes. SPI_EEPROM_KV_MAX_KEYS values of this size must
+ * fit into SPI_EEPROM_KV_SECTORS - 2 sectors. */
+#define SPI_EEPROM_KV_VALUE_MAX         (32u)
+
+/* Bytes at the end of each sector for its summary of records */
+#define SPI_EEPROM_KV_SUMMARY_SIZE      (512u)
+
+/* Largest key; 0xFFFF marks blank flash */
+#define SPI_EEPROM_KV_KEY_MAX           (0xFFFEu)
+
+/******************************************************************************
+ * Structure/Enum type declaration
+ ******************************************************************************/
+/* Counters of the store since mount */
+typedef struct
+{
+    uint32_t    sets;               /* Records written by spi_eeprom_kv_set */
+    uint32_t    deletes;            /* Records written by spi_eeprom_kv_delete */
+    uint32_t    gc_runs;            /* Sectors reclaimed */
+    uint32_t    records_moved;      /* Live records copied by reclaiming */
+    uint32_t    erase_min;          /* Fewest erases of a sector of the store */
+    uint32_t    erase_max;          /* Most erases of a sector of the store */
+    uint32_t    keys;               /* Keys held */
+} spi_eeprom_kv_stats_t;
+
+/******************************************************************************
+ * Global function declaration
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_kv_format(uint32_t base_addr);
+eeprom_dma_status_t spi_eeprom_kv_mount(uint32_t base_addr);
+eeprom_dma_status_t spi_eeprom_kv_get(uint16_t key, uint8_t *value, uint8_t size, uint8_t *len);
+eeprom_dma_status_t spi_eeprom_kv_set(uint16_t key, const uint8_t *value, uint8_t len);
+eeprom_dma_status_t spi_eeprom_kv_delete(uint16_t key);
+void spi_eeprom_kv_get_stats(spi_eeprom_kv_stats_t *stats);
+
+#endif /* SOURCE_SPI_EEPROM_KV_H_ */
+
+/* [] END OF FILE */
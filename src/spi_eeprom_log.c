@@ -0,0 +1,666 @@
+/******************************************************************************
+ * File Name: spi_eeprom_log.c
+ *
+ * Description: Source file for an append-only circular log in the EEPROM.
+ *                           Records are collected in RAM and programmed a whole page at a
+ *                           time while the next page fills, the sector ahead of the head is
+ *                           erased in the background, and mount finds the head with a
+ *                           binary search over page sequence numbers.
+ *
+ * Related Document: See README.md
+ *
+ *******************************************************************************
+ * Copyright 2023, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+
+
+/*******************************************************************************
+ * Include header files
+ ******************************************************************************/
+#include <string.h>
+#include "spi_eeprom_log.h"
+#include "spi_eeprom_erase.h"
+
+/*******************************************************************************
+ * Macros
+ *******************************************************************************/
+#define LOG_PAGE_MAGIC          (0x474Cu)
+
+/* Pages per sector and in the log. Page n of the log holds sequence numbers
+ * n, n + LOG_PAGES, ... as the log is written around from page 0 */
+#define LOG_SECTOR_PAGES        (SPI_EEPROM_SECTOR_SIZE / EEPROM_PAGE_SIZE)
+#define LOG_PAGES               (SPI_EEPROM_LOG_SECTORS * LOG_SECTOR_PAGES)
+
+/* Sequence number of a page without valid header */
+#define LOG_SEQ_NONE            (0xFFFFFFFFu)
+
+#if (SPI_EEPROM_LOG_SECTORS < 3u)
+#error "SPI_EEPROM_LOG_SECTORS must be at least 3"
+#endif
+
+/*******************************************************************************
+* Global variables declaration
+*******************************************************************************/
+/* Log. Pages first..done-1 are programmed, done..next-1 are submitted and
+ * page next is filled in buffer next % SPI_EEPROM_LOG_BUFFERS */
+static struct
+{
+    bool mounted;
+    uint32_t base;
+    uint32_t first;         /* Oldest page not erased */
+    uint32_t next;          /* Page being filled */
+    volatile uint32_t done; /* Pages programmed, in order of the queue */
+    bool filling;
+    uint32_t used;          /* Bytes of the page being filled */
+    bool erase_pending;     /* Erase ahead not queued yet */
+    uint32_t erase_addr;
+    volatile uint32_t erasing;
+    eeprom_dma_status_t check; /* Result of the blank check at mount */
+} ring;
+
+static uint8_t pages[SPI_EEPROM_LOG_BUFFERS][EEPROM_PAGE_SIZE];
+
+static spi_eeprom_log_stats_t log_stats;
+
+static uint32_t page_addr(uint32_t page)
+{
+    return ring.base + page * EEPROM_PAGE_SIZE;
+}
+
+static uint16_t get16(const uint8_t *p)
+{
+    return (uint16_t) (p[0] | (p[1] << 8));
+}
+
+/*******************************************************************************
+ * Function Name: page_seq
+ *******************************************************************************
+ *
+ * Summary:
+ *  Read the header of a page of the log.
+ *
+ * Return:
+ *  (uint32_t) Sequence number of the page, LOG_SEQ_NONE if it is blank,
+ *  torn or does not belong at this page.
+ *
+ ******************************************************************************/
+static uint32_t page_seq(uint32_t page)
+{
+    uint8_t header[SPI_EEPROM_LOG_PAGE_HEADER];
+    uint32_t seq;
+
+    log_stats.mount_reads++;
+    if (!spi_eeprom_wait(spi_eeprom_read_range(page_addr(page), header, sizeof(header), NULL, NULL)))
+    {
+        return LOG_SEQ_NONE;
+    }
+    seq = (uint32_t) get16(&header[4]) | ((uint32_t) get16(&header[6]) << 16);
+    if ((get16(header) != LOG_PAGE_MAGIC) || (get16(&header[2]) > EEPROM_PAGE_SIZE) ||
+        (seq == LOG_SEQ_NONE) || ((seq % LOG_PAGES) != page))
+    {
+        return LOG_SEQ_NONE;
+    }
+    return seq;
+}
+
+/*******************************************************************************
+ * Function Name: find_last
+ *******************************************************************************
+ *
+ * Summary:
+ *  Binary search for the last page from lo on whose sequence number is at
+ *  least that of lo, given it is. Pages past it are blank or of the
+ *  previous time around the log.
+ *
+ * Return:
+ *  (uint32_t) Sequence number of the page found.
+ *
+ ******************************************************************************/
+static uint32_t find_last(uint32_t lo, uint32_t lo_seq)
+{
+    uint32_t hi = LOG_PAGES;
+    uint32_t seq = lo_seq;
+
+    while ((hi - lo) > 1u)
+    {
+        uint32_t mid = lo + (hi - lo) / 2u;
+        uint32_t mid_seq = page_seq(mid);
+
+        if ((mid_seq != LOG_SEQ_NONE) && (mid_seq >= lo_seq))
+        {
+            lo = mid;
+            seq = mid_seq;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return seq;
+}
+
+/*******************************************************************************
+ * Function Name: erase_done / check_done / page_done
+ *******************************************************************************
+ *
+ * Summary:
+ *  Callbacks of the erase ahead, the blank check at mount and a page
+ *  program, from the DMA interrupt.
+ *
+ ******************************************************************************/
+static void erase_done(eeprom_dma_status_t status, cy_rslt_t error, void *ctx)
+{
+    (void) error;
+    (void) ctx;
+
+    if (status != INIT_SUCCESS)
+    {
+        log_stats.errors++;
+    }
+    ring.erasing--;
+}
+
+static void check_done(eeprom_dma_status_t status, cy_rslt_t error, void *ctx)
+{
+    (void) error;
+    (void) ctx;
+
+    ring.check = status;
+}
+
+static void page_done(eeprom_dma_status_t status, cy_rslt_t error, void *ctx)
+{
+    (void) error;
+    (void) ctx;
+
+    if (status != INIT_SUCCESS)
+    {
+        log_stats.errors++;
+    }
+    ring.done++;
+}
+
+/*******************************************************************************
+ * Function Name: erase_submit
+ *******************************************************************************
+ *
+ * Summary:
+ *  Queue the pending erase ahead.
+ *
+ ******************************************************************************/
+static eeprom_dma_status_t erase_submit(void)
+{
+    eeprom_dma_status_t status;
+
+    if (!ring.erase_pending)
+    {
+        return STATE_UNCONFIRMED_SUCCESS;
+    }
+    ring.erasing++;
+    status = spi_eeprom_submit(SPI_EEPROM_OP_ERASE_4K, ring.erase_addr, NULL, 0, erase_done, NULL);
+    if (status != STATE_UNCONFIRMED_SUCCESS)
+    {
+        ring.erasing--;
+        return status;
+    }
+    ring.erase_pending = false;
+    log_stats.erases++;
+    return status;
+}
+
+/*******************************************************************************
+ * Function Name: page_submit
+ *******************************************************************************
+ *
+ * Summary:
+ *  Queue the program of the page being filled. On the first page of a
+ *  sector, also the erase of the sector after it, which the queue completes
+ *  long before the head gets there. Called in a critical section.
+ *
+ ******************************************************************************/
+static eeprom_dma_status_t page_submit(void)
+{
+    uint32_t page = ring.next % LOG_PAGES;
+    uint8_t *buf = pages[ring.next % SPI_EEPROM_LOG_BUFFERS];
+    eeprom_dma_status_t status;
+
+    status = erase_submit();
+    if (status != STATE_UNCONFIRMED_SUCCESS)
+    {
+        return status;
+    }
+
+    buf[2] = (uint8_t) ring.used;
+    buf[3] = (uint8_t) (ring.used >> 8);
+    status = spi_eeprom_submit(SPI_EEPROM_OP_WRITE, page_addr(page), buf, ring.used, page_done, NULL);
+    if (status != STATE_UNCONFIRMED_SUCCESS)
+    {
+        return status;
+    }
+    ring.filling = false;
+    log_stats.pages++;
+
+    if ((page % LOG_SECTOR_PAGES) == 0)
+    {
+        /* The sector after holds pages from one time around the log ago */
+        uint32_t kept = ring.next + 2u * LOG_SECTOR_PAGES;
+
+        ring.erase_addr = page_addr((page + LOG_SECTOR_PAGES) % LOG_PAGES);
+        ring.erase_pending = true;
+        if ((kept > LOG_PAGES) && ((kept - LOG_PAGES) > ring.first))
+        {
+            ring.first = kept - LOG_PAGES;
+        }
+        (void) erase_submit();
+    }
+    ring.next++;
+    return STATE_UNCONFIRMED_SUCCESS;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_log_format
+ *******************************************************************************
+ *
+ * Summary:
+ *  Erase the sectors of the log with spi_eeprom_erase_range and mount it
+ *  empty. Blocks until done.
+ *
+ * Parameters:
+ *  base_addr Byte address of the log, aligned to SPI_EEPROM_SECTOR_SIZE.
+ *            SPI_EEPROM_LOG_SECTORS sectors from it are used.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) INIT_SUCCESS, STATE_INVALID_ARGUMENT for an
+ *  invalid base_addr, STATE_QUEUE_FULL if an erase range is in progress or
+ *  STATE_TRANSFER_ERROR.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_log_format(uint32_t base_addr)
+{
+    eeprom_dma_status_t status;
+
+    ring.mounted = false;
+    status = spi_eeprom_erase_range(base_addr, SPI_EEPROM_LOG_SECTORS * SPI_EEPROM_SECTOR_SIZE,
+                                    false, NULL, NULL);
+    if (status == STATE_INVALID_PAGE)
+    {
+        return STATE_INVALID_ARGUMENT;
+    }
+    if (status != STATE_UNCONFIRMED_SUCCESS)
+    {
+        return status;
+    }
+    while (!spi_eeprom_done() || spi_eeprom_erase_busy());
+    if (spi_transfer_get_error() != 0)
+    {
+        spi_state_reset();
+        return STATE_TRANSFER_ERROR;
+    }
+
+    return spi_eeprom_log_mount(base_addr);
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_log_mount
+ *******************************************************************************
+ *
+ * Summary:
+ *  Find head and tail of the log from the page headers. The pages written
+ *  since page 0 have sequence numbers at least that of page 0, and the
+ *  pages past them are blank or older, so a binary search finds the head
+ *  in log2 of the number of pages reads. If page 0 is blank, the head is
+ *  in the last sector and the search starts at sector 1. Appending goes on
+ *  at the page after the head, and the sector ahead of it is erased now if
+ *  a reset came before its erase. Blocks until done.
+ *
+ * Parameters:
+ *  base_addr Byte address of the log given to spi_eeprom_log_format.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) INIT_SUCCESS, STATE_INVALID_ARGUMENT for an
+ *  invalid base_addr or STATE_TRANSFER_ERROR.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_log_mount(uint32_t base_addr)
+{
+    const uint32_t eeprom_size = spi_eeprom_get_geometry(spi_eeprom_get_device())->size;
+    uint32_t head_seq;
+    uint32_t seq;
+    uint32_t page;
+    uint32_t sector;
+
+    if (((base_addr & (SPI_EEPROM_SECTOR_SIZE - 1u)) != 0) ||
+        ((base_addr + SPI_EEPROM_LOG_SECTORS * SPI_EEPROM_SECTOR_SIZE) > eeprom_size))
+    {
+        return STATE_INVALID_ARGUMENT;
+    }
+
+    memset(&ring, 0, sizeof(ring));
+    memset(&log_stats, 0, sizeof(log_stats));
+    ring.base = base_addr;
+
+    seq = page_seq(0);
+    if (seq != LOG_SEQ_NONE)
+    {
+        head_seq = find_last(0, seq);
+    }
+    else
+    {
+        seq = page_seq(LOG_SECTOR_PAGES);
+        head_seq = (seq != LOG_SEQ_NONE) ? find_last(LOG_SECTOR_PAGES, seq) : LOG_SEQ_NONE;
+    }
+
+    if (head_seq != LOG_SEQ_NONE)
+    {
+        /* Oldest page: start of the sector after the one erased ahead, or
+         * where the search started if that was never written */
+        uint32_t tail = (((head_seq % LOG_PAGES) / LOG_SECTOR_PAGES + 2u) % SPI_EEPROM_LOG_SECTORS) * LOG_SECTOR_PAGES;
+        uint32_t tail_seq = page_seq(tail);
+
+        ring.first = ((tail_seq != LOG_SEQ_NONE) && (tail_seq < head_seq)) ? tail_seq : seq;
+        ring.next = head_seq + 1u;
+    }
+    ring.done = ring.next;
+
+    /* Sector the next page goes to if it starts one, else the one after */
+    page = ring.next % LOG_PAGES;
+    sector = (page / LOG_SECTOR_PAGES + (((page % LOG_SECTOR_PAGES) == 0) ? 0u : 1u)) % SPI_EEPROM_LOG_SECTORS;
+    ring.check = STATE_UNCONFIRMED_SUCCESS;
+    if (!spi_eeprom_wait(spi_eeprom_compare_range(page_addr(sector * LOG_SECTOR_PAGES), NULL,
+                                            SPI_EEPROM_SECTOR_SIZE, check_done, NULL)) ||
+        ((ring.check != INIT_SUCCESS) && (ring.check != STATE_COMPARE_MISMATCH)))
+    {
+        return STATE_TRANSFER_ERROR;
+    }
+    if (ring.check == STATE_COMPARE_MISMATCH)
+    {
+        ring.erase_addr = page_addr(sector * LOG_SECTOR_PAGES);
+        ring.erase_pending = true;
+        if (erase_submit() != STATE_UNCONFIRMED_SUCCESS)
+        {
+            return STATE_TRANSFER_ERROR;
+        }
+        while (!spi_eeprom_done() || (ring.erasing != 0));
+        if ((ring.first < ring.next) && (((ring.first % LOG_PAGES) / LOG_SECTOR_PAGES) == sector))
+        {
+            ring.first += LOG_SECTOR_PAGES - (ring.first % LOG_SECTOR_PAGES);
+        }
+    }
+
+    ring.mounted = true;
+    return INIT_SUCCESS;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_log_append
+ *******************************************************************************
+ *
+ * Summary:
+ *  Append a record. It is copied to the page being filled, and a page is
+ *  queued for programming as soon as it is full, so writes to the EEPROM
+ *  are whole pages while the next one fills. Does not block.
+ *
+ * Parameters:
+ *  data Record.
+ *  len Number of bytes, 1 to SPI_EEPROM_LOG_RECORD_MAX.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) INIT_SUCCESS, STATE_QUEUE_FULL if all page
+ *  buffers are waiting to be programmed (try again later), INIT_FAILURE if
+ *  the log is not mounted or STATE_INVALID_ARGUMENT.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_log_append(const uint8_t *data, uint8_t len)
+{
+    eeprom_dma_status_t status = INIT_SUCCESS;
+    uint8_t *buf;
+    uint32_t intr;
+
+    if (!ring.mounted)
+    {
+        return INIT_FAILURE;
+    }
+    if ((data == NULL) || (len == 0) || (len > SPI_EEPROM_LOG_RECORD_MAX))
+    {
+        return STATE_INVALID_ARGUMENT;
+    }
+
+    intr = Cy_SysLib_EnterCriticalSection();
+    if (ring.filling && ((ring.used + 1u + len) > EEPROM_PAGE_SIZE))
+    {
+        status = page_submit();
+    }
+    if (status == INIT_SUCCESS)
+    {
+        status = STATE_UNCONFIRMED_SUCCESS;
+    }
+    if ((status == STATE_UNCONFIRMED_SUCCESS) && !ring.filling &&
+        ((ring.next - ring.done) >= SPI_EEPROM_LOG_BUFFERS))
+    {
+        status = STATE_QUEUE_FULL;
+    }
+    if (status != STATE_UNCONFIRMED_SUCCESS)
+    {
+        Cy_SysLib_ExitCriticalSection(intr);
+        return status;
+    }
+
+    buf = pages[ring.next % SPI_EEPROM_LOG_BUFFERS];
+    if (!ring.filling)
+    {
+        buf[0] = (uint8_t) LOG_PAGE_MAGIC;
+        buf[1] = (uint8_t) (LOG_PAGE_MAGIC >> 8);
+        for (uint32_t i = 0; i < 4u; i++)
+        {
+            buf[4u + i] = (uint8_t) (ring.next >> (8u * i));
+        }
+        ring.used = SPI_EEPROM_LOG_PAGE_HEADER;
+        ring.filling = true;
+    }
+    buf[ring.used] = len;
+    memcpy(&buf[ring.used + 1u], data, len);
+    ring.used += 1u + len;
+    log_stats.records++;
+
+    if (ring.used == EEPROM_PAGE_SIZE)
+    {
+        /* Retried by the next append or flush if the queue is full */
+        (void) page_submit();
+    }
+    Cy_SysLib_ExitCriticalSection(intr);
+
+    return INIT_SUCCESS;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_log_flush
+ *******************************************************************************
+ *
+ * Summary:
+ *  Queue the page being filled for programming even if it is not full, for
+ *  example before going to sleep. Records appended later start a new page.
+ *  Does not block; spi_eeprom_log_idle tells when the page is programmed.
+ *
+ * Parameters:
+ *  None
+ *
+ * Return:
+ *  (eeprom_dma_status_t) INIT_SUCCESS, STATE_QUEUE_FULL if the queue is
+ *  full (try again later) or INIT_FAILURE if the log is not mounted.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_log_flush(void)
+{
+    eeprom_dma_status_t status;
+    uint32_t intr;
+
+    if (!ring.mounted)
+    {
+        return INIT_FAILURE;
+    }
+
+    intr = Cy_SysLib_EnterCriticalSection();
+    status = ring.filling ? page_submit() : erase_submit();
+    Cy_SysLib_ExitCriticalSection(intr);
+
+    return (status == STATE_UNCONFIRMED_SUCCESS) ? INIT_SUCCESS : status;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_log_idle
+ *******************************************************************************
+ *
+ * Summary:
+ *  Return whether all queued pages are programmed and the sector ahead of
+ *  the head is erased.
+ *
+ * Parameters:
+ *  None
+ *
+ * Return:
+ *  (bool) true if no program or erase of the log is pending.
+ *
+ ******************************************************************************/
+bool spi_eeprom_log_idle(void)
+{
+    return (ring.done == ring.next) && (ring.erasing == 0) && !ring.erase_pending;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_log_bounds
+ *******************************************************************************
+ *
+ * Summary:
+ *  Sequence numbers of the pages that can be read.
+ *
+ * Parameters:
+ *  first Filled with the oldest page.
+ *  next Filled with the page after the newest programmed one.
+ *
+ * Return:
+ *  None
+ *
+ ******************************************************************************/
+void spi_eeprom_log_bounds(uint32_t *first, uint32_t *next)
+{
+    *first = ring.first;
+    *next = ring.done;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_log_read_page
+ *******************************************************************************
+ *
+ * Summary:
+ *  Queue the read of a page of the log, to be walked through with
+ *  spi_eeprom_log_record.
+ *
+ * Parameters:
+ *  seq Sequence number of the page, within spi_eeprom_log_bounds.
+ *  page Buffer of EEPROM_PAGE_SIZE bytes.
+ *  cb Called as part of the DMA interrupt when the read has completed,
+ *     may be NULL.
+ *  ctx User context passed to cb.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) STATE_UNCONFIRMED_SUCCESS if the read was queued,
+ *  STATE_QUEUE_FULL, INIT_FAILURE if the log is not mounted or
+ *  STATE_INVALID_ARGUMENT if the page cannot be read.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_log_read_page(uint32_t seq, uint8_t *page, spi_eeprom_callback_t cb, void *ctx)
+{
+    if (!ring.mounted)
+    {
+        return INIT_FAILURE;
+    }
+    if ((page == NULL) || (seq < ring.first) || (seq >= ring.done))
+    {
+        return STATE_INVALID_ARGUMENT;
+    }
+
+    return spi_eeprom_submit(SPI_EEPROM_OP_READ, page_addr(seq % LOG_PAGES), page, EEPROM_PAGE_SIZE, cb, ctx);
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_log_record
+ *******************************************************************************
+ *
+ * Summary:
+ *  Walk through the records of a page read with spi_eeprom_log_read_page.
+ *
+ * Parameters:
+ *  page Page read.
+ *  offset 0 for the first record, updated for the next one.
+ *  len Filled with the length of the record.
+ *
+ * Return:
+ *  (const uint8_t *) Data of the record, NULL after the last one or if the
+ *  page is not valid.
+ *
+ ******************************************************************************/
+const uint8_t *spi_eeprom_log_record(const uint8_t *page, uint32_t *offset, uint8_t *len)
+{
+    uint32_t used = get16(&page[2]);
+    uint32_t off = (*offset < SPI_EEPROM_LOG_PAGE_HEADER) ? SPI_EEPROM_LOG_PAGE_HEADER : *offset;
+
+    if ((get16(page) != LOG_PAGE_MAGIC) || (used > EEPROM_PAGE_SIZE) || (off >= used) ||
+        (page[off] == 0) || ((off + 1u + page[off]) > used))
+    {
+        return NULL;
+    }
+    *len = page[off];
+    *offset = off + 1u + page[off];
+    return &page[off + 1u];
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_log_get_stats
+ *******************************************************************************
+ *
+ * Summary:
+ *  Counters of the log since it was mounted.
+ *
+ * Parameters:
+ *  stats Filled with the counters.
+ *
+ * Return:
+ *  None
+ *
+ ******************************************************************************/
+void spi_eeprom_log_get_stats(spi_eeprom_log_stats_t *stats)
+{
+    *stats = log_stats;
+}
+
+/* [] END OF FILE */
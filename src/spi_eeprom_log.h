@@ -0,0 +1,97 @@
+/******************************************************************************
+ * File Name: spi_eeprom_log.h
+ *
+ * Description: Header file for the circular log in the EEPROM.
+ *
+ * Related Document: See README.md
+ *
+ *******************************************************************************
+ * Copyright 2023, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+
+
+#ifndef SOURCE_SPI_EEPROM_LOG_H_
+#define SOURCE_SPI_EEPROM_LOG_H_
+
+/*******************************************************************************
+ * Include header files
+ ******************************************************************************/
+#include "spi_eeprom_master.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Sectors of the log, used as a ring; at least 3 */
+#ifndef SPI_EEPROM_LOG_SECTORS
+#define SPI_EEPROM_LOG_SECTORS          (16u)
+#endif
+
+/* RAM page buffers: one is filled while the others are programmed */
+#ifndef SPI_EEPROM_LOG_BUFFERS
+#define SPI_EEPROM_LOG_BUFFERS          (2u)
+#endif
+
+/* Page: magic, bytes used, sequence number (little endian), then records of
+ * a length byte and the data */
+#define SPI_EEPROM_LOG_PAGE_HEADER      (8u)
+#define SPI_EEPROM_LOG_RECORD_MAX       (EEPROM_PAGE_SIZE - SPI_EEPROM_LOG_PAGE_HEADER - 1u)
+
+/******************************************************************************
+ * Structure/Enum type declaration
+ ******************************************************************************/
+/* Counters of the log since mount */
+typedef struct
+{
+    uint32_t    records;            /* Records appended */
+    uint32_t    pages;              /* Pages submitted for programming */
+    uint32_t    erases;             /* Sectors erased ahead of the head */
+    uint32_t    errors;             /* Programs or erases that failed */
+    uint32_t    mount_reads;        /* Page headers read by the last mount */
+} spi_eeprom_log_stats_t;
+
+/******************************************************************************
+ * Global function declaration
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_log_format(uint32_t base_addr);
+eeprom_dma_status_t spi_eeprom_log_mount(uint32_t base_addr);
+eeprom_dma_status_t spi_eeprom_log_append(const uint8_t *data, uint8_t len);
+eeprom_dma_status_t spi_eeprom_log_flush(void);
+bool spi_eeprom_log_idle(void);
+void spi_eeprom_log_bounds(uint32_t *first, uint32_t *next);
+eeprom_dma_status_t spi_eeprom_log_read_page(uint32_t seq, uint8_t *page, spi_eeprom_callback_t cb, void *ctx);
+const uint8_t *spi_eeprom_log_record(const uint8_t *page, uint32_t *offset, uint8_t *len);
+void spi_eeprom_log_get_stats(spi_eeprom_log_stats_t *stats);
+
+#endif /* SOURCE_SPI_EEPROM_LOG_H_ */
+
+/* [] END OF FILE */
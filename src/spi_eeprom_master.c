@@ -41,56 +41,438 @@
 /*******************************************************************************
  * Include header files
  ******************************************************************************/
+#include <string.h>
 #include "spi_eeprom_master.h"
 #include "cy_sysint.h"
 #include "cy_scb_spi.h"
 #include "dma_master.h"
+#include "timer_master.h"
+#include "spi_eeprom_cache.h"
+#include "crc32.h"
+#include "spi_eeprom_trace.h"
 
 /*******************************************************************************
  * Macros
  *******************************************************************************/
 #ifndef SET_EEPROM_ADDRESS_TYPE
 #error Requires address size of EEPROM
-#elif SET_EEPROM_ADDRESS_TYPE == EEPROM_ADDRESS_TYPE_8
-#define SPI_FLASH_CMD_MAX_SIZE (2)
-#define POPULATE_COMMAND_ADDRESS(cmd, addr) \
-    {cmd_pkt[0] = cmd; cmd_pkt[1] = ((addr))&0xFF;}
-#elif SET_EEPROM_ADDRESS_TYPE == EEPROM_ADDRESS_TYPE_16
-#define SPI_FLASH_CMD_MAX_SIZE (3)
-#define POPULATE_COMMAND_ADDRESS(cmd, addr) \
-    {cmd_pkt[0] = cmd; cmd_pkt[1] = ((addr)>>8)&0xFF; \
-    cmd_pkt[2] = ((addr))&0xFF;}
-#elif SET_EEPROM_ADDRESS_TYPE == EEPROM_ADDRESS_TYPE_24
-#define SPI_FLASH_CMD_MAX_SIZE (4)
-#define POPULATE_COMMAND_ADDRESS(cmd, addr) \
-    {cmd_pkt[0] = cmd; cmd_pkt[1] = ((addr)>>16)&0xFF; \
-    cmd_pkt[2] = ((addr)>>8)&0xFF; cmd_pkt[3] = ((addr))&0xFF;}
-#elif SET_EEPROM_ADDRESS_TYPE == EEPROM_ADDRESS_TYPE_32
-#define SPI_FLASH_CMD_MAX_SIZE (5)
-#define POPULATE_COMMAND_ADDRESS(cmd, addr) \
-    {cmd_pkt[0] = cmd; cmd_pkt[1] = ((addr)>>24)&0xFF; \
-    cmd_pkt[2] = ((addr)>>16)&0xFF; cmd_pkt[3] = ((addr)>>8)&0xFF; \
-    cmd_pkt[4] = ((addr))&0xFF;}
 #endif
 
+/* Opcode and the widest address; the address bytes of a device are in its
+ * geometry */
+#define SPI_FLASH_CMD_MAX_SIZE (1 + EEPROM_ADDRESS_TYPE_32)
+
+/* SFDP (JESD216): header and first parameter header, which describes the
+ * basic flash parameter table (BFPT). The BFPT is read up to the DWORDs
+ * used; its timing and suspend DWORDs exist from JESD216A on */
+#define SFDP_SIGNATURE          (0x50444653u)
+#define SFDP_HEADER_SIZE        (16u)
+#define SFDP_BFPT_DWORDS        (16u)
+#define SFDP_BFPT_MIN_DWORDS    (9u)
+#define SFDP_ADDR_3_OR_4        (1u)
+#define SFDP_ADDR_4_ONLY        (2u)
+
+/* Methods to enter 4-byte addressing, BFPT DWORD16 bits 31:24, of those
+ * the driver can use */
+#define SFDP_EN4B_B7            (1u << 0)   /* EN4B */
+#define SFDP_EN4B_WREN_B7       (1u << 1)   /* WREN, then EN4B */
+#define SFDP_EN4B_ALWAYS        (1u << 6)   /* Always in 4-byte mode */
+
+/* Largest array addressed with 3 bytes */
+#define ADDR_3BYTE_LIMIT        (0x1000000u)
+
+/* Largest data segment of one DMA descriptor for sequential reads */
+#define SPI_FLASH_READ_SEGMENT_SIZE (0x8000u)
+
+/* Data segment of a compare or CRC, checked as soon as it is received */
+#define SPI_FLASH_CHECK_SEGMENT_SIZE (EEPROM_PAGE_SIZE)
+
+#if (SPI_EEPROM_DEVICES < 1) || (SPI_EEPROM_DEVICES > 4)
+#error SPI_EEPROM_DEVICES must be 1 to 4, one per slave select line
+#endif
+
+/* Timer channels: one per device for its WIP polls, then the bus */
+#define BUS_TIMER_CHANNEL (SPI_EEPROM_DEVICES)
+#if (BUS_TIMER_CHANNEL + 1) > TIMER_CHANNELS
+#error TIMER_CHANNELS must be at least SPI_EEPROM_DEVICES + 1
+#endif
+
+/* Device whose pages the RAM cache holds */
+#define SPI_EEPROM_CACHE_DEVICE (0u)
+
+/* Time a suspend needs besides its latency: the RDSR before it, the
+ * suspend command and the WIP poll that finds it done */
+#define SUSPEND_MARGIN_US (2u * EEPROM_POLL_MIN_US)
+
 /*******************************************************************************
 * Global variables declaration
 *******************************************************************************/
 /* Structure for SPI context */
 static cy_stc_scb_spi_context_t flash_spi_context;
 
-/* Buffer for command and address */
-static uint8_t cmd_pkt[SPI_FLASH_CMD_MAX_SIZE];
+/* SPI clock dividers for command/status traffic and for data reads, and the
+ * one currently programmed */
+static uint32_t clk_div_cmd;
+static uint32_t clk_div_read;
+static uint32_t clk_div_active;
+
+/* Operations that set WIP, each with its own poll timing */
+typedef enum
+{
+    WIP_OP_NONE = -1,
+    WIP_OP_PP = SPI_EEPROM_TIME_PP,
+    WIP_OP_SE = SPI_EEPROM_TIME_SE,
+    WIP_OP_BE32 = SPI_EEPROM_TIME_BE32,
+    WIP_OP_BE64 = SPI_EEPROM_TIME_BE64,
+    WIP_OP_CE = SPI_EEPROM_TIME_CE,
+    WIP_OP_W = SPI_EEPROM_TIME_W,
+    WIP_OP_COUNT = SPI_EEPROM_TIME_COUNT
+} wip_op_t;
+
+/* Geometry of a device without SFDP or known RDID */
+static const spi_eeprom_geometry_t geometry_default =
+{
+    .source = SPI_EEPROM_GEOMETRY_DEFAULT,
+    .size = EEPROM_NUM_PAGES * EEPROM_PAGE_SIZE,
+    .page_size = EEPROM_PAGE_SIZE,
+    .addr_bytes = SET_EEPROM_ADDRESS_TYPE,
+    .fast_read = true,
+    .erase_4k_cmd = FLASH_4K_SECTOR_ERASE,
+    .erase_32k_cmd = FLASH_32K_BLOCK_ERASE,
+    .erase_64k_cmd = FLASH_64K_BLOCK_ERASE,
+    .suspend_cmd = FLASH_SUSPEND,
+    .resume_cmd = FLASH_RESUME,
+    .t_suspend_us = EEPROM_T_SUS_US,
+    .t_resume_us = EEPROM_T_RS_US,
+    .t_typ_us = { EEPROM_T_PP_US, EEPROM_T_SE_US, EEPROM_T_BE32_US, EEPROM_T_BE64_US,
+                  EEPROM_T_CE_US, EEPROM_T_W_US },
+    .t_max_us = { EEPROM_T_PP_MAX_US, EEPROM_T_SE_MAX_US, EEPROM_T_BE32_MAX_US, EEPROM_T_BE64_MAX_US,
+                  EEPROM_T_CE_MAX_US, EEPROM_T_W_MAX_US },
+};
+
+/* Parts known by RDID, for those without SFDP: typical and maximum times
+ * of the datasheets */
+typedef struct
+{
+    uint8_t jedec_id[3];
+    uint32_t size;
+    uint32_t page_size;
+    uint32_t t_typ_us[SPI_EEPROM_TIME_COUNT];
+    uint32_t t_max_us[SPI_EEPROM_TIME_COUNT];
+} rdid_part_t;
+
+static const rdid_part_t rdid_parts[] =
+{
+    /* Infineon S25FL064L */
+    { { 0x01u, 0x60u, 0x17u }, 0x800000u, 256u,
+      { 450u, 50000u, 150000u, 220000u, 20000000u, 2000u },
+      { 1350u, 300000u, 600000u, 1150000u, 80000000u, 15000u } },
+    /* Winbond W25Q64JV */
+    { { 0xEFu, 0x40u, 0x17u }, 0x800000u, 256u,
+      { 400u, 45000u, 120000u, 150000u, 20000000u, 10000u },
+      { 3000u, 400000u, 1600000u, 2000000u, 100000000u, 15000u } },
+};
+
+/* States of the multi-page write engine */
+typedef enum
+{
+    WRITE_RANGE_IDLE,
+    WRITE_RANGE_ENABLE,     /* WREN sent, page program follows */
+    WRITE_RANGE_PROGRAM     /* Page program sent, WIP polled */
+} write_range_state_t;
+
+/* Steps of a verified write */
+typedef enum
+{
+    VERIFY_IDLE,
+    VERIFY_PROGRAM,         /* Pages programmed by write_range */
+    VERIFY_READ_BACK        /* Programmed range compared with data */
+} verify_state_t;
+
+/* Background operation set aside for critical ones */
+typedef enum
+{
+    SUSPEND_NONE,
+    SUSPEND_ENTER,          /* Suspend sent, WIP polled until reads are served */
+    SUSPEND_ACTIVE,         /* Suspended, critical reads run */
+    SUSPEND_RESUME,         /* Resume sent */
+    SUSPEND_HOLD,           /* Resumed, no suspend before t_resume_us */
+    SUSPEND_ABANDONED,      /* Dropped by spi_state_reset, resumed and waited for */
+    SUSPEND_PARKED          /* Write between two pages, critical operations run */
+} suspend_state_t;
+
+/* Transfer of a device waiting for the bus */
+typedef enum
+{
+    BUS_REQ_NONE,
+    BUS_REQ_PACKET,         /* send_packet of pong */
+    BUS_REQ_MULTI,          /* send_packet_multi of ping and pong */
+    BUS_REQ_STREAM          /* send_packet_stream of read_range */
+} bus_req_t;
+
+/* Operation of spi_eeprom_submit with its own command buffer, so it never
+ * shares cmd_pkt with the operation in progress */
+typedef struct queue_entry
+{
+    struct queue_entry *next;
+    spi_eeprom_op_t op;
+    spi_eeprom_prio_t prio;
+    bool has_deadline;
+    uint32_t deadline;      /* timer_now by which to start; submission if none */
+    uint32_t bypassed;      /* Critical operations started before this one */
+    uint32_t device;
+    uint32_t addr;
+    uint8_t *buffer;
+    uint32_t size;
+    spi_eeprom_callback_t cb;
+    void *ctx;
+#if SPI_EEPROM_TRACE
+    uint32_t submitted;     /* Timestamp of spi_eeprom_submit */
+#endif
+    uint8_t cmd[SPI_FLASH_CMD_MAX_SIZE + FAST_READ_DUMMY_LEN];
+} queue_entry_t;
+
+/* State of one EEPROM on its slave select line. Each device runs its own
+ * operation; they share the SCB and DMA, which the bus arbiter hands to one
+ * transfer at a time, so one device transfers while the others wait on WIP */
+typedef struct
+{
+    uint32_t index;
+    cy_en_scb_spi_slave_select_t ss;
+
+    /* Found by spi_eeprom_probe */
+    spi_eeprom_geometry_t geo;
+
+    /* Buffer for command, address and FAST_READ dummy byte */
+    uint8_t cmd_pkt[SPI_FLASH_CMD_MAX_SIZE + FAST_READ_DUMMY_LEN];
+
+    /* Buffer for DMA structure */
+    dma_master_packet_t ping, pong;
+
+    /* Transfer waiting for the bus, and the clock divider of the operation */
+    bus_req_t bus_req;
+    uint32_t divider;
+
+    /* Copy of status register 1 in bg_status.status, used to determine IDLE state or waiting on WIP */
+    struct
+    {
+        uint8_t placeholder;
+        uint8_t status;
+    } bg_status;
+
+    /* Remaining data of a sequential read, split into DMA segments */
+    struct
+    {
+        bool header_sent;
+        uint8_t *header;
+        uint8_t header_size;
+        uint8_t *buffer;
+        uint32_t remaining;
+    } read_range;
+
+    /* Checks of a sequential read, done on each segment as soon as the RX
+     * DMA has received it while the following ones transfer: the compare
+     * with expect (0xFF if NULL) and the CRC-32. The segments go to the
+     * buffer of the caller or, without one, to those of check_buf in turn */
+    struct
+    {
+        bool active;
+        bool compare;
+        bool mismatch;
+        bool crc_on;
+        uint32_t crc;
+        const uint8_t *expect;
+        uint8_t *buffer;        /* Buffer of the caller, NULL for check_buf */
+        uint32_t size;
+        uint32_t fetched;       /* Segments handed to the DMA */
+        uint32_t checked;       /* Segments checked */
+    } check;
+
+    /* Timer paced WIP polling of the operation in progress */
+    struct
+    {
+        wip_op_t op;
+        uint32_t polls;         /* RDSR issued so far */
+        uint32_t elapsed_us;    /* Delay scheduled so far */
+        uint32_t interval_us;   /* Delay before the next RDSR */
+    } wip_poll;
+
+    /* Expected duration of each operation, starting at the typical time of
+     * the device and adapted to the measured ones, but never above it */
+    uint32_t wip_estimate_us[WIP_OP_COUNT];
+
+    /* Remaining data of a multi-page write, programmed one page per step */
+    struct
+    {
+        write_range_state_t state;
+        uint8_t *cmd;           /* Buffer for the page program command */
+        uint32_t addr;
+        uint8_t *buffer;
+        uint32_t remaining;
+        uint16_t size;          /* Bytes of the page being programmed */
+    } write_range;
+
+    /* Verified write: the range and data kept for the read back */
+    struct
+    {
+        verify_state_t state;
+        uint8_t *cmd;
+        uint32_t addr;
+        const uint8_t *data;
+        uint32_t size;
+    } verify;
+
+    /* Program of the operation in progress, applied to the page cache once
+     * it has succeeded */
+    struct
+    {
+        uint32_t addr;
+        const uint8_t *data;
+        uint32_t size;          /* 0 if none */
+    } cache_program;
+
+    /* Command sent once the WREN preceding it has completed */
+    struct
+    {
+        uint8_t *cmd;           /* NULL if none pending */
+        uint8_t size;
+    } enabled_cmd;
+
+    /* Completion callback of the operation in progress */
+    struct
+    {
+        bool busy;
+        spi_eeprom_callback_t cb;
+        void *ctx;
+    } request;
+
+    /* Operations of spi_eeprom_submit for this device, from head to tail in
+     * order: critical ones by deadline, then background ones as submitted;
+     * and the one in progress */
+    struct
+    {
+        queue_entry_t *head;
+        queue_entry_t *tail;
+        queue_entry_t *active;
+    } queue;
+
+    /* Background operation set aside for critical ones, a program or erase
+     * suspended or a write parked between pages: its WIP operation and
+     * request, and the critical operations started meanwhile */
+    struct
+    {
+        suspend_state_t state;
+        uint8_t cmd;            /* Suspend or resume opcode being sent */
+        uint32_t wait_us;       /* Delay scheduled since the suspend */
+        uint32_t bypassed;
+        wip_op_t op;
+        spi_eeprom_callback_t cb;
+        void *ctx;
+        queue_entry_t *active;
+        spi_eeprom_suspend_stats_t stats;
+    } suspend;
+} eeprom_dev_t;
+
+static eeprom_dev_t devices[SPI_EEPROM_DEVICES];
+
+/* Device of the spi_eeprom_* functions other than spi_eeprom_submit_to */
+static eeprom_dev_t *selected = &devices[0];
+
+/* Owner of SCB and DMA: the device whose transfer is in progress, or whose
+ * slave select is about to be activated. While dma_completion_cb runs the
+ * bus is not granted; afterwards the devices waiting get it in turn */
+static struct
+{
+    eeprom_dev_t *owner;
+    uint32_t next;          /* Device asked first at the next grant */
+    cy_en_scb_spi_slave_select_t ss;
+    bool completing;
+} bus;
+
+/* Segments of a compare or CRC without buffer of the caller; only the device
+ * owning the bus streams */
+static uint8_t check_buf[DMA_STREAM_QUEUE_LEN][SPI_FLASH_CHECK_SEGMENT_SIZE];
 
-/* Buffer for DMA structure */
-static dma_master_packet_t ping, pong;
+/* CRC-32 of the last CRC completed on any device */
+static uint32_t crc_result;
+
+/* Page read of spi_eeprom_read_flash into a cache slot, copied to the
+ * caller's buffer on completion */
+static struct
+{
+    uint32_t page_addr;
+    uint8_t *slot;
+    uint8_t *buffer;
+    uint16_t size;
+    spi_eeprom_callback_t cb;
+    void *ctx;
+} cache_fill;
 
-/* Copy of status register 1 in bg_status.status, used to determine IDLE state or waiting on WIP */
+/* Fixed pool of queue entries shared by all devices; free ones are chained
+ * in free */
+static queue_entry_t queue_pool[SPI_EEPROM_QUEUE_LEN];
 static struct
 {
-    uint8_t placeholder;
-    uint8_t status;
-} bg_status;
+    bool init;
+    queue_entry_t *free;
+} queue;
+
+/* Internal functions */
+static void transfer_done(eeprom_dev_t *d, bool error);
+static bool device_busy(const eeprom_dev_t *d);
+static void request_begin(eeprom_dev_t *d, spi_eeprom_callback_t cb, void *ctx);
+static void request_complete(eeprom_dev_t *d, eeprom_dma_status_t status);
+static bool write_range_step(eeprom_dev_t *d);
+static void request_abort(eeprom_dev_t *d, eeprom_dma_status_t status);
+static wip_op_t wip_op_of(const eeprom_dev_t *d, uint8_t cmd);
+static uint8_t erase_cmd_of(const eeprom_dev_t *d, spi_eeprom_op_t op);
+static uint32_t sfdp_dword(const uint8_t *p);
+static uint32_t sfdp_time_us(uint32_t field, uint32_t count_bits, const uint32_t *units_us);
+static uint32_t sfdp_max_us(uint32_t typ_us, uint32_t factor);
+static void sfdp_parse(spi_eeprom_geometry_t *geo, const uint32_t *bfpt, uint32_t dwords);
+static void wip_poll_begin(eeprom_dev_t *d, uint8_t cmd);
+static void wip_poll_step(eeprom_dev_t *d);
+static void wip_poll_send(uint32_t channel);
+static void wip_poll_done(eeprom_dev_t *d);
+static bool entry_starved(const queue_entry_t *entry, uint32_t bypassed);
+static bool preempt_allowed(const eeprom_dev_t *d, const queue_entry_t *current, suspend_state_t aside);
+static bool suspend_due(const eeprom_dev_t *d, uint32_t wait_us);
+static bool park_due(const eeprom_dev_t *d);
+static void suspend_begin(eeprom_dev_t *d);
+static void suspend_step(eeprom_dev_t *d);
+static void suspend_stash(eeprom_dev_t *d);
+static void suspend_resume(eeprom_dev_t *d);
+static void suspend_hold_end(uint32_t channel);
+static void bus_request(eeprom_dev_t *d, bus_req_t req);
+static void bus_grant(void);
+static bool bus_critical(const eeprom_dev_t *d);
+static void bus_switch(uint32_t channel);
+static void bus_send(eeprom_dev_t *d);
+static bool read_range_next(dma_master_packet_t *next);
+static bool bus_idle(void);
+static void device_reset(eeprom_dev_t *d);
+static void spi_set_clock_divider(uint32_t divider);
+static uint8_t populate_read_command(const eeprom_dev_t *d, uint8_t *buf, uint32_t addr);
+static uint8_t command_address(const eeprom_dev_t *d, uint8_t *buf, uint8_t cmd, uint32_t addr);
+static void read_range_start(eeprom_dev_t *d, uint8_t *header, uint32_t addr, uint8_t *buffer, uint32_t size);
+static void read_stream_start(eeprom_dev_t *d, uint8_t *header, uint32_t addr, uint8_t *buffer, uint32_t size);
+static void compare_range_start(eeprom_dev_t *d, uint8_t *header, uint32_t addr, const uint8_t *expect,
+        uint32_t size);
+static void crc_range_start(eeprom_dev_t *d, uint8_t *header, uint32_t addr, uint8_t *buffer, uint32_t size);
+static void check_segment(eeprom_dev_t *d);
+static eeprom_dma_status_t check_finish(eeprom_dev_t *d);
+static void write_range_start(eeprom_dev_t *d, uint8_t *cmd, uint32_t addr, uint8_t *buffer, uint32_t size);
+static void write_verify_start(eeprom_dev_t *d, uint8_t *cmd, uint32_t addr, uint8_t *buffer, uint32_t size);
+static void enabled_cmd_start(eeprom_dev_t *d, uint8_t *cmd, uint8_t size, uint32_t addr);
+static void enabled_cmd_send(eeprom_dev_t *d);
+static eeprom_dma_status_t read_write_array(eeprom_dev_t *d, uint8_t *wr_buf, uint8_t *rd_buf,
+        uint16_t size, uint8_t *cmd_buf, uint8_t cmd_size, spi_eeprom_callback_t cb, void *ctx);
+static void queue_init(void);
+static queue_entry_t *queue_next(const eeprom_dev_t *d);
+static void queue_dispatch(eeprom_dev_t *d);
+static void queue_entry_done(eeprom_dma_status_t status, cy_rslt_t error, void *ctx);
+static void cache_fill_done(eeprom_dma_status_t status, cy_rslt_t error, void *ctx);
+static void cache_invalidate_erase(eeprom_dev_t *d, uint8_t cmd, uint32_t addr);
 
 /*******************************************************************************
  * Function Name: dmaCompletionCallback
@@ -99,426 +481,3402 @@ static struct
  * Summary:
  *  This function is executed as part of the DMA interrupt. With this additional
  *  checks may be performed or transfer functions started.
- * 
- *  In this case, the backgorund status register is checked to see if the
- *  write is complete. As long as this is not the case, another DMA transfer
- *  is triggered to poll the status register.
- * 
+ *
+ *  The transfer that completed belongs to the device owning the bus, which
+ *  releases it. The device continues its operation in transfer_done; then
+ *  the bus goes to the next device waiting for it.
+ *
  * Parameters:
- *  bg_status: Global variable with backup of status.
+ *  error: True if the DMA reported a bus error.
  *
  * Return:
- *  (bool) True if no more data to be transferred.
+ *  (bool) True if no more data to be transferred on any device.
  *  Otherwise it returns false.
  *
  ******************************************************************************/
-bool dma_completion_cb(void)
+bool dma_completion_cb(bool error)
 {
-    if (SPI_EEPROM_IS_WRITE_IN_PROGRESS(bg_status.status))
+    eeprom_dev_t *d = bus.owner;
+
+    bus.owner = NULL;
+    if (d != NULL)
     {
-        static uint8_t cmd[RD_STATUS_SINGULAR_LEN] = {FLASH_READ_STATUS, 0};
-        pong = (dma_master_packet_t)
-        {
-            .src = cmd,
-            .dst = (uint8_t*)&bg_status,
-            .num_bytes = RD_STATUS_SINGULAR_LEN, /* Using one buffer with full length each */
-        };
-        send_packet(&pong);
-        return false;
+        SPI_EEPROM_TRACE_EVENT(d->index, SPI_EEPROM_TRACE_DMA_DONE);
+        bus.completing = true;
+        transfer_done(d, error);
+        bus.completing = false;
+        bus_grant();
+    }
+    return bus_idle();
+}
+
+/*******************************************************************************
+ * Function Name: transfer_done
+ *******************************************************************************
+ *
+ * Summary:
+ *  Executed as part of the DMA interrupt when a transfer of device d has
+ *  completed.
+ * 
+ *  The backgorund status register is checked to see if the write is
+ *  complete. As long as this is not the case, another DMA transfer is
+ *  triggered to poll the status register. After that a running
+ *  spi_eeprom_write_range continues with its next step, or the command
+ *  waiting for its WREN is sent. Once the operation has completed, or failed
+ *  with a DMA error, its callback is called and the next operation of
+ *  spi_eeprom_submit is started. Suspend and resume of a program or erase
+ *  continue in suspend_step. A write with pages left is parked here, after
+ *  a page and before the WREN of the next, when a critical operation is
+ *  next in the queue.
+ *
+ * Parameters:
+ *  d: device of the transfer
+ *  error: True if the DMA reported a bus error.
+ *
+ ******************************************************************************/
+static void transfer_done(eeprom_dev_t *d, bool error)
+{
+    eeprom_dma_status_t status;
+    bool aside;
+
+    if (error)
+    {
+        /* spi_state_reset clears the remaining state */
+        request_abort(d, STATE_TRANSFER_ERROR);
+        return;
+    }
+
+    if ((d->suspend.state == SUSPEND_ENTER) || (d->suspend.state == SUSPEND_RESUME))
+    {
+        suspend_step(d);
+        return;
+    }
+    if (SPI_EEPROM_IS_WRITE_IN_PROGRESS(d->bg_status.status))
+    {
+        wip_poll_step(d);
+        return;
+    }
+    wip_poll_done(d);
+    if (park_due(d))
+    {
+        d->suspend.state = SUSPEND_PARKED;
+        d->suspend.stats.parks++;
+        suspend_stash(d);
+        return;
+    }
+
+    /* While an operation is set aside the one completing is critical;
+     * write_range and verify are those of the other */
+    aside = (d->suspend.state == SUSPEND_ACTIVE) || (d->suspend.state == SUSPEND_PARKED);
+    if (!aside && (d->write_range.state != WRITE_RANGE_IDLE) && !write_range_step(d))
+    {
+        return;
+    }
+    if (d->enabled_cmd.cmd != NULL)
+    {
+        enabled_cmd_send(d);
+        return;
+    }
+    if (!aside && (d->verify.state == VERIFY_PROGRAM))
+    {
+        /* Read back the pages just programmed, compared as they arrive */
+        d->verify.state = VERIFY_READ_BACK;
+        compare_range_start(d, d->verify.cmd, d->verify.addr, d->verify.data, d->verify.size);
+        return;
     }
 
     /* Everything related to this r/w is done */
-    return true;
+    status = d->check.active ? check_finish(d) : INIT_SUCCESS;
+    if (!aside && (d->verify.state == VERIFY_READ_BACK))
+    {
+        d->verify.state = VERIFY_IDLE;
+        if ((status != INIT_SUCCESS) && (d->index == SPI_EEPROM_CACHE_DEVICE))
+        {
+            /* The flash no longer holds what the cache does */
+            spi_eeprom_cache_invalidate(d->verify.addr, d->verify.size);
+        }
+    }
+    if (!aside && (d->cache_program.size != 0))
+    {
+        if (status == INIT_SUCCESS)
+        {
+            spi_eeprom_cache_write(d->cache_program.addr, d->cache_program.data, d->cache_program.size);
+        }
+        d->cache_program.size = 0;
+    }
+    request_complete(d, status);
 }
 
 /*******************************************************************************
- * Function Name: spi_eeprom_init
+ * Function Name: bus_request
  *******************************************************************************
  *
  * Summary:
- *  This function initializes the SPI master based on the configuration done in
- *  design.modus file and calls initialize for DMA.
+ *  Ask for the bus for the transfer of device d prepared in its ping/pong or
+ *  read_range. The transfer starts right away if the bus is free, otherwise
+ *  when the device gets its turn after the transfers in progress.
  *
  * Parameters:
- *  None
+ *  d: device
+ *  req: how the transfer is sent
  *
- * Return:
- *  (eeprom_dma_status_t) Returns INIT_SUCCESS if the initialization is successful.
- *  Otherwise it returns INIT_FAILURE
+ ******************************************************************************/
+static void bus_request(eeprom_dev_t *d, bus_req_t req)
+{
+    uint32_t intr = Cy_SysLib_EnterCriticalSection();
+
+    d->bus_req = req;
+    if ((bus.owner == NULL) && !bus.completing)
+    {
+        bus_grant();
+    }
+    Cy_SysLib_ExitCriticalSection(intr);
+}
+
+/*******************************************************************************
+ * Function Name: bus_grant
+ *******************************************************************************
+ *
+ * Summary:
+ *  Give the free bus to the next device waiting for it, round robin, and
+ *  start its transfer. Devices serving a critical operation go first. If
+ *  the slave select changes while the previous device is still selected,
+ *  the transfer is started by bus_switch once it is deselected; so is a
+ *  read_range stream, which tells a broken chip select assertion by the SPI
+ *  done status. Does nothing after a DMA error until spi_state_reset.
  *
  ******************************************************************************/
-eeprom_dma_status_t spi_eeprom_init(void)
+static void bus_grant(void)
 {
-    cy_rslt_t result = Cy_SCB_SPI_Init(FLASH_SPI_HW, &FLASH_SPI_config, &flash_spi_context);
-    if (result != CY_SCB_SPI_SUCCESS)
+    eeprom_dev_t *d = NULL;
+
+    if (dma_has_error())
     {
-        return INIT_FAILURE;
+        return;
     }
+    for (uint32_t i = 0; i < SPI_EEPROM_DEVICES; i++)
+    {
+        eeprom_dev_t *candidate = &devices[(bus.next + i) % SPI_EEPROM_DEVICES];
 
-    /* Enable the SPI Master block */
-    Cy_SCB_SPI_Enable(FLASH_SPI_HW);
+        if (candidate->bus_req != BUS_REQ_NONE)
+        {
+            if (bus_critical(candidate))
+            {
+                d = candidate;
+                break;
+            }
+            if (d == NULL)
+            {
+                d = candidate;
+            }
+        }
+    }
+    if (d == NULL)
+    {
+        return;
+    }
 
-    result = dma_init((void *) &(FLASH_SPI_HW->TX_FIFO_WR), (void *) &(FLASH_SPI_HW->RX_FIFO_RD),
-            &dma_completion_cb);
-    if (result != INIT_SUCCESS)
+    bus.owner = d;
+    bus.next = (d->index + 1u) % SPI_EEPROM_DEVICES;
+    if (((d->ss != bus.ss) || (d->bus_req == BUS_REQ_STREAM)) && Cy_SCB_SPI_IsBusBusy(FLASH_SPI_HW))
     {
-        return INIT_FAILURE;
+        timer_start(BUS_TIMER_CHANNEL, 1u, bus_switch);
+        return;
     }
-    return INIT_SUCCESS;
+    if (d->ss != bus.ss)
+    {
+        Cy_SCB_SPI_SetActiveSlaveSelect(FLASH_SPI_HW, d->ss);
+        bus.ss = d->ss;
+    }
+    bus_send(d);
+}
+
+/*******************************************************************************
+ * Function Name: bus_critical
+ *******************************************************************************
+ *
+ * Summary:
+ *  Whether the transfer of device d is for a critical operation: one in
+ *  progress, or the suspend of a program or erase for a critical read.
+ *
+ ******************************************************************************/
+static bool bus_critical(const eeprom_dev_t *d)
+{
+    if (d->suspend.state == SUSPEND_ENTER)
+    {
+        return true;
+    }
+    return (d->queue.active != NULL) && (d->queue.active->prio == SPI_EEPROM_PRIO_CRITICAL);
 }
 
+/*******************************************************************************
+ * Function Name: bus_switch
+ *******************************************************************************
+ *
+ * Summary:
+ *  Timer callback: activate the slave select of the bus owner once the
+ *  previous device is deselected, and start its transfer.
+ *
+ ******************************************************************************/
+static void bus_switch(uint32_t channel)
+{
+    eeprom_dev_t *d = bus.owner;
+
+    if (d == NULL)
+    {
+        return;
+    }
+    if (Cy_SCB_SPI_IsBusBusy(FLASH_SPI_HW))
+    {
+        timer_start(channel, 1u, bus_switch);
+        return;
+    }
+    Cy_SCB_SPI_SetActiveSlaveSelect(FLASH_SPI_HW, d->ss);
+    bus.ss = d->ss;
+    bus_send(d);
+}
 
 /*******************************************************************************
- * Function Name: spi_eeprom_rdid_reg
+ * Function Name: bus_send
  *******************************************************************************
  *
  * Summary:
- *  Read SPI EEPROM RDID register.
+ *  Start the transfer of the bus owner d at the data rate of its operation.
+ *
+ ******************************************************************************/
+static void bus_send(eeprom_dev_t *d)
+{
+    bus_req_t req = d->bus_req;
+
+    d->bus_req = BUS_REQ_NONE;
+    spi_set_clock_divider(d->divider);
+    switch (req)
+    {
+        case BUS_REQ_PACKET:
+            send_packet(&d->pong);
+            break;
+        case BUS_REQ_MULTI:
+            send_packet_multi(&d->ping, &d->pong);
+            break;
+        default:
+            send_packet_stream(read_range_next);
+            break;
+    }
+    SPI_EEPROM_TRACE_EVENT(d->index, SPI_EEPROM_TRACE_FIRST_BYTE);
+}
+
+/*******************************************************************************
+ * Function Name: bus_idle
+ *******************************************************************************
+ *
+ * Summary:
+ *  Whether no device has an operation in progress and the bus is free.
+ *
+ ******************************************************************************/
+static bool bus_idle(void)
+{
+    if (bus.owner != NULL)
+    {
+        return false;
+    }
+    for (uint32_t i = 0; i < SPI_EEPROM_DEVICES; i++)
+    {
+        if (devices[i].request.busy)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*******************************************************************************
+ * Function Name: request_begin
+ *******************************************************************************
+ *
+ * Summary:
+ *  Register the completion callback of the operation about to be started.
  *
  * Parameters:
- *  data Pointer to EEPROM RDID register value.
- *  data_len Number of bytes to be read from teh register.
+ *  d: device of the operation
+ *  cb: callback, may be NULL
+ *  ctx: user context passed to cb
  *
- * Return:
- *  (eeprom_dma_status_t) The status of the transfer-ignition.
+ ******************************************************************************/
+static void request_begin(eeprom_dev_t *d, spi_eeprom_callback_t cb, void *ctx)
+{
+    d->request.busy = true;
+    d->request.cb = cb;
+    d->request.ctx = ctx;
+    SPI_EEPROM_TRACE_EVENT(d->index, SPI_EEPROM_TRACE_START);
+}
+
+/*******************************************************************************
+ * Function Name: request_complete
+ *******************************************************************************
+ *
+ * Summary:
+ *  Finish the operation in progress on device d and call its callback. The
+ *  callback may start the next operation right away; otherwise the next one
+ *  queued by spi_eeprom_submit is started.
+ *
+ * Parameters:
+ *  d: device of the operation
+ *  status: INIT_SUCCESS or STATE_TRANSFER_ERROR
  *
  ******************************************************************************/
-eeprom_dma_status_t spi_eeprom_rdid_reg(uint8_t *data, uint8_t data_len)
-{   
-    /* Create RDID command packet. */
-    cmd_pkt[0] = FLASH_RDID;
+static void request_complete(eeprom_dev_t *d, eeprom_dma_status_t status)
+{
+    spi_eeprom_callback_t cb = d->request.cb;
+    void *ctx = d->request.ctx;
+
+    d->request.busy = false;
+    d->request.cb = NULL;
+    if (d->suspend.state == SUSPEND_NONE)
+    {
+        /* The operation set aside for critical ones, if any, is done */
+        d->suspend.bypassed = 0;
+    }
+    SPI_EEPROM_TRACE_EVENT(d->index, SPI_EEPROM_TRACE_CALLBACK);
+    if (cb != NULL)
+    {
+        cb(status, (status == INIT_SUCCESS) ? CY_RSLT_SUCCESS : spi_transfer_get_error(), ctx);
+    }
+    SPI_EEPROM_TRACE_EVENT(d->index, SPI_EEPROM_TRACE_END);
+    if (!d->request.busy)
+    {
+        queue_dispatch(d);
+    }
+}
 
-    return spi_master_read_write_array (NULL, data, data_len, cmd_pkt, CMD_LEN_1BYTE);
+/*******************************************************************************
+ * Function Name: request_abort
+ *******************************************************************************
+ *
+ * Summary:
+ *  Abandon the operation in progress on device d and complete it with
+ *  status.
+ *
+ ******************************************************************************/
+static void request_abort(eeprom_dev_t *d, eeprom_dma_status_t status)
+{
+    if ((d->suspend.state != SUSPEND_ACTIVE) && (d->suspend.state != SUSPEND_PARKED))
+    {
+        /* Otherwise they belong to the operation set aside */
+        d->write_range.state = WRITE_RANGE_IDLE;
+        d->verify.state = VERIFY_IDLE;
+        d->cache_program.size = 0;
+    }
+    d->enabled_cmd.cmd = NULL;
+    d->wip_poll.op = WIP_OP_NONE;
+    d->bg_status.status = 0;
+    d->check.active = false;
+    /* A program or erase may have been cut short */
+    spi_eeprom_cache_clear();
+    request_complete(d, status);
 }
 
-/*******************************************************************************
- * Function Name: spi_eeprom_read_status_reg
- *******************************************************************************
- *
- * Summary:
- *  Read SPI EEPROM status register.
- *
- * Parameters:
- *  status Variable to hold EEPROM status register value.
- *
- * Return:
- *  (eeprom_dma_status_t) The status of the transfer-ignition.
- *
- ******************************************************************************/
-eeprom_dma_status_t spi_eeprom_read_status_reg(uint8_t *status)
-{
-    /* Create READ_STATUS command packet. */
-    cmd_pkt[0] = FLASH_READ_STATUS;
+/*******************************************************************************
+ * Function Name: wip_op_of
+ *******************************************************************************
+ *
+ * Summary:
+ *  Operation started by a command on device d, by the erase opcodes of its
+ *  geometry and the fixed program, chip erase and write status opcodes.
+ *
+ ******************************************************************************/
+static wip_op_t wip_op_of(const eeprom_dev_t *d, uint8_t cmd)
+{
+    if (cmd == 0)
+    {
+        return WIP_OP_NONE;
+    }
+    if (cmd == d->geo.erase_4k_cmd)
+    {
+        return WIP_OP_SE;
+    }
+    if (cmd == d->geo.erase_32k_cmd)
+    {
+        return WIP_OP_BE32;
+    }
+    if (cmd == d->geo.erase_64k_cmd)
+    {
+        return WIP_OP_BE64;
+    }
+    switch (cmd)
+    {
+        case FLASH_WRITE_DATA:
+            return WIP_OP_PP;
+        case FLASH_CHIP_ERASE:
+        case FLASH_CHIP_ERASE_ALT:
+            return WIP_OP_CE;
+        case FLASH_WRITE_STATUS_CFG:
+            return WIP_OP_W;
+        default:
+            return WIP_OP_NONE;
+    }
+}
+
+/*******************************************************************************
+ * Function Name: wip_poll_begin
+ *******************************************************************************
+ *
+ * Summary:
+ *  Prepare WIP polling for a command that is about to be sent. Program,
+ *  erase and write status commands set bg_status WIP, so that the completion
+ *  callback keeps polling until the EEPROM reports the end of the operation.
+ *
+ * Parameters:
+ *  d: device the command is sent to
+ *  cmd: opcode of the command
+ *
+ ******************************************************************************/
+static void wip_poll_begin(eeprom_dev_t *d, uint8_t cmd)
+{
+    d->wip_poll.op = wip_op_of(d, cmd);
+    if (d->wip_poll.op == WIP_OP_NONE)
+    {
+        /* Reads, WREN and WRDI complete with the transfer */
+        return;
+    }
+
+    d->wip_poll.polls = 0;
+    d->wip_poll.elapsed_us = 0;
+    d->bg_status.status |= SPI_EEPROM_STAT_REG_WIP;
+}
+
+/*******************************************************************************
+ * Function Name: wip_poll_step
+ *******************************************************************************
+ *
+ * Summary:
+ *  Executed as part of the DMA interrupt while bg_status shows WIP. Instead
+ *  of reading the status register back to back, the next RDSR is scheduled
+ *  on the timer channel of the device: the first one after the expected
+ *  duration of the operation, then at an interval that starts at 1/16 of it
+ *  and doubles up to 1/4. The bus is free for the other devices meanwhile.
+ *
+ *  When WIP has cleared, the measured duration updates the expectation:
+ *  done at the first poll shortens it by 1/16, later polls move it 1/4 of the
+ *  way to the measured time, up to the typical time. A device faster than
+ *  typical is thus polled earlier, a slower one at the growing interval.
+ *  Still busy past its maximum time, the operation fails with
+ *  STATE_TIMEOUT; the queue goes on with the next one. With a critical
+ *  read queued, a program or erase is suspended instead of polled, once
+ *  waiting for the next poll would make the read miss its deadline.
+ *
+ ******************************************************************************/
+static void wip_poll_step(eeprom_dev_t *d)
+{
+    uint32_t estimate = d->wip_estimate_us[d->wip_poll.op];
+    uint32_t delay;
+
+    if (d->wip_poll.elapsed_us > d->geo.t_max_us[d->wip_poll.op])
+    {
+        request_abort(d, STATE_TIMEOUT);
+        return;
+    }
+
+    delay = (d->wip_poll.polls == 0) ? estimate : d->wip_poll.interval_us;
+    if (delay < EEPROM_POLL_MIN_US)
+    {
+        delay = EEPROM_POLL_MIN_US;
+    }
+    if (suspend_due(d, delay))
+    {
+        suspend_begin(d);
+        return;
+    }
+
+    if (d->wip_poll.polls == 0)
+    {
+        d->wip_poll.interval_us = estimate / 16u;
+    }
+    else if (d->wip_poll.interval_us < (estimate / 4u))
+    {
+        d->wip_poll.interval_us *= 2u;
+    }
+
+    d->wip_poll.polls++;
+    d->wip_poll.elapsed_us += delay;
+    SPI_EEPROM_TRACE_EVENT(d->index, SPI_EEPROM_TRACE_WIP_WAIT);
+    timer_start(d->index, delay, wip_poll_send);
+}
+
+/*******************************************************************************
+ * Function Name: wip_poll_send
+ *******************************************************************************
+ *
+ * Summary:
+ *  Timer callback: read the status register of the device of the channel
+ *  into its bg_status. The completion callback continues polling or
+ *  finishes the operation.
+ *
+ ******************************************************************************/
+static void wip_poll_send(uint32_t channel)
+{
+    static uint8_t cmd[RD_STATUS_SINGULAR_LEN] = {FLASH_READ_STATUS, 0};
+    eeprom_dev_t *d = &devices[channel];
+
+    d->pong = (dma_master_packet_t)
+    {
+        .src = cmd,
+        .dst = (uint8_t*)&d->bg_status,
+        .num_bytes = RD_STATUS_SINGULAR_LEN, /* Using one buffer with full length each */
+    };
+    bus_request(d, BUS_REQ_PACKET);
+}
+
+/*******************************************************************************
+ * Function Name: wip_poll_done
+ *******************************************************************************
+ *
+ * Summary:
+ *  Adapt the expected duration of the finished operation.
+ *
+ ******************************************************************************/
+static void wip_poll_done(eeprom_dev_t *d)
+{
+    uint32_t *estimate;
+
+    if (d->wip_poll.op == WIP_OP_NONE)
+    {
+        return;
+    }
+    SPI_EEPROM_TRACE_EVENT(d->index, SPI_EEPROM_TRACE_WIP_CLEAR);
+
+    estimate = &d->wip_estimate_us[d->wip_poll.op];
+    if (d->wip_poll.polls <= 1u)
+    {
+        *estimate -= *estimate / 16u;
+    }
+    else
+    {
+        /* A suspend takes its cancelled delay back, so the elapsed time can
+         * fall short of the estimate */
+        *estimate = (uint32_t) ((int32_t) *estimate +
+                                ((int32_t) (d->wip_poll.elapsed_us - *estimate) / 4));
+        if (*estimate > d->geo.t_typ_us[d->wip_poll.op])
+        {
+            *estimate = d->geo.t_typ_us[d->wip_poll.op];
+        }
+    }
+    d->wip_poll.op = WIP_OP_NONE;
+}
+
+/*******************************************************************************
+ * Function Name: entry_starved
+ *******************************************************************************
+ *
+ * Summary:
+ *  Whether a background operation has waited long enough for critical ones:
+ *  bypassed SPI_EEPROM_STARVATION_LIMIT times, or past its deadline. entry
+ *  may be NULL for an operation not of the queue.
+ *
+ ******************************************************************************/
+static bool entry_starved(const queue_entry_t *entry, uint32_t bypassed)
+{
+    if (bypassed >= SPI_EEPROM_STARVATION_LIMIT)
+    {
+        return true;
+    }
+    return (entry != NULL) && entry->has_deadline && ((int32_t) (timer_now() - entry->deadline) >= 0);
+}
+
+/*******************************************************************************
+ * Function Name: preempt_allowed
+ *******************************************************************************
+ *
+ * Summary:
+ *  Whether the critical operation next in the queue of device d may run
+ *  while the background operation current is set aside as aside: only
+ *  reads while a program or erase is suspended, no writes while a write is
+ *  parked, as they would take its write_range and verify. Not once current
+ *  is starved; current is NULL for an operation not of the queue.
+ *
+ ******************************************************************************/
+static bool preempt_allowed(const eeprom_dev_t *d, const queue_entry_t *current, suspend_state_t aside)
+{
+    const queue_entry_t *next = queue_next(d);
+
+    if ((next == NULL) || (next->prio != SPI_EEPROM_PRIO_CRITICAL))
+    {
+        return false;
+    }
+    if (aside == SUSPEND_ACTIVE)
+    {
+        if (next->op != SPI_EEPROM_OP_READ)
+        {
+            return false;
+        }
+    }
+    else if ((next->op == SPI_EEPROM_OP_WRITE) || (next->op == SPI_EEPROM_OP_WRITE_VERIFY))
+    {
+        return false;
+    }
+    return !entry_starved(current, d->suspend.bypassed);
+}
+
+/*******************************************************************************
+ * Function Name: suspend_due
+ *******************************************************************************
+ *
+ * Summary:
+ *  Whether device d is to suspend its operation now rather than poll WIP
+ *  again after wait_us: a critical read is next, the EEPROM suspends, and
+ *  a background page program or sector/block erase is waiting for WIP,
+ *  not within t_resume_us of its last resume. Chip erase and write status
+ *  run to completion. A read with a deadline lets the operation go on
+ *  while it can still be suspended in time after the next poll.
+ *
+ ******************************************************************************/
+static bool suspend_due(const eeprom_dev_t *d, uint32_t wait_us)
+{
+    const queue_entry_t *next;
+    uint32_t need = d->geo.t_suspend_us + SUSPEND_MARGIN_US;
+    int32_t slack;
+
+    if ((d->suspend.state != SUSPEND_NONE) || (d->geo.suspend_cmd == 0) ||
+        ((d->queue.active != NULL) && (d->queue.active->prio == SPI_EEPROM_PRIO_CRITICAL)) ||
+        !preempt_allowed(d, d->queue.active, SUSPEND_ACTIVE))
+    {
+        return false;
+    }
+    switch (d->wip_poll.op)
+    {
+        case WIP_OP_PP:
+        case WIP_OP_SE:
+        case WIP_OP_BE32:
+        case WIP_OP_BE64:
+            break;
+        default:
+            return false;
+    }
+    next = queue_next(d);
+    if (!next->has_deadline)
+    {
+        return true;
+    }
+    slack = (int32_t) (next->deadline - timer_now());
+    return (slack <= (int32_t) need) || (((uint32_t) slack - need) < wait_us);
+}
+
+/*******************************************************************************
+ * Function Name: park_due
+ *******************************************************************************
+ *
+ * Summary:
+ *  Whether device d, between two steps of its operation with WIP clear, is
+ *  to set it aside for a critical operation: a background write with pages
+ *  left to program, or a verified write before its read back. Never while
+ *  WEL is set, so that the critical operation cannot be the one to use it.
+ *
+ ******************************************************************************/
+static bool park_due(const eeprom_dev_t *d)
+{
+    if ((d->suspend.state != SUSPEND_NONE) || (d->enabled_cmd.cmd != NULL) ||
+        (d->write_range.state == WRITE_RANGE_ENABLE) ||
+        ((d->queue.active != NULL) && (d->queue.active->prio == SPI_EEPROM_PRIO_CRITICAL)) ||
+        !preempt_allowed(d, d->queue.active, SUSPEND_PARKED))
+    {
+        return false;
+    }
+    if ((d->write_range.state == WRITE_RANGE_PROGRAM) && (d->write_range.remaining > d->write_range.size))
+    {
+        return true;
+    }
+    return d->verify.state == VERIFY_PROGRAM;
+}
+
+/*******************************************************************************
+ * Function Name: suspend_begin
+ *******************************************************************************
+ *
+ * Summary:
+ *  Send the suspend command to device d, whose WIP poll is not pending.
+ *  suspend_step polls WIP until the EEPROM serves reads.
+ *
+ ******************************************************************************/
+static void suspend_begin(eeprom_dev_t *d)
+{
+    d->suspend.state = SUSPEND_ENTER;
+    d->suspend.op = d->wip_poll.op;
+    d->suspend.wait_us = 0;
+    d->suspend.cmd = d->geo.suspend_cmd;
+    d->suspend.stats.suspends++;
+
+    d->pong = (dma_master_packet_t)
+    {
+        .src = &d->suspend.cmd,
+        .dst = NULL,
+        .num_bytes = CMD_LEN_1BYTE
+    };
+    d->divider = clk_div_cmd;
+    bus_request(d, BUS_REQ_PACKET);
+}
+
+/*******************************************************************************
+ * Function Name: suspend_step
+ *******************************************************************************
+ *
+ * Summary:
+ *  Executed as part of the DMA interrupt after the suspend or resume
+ *  command of device d, and after the RDSR following the suspend. WIP is
+ *  read first after the suspend latency, then every EEPROM_POLL_MIN_US.
+ *  Once it has cleared the operation is set aside and the critical reads
+ *  start; an operation that completed meanwhile ignores the suspend, and
+ *  the resume after the reads, and is found done by the next poll.
+ *
+ *  After the resume WIP polling continues once t_resume_us has passed,
+ *  unless another critical read is due meanwhile. The time spent
+ *  suspending and held after the resume counts to the operation, the time
+ *  suspended does not.
+ *
+ ******************************************************************************/
+static void suspend_step(eeprom_dev_t *d)
+{
+    uint32_t delay;
+
+    if (d->suspend.state == SUSPEND_RESUME)
+    {
+        d->suspend.state = SUSPEND_HOLD;
+        d->wip_poll.elapsed_us += d->geo.t_resume_us;
+        timer_start(d->index, d->geo.t_resume_us, suspend_hold_end);
+        return;
+    }
+
+    if (SPI_EEPROM_IS_WRITE_IN_PROGRESS(d->bg_status.status))
+    {
+        delay = (d->suspend.wait_us == 0) ? d->geo.t_suspend_us : EEPROM_POLL_MIN_US;
+        d->suspend.wait_us += delay;
+        timer_start(d->index, delay, wip_poll_send);
+        return;
+    }
+
+    if (d->suspend.wait_us > d->suspend.stats.suspend_max_us)
+    {
+        d->suspend.stats.suspend_max_us = d->suspend.wait_us;
+    }
+    d->wip_poll.elapsed_us += d->suspend.wait_us;
+    d->wip_poll.op = WIP_OP_NONE;
+    d->suspend.state = SUSPEND_ACTIVE;
+    suspend_stash(d);
+}
+
+/*******************************************************************************
+ * Function Name: suspend_stash
+ *******************************************************************************
+ *
+ * Summary:
+ *  Set the request of device d aside, suspended or parked, and start the
+ *  critical operations.
+ *
+ ******************************************************************************/
+static void suspend_stash(eeprom_dev_t *d)
+{
+    d->suspend.cb = d->request.cb;
+    d->suspend.ctx = d->request.ctx;
+    d->suspend.active = d->queue.active;
+    d->request.busy = false;
+    d->request.cb = NULL;
+    d->queue.active = NULL;
+    SPI_EEPROM_TRACE_SUSPEND(d->index);
+    queue_dispatch(d);
+}
+
+/*******************************************************************************
+ * Function Name: suspend_resume
+ *******************************************************************************
+ *
+ * Summary:
+ *  Called by queue_dispatch once no critical operation is left to run, or
+ *  the one set aside is starved: take it up again and send the resume
+ *  command, or continue a parked write with its next page. An operation
+ *  dropped by spi_state_reset is resumed without callback, so that the
+ *  next one does not find the EEPROM suspended or busy.
+ *
+ ******************************************************************************/
+static void suspend_resume(eeprom_dev_t *d)
+{
+    if (d->suspend.state == SUSPEND_ABANDONED)
+    {
+        request_begin(d, NULL, NULL);
+    }
+    else
+    {
+        d->request.busy = true;
+        d->request.cb = d->suspend.cb;
+        d->request.ctx = d->suspend.ctx;
+        d->queue.active = d->suspend.active;
+        SPI_EEPROM_TRACE_RESUME(d->index);
+    }
+    d->suspend.cb = NULL;
+    d->suspend.active = NULL;
+    if (d->suspend.state == SUSPEND_PARKED)
+    {
+        d->suspend.state = SUSPEND_NONE;
+        transfer_done(d, false);
+        return;
+    }
+    d->suspend.state = SUSPEND_RESUME;
+    d->suspend.cmd = d->geo.resume_cmd;
+    d->wip_poll.op = d->suspend.op;
+    d->bg_status.status |= SPI_EEPROM_STAT_REG_WIP;
+
+    d->pong = (dma_master_packet_t)
+    {
+        .src = &d->suspend.cmd,
+        .dst = NULL,
+        .num_bytes = CMD_LEN_1BYTE
+    };
+    d->divider = clk_div_cmd;
+    bus_request(d, BUS_REQ_PACKET);
+}
+
+/*******************************************************************************
+ * Function Name: suspend_hold_end
+ *******************************************************************************
+ *
+ * Summary:
+ *  Timer callback t_resume_us after a resume: suspend again for a critical
+ *  read due meanwhile, otherwise poll WIP.
+ *
+ ******************************************************************************/
+static void suspend_hold_end(uint32_t channel)
+{
+    eeprom_dev_t *d = &devices[channel];
+
+    d->suspend.state = SUSPEND_NONE;
+    if (suspend_due(d, 0))
+    {
+        suspend_begin(d);
+        return;
+    }
+    wip_poll_send(channel);
+}
+
+/*******************************************************************************
+ * Function Name: write_range_step
+ *******************************************************************************
+ *
+ * Summary:
+ *  Next step of spi_eeprom_write_range, executed as part of the DMA interrupt
+ *  once the previous command has completed (and WIP has cleared):
+ *  after WREN the page program follows, after a page program the WREN for
+ *  the next page, until all data is written.
+ *
+ * Return:
+ *  (bool) True if the write is complete, false otherwise.
+ *
+ ******************************************************************************/
+static bool write_range_step(eeprom_dev_t *d)
+{
+    static uint8_t cmd_wren = FLASH_WRITE_ENABLE;
+
+    if (d->write_range.state == WRITE_RANGE_ENABLE)
+    {
+        /* Program up to the end of the page */
+        uint32_t size = d->geo.page_size - (d->write_range.addr % d->geo.page_size);
+
+        d->write_range.size = (size > d->write_range.remaining) ? d->write_range.remaining : size;
+        d->ping = (dma_master_packet_t)
+        {
+            .src = d->write_range.cmd,
+            .dst = NULL,
+            .num_bytes = command_address(d, d->write_range.cmd, FLASH_WRITE_DATA, d->write_range.addr)
+        };
+        d->pong = (dma_master_packet_t)
+        {
+            .src = d->write_range.buffer,
+            .dst = NULL,
+            .num_bytes = d->write_range.size
+        };
+        wip_poll_begin(d, FLASH_WRITE_DATA);
+        d->write_range.state = WRITE_RANGE_PROGRAM;
+        bus_request(d, BUS_REQ_MULTI);
+        return false;
+    }
+
+    /* Page programmed */
+    d->write_range.addr += d->write_range.size;
+    d->write_range.buffer += d->write_range.size;
+    d->write_range.remaining -= d->write_range.size;
+    if (d->write_range.remaining == 0)
+    {
+        d->write_range.state = WRITE_RANGE_IDLE;
+        return true;
+    }
+
+    d->pong = (dma_master_packet_t)
+    {
+        .src = &cmd_wren,
+        .dst = NULL,
+        .num_bytes = CMD_LEN_1BYTE
+    };
+    d->write_range.state = WRITE_RANGE_ENABLE;
+    bus_request(d, BUS_REQ_PACKET);
+    return false;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_init
+ *******************************************************************************
+ *
+ * Summary:
+ *  This function initializes the SPI master based on the configuration done in
+ *  design.modus file and calls initialize for DMA. All devices start with the
+ *  geometry of the EEPROM_* macros; spi_eeprom_probe finds theirs once the
+ *  interrupts are enabled.
+ *
+ * Parameters:
+ *  None
+ *
+ * Return:
+ *  (eeprom_dma_status_t) Returns INIT_SUCCESS if the initialization is successful.
+ *  Otherwise it returns INIT_FAILURE
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_init(void)
+{
+    cy_rslt_t result = Cy_SCB_SPI_Init(FLASH_SPI_HW, &FLASH_SPI_config, &flash_spi_context);
+    if (result != CY_SCB_SPI_SUCCESS)
+    {
+        return INIT_FAILURE;
+    }
+
+    /* Enable the SPI Master block */
+    Cy_SCB_SPI_Enable(FLASH_SPI_HW);
+    Cy_SCB_SPI_SetActiveSlaveSelect(FLASH_SPI_HW, CY_SCB_SPI_SLAVE_SELECT0);
+
+    /* Start with the data rate of design.modus for all traffic */
+    clk_div_active = Cy_SysClk_PeriphGetDivider(CYBSP_CLK_SPI_HW, CYBSP_CLK_SPI_NUM) + 1u;
+    clk_div_cmd = clk_div_active;
+    clk_div_read = clk_div_active;
+
+    result = dma_init((void *) &(FLASH_SPI_HW->TX_FIFO_WR), (void *) &(FLASH_SPI_HW->RX_FIFO_RD),
+            &dma_completion_cb);
+    if (result != INIT_SUCCESS)
+    {
+        return INIT_FAILURE;
+    }
+
+    /* Timer pacing the WIP polls and slave select changes */
+    result = timer_init();
+    if (result != INIT_SUCCESS)
+    {
+        return INIT_FAILURE;
+    }
+
+    /* Time base of the latency trace, if enabled */
+    result = spi_eeprom_trace_init();
+    if (result != INIT_SUCCESS)
+    {
+        return INIT_FAILURE;
+    }
+    memset(&bus, 0, sizeof(bus));
+    bus.ss = CY_SCB_SPI_SLAVE_SELECT0;
+    for (uint32_t i = 0; i < SPI_EEPROM_DEVICES; i++)
+    {
+        eeprom_dev_t *d = &devices[i];
+
+        memset(d, 0, sizeof(*d));
+        d->index = i;
+        d->ss = (cy_en_scb_spi_slave_select_t) (CY_SCB_SPI_SLAVE_SELECT0 + i);
+        d->divider = clk_div_cmd;
+        d->wip_poll.op = WIP_OP_NONE;
+        d->geo = geometry_default;
+        memcpy(d->wip_estimate_us, d->geo.t_typ_us, sizeof(d->wip_estimate_us));
+    }
+    selected = &devices[0];
+    queue_init();
+    spi_eeprom_cache_clear();
+    return INIT_SUCCESS;
+}
+
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_probe
+ *******************************************************************************
+ *
+ * Summary:
+ *  Find the geometry of device: read its RDID and its SFDP basic flash
+ *  parameter table (JESD216), which gives density, program page size, the
+ *  erase opcodes of the 4 KB / 32 KB / 64 KB units, the address width and,
+ *  from JESD216A on, the typical times and their maximum multipliers and
+ *  the program/erase suspend opcodes and latency. A part
+ *  without SFDP is looked up by RDID in a table of known parts; an unknown
+ *  one keeps the EEPROM_* macros. A part above 16 MB that supports 3- and
+ *  4-byte addresses is switched to 4-byte addresses with EN4B, preceded by
+ *  WREN if its BFPT DWORD16 asks so; without a method the driver can use it
+ *  stays at 3-byte addresses and is used up to 16 MB.
+ *
+ *  Blocks until done; call with interrupts enabled and no operation pending
+ *  on any device. For that reason spi_eeprom_init, which runs before the
+ *  interrupts are enabled, does not probe; until probed a device has the
+ *  geometry of the EEPROM_* macros. The WIP poll estimates of the device
+ *  restart from the typical times found.
+ *
+ * Parameters:
+ *  device Device, below SPI_EEPROM_DEVICES.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) INIT_SUCCESS, STATE_INVALID_ARGUMENT for an unknown
+ *  device, STATE_NOT_FOUND if the device answers neither RDID nor SFDP,
+ *  STATE_TRANSFER_ERROR if a transfer failed and STATE_BUSY if the device
+ *  has an operation in progress or queued.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_probe(uint32_t device)
+{
+    eeprom_dev_t *d;
+    spi_eeprom_geometry_t geo = geometry_default;
+    uint8_t header[SFDP_HEADER_SIZE];
+    uint8_t table[4u * SFDP_BFPT_DWORDS];
+    uint32_t bfpt[SFDP_BFPT_DWORDS];
+    uint32_t dwords;
+    uint32_t addr;
+    uint32_t en4b = 0;
+
+    if (device >= SPI_EEPROM_DEVICES)
+    {
+        return STATE_INVALID_ARGUMENT;
+    }
+    d = &devices[device];
+    if (device_busy(d))
+    {
+        return STATE_BUSY;
+    }
+    d->geo = geometry_default;
+
+    d->cmd_pkt[0] = FLASH_RDID;
+    if (!spi_eeprom_wait(read_write_array(d, NULL, geo.jedec_id, sizeof(geo.jedec_id),
+            d->cmd_pkt, CMD_LEN_1BYTE, NULL, NULL)))
+    {
+        return STATE_TRANSFER_ERROR;
+    }
+    for (uint32_t i = 0; i < (sizeof(rdid_parts) / sizeof(rdid_parts[0])); i++)
+    {
+        const rdid_part_t *part = &rdid_parts[i];
+
+        if (memcmp(part->jedec_id, geo.jedec_id, sizeof(geo.jedec_id)) == 0)
+        {
+            geo.source = SPI_EEPROM_GEOMETRY_RDID;
+            geo.size = part->size;
+            geo.page_size = part->page_size;
+            memcpy(geo.t_typ_us, part->t_typ_us, sizeof(geo.t_typ_us));
+            memcpy(geo.t_max_us, part->t_max_us, sizeof(geo.t_max_us));
+            break;
+        }
+    }
+
+    /* SFDP header; READ_SFDP always takes 3 address bytes and a dummy byte */
+    memset(d->cmd_pkt, 0, CMD_LEN_1BYTE + EEPROM_ADDRESS_TYPE_24 + FAST_READ_DUMMY_LEN);
+    d->cmd_pkt[0] = FLASH_READ_SFDP;
+    if (!spi_eeprom_wait(read_write_array(d, NULL, header, sizeof(header), d->cmd_pkt,
+            CMD_LEN_1BYTE + EEPROM_ADDRESS_TYPE_24 + FAST_READ_DUMMY_LEN, NULL, NULL)))
+    {
+        return STATE_TRANSFER_ERROR;
+    }
+    /* The first parameter header must be the one of the BFPT */
+    dwords = header[11];
+    if ((sfdp_dword(&header[0]) == SFDP_SIGNATURE) && (header[8] == 0x00u) &&
+        (header[15] == 0xFFu) && (dwords >= SFDP_BFPT_MIN_DWORDS))
+    {
+        dwords = (dwords > SFDP_BFPT_DWORDS) ? SFDP_BFPT_DWORDS : dwords;
+        addr = header[12] | ((uint32_t) header[13] << 8) | ((uint32_t) header[14] << 16);
+        d->cmd_pkt[1] = (uint8_t) (addr >> 16);
+        d->cmd_pkt[2] = (uint8_t) (addr >> 8);
+        d->cmd_pkt[3] = (uint8_t) addr;
+        if (!spi_eeprom_wait(read_write_array(d, NULL, table, (uint16_t) (4u * dwords), d->cmd_pkt,
+                CMD_LEN_1BYTE + EEPROM_ADDRESS_TYPE_24 + FAST_READ_DUMMY_LEN, NULL, NULL)))
+        {
+            return STATE_TRANSFER_ERROR;
+        }
+        for (uint32_t i = 0; i < dwords; i++)
+        {
+            bfpt[i] = sfdp_dword(&table[4u * i]);
+        }
+        sfdp_parse(&geo, bfpt, dwords);
+        /* Parts with 4-byte addresses only need no EN4B; the others enter
+         * 4-byte addressing as DWORD16 tells, or are used up to 16 MB with
+         * 3-byte addresses when it names no method of ours */
+        if ((geo.addr_bytes == EEPROM_ADDRESS_TYPE_32) && (((bfpt[0] >> 17) & 0x3u) == SFDP_ADDR_3_OR_4))
+        {
+            en4b = (dwords >= 16u) ? (bfpt[15] >> 24) : 0u;
+            if ((en4b & (SFDP_EN4B_B7 | SFDP_EN4B_WREN_B7 | SFDP_EN4B_ALWAYS)) == 0u)
+            {
+                geo.addr_bytes = EEPROM_ADDRESS_TYPE_24;
+                geo.size = ADDR_3BYTE_LIMIT;
+            }
+        }
+    }
+    else if (((geo.jedec_id[0] == 0xFFu) && (geo.jedec_id[1] == 0xFFu) && (geo.jedec_id[2] == 0xFFu)) ||
+             ((geo.jedec_id[0] == 0x00u) && (geo.jedec_id[1] == 0x00u) && (geo.jedec_id[2] == 0x00u)))
+    {
+        /* Nothing drives MISO */
+        return STATE_NOT_FOUND;
+    }
+
+    if (((en4b & (SFDP_EN4B_B7 | SFDP_EN4B_ALWAYS)) == 0u) && ((en4b & SFDP_EN4B_WREN_B7) != 0u))
+    {
+        d->cmd_pkt[0] = FLASH_WRITE_ENABLE;
+        if (!spi_eeprom_wait(read_write_array(d, NULL, NULL, 0, d->cmd_pkt, CMD_LEN_1BYTE, NULL, NULL)))
+        {
+            return STATE_TRANSFER_ERROR;
+        }
+    }
+    if (((en4b & SFDP_EN4B_ALWAYS) == 0u) && ((en4b & (SFDP_EN4B_B7 | SFDP_EN4B_WREN_B7)) != 0u))
+    {
+        d->cmd_pkt[0] = FLASH_ENTER_4BYTE;
+        if (!spi_eeprom_wait(read_write_array(d, NULL, NULL, 0, d->cmd_pkt, CMD_LEN_1BYTE, NULL, NULL)))
+        {
+            return STATE_TRANSFER_ERROR;
+        }
+    }
+
+    d->geo = geo;
+    memcpy(d->wip_estimate_us, d->geo.t_typ_us, sizeof(d->wip_estimate_us));
+    return INIT_SUCCESS;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_get_geometry
+ *******************************************************************************
+ *
+ * Summary:
+ *  Geometry of device as found by spi_eeprom_probe; the EEPROM_* macros
+ *  before.
+ *
+ * Parameters:
+ *  device Device, below SPI_EEPROM_DEVICES.
+ *
+ * Return:
+ *  (const spi_eeprom_geometry_t *) The geometry, NULL for an unknown device.
+ *
+ ******************************************************************************/
+const spi_eeprom_geometry_t *spi_eeprom_get_geometry(uint32_t device)
+{
+    if (device >= SPI_EEPROM_DEVICES)
+    {
+        return NULL;
+    }
+    return &devices[device].geo;
+}
+
+/*******************************************************************************
+ * Function Name: sfdp_dword
+ *******************************************************************************
+ *
+ * Summary:
+ *  Little endian DWORD of an SFDP table.
+ *
+ ******************************************************************************/
+static uint32_t sfdp_dword(const uint8_t *p)
+{
+    return p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+/*******************************************************************************
+ * Function Name: sfdp_time_us
+ *******************************************************************************
+ *
+ * Summary:
+ *  Time of an SFDP time field: a count of count_bits plus one, in the unit
+ *  of units_us selected by the bits above.
+ *
+ ******************************************************************************/
+static uint32_t sfdp_time_us(uint32_t field, uint32_t count_bits, const uint32_t *units_us)
+{
+    return ((field & ((1u << count_bits) - 1u)) + 1u) * units_us[field >> count_bits];
+}
+
+/*******************************************************************************
+ * Function Name: sfdp_max_us
+ *******************************************************************************
+ *
+ * Summary:
+ *  Maximum time from a typical one and the multiplier field N of the BFPT:
+ *  2 * (N + 1) * typical, limited to 32 bit.
+ *
+ ******************************************************************************/
+static uint32_t sfdp_max_us(uint32_t typ_us, uint32_t factor)
+{
+    uint64_t max_us = 2u * ((uint64_t) factor + 1u) * typ_us;
+
+    return (max_us > UINT32_MAX) ? UINT32_MAX : (uint32_t) max_us;
+}
+
+/*******************************************************************************
+ * Function Name: sfdp_parse
+ *******************************************************************************
+ *
+ * Summary:
+ *  Fill geo from the first dwords DWORDs of the BFPT. Times and suspend
+ *  not in the table (JESD216 before revision A) stay as found by RDID.
+ *
+ ******************************************************************************/
+static void sfdp_parse(spi_eeprom_geometry_t *geo, const uint32_t *bfpt, uint32_t dwords)
+{
+    static const uint32_t erase_units_us[] = { 1000u, 16000u, 128000u, 1000000u };
+    static const uint32_t pp_units_us[] = { 8u, 64u };
+    static const uint32_t ce_units_us[] = { 16000u, 256000u, 4000000u, 64000000u };
+    static const uint32_t suspend_units_ns[] = { 128u, 1000u, 8000u, 64000u };
+    uint32_t addr_mode = (bfpt[0] >> 17) & 0x3u;
+    uint32_t erase_times[4] = { 0 };
+    uint32_t factor = 0;
+
+    geo->source = SPI_EEPROM_GEOMETRY_SFDP;
+    geo->fast_read = true;
+
+    /* 2: density in bits, 2^N above 2 Gbit */
+    if ((bfpt[1] & 0x80000000u) == 0u)
+    {
+        geo->size = (bfpt[1] >> 3) + 1u;
+    }
+    else
+    {
+        uint32_t n = bfpt[1] & 0x7FFFFFFFu;
+
+        geo->size = (n >= 34u) ? 0x80000000u : (1u << ((n < 3u) ? 0u : (n - 3u)));
+    }
+
+    if (dwords >= 11u)
+    {
+        /* 10: typical erase times of the four types, 11: page size,
+         * typical page program and chip erase times */
+        for (uint32_t i = 0; i < 4u; i++)
+        {
+            erase_times[i] = sfdp_time_us((bfpt[9] >> (4u + 7u * i)) & 0x7Fu, 5u, erase_units_us);
+        }
+        factor = bfpt[9] & 0xFu;
+        geo->page_size = 1u << ((bfpt[10] >> 4) & 0xFu);
+        geo->t_typ_us[SPI_EEPROM_TIME_PP] = sfdp_time_us((bfpt[10] >> 8) & 0x3Fu, 5u, pp_units_us);
+        geo->t_typ_us[SPI_EEPROM_TIME_CE] = sfdp_time_us((bfpt[10] >> 24) & 0x7Fu, 5u, ce_units_us);
+        geo->t_max_us[SPI_EEPROM_TIME_PP] = sfdp_max_us(geo->t_typ_us[SPI_EEPROM_TIME_PP], bfpt[10] & 0xFu);
+        geo->t_max_us[SPI_EEPROM_TIME_CE] = sfdp_max_us(geo->t_typ_us[SPI_EEPROM_TIME_CE], bfpt[10] & 0xFu);
+    }
+    if (dwords >= 13u)
+    {
+        /* 12: suspend latency and resume to suspend interval of erase and
+         * program, the longer ones apply to both; bit 31 set without
+         * suspend. 13: erase suspend and resume opcodes, the program ones
+         * are the same on the parts known */
+        if ((bfpt[11] & 0x80000000u) != 0u)
+        {
+            geo->suspend_cmd = 0;
+            geo->resume_cmd = 0;
+        }
+        else
+        {
+            uint32_t erase_ns = sfdp_time_us((bfpt[11] >> 24) & 0x7Fu, 5u, suspend_units_ns);
+            uint32_t program_ns = sfdp_time_us((bfpt[11] >> 13) & 0x7Fu, 5u, suspend_units_ns);
+            uint32_t erase_rs = (((bfpt[11] >> 20) & 0xFu) + 1u) * 64u;
+            uint32_t program_rs = (((bfpt[11] >> 9) & 0xFu) + 1u) * 64u;
+
+            geo->t_suspend_us = (((erase_ns > program_ns) ? erase_ns : program_ns) + 999u) / 1000u;
+            geo->t_resume_us = (erase_rs > program_rs) ? erase_rs : program_rs;
+            geo->suspend_cmd = (uint8_t) (bfpt[12] >> 24);
+            geo->resume_cmd = (uint8_t) (bfpt[12] >> 16);
+        }
+    }
+
+    /* 8, 9: erase types as size exponent and opcode */
+    geo->erase_4k_cmd = 0;
+    geo->erase_32k_cmd = 0;
+    geo->erase_64k_cmd = 0;
+    for (uint32_t i = 0; i < 4u; i++)
+    {
+        uint32_t type = (bfpt[7u + i / 2u] >> (16u * (i % 2u))) & 0xFFFFu;
+        uint8_t cmd = (uint8_t) (type >> 8);
+        spi_eeprom_time_t t;
+
+        switch (type & 0xFFu)
+        {
+            case 12u:
+                geo->erase_4k_cmd = cmd;
+                t = SPI_EEPROM_TIME_SE;
+                break;
+            case 15u:
+                geo->erase_32k_cmd = cmd;
+                t = SPI_EEPROM_TIME_BE32;
+                break;
+            case 16u:
+                geo->erase_64k_cmd = cmd;
+                t = SPI_EEPROM_TIME_BE64;
+                break;
+            default:
+                continue;
+        }
+        if (erase_times[i] != 0u)
+        {
+            geo->t_typ_us[t] = erase_times[i];
+            geo->t_max_us[t] = sfdp_max_us(erase_times[i], factor);
+        }
+    }
+
+    /* 1: address bytes; beyond 16 MB a 3-byte only part is used up to there */
+    if ((addr_mode == SFDP_ADDR_4_ONLY) ||
+        ((addr_mode == SFDP_ADDR_3_OR_4) && (geo->size > ADDR_3BYTE_LIMIT)))
+    {
+        geo->addr_bytes = EEPROM_ADDRESS_TYPE_32;
+    }
+    else
+    {
+        geo->addr_bytes = EEPROM_ADDRESS_TYPE_24;
+        if (geo->size > ADDR_3BYTE_LIMIT)
+        {
+            geo->size = ADDR_3BYTE_LIMIT;
+        }
+    }
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_rdid_reg
+ *******************************************************************************
+ *
+ * Summary:
+ *  Read SPI EEPROM RDID register.
+ *
+ * Parameters:
+ *  data Pointer to EEPROM RDID register value.
+ *  data_len Number of bytes to be read from teh register.
+ *  cb Called as part of the DMA interrupt when the operation has completed,
+ *     may be NULL.
+ *  ctx User context passed to cb.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) The status of the transfer-ignition.
+ *  Returns STATE_BUSY while the device has an operation in progress or queued.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_rdid_reg(uint8_t *data, uint8_t data_len, spi_eeprom_callback_t cb, void *ctx)
+{   
+    eeprom_dev_t *d = selected;
+
+    if (device_busy(d))
+    {
+        return STATE_BUSY;
+    }
+
+    /* Create RDID command packet. */
+    d->cmd_pkt[0] = FLASH_RDID;
+
+    return read_write_array(d, NULL, data, data_len, d->cmd_pkt, CMD_LEN_1BYTE, cb, ctx);
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_read_status_reg
+ *******************************************************************************
+ *
+ * Summary:
+ *  Read SPI EEPROM status register.
+ *
+ * Parameters:
+ *  status Variable to hold EEPROM status register value.
+ *  cb Called as part of the DMA interrupt when the operation has completed,
+ *     may be NULL.
+ *  ctx User context passed to cb.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) The status of the transfer-ignition.
+ *  Returns STATE_BUSY while the device has an operation in progress or queued.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_read_status_reg(uint8_t *status, spi_eeprom_callback_t cb, void *ctx)
+{
+    eeprom_dev_t *d = selected;
+
+    if (device_busy(d))
+    {
+        return STATE_BUSY;
+    }
+
+    /* Create READ_STATUS command packet. */
+    d->cmd_pkt[0] = FLASH_READ_STATUS;
+
+    return read_write_array(d, NULL, status, RD_STATUS_DATA_LEN, d->cmd_pkt, CMD_LEN_1BYTE, cb, ctx);
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_read_status_reg
+ *******************************************************************************
+ *
+ * Summary:
+ *  Read SPI EEPROM status register 2.
+ *
+ * Parameters:
+ *  status Variable to hold EEPROM status register 2 value.
+ *  cb Called as part of the DMA interrupt when the operation has completed,
+ *     may be NULL.
+ *  ctx User context passed to cb.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) The status of the transfer-ignition.
+ *  Returns STATE_BUSY while the device has an operation in progress or queued.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_read_status_2_reg(uint8_t *status, spi_eeprom_callback_t cb, void *ctx)
+{
+    eeprom_dev_t *d = selected;
+
+    if (device_busy(d))
+    {
+        return STATE_BUSY;
+    }
+
+    /* Create READ_STATUS command packet. */
+    d->cmd_pkt[0] = FLASH_READ_STATUS_2;
+
+    return read_write_array(d, NULL, status, RD_STATUS_DATA_LEN, d->cmd_pkt, CMD_LEN_1BYTE, cb, ctx);
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_read_status_reg
+ *******************************************************************************
+ *
+ * Summary:
+ *  Read SPI EEPROM configuration register.
+ *
+ * Parameters:
+ *  rd_config Variable to hold EEPROM rd_config register value.
+ *  cb Called as part of the DMA interrupt when the operation has completed,
+ *     may be NULL.
+ *  ctx User context passed to cb.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) The status of the transfer-ignition.
+ *  Returns STATE_BUSY while the device has an operation in progress or queued.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_read_config_reg(uint8_t *rd_config, spi_eeprom_callback_t cb, void *ctx)
+{
+    eeprom_dev_t *d = selected;
+
+    if (device_busy(d))
+    {
+        return STATE_BUSY;
+    }
+
+    /* Create READ_CONFIG command packet. */
+    d->cmd_pkt[0] = FLASH_READ_CONFIG;
+
+    return read_write_array(d, NULL, rd_config, RD_STATUS_DATA_LEN, d->cmd_pkt, CMD_LEN_1BYTE, cb, ctx);
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_write_status_reg
+ *******************************************************************************
+ *
+ * Summary:
+ *  Write SPI EEPROM status/configuration register.
+ *  Status/Configuration register is written to set/clear HPM in the EEPROM.
+ *
+ * Parameters:
+ *  srwd_block_write_prot_en This parameter indicates if SRWD needs to
+ *                           be set and all blocks needs to be
+ *                           protected in the SPI Flash. This will
+ *                           prepare the SPI Flash for Hardware
+ *                           Protection Mode.
+ *  cb Called as part of the DMA interrupt when the operation has completed,
+ *     may be NULL.
+ *  ctx User context passed to cb.
+ *
+ * Notes:
+ *  1. EEPROM write protect GPIO is not handled in this function.
+ *  2. The value of status register is different for different flashes.
+ *    So this API needs to be changed accordingly to suite the EEPROM requirements.
+ * 
+ * Return:
+ *  (eeprom_dma_status_t) The status of the transfer-ignition.
+ *  Returns STATE_BUSY while the device has an operation in progress or queued.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_write_status_reg(bool srwd_block_write_prot_en, spi_eeprom_callback_t cb, void *ctx)
+{
+    eeprom_dev_t *d = selected;
+
+    if (device_busy(d))
+    {
+        return STATE_BUSY;
+    }
+
+    /* Create WRSR (Write Status Register) command packet. */
+    d->cmd_pkt[0] = FLASH_WRITE_STATUS_CFG;
+    d->cmd_pkt[1] = 0;
+
+    if(srwd_block_write_prot_en)
+    {
+        /* When write protect to be enabled perform the following in
+         * the Status Register
+         *
+         * SRWD[7] = 1
+         * BP[3:0]: bit[5:2] = b1111
+         */
+        d->cmd_pkt[1] |= (SPI_EEPROM_STAT_REG_WR_DISABLE |
+                SPI_EEPROM_PROT_ALL_BLOCKS);
+    }
+
+    return read_write_array(d, NULL, NULL, 0, d->cmd_pkt, WR_STATUS_DATA_LEN, cb, ctx);
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_write_enable
+ *******************************************************************************
+ *
+ * Summary:
+ *  Enable/disable write access to EEPROM. This is software based write enable.
+ *  When called with enable param as "true", it sets the Write Enable Latch (WEL)
+ *  bit of the EEPROM Status Register. It must be so called to enable write, program and
+ *  erase commands.
+ *  When called with enable param as "false", it clears the Write Enable Latch (WEL)
+ *  bit of the EEPROM Status Register.
+ *
+ *  Note: WEL bit is cleared automatcially after successful erase or write or program operation.
+ *
+ * Parameters:
+ *  (bool) enable Indicates write enable/disable.
+ *  cb Called as part of the DMA interrupt when the operation has completed,
+ *     may be NULL.
+ *  ctx User context passed to cb.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) The status of the transfer-ignition.
+ *  Returns STATE_BUSY while the device has an operation in progress or queued.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_write_enable(bool enable, spi_eeprom_callback_t cb, void *ctx)
+{
+    eeprom_dev_t *d = selected;
+
+    if (device_busy(d))
+    {
+        return STATE_BUSY;
+    }
+
+    if (enable)
+    {
+        /* Create WRITE_ENABLE command packet. */
+        d->cmd_pkt[0] = FLASH_WRITE_ENABLE;
+    }
+    else
+    {
+        /* Create WRITE_DISABLE command packet. */
+        d->cmd_pkt[0] = FLASH_WRITE_DISABLE;
+    }
+
+    return read_write_array(d, NULL, NULL, 0, d->cmd_pkt, CMD_LEN_1BYTE, cb, ctx);
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_read_flash
+ *******************************************************************************
+ *
+ * Summary:
+ *  Read data from SPI EEPROM. With SPI_EEPROM_CACHE_PAGES > 0 the page is
+ *  served from the RAM cache if it holds it; cb is then called before the
+ *  function returns. On a miss the whole page is read into the cache.
+ *
+ * Parameters:
+ *  buffer Buffer to store data.
+ *  size Size of data to be read.
+ *  page_addr Page address from where data is to be read.
+ *  cb Called as part of the DMA interrupt when the operation has completed,
+ *     may be NULL.
+ *  ctx User context passed to cb.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) The status of the transfer-ignition.
+ *  Returns STATE_BUSY while the device has an operation in progress or queued.
+ * 
+ * Note: This function will not read across page boundary. Thus, user must issue
+ *       multiple read commands in junks of EEPROM_PAGE_SIZE data, or use
+ *       spi_eeprom_read_range.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_read_flash(uint8_t *buffer, uint16_t size, uint32_t page_addr, spi_eeprom_callback_t cb, void *ctx)
+{
+    eeprom_dev_t *d = selected;
+
+    if (device_busy(d))
+    {
+        return STATE_BUSY;
+    }
+
+    if(page_addr >= (d->geo.size / EEPROM_PAGE_SIZE))
+    {
+        return STATE_INVALID_PAGE;
+    }
+
+    /* Create READ_DATA or FAST_READ command packet. */
+    uint32_t addr = page_addr * EEPROM_PAGE_SIZE;
+    uint8_t cmd_size = populate_read_command(d, d->cmd_pkt, addr);
+    uint8_t *cached;
+    
+    if (size > EEPROM_PAGE_SIZE)
+    {
+        size = EEPROM_PAGE_SIZE;
+    }
+    if (d->index != SPI_EEPROM_CACHE_DEVICE)
+    {
+        return read_write_array(d, NULL, buffer, size, d->cmd_pkt, cmd_size, cb, ctx);
+    }
+
+    cached = spi_eeprom_cache_lookup(page_addr);
+    if (cached != NULL)
+    {
+        memcpy(buffer, cached, size);
+        if (cb != NULL)
+        {
+            cb(INIT_SUCCESS, CY_RSLT_SUCCESS, ctx);
+        }
+        return STATE_UNCONFIRMED_SUCCESS;
+    }
+
+    cached = spi_eeprom_cache_fill_begin(page_addr);
+    if (cached != NULL)
+    {
+        cache_fill.page_addr = page_addr;
+        cache_fill.slot = cached;
+        cache_fill.buffer = buffer;
+        cache_fill.size = size;
+        cache_fill.cb = cb;
+        cache_fill.ctx = ctx;
+        return read_write_array(d, NULL, cached, EEPROM_PAGE_SIZE, d->cmd_pkt, cmd_size,
+                cache_fill_done, NULL);
+    }
+    
+    return read_write_array(d, NULL, buffer, size, d->cmd_pkt, cmd_size, cb, ctx);
+}
+
+/*******************************************************************************
+ * Function Name: cache_fill_done
+ *******************************************************************************
+ *
+ * Summary:
+ *  Completion of a page read into the cache: mark the slot valid, copy the
+ *  requested bytes to the caller's buffer and call its callback.
+ *
+ ******************************************************************************/
+static void cache_fill_done(eeprom_dma_status_t status, cy_rslt_t error, void *ctx)
+{
+    (void) ctx;
+
+    spi_eeprom_cache_fill_end(cache_fill.page_addr, status == INIT_SUCCESS);
+    if (status == INIT_SUCCESS)
+    {
+        memcpy(cache_fill.buffer, cache_fill.slot, cache_fill.size);
+    }
+    if (cache_fill.cb != NULL)
+    {
+        cache_fill.cb(status, error, cache_fill.ctx);
+    }
+}
+
+/*******************************************************************************
+ * Function Name: read_range_next
+ *******************************************************************************
+ *
+ * Summary:
+ *  Stream callback for spi_eeprom_read_range of the bus owner. Returns the
+ *  command header first, then the data in segments of
+ *  SPI_FLASH_READ_SEGMENT_SIZE.
+ *
+ ******************************************************************************/
+static bool read_range_next(dma_master_packet_t *next)
+{
+    eeprom_dev_t *d = bus.owner;
+    uint32_t size;
+
+    if (!d->read_range.header_sent)
+    {
+        d->read_range.header_sent = true;
+        *next = (dma_master_packet_t)
+        {
+            .src = d->read_range.header,
+            .dst = NULL,
+            .num_bytes = d->read_range.header_size
+        };
+        return true;
+    }
+
+    if (d->check.active)
+    {
+        /* Check the segments received so far (packet 0 is the header),
+         * which include the one of check_buf about to be reused */
+        uint32_t received = dma_stream_received();
+
+        while ((d->check.checked + 1u) < received)
+        {
+            check_segment(d);
+        }
+    }
+    if ((d->read_range.remaining == 0) || (d->check.active && d->check.compare && d->check.mismatch))
+    {
+        return false;
+    }
+
+    size = d->read_range.remaining;
+    if (d->check.active)
+    {
+        if (size > SPI_FLASH_CHECK_SEGMENT_SIZE)
+        {
+            size = SPI_FLASH_CHECK_SEGMENT_SIZE;
+        }
+        if (d->check.buffer == NULL)
+        {
+            d->read_range.buffer = check_buf[d->check.fetched % DMA_STREAM_QUEUE_LEN];
+        }
+        d->check.fetched++;
+    }
+    else if (size > SPI_FLASH_READ_SEGMENT_SIZE)
+    {
+        size = SPI_FLASH_READ_SEGMENT_SIZE;
+    }
+    *next = (dma_master_packet_t)
+    {
+        .src = NULL,
+        .dst = d->read_range.buffer,
+        .num_bytes = size
+    };
+    d->read_range.buffer += size;
+    d->read_range.remaining -= size;
+    return true;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_read_range
+ *******************************************************************************
+ *
+ * Summary:
+ *  Read any number of bytes from SPI EEPROM with a single READ command. The
+ *  EEPROM increments the address across page boundaries, so the whole range
+ *  is transferred in one chip select assertion; the data is split into DMA
+ *  segments which the DMA interrupt chains.
+ *
+ * Parameters:
+ *  addr Byte address to start reading from.
+ *  buffer Buffer to store data.
+ *  size Number of bytes to be read.
+ *  cb Called as part of the DMA interrupt when the operation has completed,
+ *     may be NULL.
+ *  ctx User context passed to cb.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) The status of the transfer-ignition.
+ *  Returns STATE_BUSY while the device has an operation in progress or queued.
+ *  Returns STATE_INVALID_ARGUMENT if buffer is NULL or size is 0 and
+ *  STATE_INVALID_PAGE if the range exceeds the EEPROM.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_read_range(uint32_t addr, uint8_t *buffer, uint32_t size, spi_eeprom_callback_t cb, void *ctx)
+{
+    eeprom_dev_t *d = selected;
+    const uint32_t eeprom_size = d->geo.size;
+
+    if (device_busy(d))
+    {
+        return STATE_BUSY;
+    }
+
+    if ((buffer == NULL) || (size == 0))
+    {
+        return STATE_INVALID_ARGUMENT;
+    }
+    if ((addr >= eeprom_size) || (size > (eeprom_size - addr)))
+    {
+        return STATE_INVALID_PAGE;
+    }
+
+    request_begin(d, cb, ctx);
+    read_range_start(d, d->cmd_pkt, addr, buffer, size);
+    return STATE_UNCONFIRMED_SUCCESS;
+}
+
+/*******************************************************************************
+ * Function Name: read_range_start
+ *******************************************************************************
+ *
+ * Summary:
+ *  Start a sequential read with the READ_DATA or FAST_READ command built in
+ *  header.
+ *
+ ******************************************************************************/
+static void read_range_start(eeprom_dev_t *d, uint8_t *header, uint32_t addr, uint8_t *buffer, uint32_t size)
+{
+    d->check.active = false;
+    read_stream_start(d, header, addr, buffer, size);
+}
+
+/*******************************************************************************
+ * Function Name: read_stream_start
+ *******************************************************************************
+ *
+ * Summary:
+ *  Start the DMA stream of a sequential read, compare or CRC.
+ *
+ ******************************************************************************/
+static void read_stream_start(eeprom_dev_t *d, uint8_t *header, uint32_t addr, uint8_t *buffer, uint32_t size)
+{
+    d->read_range.header = header;
+    d->read_range.header_size = populate_read_command(d, header, addr);
+    d->read_range.header_sent = false;
+    d->read_range.buffer = buffer;
+    d->read_range.remaining = size;
+    SPI_EEPROM_TRACE_COMMAND(d->index, header[0]);
+
+    d->divider = clk_div_read;
+    bus_request(d, BUS_REQ_STREAM);
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_compare_range
+ *******************************************************************************
+ *
+ * Summary:
+ *  Compare a range of the EEPROM with data, or check that it is blank (all
+ *  0xFF). The range is read with a single READ command as by
+ *  spi_eeprom_read_range, but into a few segments of a small internal
+ *  buffer that are compared as they arrive from the RX DMA, so no buffer of
+ *  the size of the range is needed. The read stops early at the first
+ *  segment that differs.
+ *
+ * Parameters:
+ *  addr Byte address to start comparing at.
+ *  data Data to compare with, NULL for a blank check.
+ *  size Number of bytes to be compared.
+ *  cb Called as part of the DMA interrupt when the operation has completed,
+ *     may be NULL. Its status is INIT_SUCCESS if the range matches and
+ *     STATE_COMPARE_MISMATCH if it differs.
+ *  ctx User context passed to cb.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) The status of the transfer-ignition.
+ *  Returns STATE_BUSY while the device has an operation in progress or queued.
+ *  Returns STATE_INVALID_ARGUMENT if size is 0 and STATE_INVALID_PAGE if the
+ *  range exceeds the EEPROM.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_compare_range(uint32_t addr, const uint8_t *data, uint32_t size,
+        spi_eeprom_callback_t cb, void *ctx)
+{
+    eeprom_dev_t *d = selected;
+    const uint32_t eeprom_size = d->geo.size;
+
+    if (device_busy(d))
+    {
+        return STATE_BUSY;
+    }
+
+    if (size == 0)
+    {
+        return STATE_INVALID_ARGUMENT;
+    }
+    if ((addr >= eeprom_size) || (size > (eeprom_size - addr)))
+    {
+        return STATE_INVALID_PAGE;
+    }
+
+    request_begin(d, cb, ctx);
+    compare_range_start(d, d->cmd_pkt, addr, data, size);
+    return STATE_UNCONFIRMED_SUCCESS;
+}
+
+/*******************************************************************************
+ * Function Name: compare_range_start
+ *******************************************************************************
+ *
+ * Summary:
+ *  Start a sequential read into the check segments, compared as received.
+ *
+ ******************************************************************************/
+static void compare_range_start(eeprom_dev_t *d, uint8_t *header, uint32_t addr, const uint8_t *expect,
+        uint32_t size)
+{
+    d->check.active = true;
+    d->check.compare = true;
+    d->check.mismatch = false;
+    d->check.crc_on = false;
+    d->check.expect = expect;
+    d->check.buffer = NULL;
+    d->check.size = size;
+    d->check.fetched = 0;
+    d->check.checked = 0;
+    read_stream_start(d, header, addr, NULL, size);
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_crc_range
+ *******************************************************************************
+ *
+ * Summary:
+ *  Read a range of the EEPROM as spi_eeprom_read_range and compute its
+ *  CRC-32 on the way: each segment of SPI_FLASH_CHECK_SEGMENT_SIZE bytes is
+ *  added in the DMA interrupt as soon as it is received, while the next
+ *  ones transfer, so the CRC is ready one segment after the data. Without
+ *  buffer the data only passes through a few internal segments, to check
+ *  a range of any size against a stored checksum.
+ *
+ * Parameters:
+ *  addr Byte address to start reading from.
+ *  buffer Buffer to store data, or NULL.
+ *  size Number of bytes.
+ *  cb Called as part of the DMA interrupt when the operation has completed,
+ *     may be NULL. spi_eeprom_get_crc returns the CRC from then on.
+ *  ctx User context passed to cb.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) The status of the transfer-ignition.
+ *  Returns STATE_BUSY while the device has an operation in progress or queued.
+ *  Returns STATE_INVALID_ARGUMENT if size is 0 and STATE_INVALID_PAGE if the
+ *  range exceeds the EEPROM.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_crc_range(uint32_t addr, uint8_t *buffer, uint32_t size,
+        spi_eeprom_callback_t cb, void *ctx)
+{
+    eeprom_dev_t *d = selected;
+    const uint32_t eeprom_size = d->geo.size;
+
+    if (device_busy(d))
+    {
+        return STATE_BUSY;
+    }
+
+    if (size == 0)
+    {
+        return STATE_INVALID_ARGUMENT;
+    }
+    if ((addr >= eeprom_size) || (size > (eeprom_size - addr)))
+    {
+        return STATE_INVALID_PAGE;
+    }
+
+    request_begin(d, cb, ctx);
+    crc_range_start(d, d->cmd_pkt, addr, buffer, size);
+    return STATE_UNCONFIRMED_SUCCESS;
+}
+
+/*******************************************************************************
+ * Function Name: crc_range_start
+ *******************************************************************************
+ *
+ * Summary:
+ *  Start a sequential read into buffer, or the check segments if NULL, with
+ *  the CRC added as received.
+ *
+ ******************************************************************************/
+static void crc_range_start(eeprom_dev_t *d, uint8_t *header, uint32_t addr, uint8_t *buffer, uint32_t size)
+{
+    d->check.active = true;
+    d->check.compare = false;
+    d->check.mismatch = false;
+    d->check.crc_on = true;
+    d->check.crc = 0;
+    d->check.buffer = buffer;
+    d->check.size = size;
+    d->check.fetched = 0;
+    d->check.checked = 0;
+    read_stream_start(d, header, addr, buffer, size);
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_get_crc
+ *******************************************************************************
+ *
+ * Summary:
+ *  CRC-32 of the last spi_eeprom_crc_range (or SPI_EEPROM_OP_CRC) on any
+ *  device, valid from its callback on until the next one completes.
+ *
+ * Parameters:
+ *  None
+ *
+ * Return:
+ *  (uint32_t) CRC-32 as crc32_update computes it.
+ *
+ ******************************************************************************/
+uint32_t spi_eeprom_get_crc(void)
+{
+    return crc_result;
+}
+
+/*******************************************************************************
+ * Function Name: check_segment
+ *******************************************************************************
+ *
+ * Summary:
+ *  Check the oldest segment received and not yet checked.
+ *
+ ******************************************************************************/
+static void check_segment(eeprom_dev_t *d)
+{
+    uint32_t offset = d->check.checked * SPI_FLASH_CHECK_SEGMENT_SIZE;
+    const uint8_t *seg = (d->check.buffer != NULL) ? &d->check.buffer[offset] :
+                         check_buf[d->check.checked % DMA_STREAM_QUEUE_LEN];
+    uint32_t size = d->check.size - offset;
+
+    if (size > SPI_FLASH_CHECK_SEGMENT_SIZE)
+    {
+        size = SPI_FLASH_CHECK_SEGMENT_SIZE;
+    }
+    d->check.checked++;
+    if (d->check.crc_on)
+    {
+        d->check.crc = crc32_update(d->check.crc, seg, size);
+    }
+    if (!d->check.compare || d->check.mismatch)
+    {
+        return;
+    }
+
+    if (d->check.expect == NULL)
+    {
+        for (uint32_t i = 0; i < size; i++)
+        {
+            if (seg[i] != 0xFFu)
+            {
+                d->check.mismatch = true;
+                return;
+            }
+        }
+    }
+    else if (memcmp(seg, &d->check.expect[offset], size) != 0)
+    {
+        d->check.mismatch = true;
+    }
+}
+
+/*******************************************************************************
+ * Function Name: check_finish
+ *******************************************************************************
+ *
+ * Summary:
+ *  Check the segments still outstanding after the read has completed.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) INIT_SUCCESS if the range matches or is not
+ *  compared, STATE_COMPARE_MISMATCH otherwise.
+ *
+ ******************************************************************************/
+static eeprom_dma_status_t check_finish(eeprom_dev_t *d)
+{
+    while (d->check.checked < d->check.fetched)
+    {
+        check_segment(d);
+    }
+    d->check.active = false;
+    if (d->check.crc_on)
+    {
+        crc_result = d->check.crc;
+    }
+    return (d->check.compare && d->check.mismatch) ? STATE_COMPARE_MISMATCH : INIT_SUCCESS;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_write_flash
+ *******************************************************************************
+ *
+ * Summary:
+ *  Write data to SPI EEPROM.
+ *
+ * Parameters:
+ *  buffer Buffer to store data.
+ *  size Size of data to be read.
+ *  page_addr Page address from where data is to be read.
+ *  cb Called as part of the DMA interrupt when the operation has completed,
+ *     may be NULL.
+ *  ctx User context passed to cb.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) The status of the transfer-ignition.
+ *  Returns STATE_BUSY while the device has an operation in progress or queued.
+ * 
+ * Note: This function will not write across page boundary. Thus, user must issue
+ *       multiple read commands in junks of EEPROM_PAGE_SIZE data.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_write_flash(uint8_t *buffer, uint16_t size, uint32_t page_addr, spi_eeprom_callback_t cb, void *ctx)
+{
+    eeprom_dev_t *d = selected;
+
+    if (device_busy(d))
+    {
+        return STATE_BUSY;
+    }
+
+    if(page_addr >= (d->geo.size / EEPROM_PAGE_SIZE))
+    {
+        return STATE_INVALID_PAGE;
+    }
+
+    /* Create WRITE_DATA command packet. */
+    uint32_t addr = page_addr * EEPROM_PAGE_SIZE;
+    uint8_t cmd_size = command_address(d, d->cmd_pkt, FLASH_WRITE_DATA, addr);
+
+    if (size > EEPROM_PAGE_SIZE)
+    {
+        size = EEPROM_PAGE_SIZE;
+    }
+    /* A part with smaller program pages takes up to the end of its page */
+    if (size > (d->geo.page_size - (addr % d->geo.page_size)))
+    {
+        size = d->geo.page_size - (addr % d->geo.page_size);
+    }
+    if (d->index == SPI_EEPROM_CACHE_DEVICE)
+    {
+        d->cache_program.addr = addr;
+        d->cache_program.data = buffer;
+        d->cache_program.size = size;
+    }
+
+    return read_write_array(d, buffer, NULL, size, d->cmd_pkt, cmd_size, cb, ctx);
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_write_range
+ *******************************************************************************
+ *
+ * Summary:
+ *  Write any number of bytes to SPI EEPROM. The data is split at page
+ *  boundaries; for every page WREN, page program and WIP polling run from
+ *  the DMA interrupt without involvement of the caller. cb is called and
+ *  spi_eeprom_done returns true once the last page is programmed. There is no need to call
+ *  spi_eeprom_write_enable before.
+ *
+ * Parameters:
+ *  addr Byte address to start writing to.
+ *  buffer Data to be written. Must stay valid until spi_eeprom_done.
+ *  size Number of bytes to be written.
+ *  cb Called as part of the DMA interrupt when the operation has completed,
+ *     may be NULL.
+ *  ctx User context passed to cb.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) The status of the transfer-ignition.
+ *  Returns STATE_BUSY while the device has an operation in progress or queued.
+ *  Returns STATE_INVALID_ARGUMENT if buffer is NULL or size is 0 and
+ *  STATE_INVALID_PAGE if the range exceeds the EEPROM.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_write_range(uint32_t addr, uint8_t *buffer, uint32_t size, spi_eeprom_callback_t cb, void *ctx)
+{
+    eeprom_dev_t *d = selected;
+    const uint32_t eeprom_size = d->geo.size;
+
+    if (device_busy(d))
+    {
+        return STATE_BUSY;
+    }
+
+    if ((buffer == NULL) || (size == 0))
+    {
+        return STATE_INVALID_ARGUMENT;
+    }
+    if ((addr >= eeprom_size) || (size > (eeprom_size - addr)))
+    {
+        return STATE_INVALID_PAGE;
+    }
+
+    request_begin(d, cb, ctx);
+    write_range_start(d, d->cmd_pkt, addr, buffer, size);
+    return STATE_UNCONFIRMED_SUCCESS;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_write_verify
+ *******************************************************************************
+ *
+ * Summary:
+ *  Write as spi_eeprom_write_range, then read the range back once the last
+ *  page is programmed and compare it with buffer as spi_eeprom_compare_range
+ *  does: in a few internal segments as they arrive, so no buffer for the
+ *  read back is needed. Costs one read of the range.
+ *
+ * Parameters:
+ *  addr Byte address to start writing to.
+ *  buffer Data to be written. Must stay valid until spi_eeprom_done.
+ *  size Number of bytes to be written.
+ *  cb Called as part of the DMA interrupt when the operation has completed,
+ *     may be NULL. Its status is INIT_SUCCESS if the EEPROM holds the data
+ *     and STATE_COMPARE_MISMATCH if it does not, e.g. because the range was
+ *     not erased or is write protected.
+ *  ctx User context passed to cb.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) The status of the transfer-ignition.
+ *  Returns STATE_BUSY while the device has an operation in progress or queued.
+ *  Returns STATE_INVALID_ARGUMENT if buffer is NULL or size is 0 and
+ *  STATE_INVALID_PAGE if the range exceeds the EEPROM.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_write_verify(uint32_t addr, uint8_t *buffer, uint32_t size,
+        spi_eeprom_callback_t cb, void *ctx)
+{
+    eeprom_dev_t *d = selected;
+    const uint32_t eeprom_size = d->geo.size;
+
+    if (device_busy(d))
+    {
+        return STATE_BUSY;
+    }
+
+    if ((buffer == NULL) || (size == 0))
+    {
+        return STATE_INVALID_ARGUMENT;
+    }
+    if ((addr >= eeprom_size) || (size > (eeprom_size - addr)))
+    {
+        return STATE_INVALID_PAGE;
+    }
+
+    request_begin(d, cb, ctx);
+    write_verify_start(d, d->cmd_pkt, addr, buffer, size);
+    return STATE_UNCONFIRMED_SUCCESS;
+}
+
+/*******************************************************************************
+ * Function Name: write_verify_start
+ *******************************************************************************
+ *
+ * Summary:
+ *  Start a write that the DMA interrupt follows with the read back.
+ *
+ ******************************************************************************/
+static void write_verify_start(eeprom_dev_t *d, uint8_t *cmd, uint32_t addr, uint8_t *buffer, uint32_t size)
+{
+    d->verify.state = VERIFY_PROGRAM;
+    d->verify.cmd = cmd;
+    d->verify.addr = addr;
+    d->verify.data = buffer;
+    d->verify.size = size;
+    write_range_start(d, cmd, addr, buffer, size);
+}
+
+/*******************************************************************************
+ * Function Name: write_range_start
+ *******************************************************************************
+ *
+ * Summary:
+ *  Start a multi-page write with the WREN of the first page. The page program
+ *  commands are built in cmd.
+ *
+ ******************************************************************************/
+static void write_range_start(eeprom_dev_t *d, uint8_t *cmd, uint32_t addr, uint8_t *buffer, uint32_t size)
+{
+    d->write_range.cmd = cmd;
+    d->write_range.addr = addr;
+    d->write_range.buffer = buffer;
+    d->write_range.remaining = size;
+    d->write_range.size = 0;
+    d->write_range.state = WRITE_RANGE_ENABLE;
+    if (d->index == SPI_EEPROM_CACHE_DEVICE)
+    {
+        d->cache_program.addr = addr;
+        d->cache_program.data = buffer;
+        d->cache_program.size = size;
+    }
+    SPI_EEPROM_TRACE_COMMAND(d->index, FLASH_WRITE_DATA);
+
+    /* Create WRITE_ENABLE command packet; the DMA interrupt continues */
+    cmd[0] = FLASH_WRITE_ENABLE;
+    d->divider = clk_div_cmd;
+    d->pong = (dma_master_packet_t)
+    {
+        .src = cmd,
+        .dst = NULL,
+        .num_bytes = CMD_LEN_1BYTE
+    };
+    bus_request(d, BUS_REQ_PACKET);
+}
+
+/*******************************************************************************
+ * Function Name: enabled_cmd_start
+ *******************************************************************************
+ *
+ * Summary:
+ *  Send WREN; the DMA interrupt follows with the command in cmd (erase of
+ *  the sector/block containing addr) and polls WIP after it.
+ *
+ ******************************************************************************/
+static void enabled_cmd_start(eeprom_dev_t *d, uint8_t *cmd, uint8_t size, uint32_t addr)
+{
+    static uint8_t cmd_wren = FLASH_WRITE_ENABLE;
+
+    d->enabled_cmd.cmd = cmd;
+    d->enabled_cmd.size = size;
+    cache_invalidate_erase(d, cmd[0], addr);
+    SPI_EEPROM_TRACE_COMMAND(d->index, cmd[0]);
+
+    d->divider = clk_div_cmd;
+    d->pong = (dma_master_packet_t)
+    {
+        .src = &cmd_wren,
+        .dst = NULL,
+        .num_bytes = CMD_LEN_1BYTE
+    };
+    bus_request(d, BUS_REQ_PACKET);
+}
+
+/*******************************************************************************
+ * Function Name: enabled_cmd_send
+ *******************************************************************************
+ *
+ * Summary:
+ *  Executed as part of the DMA interrupt after the WREN of enabled_cmd_start:
+ *  send the command itself.
+ *
+ ******************************************************************************/
+static void enabled_cmd_send(eeprom_dev_t *d)
+{
+    d->pong = (dma_master_packet_t)
+    {
+        .src = d->enabled_cmd.cmd,
+        .dst = NULL,
+        .num_bytes = d->enabled_cmd.size
+    };
+    wip_poll_begin(d, d->enabled_cmd.cmd[0]);
+    d->enabled_cmd.cmd = NULL;
+    bus_request(d, BUS_REQ_PACKET);
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_64k_block_erase
+ *******************************************************************************
+ *
+ * Summary:
+ *  Erase 64 KB block of SPI EEPROM.
+ *
+ * Parameters:
+ *  page_addr Address of the start of the block to be erased.
+ *  cb Called as part of the DMA interrupt when the operation has completed,
+ *     may be NULL.
+ *  ctx User context passed to cb.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) The status of the transfer-ignition.
+ *  Returns STATE_BUSY while the device has an operation in progress or queued.
+ *  Returns STATE_INVALID_COMMAND if the EEPROM has no such erase.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_64k_block_erase(uint32_t page_addr, spi_eeprom_callback_t cb, void *ctx)
+{
+    eeprom_dev_t *d = selected;
+
+    if (device_busy(d))
+    {
+        return STATE_BUSY;
+    }
+
+    if(page_addr >= (d->geo.size / EEPROM_PAGE_SIZE))
+    {
+        return STATE_INVALID_PAGE;
+    }
+
+    if (d->geo.erase_64k_cmd == 0)
+    {
+        return STATE_INVALID_COMMAND;
+    }
+
+    /* Create 64K Block Erase command packet. */
+    uint32_t addr = page_addr * EEPROM_PAGE_SIZE;
+    uint8_t cmd_size = command_address(d, d->cmd_pkt, d->geo.erase_64k_cmd, addr);
+    cache_invalidate_erase(d, d->geo.erase_64k_cmd, addr);
+
+    return read_write_array(d, NULL, NULL, 0, d->cmd_pkt, cmd_size, cb, ctx);
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_32k_block_erase
+ *******************************************************************************
+ *
+ * Summary:
+ *  Erase 32 KB block of SPI EEPROM.
+ *
+ * Parameters:
+ *  page_addr Address of the start of the block to be erased.
+ *  cb Called as part of the DMA interrupt when the operation has completed,
+ *     may be NULL.
+ *  ctx User context passed to cb.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) The status of the transfer-ignition.
+ *  Returns STATE_BUSY while the device has an operation in progress or queued.
+ *  Returns STATE_INVALID_COMMAND if the EEPROM has no such erase.
+ * 
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_32k_block_erase(uint32_t page_addr, spi_eeprom_callback_t cb, void *ctx)
+{
+    eeprom_dev_t *d = selected;
+
+    if (device_busy(d))
+    {
+        return STATE_BUSY;
+    }
+
+    if(page_addr >= (d->geo.size / EEPROM_PAGE_SIZE))
+    {
+        return STATE_INVALID_PAGE;
+    }
+
+    if (d->geo.erase_32k_cmd == 0)
+    {
+        return STATE_INVALID_COMMAND;
+    }
+
+    /* Create 32K Block Erase command packet. */
+    uint32_t addr = page_addr * EEPROM_PAGE_SIZE;
+    uint8_t cmd_size = command_address(d, d->cmd_pkt, d->geo.erase_32k_cmd, addr);
+    cache_invalidate_erase(d, d->geo.erase_32k_cmd, addr);
+
+    return read_write_array(d, NULL, NULL, 0, d->cmd_pkt, cmd_size, cb, ctx);
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_4k_sector_erase
+ *******************************************************************************
+ *
+ * Summary:
+ *  Erase 4 KB sector of SPI EEPROM.
+ *
+ * Parameters:
+ *  page_addr Address of the start of the block to be erased.
+ *  cb Called as part of the DMA interrupt when the operation has completed,
+ *     may be NULL.
+ *  ctx User context passed to cb.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) The status of the transfer-ignition.
+ *  Returns STATE_BUSY while the device has an operation in progress or queued.
+ *  Returns STATE_INVALID_COMMAND if the EEPROM has no such erase.
+ * 
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_4k_sector_erase(uint32_t page_addr, spi_eeprom_callback_t cb, void *ctx)
+{
+    eeprom_dev_t *d = selected;
+
+    if (device_busy(d))
+    {
+        return STATE_BUSY;
+    }
+
+    if(page_addr >= (d->geo.size / EEPROM_PAGE_SIZE))
+    {
+        return STATE_INVALID_PAGE;
+    }
+    
+    if (d->geo.erase_4k_cmd == 0)
+    {
+        return STATE_INVALID_COMMAND;
+    }
+
+    /* Create 4K Block Erase command packet. */
+    uint32_t addr = page_addr * EEPROM_PAGE_SIZE;
+    uint8_t cmd_size = command_address(d, d->cmd_pkt, d->geo.erase_4k_cmd, addr);
+    cache_invalidate_erase(d, d->geo.erase_4k_cmd, addr);
+
+    return read_write_array(d, NULL, NULL, 0, d->cmd_pkt, cmd_size, cb, ctx);
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_chip_erase
+ *******************************************************************************
+ *
+ * Summary:
+ *  Erase entire chip of SPI EEPROM.
+ *
+ * Parameters:
+ *  cb Called as part of the DMA interrupt when the operation has completed,
+ *     may be NULL.
+ *  ctx User context passed to cb.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) The status of the transfer-ignition.
+ *  Returns STATE_BUSY while the device has an operation in progress or queued.
+ * 
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_chip_erase(spi_eeprom_callback_t cb, void *ctx)
+{
+    eeprom_dev_t *d = selected;
+
+    if (device_busy(d))
+    {
+        return STATE_BUSY;
+    }
+
+    /* Create Chip Erase command packet. */
+    d->cmd_pkt[0] = FLASH_CHIP_ERASE;
+    cache_invalidate_erase(d, FLASH_CHIP_ERASE, 0);
+
+    return read_write_array(d, NULL, NULL, 0, d->cmd_pkt, CMD_LEN_1BYTE, cb, ctx);
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_submit
+ *******************************************************************************
+ *
+ * Summary:
+ *  Queue an operation on the device selected by spi_eeprom_set_device, see
+ *  spi_eeprom_submit_to.
+ *
+ * Parameters:
+ *  op Operation.
+ *  addr Byte address.
+ *  buffer Data or buffer of the operation.
+ *  size Number of bytes.
+ *  cb Called as part of the DMA interrupt when the operation has completed,
+ *     may be NULL.
+ *  ctx User context passed to cb.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) As spi_eeprom_submit_to.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_submit(spi_eeprom_op_t op, uint32_t addr, uint8_t *buffer, uint32_t size,
+        spi_eeprom_callback_t cb, void *ctx)
+{
+    return spi_eeprom_submit_to(selected->index, op, addr, buffer, size, cb, ctx);
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_submit_to
+ *******************************************************************************
+ *
+ * Summary:
+ *  Queue an operation on a device. Up to SPI_EEPROM_QUEUE_LEN operations are
+ *  held for all devices together, each with its own command buffer; those
+ *  of one device run in the order submitted, each one started by the DMA
+ *  interrupt as soon as the previous one has completed. Operations of
+ *  different devices run side by side: while one device is busy with a
+ *  program or erase, the others use the bus. Writes and erases send WREN
+ *  themselves, so there is no need to call spi_eeprom_write_enable. The
+ *  callback of an operation may submit more. These are background
+ *  operations: the critical ones of spi_eeprom_submit_prio and
+ *  spi_eeprom_read_urgent go ahead of them.
+ *
+ *  While operations are queued for a device, the other spi_eeprom_*
+ *  functions must not be called for it; spi_eeprom_done returns true once
+ *  the queues of all devices are empty, spi_eeprom_device_busy tells about
+ *  one device. After an error the remaining operations of all devices wait
+ *  for spi_state_reset.
+ *
+ * Parameters:
+ *  device Device, below SPI_EEPROM_DEVICES.
+ *  op Operation.
+ *  addr Byte address; for erases any address within the sector/block,
+ *       ignored for SPI_EEPROM_OP_ERASE_CHIP.
+ *  buffer Data to be written or buffer for data read, unused for erases.
+ *         Data to compare with, or NULL for a blank check. Buffer for
+ *         data of a CRC, or NULL.
+ *         Must stay valid until the callback.
+ *  size Number of bytes to be read, written or compared, unused for erases.
+ *  cb Called as part of the DMA interrupt when the operation has completed,
+ *     may be NULL. A compare or verified write completes with
+ *     STATE_COMPARE_MISMATCH if the EEPROM differs; the result of a CRC is
+ *     in spi_eeprom_get_crc.
+ *  ctx User context passed to cb.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) STATE_UNCONFIRMED_SUCCESS if the operation was
+ *  queued, STATE_QUEUE_FULL if all entries are in use, STATE_INVALID_ARGUMENT
+ *  for an unknown device or operation or a read/write without buffer or
+ *  size, STATE_INVALID_COMMAND for an erase unit the EEPROM does not have
+ *  and STATE_INVALID_PAGE if the range exceeds the EEPROM.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_submit_to(uint32_t device, spi_eeprom_op_t op, uint32_t addr,
+        uint8_t *buffer, uint32_t size, spi_eeprom_callback_t cb, void *ctx)
+{
+    return spi_eeprom_submit_prio(device, op, SPI_EEPROM_PRIO_BACKGROUND, 0, addr, buffer, size, cb, ctx);
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_submit_prio
+ *******************************************************************************
+ *
+ * Summary:
+ *  Queue an operation on a device as spi_eeprom_submit_to, in a priority
+ *  class and with a deadline. Critical operations run before background
+ *  ones, earliest deadline first, those without deadline at their
+ *  submission; background operations run in the order submitted.
+ *
+ *  For a critical operation the device does not wait for the background
+ *  one in progress: a write is parked after the page being programmed
+ *  (unless the critical operation is a write too), and a page program or
+ *  sector/block erase the EEPROM can suspend is suspended for a critical
+ *  read, as late as the deadline of the read allows (right away without
+ *  deadline). The read then waits at most for
+ *  the suspend latency of the geometry and the transfer of the current WIP
+ *  poll, plus t_resume_us if the operation was resumed just before.
+ *  Otherwise it starts once the operation in progress has completed. Reads
+ *  of a range being programmed or erased return undefined data.
+ *
+ *  A background operation does not starve: once SPI_EEPROM_STARVATION_LIMIT
+ *  critical operations have started ahead of it, or its deadline has
+ *  passed, it runs next and is no longer set aside until done.
+ *
+ * Parameters:
+ *  device Device, below SPI_EEPROM_DEVICES.
+ *  op Operation.
+ *  prio Priority class.
+ *  deadline_us Microseconds after submission by which the operation is to
+ *       start, up to SPI_EEPROM_DEADLINE_MAX_US; 0 for none.
+ *  addr, buffer, size, cb, ctx As spi_eeprom_submit_to.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) As spi_eeprom_submit_to; STATE_INVALID_ARGUMENT
+ *  also for an unknown priority class or a longer deadline.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_submit_prio(uint32_t device, spi_eeprom_op_t op, spi_eeprom_prio_t prio,
+        uint32_t deadline_us, uint32_t addr, uint8_t *buffer, uint32_t size, spi_eeprom_callback_t cb, void *ctx)
+{
+    uint32_t eeprom_size;
+    eeprom_dev_t *d;
+    queue_entry_t *entry;
+    queue_entry_t **link;
+    uint32_t intr;
+
+    if ((device >= SPI_EEPROM_DEVICES) || (prio >= SPI_EEPROM_PRIOS) || (deadline_us > SPI_EEPROM_DEADLINE_MAX_US))
+    {
+        return STATE_INVALID_ARGUMENT;
+    }
+    d = &devices[device];
+    eeprom_size = d->geo.size;
+
+    switch (op)
+    {
+        case SPI_EEPROM_OP_READ:
+        case SPI_EEPROM_OP_WRITE:
+        case SPI_EEPROM_OP_WRITE_VERIFY:
+            if ((buffer == NULL) || (size == 0))
+            {
+                return STATE_INVALID_ARGUMENT;
+            }
+            break;
+        case SPI_EEPROM_OP_COMPARE:
+        case SPI_EEPROM_OP_CRC:
+            if (size == 0)
+            {
+                return STATE_INVALID_ARGUMENT;
+            }
+            break;
+        case SPI_EEPROM_OP_ERASE_4K:
+        case SPI_EEPROM_OP_ERASE_32K:
+        case SPI_EEPROM_OP_ERASE_64K:
+            if (erase_cmd_of(d, op) == 0)
+            {
+                return STATE_INVALID_COMMAND;
+            }
+            size = 1;
+            break;
+        case SPI_EEPROM_OP_ERASE_CHIP:
+            addr = 0;
+            size = 1;
+            break;
+        default:
+            return STATE_INVALID_ARGUMENT;
+    }
+    if ((addr >= eeprom_size) || (size > (eeprom_size - addr)))
+    {
+        return STATE_INVALID_PAGE;
+    }
+
+    intr = Cy_SysLib_EnterCriticalSection();
+    if (!queue.init)
+    {
+        queue_init();
+    }
+    entry = queue.free;
+    if (entry == NULL)
+    {
+        Cy_SysLib_ExitCriticalSection(intr);
+        return STATE_QUEUE_FULL;
+    }
+    queue.free = entry->next;
+
+    entry->next = NULL;
+    entry->op = op;
+    entry->prio = prio;
+    entry->has_deadline = (deadline_us != 0);
+    entry->deadline = timer_now() + deadline_us;
+    entry->bypassed = 0;
+    entry->device = device;
+    entry->addr = addr;
+    entry->buffer = buffer;
+    entry->size = size;
+    entry->cb = cb;
+    entry->ctx = ctx;
+    SPI_EEPROM_TRACE_STAMP(entry->submitted);
+
+    /* Critical entries after those with the same or an earlier deadline,
+     * background entries at the tail */
+    if (prio == SPI_EEPROM_PRIO_CRITICAL)
+    {
+        link = &d->queue.head;
+        while ((*link != NULL) && ((*link)->prio == SPI_EEPROM_PRIO_CRITICAL) &&
+               ((int32_t) ((*link)->deadline - entry->deadline) <= 0))
+        {
+            link = &(*link)->next;
+        }
+    }
+    else
+    {
+        link = (d->queue.tail != NULL) ? &d->queue.tail->next : &d->queue.head;
+    }
+    entry->next = *link;
+    *link = entry;
+    if (entry->next == NULL)
+    {
+        d->queue.tail = entry;
+    }
+
+    if (!d->request.busy)
+    {
+        queue_dispatch(d);
+    }
+    else if ((d->suspend.state == SUSPEND_NONE) && timer_running(d->index) && suspend_due(d, UINT32_MAX))
+    {
+        /* Only the delay elapsed so far counts to the operation; suspended
+         * now, or polled as planned if the deadline of the read allows */
+        uint32_t remaining = timer_stop(d->index);
+
+        if (suspend_due(d, remaining))
+        {
+            d->wip_poll.elapsed_us -= remaining;
+            suspend_begin(d);
+        }
+        else
+        {
+            timer_start(d->index, remaining, wip_poll_send);
+        }
+    }
+    Cy_SysLib_ExitCriticalSection(intr);
+    return STATE_UNCONFIRMED_SUCCESS;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_read_urgent
+ *******************************************************************************
+ *
+ * Summary:
+ *  Queue a critical read without deadline on a device, see
+ *  spi_eeprom_submit_prio: it goes ahead of all background operations and
+ *  of the critical ones with a later deadline, and a program or erase in
+ *  progress is suspended for it right away.
+ *
+ * Parameters:
+ *  device Device, below SPI_EEPROM_DEVICES.
+ *  addr Byte address.
+ *  buffer Buffer for data read, must stay valid until the callback.
+ *  size Number of bytes to be read.
+ *  cb Called as part of the DMA interrupt when the read has completed,
+ *     may be NULL.
+ *  ctx User context passed to cb.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) As spi_eeprom_submit_to.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_read_urgent(uint32_t device, uint32_t addr, uint8_t *buffer, uint32_t size,
+        spi_eeprom_callback_t cb, void *ctx)
+{
+    return spi_eeprom_submit_prio(device, SPI_EEPROM_OP_READ, SPI_EEPROM_PRIO_CRITICAL, 0, addr, buffer, size,
+            cb, ctx);
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_get_suspend_stats
+ *******************************************************************************
+ *
+ * Summary:
+ *  Critical reads of a device so far, the suspends they took and the
+ *  longest suspend latency, as scheduled by the WIP polls; the writes
+ *  parked for critical operations, the background operations let go first
+ *  as starved and the critical operations started past their deadline.
+ *
+ * Parameters:
+ *  device Device, below SPI_EEPROM_DEVICES.
+ *  stats Filled with the counters, zero for an unknown device.
+ *
+ ******************************************************************************/
+void spi_eeprom_get_suspend_stats(uint32_t device, spi_eeprom_suspend_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    if (device < SPI_EEPROM_DEVICES)
+    {
+        *stats = devices[device].suspend.stats;
+    }
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_queue_count
+ *******************************************************************************
+ *
+ * Summary:
+ *  Number of operations of spi_eeprom_submit not yet completed on all
+ *  devices, including the ones in progress.
+ *
+ * Parameters:
+ *  None
+ *
+ * Return:
+ *  (uint32_t) Number of queue entries in use.
+ *
+ ******************************************************************************/
+uint32_t spi_eeprom_queue_count(void)
+{
+    uint32_t count = SPI_EEPROM_QUEUE_LEN;
+    uint32_t intr = Cy_SysLib_EnterCriticalSection();
+
+    if (!queue.init)
+    {
+        count = 0;
+    }
+    for (queue_entry_t *e = queue.free; (e != NULL) && (count > 0); e = e->next)
+    {
+        count--;
+    }
+    Cy_SysLib_ExitCriticalSection(intr);
+    return count;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_set_device
+ *******************************************************************************
+ *
+ * Summary:
+ *  Select the device the spi_eeprom_* functions address from now on, except
+ *  spi_eeprom_submit_to. Device n is the EEPROM on slave select line n.
+ *  Not to be changed from a callback while the main loop starts operations.
+ *
+ * Parameters:
+ *  device Device, below SPI_EEPROM_DEVICES.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) INIT_SUCCESS, or STATE_INVALID_ARGUMENT for an
+ *  unknown device.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_set_device(uint32_t device)
+{
+    if (device >= SPI_EEPROM_DEVICES)
+    {
+        return STATE_INVALID_ARGUMENT;
+    }
+    selected = &devices[device];
+    return INIT_SUCCESS;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_get_device
+ *******************************************************************************
+ *
+ * Summary:
+ *  Device selected by spi_eeprom_set_device.
+ *
+ * Parameters:
+ *  None
+ *
+ * Return:
+ *  (uint32_t) Device index.
+ *
+ ******************************************************************************/
+uint32_t spi_eeprom_get_device(void)
+{
+    return selected->index;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_device_busy
+ *******************************************************************************
+ *
+ * Summary:
+ *  Whether a device has an operation in progress or queued, for instance to
+ *  wait for one device while the others keep working.
+ *
+ * Parameters:
+ *  device Device, below SPI_EEPROM_DEVICES.
+ *
+ * Return:
+ *  (bool) True if busy, false if idle or unknown.
+ *
+ ******************************************************************************/
+bool spi_eeprom_device_busy(uint32_t device)
+{
+    if (device >= SPI_EEPROM_DEVICES)
+    {
+        return false;
+    }
+    return device_busy(&devices[device]);
+}
+
+/*******************************************************************************
+ * Function Name: device_busy
+ *******************************************************************************
+ *
+ * Summary:
+ *  Whether device d has an operation in progress, set aside or queued. The
+ *  direct functions refuse to start then, as they would take over its
+ *  request and cmd_pkt.
+ *
+ ******************************************************************************/
+static bool device_busy(const eeprom_dev_t *d)
+{
+    return d->request.busy || (d->queue.head != NULL) || (d->suspend.state != SUSPEND_NONE);
+}
+
+/*******************************************************************************
+ * Function Name: queue_init
+ *******************************************************************************
+ *
+ * Summary:
+ *  Put all entries of the pool on the free list.
+ *
+ ******************************************************************************/
+static void queue_init(void)
+{
+    queue.free = NULL;
+    for (uint32_t i = SPI_EEPROM_QUEUE_LEN; i > 0; i--)
+    {
+        queue_pool[i - 1u].next = queue.free;
+        queue.free = &queue_pool[i - 1u];
+    }
+    for (uint32_t i = 0; i < SPI_EEPROM_DEVICES; i++)
+    {
+        devices[i].queue.head = NULL;
+        devices[i].queue.tail = NULL;
+        devices[i].queue.active = NULL;
+    }
+    queue.init = true;
+}
+
+/*******************************************************************************
+ * Function Name: queue_next
+ *******************************************************************************
+ *
+ * Summary:
+ *  Queued operation of device d to start next: the head, unless the oldest
+ *  background operation is starved.
+ *
+ ******************************************************************************/
+static queue_entry_t *queue_next(const eeprom_dev_t *d)
+{
+    queue_entry_t *entry = d->queue.head;
+
+    while ((entry != NULL) && (entry->prio == SPI_EEPROM_PRIO_CRITICAL))
+    {
+        entry = entry->next;
+    }
+    if ((entry != NULL) && entry_starved(entry, entry->bypassed))
+    {
+        return entry;
+    }
+    return d->queue.head;
+}
+
+/*******************************************************************************
+ * Function Name: queue_dispatch
+ *******************************************************************************
+ *
+ * Summary:
+ *  Start the next queued operation of device d, critical ones first.
+ *  Called while the device has no operation in progress: from
+ *  spi_eeprom_submit_to, or from the DMA interrupt when its previous
+ *  operation has completed. While a background operation is set aside
+ *  only critical operations start, and only reads while a program or
+ *  erase is suspended; once none is left, or the operation set aside is
+ *  starved, it is taken up again. Does nothing after a DMA error until
+ *  spi_state_reset.
+ *
+ ******************************************************************************/
+static void queue_dispatch(eeprom_dev_t *d)
+{
+    queue_entry_t *entry;
+    queue_entry_t *prev = NULL;
+    queue_entry_t *background;
+
+    if ((d->queue.active != NULL) || dma_has_error())
+    {
+        return;
+    }
+    entry = queue_next(d);
+    if ((d->suspend.state == SUSPEND_ABANDONED) ||
+        (((d->suspend.state == SUSPEND_ACTIVE) || (d->suspend.state == SUSPEND_PARKED)) &&
+         !preempt_allowed(d, d->suspend.active, d->suspend.state)))
+    {
+        suspend_resume(d);
+        return;
+    }
+    if (entry == NULL)
+    {
+        return;
+    }
+
+    for (queue_entry_t *e = d->queue.head; e != entry; e = e->next)
+    {
+        prev = e;
+    }
+    if (prev == NULL)
+    {
+        d->queue.head = entry->next;
+    }
+    else
+    {
+        prev->next = entry->next;
+    }
+    if (d->queue.tail == entry)
+    {
+        d->queue.tail = prev;
+    }
+
+    if (entry->prio == SPI_EEPROM_PRIO_CRITICAL)
+    {
+        /* Count the bypass to the operation set aside and the oldest
+         * background one queued */
+        if (d->suspend.state != SUSPEND_NONE)
+        {
+            d->suspend.bypassed++;
+        }
+        for (background = d->queue.head; background != NULL; background = background->next)
+        {
+            if (background->prio != SPI_EEPROM_PRIO_CRITICAL)
+            {
+                background->bypassed++;
+                break;
+            }
+        }
+        if (entry->has_deadline && ((int32_t) (timer_now() - entry->deadline) > 0))
+        {
+            d->suspend.stats.late++;
+        }
+    }
+    else
+    {
+        if (prev != NULL)
+        {
+            d->suspend.stats.starved++;
+        }
+        d->suspend.bypassed = entry->bypassed;
+    }
+
+    d->queue.active = entry;
+    request_begin(d, queue_entry_done, entry);
+    SPI_EEPROM_TRACE_SUBMITTED(d->index, entry->submitted);
+    if (entry->prio == SPI_EEPROM_PRIO_CRITICAL)
+    {
+        SPI_EEPROM_TRACE_URGENT(d->index);
+    }
 
-    return spi_master_read_write_array (NULL, status, RD_STATUS_DATA_LEN, cmd_pkt, CMD_LEN_1BYTE);
+    switch (entry->op)
+    {
+        case SPI_EEPROM_OP_READ:
+            read_range_start(d, entry->cmd, entry->addr, entry->buffer, entry->size);
+            break;
+        case SPI_EEPROM_OP_WRITE:
+            write_range_start(d, entry->cmd, entry->addr, entry->buffer, entry->size);
+            break;
+        case SPI_EEPROM_OP_COMPARE:
+            compare_range_start(d, entry->cmd, entry->addr, entry->buffer, entry->size);
+            break;
+        case SPI_EEPROM_OP_CRC:
+            crc_range_start(d, entry->cmd, entry->addr, entry->buffer, entry->size);
+            break;
+        case SPI_EEPROM_OP_WRITE_VERIFY:
+            write_verify_start(d, entry->cmd, entry->addr, entry->buffer, entry->size);
+            break;
+        case SPI_EEPROM_OP_ERASE_4K:
+        case SPI_EEPROM_OP_ERASE_32K:
+        case SPI_EEPROM_OP_ERASE_64K:
+            enabled_cmd_start(d, entry->cmd,
+                    command_address(d, entry->cmd, erase_cmd_of(d, entry->op), entry->addr), entry->addr);
+            break;
+        default:
+            entry->cmd[0] = FLASH_CHIP_ERASE;
+            enabled_cmd_start(d, entry->cmd, CMD_LEN_1BYTE, 0);
+            break;
+    }
 }
 
 /*******************************************************************************
- * Function Name: spi_eeprom_read_status_reg
+ * Function Name: queue_entry_done
  *******************************************************************************
  *
  * Summary:
- *  Read SPI EEPROM status register 2.
- *
- * Parameters:
- *  status Variable to hold EEPROM status register 2 value.
- *
- * Return:
- *  (eeprom_dma_status_t) The status of the transfer-ignition.
+ *  Completion callback of a queued operation: return the entry to the pool,
+ *  then call the callback given to spi_eeprom_submit, which may reuse it.
  *
  ******************************************************************************/
-eeprom_dma_status_t spi_eeprom_read_status_2_reg(uint8_t *status)
+static void queue_entry_done(eeprom_dma_status_t status, cy_rslt_t error, void *ctx)
 {
-    /* Create READ_STATUS command packet. */
-    cmd_pkt[0] = FLASH_READ_STATUS_2;
+    queue_entry_t *entry = (queue_entry_t *) ctx;
+    spi_eeprom_callback_t cb = entry->cb;
+    void *user_ctx = entry->ctx;
+
+    devices[entry->device].queue.active = NULL;
+    if ((entry->prio == SPI_EEPROM_PRIO_CRITICAL) && (entry->op == SPI_EEPROM_OP_READ))
+    {
+        devices[entry->device].suspend.stats.urgent_reads++;
+    }
+    entry->next = queue.free;
+    queue.free = entry;
 
-    return spi_master_read_write_array (NULL, status, RD_STATUS_DATA_LEN, cmd_pkt, CMD_LEN_1BYTE);
+    if (cb != NULL)
+    {
+        cb(status, error, user_ctx);
+    }
 }
 
 /*******************************************************************************
- * Function Name: spi_eeprom_read_status_reg
+ * Function Name: erase_cmd_of
  *******************************************************************************
  *
  * Summary:
- *  Read SPI EEPROM configuration register.
- *
- * Parameters:
- *  rd_config Variable to hold EEPROM rd_config register value.
+ *  Opcode of the sector or block erase op on device d.
  *
  * Return:
- *  (eeprom_dma_status_t) The status of the transfer-ignition.
+ *  (uint8_t) The opcode, 0 if the EEPROM does not have the erase unit.
  *
  ******************************************************************************/
-eeprom_dma_status_t spi_eeprom_read_config_reg(uint8_t *rd_config)
+static uint8_t erase_cmd_of(const eeprom_dev_t *d, spi_eeprom_op_t op)
 {
-    /* Create READ_CONFIG command packet. */
-    cmd_pkt[0] = FLASH_READ_CONFIG;
-
-    return spi_master_read_write_array (NULL, rd_config, RD_STATUS_DATA_LEN, cmd_pkt, CMD_LEN_1BYTE);
+    switch (op)
+    {
+        case SPI_EEPROM_OP_ERASE_4K:
+            return d->geo.erase_4k_cmd;
+        case SPI_EEPROM_OP_ERASE_32K:
+            return d->geo.erase_32k_cmd;
+        case SPI_EEPROM_OP_ERASE_64K:
+            return d->geo.erase_64k_cmd;
+        default:
+            return 0;
+    }
 }
 
 /*******************************************************************************
- * Function Name: spi_eeprom_write_status_reg
+ * Function Name: cache_invalidate_erase
  *******************************************************************************
  *
  * Summary:
- *  Write SPI EEPROM status/configuration register.
- *  Status/Configuration register is written to set/clear HPM in the EEPROM.
- *
- * Parameters:
- *  srwd_block_write_prot_en This parameter indicates if SRWD needs to
- *                           be set and all blocks needs to be
- *                           protected in the SPI Flash. This will
- *                           prepare the SPI Flash for Hardware
- *                           Protection Mode.
- *
- * Notes:
- *  1. EEPROM write protect GPIO is not handled in this function.
- *  2. The value of status register is different for different flashes.
- *    So this API needs to be changed accordingly to suite the EEPROM requirements.
- * 
- * Return:
- *  (eeprom_dma_status_t) The status of the transfer-ignition.
+ *  Drop the cached pages of the sector, block or chip erased by cmd on
+ *  device d.
  *
  ******************************************************************************/
-eeprom_dma_status_t spi_eeprom_write_status_reg(bool srwd_block_write_prot_en)
+static void cache_invalidate_erase(eeprom_dev_t *d, uint8_t cmd, uint32_t addr)
 {
-    /* Create WRSR (Write Status Register) command packet. */
-    cmd_pkt[0] = FLASH_WRITE_STATUS_CFG;
-    cmd_pkt[1] = 0;
+    uint32_t size;
 
-    if(srwd_block_write_prot_en)
+    if (d->index != SPI_EEPROM_CACHE_DEVICE)
     {
-        /* When write protect to be enabled perform the following in
-         * the Status Register
-         *
-         * SRWD[7] = 1
-         * BP[3:0]: bit[5:2] = b1111
-         */
-        cmd_pkt[1] |= (SPI_EEPROM_STAT_REG_WR_DISABLE |
-                SPI_EEPROM_PROT_ALL_BLOCKS);
+        return;
     }
-
-    return spi_master_read_write_array(NULL, NULL, 0, cmd_pkt, WR_STATUS_DATA_LEN);
+    if (cmd == d->geo.erase_4k_cmd)
+    {
+        size = 0x1000u;
+    }
+    else if (cmd == d->geo.erase_32k_cmd)
+    {
+        size = 0x8000u;
+    }
+    else if (cmd == d->geo.erase_64k_cmd)
+    {
+        size = 0x10000u;
+    }
+    else
+    {
+        spi_eeprom_cache_clear();
+        return;
+    }
+    spi_eeprom_cache_invalidate(addr & ~(size - 1u), size);
 }
 
 /*******************************************************************************
- * Function Name: spi_eeprom_write_enable
+ * Function Name: spi_eeprom_set_clock_divider
  *******************************************************************************
  *
  * Summary:
- *  Enable/disable write access to EEPROM. This is software based write enable.
- *  When called with enable param as "true", it sets the Write Enable Latch (WEL)
- *  bit of the EEPROM Status Register. It must be so called to enable write, program and
- *  erase commands.
- *  When called with enable param as "false", it clears the Write Enable Latch (WEL)
- *  bit of the EEPROM Status Register.
+ *  Set the SPI clock dividers used from the next transfer on. Array reads
+ *  (spi_eeprom_read_flash, spi_eeprom_read_range) use read_divider, all other
+ *  commands use cmd_divider, so bulk reads can run at the highest rate the
+ *  EEPROM and board allow while command and status traffic stays at a safe
+ *  rate. Above EEPROM_READ_MAX_FREQ_HZ reads use FAST_READ.
  *
- *  Note: WEL bit is cleared automatcially after successful erase or write or program operation.
+ *  The divider is applied to CLK_PERI; the SPI data rate is
+ *  CLK_PERI / (divider * oversample), see spi_eeprom_get_data_rate.
  *
  * Parameters:
- *  (bool) enable Indicates write enable/disable.
+ *  cmd_divider Divider for command and status traffic, 0 to keep current.
+ *  read_divider Divider for array reads, 0 to keep current.
  *
  * Return:
- *  (eeprom_dma_status_t) The status of the transfer-ignition.
+ *  (eeprom_dma_status_t) INIT_SUCCESS, or STATE_INVALID_ARGUMENT if a divider
+ *  exceeds the 16-bit divider range.
  *
  ******************************************************************************/
-eeprom_dma_status_t spi_eeprom_write_enable(bool enable)
+eeprom_dma_status_t spi_eeprom_set_clock_divider(uint32_t cmd_divider, uint32_t read_divider)
 {
-    if (enable)
+    if ((cmd_divider > (UINT16_MAX + 1u)) || (read_divider > (UINT16_MAX + 1u)))
     {
-        /* Create WRITE_ENABLE command packet. */
-        cmd_pkt[0] = FLASH_WRITE_ENABLE;
+        return STATE_INVALID_ARGUMENT;
     }
-    else
+
+    if (cmd_divider != 0)
     {
-        /* Create WRITE_DISABLE command packet. */
-        cmd_pkt[0] = FLASH_WRITE_DISABLE;
+        clk_div_cmd = cmd_divider;
     }
-
-    return spi_master_read_write_array(NULL, NULL, 0, cmd_pkt, CMD_LEN_1BYTE);
+    if (read_divider != 0)
+    {
+        clk_div_read = read_divider;
+    }
+    return INIT_SUCCESS;
 }
 
 /*******************************************************************************
- * Function Name: spi_eeprom_read_flash
+ * Function Name: spi_eeprom_get_clock_divider
  *******************************************************************************
  *
  * Summary:
- *  Read data from SPI EEPROM.
+ *  Get the SPI clock dividers set by spi_eeprom_set_clock_divider.
  *
  * Parameters:
- *  buffer Buffer to store data.
- *  size Size of data to be read.
- *  page_addr Page address from where data is to be read.
+ *  cmd_divider Divider for command and status traffic, may be NULL.
+ *  read_divider Divider for array reads, may be NULL.
  *
  * Return:
- *  (eeprom_dma_status_t) The status of the transfer-ignition.
- * 
- * Note: This function will not read across page boundary. Thus, user must issue
- *       multiple read commands in junks of EEPROM_PAGE_SIZE data.
+ *  None
  *
  ******************************************************************************/
-eeprom_dma_status_t spi_eeprom_read_flash(uint8_t *buffer, uint16_t size, uint32_t page_addr)
+void spi_eeprom_get_clock_divider(uint32_t *cmd_divider, uint32_t *read_divider)
 {
-    if(page_addr >= EEPROM_NUM_PAGES)
+    if (cmd_divider != NULL)
     {
-        return STATE_INVALID_PAGE;
+        *cmd_divider = clk_div_cmd;
     }
-
-    /* Create READ_DATA command packet. */
-    uint32_t addr = page_addr * EEPROM_PAGE_SIZE;
-    POPULATE_COMMAND_ADDRESS(FLASH_READ_DATA, addr)
-    
-    if (size > EEPROM_PAGE_SIZE)
+    if (read_divider != NULL)
     {
-        size = EEPROM_PAGE_SIZE;
+        *read_divider = clk_div_read;
     }
-    
-    return spi_master_read_write_array (NULL, buffer, size, cmd_pkt, SPI_FLASH_CMD_MAX_SIZE);
 }
 
 /*******************************************************************************
- * Function Name: spi_eeprom_write_flash
+ * Function Name: spi_eeprom_get_data_rate
  *******************************************************************************
  *
  * Summary:
- *  Write data to SPI EEPROM.
+ *  SPI data rate resulting from a clock divider.
  *
  * Parameters:
- *  buffer Buffer to store data.
- *  size Size of data to be read.
- *  page_addr Page address from where data is to be read.
+ *  divider Divider of CLK_PERI.
  *
  * Return:
- *  (eeprom_dma_status_t) The status of the transfer-ignition.
- * 
- * Note: This function will not write across page boundary. Thus, user must issue
- *       multiple read commands in junks of EEPROM_PAGE_SIZE data.
+ *  (uint32_t) Data rate in bits per second, 0 for divider 0.
  *
  ******************************************************************************/
-eeprom_dma_status_t spi_eeprom_write_flash(uint8_t *buffer, uint16_t size, uint32_t page_addr)
+uint32_t spi_eeprom_get_data_rate(uint32_t divider)
 {
-    if(page_addr >= EEPROM_NUM_PAGES)
-    {
-        return STATE_INVALID_PAGE;
-    }
-
-    /* Create WRITE_DATA command packet. */
-    uint32_t addr = page_addr * EEPROM_PAGE_SIZE;
-    POPULATE_COMMAND_ADDRESS(FLASH_WRITE_DATA, addr)
-
-    if (size > EEPROM_PAGE_SIZE)
+    if (divider == 0)
     {
-        size = EEPROM_PAGE_SIZE;
+        return 0;
     }
-
-    return spi_master_read_write_array(buffer, NULL, size, cmd_pkt, SPI_FLASH_CMD_MAX_SIZE);
+    return Cy_SysClk_ClkPeriGetFrequency() / (divider * FLASH_SPI_config.oversample);
 }
 
 /*******************************************************************************
- * Function Name: spi_eeprom_64k_block_erase
+ * Function Name: spi_eeprom_divider_for_rate
  *******************************************************************************
  *
  * Summary:
- *  Erase 64 KB block of SPI EEPROM.
+ *  Smallest clock divider whose data rate does not exceed data_rate.
  *
  * Parameters:
- *  page_addr Address of the start of the block to be erased.
+ *  data_rate Requested data rate in bits per second.
  *
  * Return:
- *  (eeprom_dma_status_t) The status of the transfer-ignition.
+ *  (uint32_t) Divider for spi_eeprom_set_clock_divider, 0 if data_rate is 0.
  *
  ******************************************************************************/
-eeprom_dma_status_t spi_eeprom_64k_block_erase(uint32_t page_addr)
+uint32_t spi_eeprom_divider_for_rate(uint32_t data_rate)
 {
-    if(page_addr >= EEPROM_NUM_PAGES)
+    uint32_t bit_clock = data_rate * FLASH_SPI_config.oversample;
+    uint32_t divider;
+
+    if (data_rate == 0)
     {
-        return STATE_INVALID_PAGE;
+        return 0;
     }
 
-    /* Create 64K Block Erase command packet. */
-    uint32_t addr = page_addr * EEPROM_PAGE_SIZE;
-    POPULATE_COMMAND_ADDRESS(FLASH_64K_BLOCK_ERASE, addr)
-
-    return spi_master_read_write_array(NULL, NULL, 0, cmd_pkt, SPI_FLASH_CMD_MAX_SIZE);
+    divider = (Cy_SysClk_ClkPeriGetFrequency() + bit_clock - 1u) / bit_clock;
+    return (divider == 0) ? 1u : divider;
 }
 
 /*******************************************************************************
- * Function Name: spi_eeprom_32k_block_erase
+ * Function Name: spi_set_clock_divider
  *******************************************************************************
  *
  * Summary:
- *  Erase 32 KB block of SPI EEPROM.
- *
- * Parameters:
- *  page_addr Address of the start of the block to be erased.
+ *  Reprogram the divider of the SCB clock if it differs from the current one.
+ *  Only called while the SPI is idle.
  *
- * Return:
- *  (eeprom_dma_status_t) The status of the transfer-ignition.
- * 
  ******************************************************************************/
-eeprom_dma_status_t spi_eeprom_32k_block_erase(uint32_t page_addr)
+static void spi_set_clock_divider(uint32_t divider)
 {
-    if(page_addr >= EEPROM_NUM_PAGES)
+    if (divider == clk_div_active)
     {
-        return STATE_INVALID_PAGE;
+        return;
     }
 
-    /* Create 32K Block Erase command packet. */
-    uint32_t addr = page_addr * EEPROM_PAGE_SIZE;
-    POPULATE_COMMAND_ADDRESS(FLASH_32K_BLOCK_ERASE, addr)
- 
-    return spi_master_read_write_array(NULL, NULL, 0, cmd_pkt, SPI_FLASH_CMD_MAX_SIZE);
+    Cy_SysClk_PeriphDisableDivider(CYBSP_CLK_SPI_HW, CYBSP_CLK_SPI_NUM);
+    Cy_SysClk_PeriphSetDivider(CYBSP_CLK_SPI_HW, CYBSP_CLK_SPI_NUM, divider - 1u);
+    Cy_SysClk_PeriphEnableDivider(CYBSP_CLK_SPI_HW, CYBSP_CLK_SPI_NUM);
+    clk_div_active = divider;
 }
 
 /*******************************************************************************
- * Function Name: spi_eeprom_4k_sector_erase
+ * Function Name: populate_read_command
  *******************************************************************************
  *
  * Summary:
- *  Erase 4 KB sector of SPI EEPROM.
- *
- * Parameters:
- *  page_addr Address of the start of the block to be erased.
+ *  Fill buf with the read command for the read data rate: READ up to
+ *  EEPROM_READ_MAX_FREQ_HZ, FAST_READ with its dummy byte above if device d
+ *  supports it.
  *
  * Return:
- *  (eeprom_dma_status_t) The status of the transfer-ignition.
- * 
+ *  (uint8_t) Size of the command in buf.
+ *
  ******************************************************************************/
-eeprom_dma_status_t spi_eeprom_4k_sector_erase(uint32_t page_addr)
+static uint8_t populate_read_command(const eeprom_dev_t *d, uint8_t *buf, uint32_t addr)
 {
-    if(page_addr >= EEPROM_NUM_PAGES)
+    uint8_t len;
+
+    if (d->geo.fast_read && (spi_eeprom_get_data_rate(clk_div_read) > EEPROM_READ_MAX_FREQ_HZ))
     {
-        return STATE_INVALID_PAGE;
+        len = command_address(d, buf, FLASH_FAST_READ, addr);
+        buf[len] = 0;
+        return len + FAST_READ_DUMMY_LEN;
     }
-    
-    /* Create 4K Block Erase command packet. */
-    uint32_t addr = page_addr * EEPROM_PAGE_SIZE;
-    POPULATE_COMMAND_ADDRESS(FLASH_4K_SECTOR_ERASE, addr)
 
-    return spi_master_read_write_array(NULL, NULL, 0, cmd_pkt, SPI_FLASH_CMD_MAX_SIZE);
+    return command_address(d, buf, FLASH_READ_DATA, addr);
 }
 
 /*******************************************************************************
- * Function Name: spi_eeprom_chip_erase
+ * Function Name: command_address
  *******************************************************************************
  *
  * Summary:
- *  Erase entire chip of SPI EEPROM.
- *
- * Parameters:
- *  None
+ *  Fill buf with cmd followed by addr in the address width of device d,
+ *  most significant byte first.
  *
  * Return:
- *  (eeprom_dma_status_t) The status of the transfer-ignition.
- * 
+ *  (uint8_t) Size of the command in buf.
+ *
  ******************************************************************************/
-eeprom_dma_status_t spi_eeprom_chip_erase(void)
+static uint8_t command_address(const eeprom_dev_t *d, uint8_t *buf, uint8_t cmd, uint32_t addr)
 {
-    /* Create Chip Erase command packet. */
-    cmd_pkt[0] = FLASH_CHIP_ERASE;
+    uint8_t len = 0;
 
-    return spi_master_read_write_array(NULL, NULL, 0, cmd_pkt, CMD_LEN_1BYTE);
+    buf[len++] = cmd;
+    for (uint32_t shift = 8u * d->geo.addr_bytes; shift > 0u; shift -= 8u)
+    {
+        buf[len++] = (uint8_t) (addr >> (shift - 8u));
+    }
+    return len;
 }
 
 /*******************************************************************************
@@ -532,12 +3890,15 @@ eeprom_dma_status_t spi_eeprom_chip_erase(void)
  *  None
  *
  * Return:
- *  (bool) True if SPI and DMA is idle or errors occured, false otherwise.
+ *  (bool) True if SPI and DMA is idle and no device has an operation in
+ *  progress, or errors occured, false otherwise.
  * 
  ******************************************************************************/
 bool spi_eeprom_done()
 {
-    return (dma_state_done() & Cy_SCB_SPI_IsTxComplete(FLASH_SPI_HW)) | dma_has_error();
+    /* bus_idle covers a transfer waiting for the previous one to be
+     * deselected, which has not reset the DMA done state yet */
+    return (dma_state_done() & Cy_SCB_SPI_IsTxComplete(FLASH_SPI_HW) & bus_idle()) | dma_has_error();
 }
 
 /*******************************************************************************
@@ -564,7 +3925,9 @@ cy_rslt_t spi_transfer_get_error()
  *******************************************************************************
  *
  * Summary:
- *  Reset everything related to SPI and DMA.
+ *  Reset everything related to SPI and DMA, and abandon the operations in
+ *  progress on all devices. Operations still queued by spi_eeprom_submit
+ *  are started afterwards.
  *
  * Parameters:
  *  None
@@ -577,7 +3940,100 @@ void spi_state_reset(void)
 {
     Cy_SCB_SPI_ClearRxFifo(FLASH_SPI_HW);
     Cy_SCB_SPI_ClearTxFifo(FLASH_SPI_HW);
+    for (uint32_t i = 0; i < TIMER_CHANNELS; i++)
+    {
+        timer_stop(i);
+    }
     dma_state_reset();
+    bus.owner = NULL;
+    bus.completing = false;
+    for (uint32_t i = 0; i < SPI_EEPROM_DEVICES; i++)
+    {
+        device_reset(&devices[i]);
+    }
+    for (uint32_t i = 0; i < SPI_EEPROM_DEVICES; i++)
+    {
+        queue_dispatch(&devices[i]);
+    }
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_wait
+ *******************************************************************************
+ *
+ * Summary:
+ *  Block until the transfer started with status completes. Lets the blocking
+ *  layers chain direct calls: a refused start returns false at once.
+ *
+ * Parameters:
+ *  status: return value of the call that started the transfer
+ *
+ * Return:
+ *  (bool) true if the transfer completed without error. Errors are cleared
+ *  with spi_state_reset.
+ *
+ ******************************************************************************/
+bool spi_eeprom_wait(eeprom_dma_status_t status)
+{
+    if (status != STATE_UNCONFIRMED_SUCCESS)
+    {
+        return false;
+    }
+
+    while (!spi_eeprom_done());
+
+    if (spi_transfer_get_error() != 0)
+    {
+        spi_state_reset();
+        return false;
+    }
+    return true;
+}
+
+/*******************************************************************************
+ * Function Name: device_reset
+ *******************************************************************************
+ *
+ * Summary:
+ *  Abandon the operation in progress on device d. An aborted operation of
+ *  the queue is dropped, the others continue. A suspended one is resumed
+ *  and waited for before them.
+ *
+ ******************************************************************************/
+static void device_reset(eeprom_dev_t *d)
+{
+    d->bus_req = BUS_REQ_NONE;
+    d->write_range.state = WRITE_RANGE_IDLE;
+    d->enabled_cmd.cmd = NULL;
+    d->wip_poll.op = WIP_OP_NONE;
+    d->check.active = false;
+    d->verify.state = VERIFY_IDLE;
+    d->cache_program.size = 0;
+    d->bg_status.status = 0;
+    d->request.busy = false;
+    d->request.cb = NULL;
+
+    if (d->queue.active != NULL)
+    {
+        d->queue.active->next = queue.free;
+        queue.free = d->queue.active;
+        d->queue.active = NULL;
+    }
+
+    /* The EEPROM may be left suspended, or still busy; a parked write
+     * leaves it idle */
+    if (d->suspend.state != SUSPEND_NONE)
+    {
+        if (d->suspend.active != NULL)
+        {
+            d->suspend.active->next = queue.free;
+            queue.free = d->suspend.active;
+        }
+        d->suspend.state = (d->suspend.state == SUSPEND_PARKED) ? SUSPEND_NONE : SUSPEND_ABANDONED;
+        d->suspend.cb = NULL;
+        d->suspend.active = NULL;
+    }
+    d->suspend.bypassed = 0;
 }
 
 /*******************************************************************************
@@ -585,17 +4041,56 @@ void spi_state_reset(void)
  *******************************************************************************
  *
  * Summary:
- *  Internal function to start the transfer. Will call appropriate DMA related
- *  functions. First send is command. Second send is user data.
+ *  Internal function to start the transfer on the device selected by
+ *  spi_eeprom_set_device, see read_write_array.
+ *
+ * Parameters:
+ *  wr_buf: Pointer to the user buffer to write to.
+ *  rd_buf: Pointer to the user buffer to read from.
+ *  size: Number of bytes for user operation.
+ *  cmd_buf: Pointer to the command buffer.
+ *  cmd_size: Number of bytes for command operation.
+ *  cb: Called as part of the DMA interrupt when the operation has completed,
+ *      may be NULL.
+ *  ctx: User context passed to cb.
+ *
+ * Return:
+ *  (uint32_t) Returns STATE_UNCONFIRMED_SUCCESS if transfer was started.
+ *  Returns STATE_INVALID_COMMAND if cmd_buf is NULL or size is 0.
+ *  Returns STATE_BUSY while the selected device has an operation in
+ *  progress or queued.
+ * 
+ ******************************************************************************/
+eeprom_dma_status_t spi_master_read_write_array(uint8_t *wr_buf, uint8_t *rd_buf,
+        uint16_t size, uint8_t *cmd_buf, uint8_t cmd_size, spi_eeprom_callback_t cb, void *ctx)
+{
+    if (device_busy(selected))
+    {
+        return STATE_BUSY;
+    }
+    return read_write_array(selected, wr_buf, rd_buf, size, cmd_buf, cmd_size, cb, ctx);
+}
+
+/*******************************************************************************
+ * Function Name: read_write_array
+ *******************************************************************************
+ *
+ * Summary:
+ *  Start the transfer on device d. First send is command. Second send is
+ *  user data. The transfer waits for the bus if another device uses it.
  *
  * Parameters:
+ *  d: device
  *  wr_buf: Pointer to the user buffer to write to.
  *  rd_buf: Pointer to the user buffer to read from.
  *  size: Number of bytes for user operation.
  *  cmd_buf: Pointer to the command buffer.
  *  cmd_size: Number of bytes for command operation.
+ *  cb: Called as part of the DMA interrupt when the operation has completed,
+ *      may be NULL.
+ *  ctx: User context passed to cb.
  * 
- *  bg_status: Global variable with backup of status. This is set to force
+ *  bg_status: Device variable with backup of status. This is set to force
  *  re-checking status after transfer completion.
  *
  * Return:
@@ -603,49 +4098,56 @@ void spi_state_reset(void)
  *  Returns STATE_INVALID_COMMAND if cmd_buf is NULL or size is 0.
  * 
  ******************************************************************************/
-eeprom_dma_status_t spi_master_read_write_array(uint8_t *wr_buf, uint8_t *rd_buf,
-        uint16_t size, uint8_t *cmd_buf, uint8_t cmd_size)
+static eeprom_dma_status_t read_write_array(eeprom_dev_t *d, uint8_t *wr_buf, uint8_t *rd_buf,
+        uint16_t size, uint8_t *cmd_buf, uint8_t cmd_size, spi_eeprom_callback_t cb, void *ctx)
 {
     if (cmd_buf == NULL || cmd_size == 0)
     {
         return STATE_INVALID_COMMAND;
     }
+    request_begin(d, cb, ctx);
+    SPI_EEPROM_TRACE_COMMAND(d->index, cmd_buf[0]);
 
     /* Preset variable so that after actual command completes,
-     * the interrupt will trigger another Read command 
+     * the interrupt will schedule Read Status commands
      * and further wait until WIP-bit is cleared */
-    if (!(cmd_buf[0] == FLASH_READ_DATA || cmd_buf[0] == FLASH_READ_STATUS ||
-            cmd_buf[0] == FLASH_READ_STATUS_2 || cmd_buf[0] == FLASH_READ_CONFIG ||
-            cmd_buf[0] == FLASH_RDID))
+    wip_poll_begin(d, cmd_buf[0]);
+
+    /* Array reads run at the read data rate, everything else at the command rate */
+    if (cmd_buf[0] == FLASH_READ_DATA || cmd_buf[0] == FLASH_FAST_READ)
+    {
+        d->divider = clk_div_read;
+    }
+    else
     {
-        bg_status.status |= SPI_EEPROM_STAT_REG_WIP;
+        d->divider = clk_div_cmd;
     }
 
     if (size == 0)
     {
-        pong = (dma_master_packet_t)
+        d->pong = (dma_master_packet_t)
         {
             .src = cmd_buf, 
             .dst = NULL,
             .num_bytes = cmd_size
         };
-        send_packet(&pong);
+        bus_request(d, BUS_REQ_PACKET);
     }
     else
     {
-        ping = (dma_master_packet_t)
+        d->ping = (dma_master_packet_t)
         {
             .src = cmd_buf, 
             .dst = NULL,
             .num_bytes = cmd_size
         };
-        pong = (dma_master_packet_t)
+        d->pong = (dma_master_packet_t)
         {
             .src = wr_buf, 
             .dst = rd_buf,
             .num_bytes = size
         };
-        send_packet_multi(&ping, &pong);
+        bus_request(d, BUS_REQ_MULTI);
     }
     return STATE_UNCONFIRMED_SUCCESS;
 }
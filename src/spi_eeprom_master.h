@@ -77,24 +77,82 @@
 /* Write Status Data Length */
 #define WR_STATUS_DATA_LEN                      (2u)
 
+/* Dummy bytes between address and data of FAST_READ */
+#define FAST_READ_DUMMY_LEN                     (1u)
+
 /* Read Status Singular Length */
 #define RD_STATUS_SINGULAR_LEN                  (2u)
 
-/* The below macros can be changed according to the EEPROM used */
-/* Size of EEPROM Page */
+/* The below macros can be changed according to the EEPROM used. They are
+ * the geometry and timing of a device for which spi_eeprom_probe finds
+ * neither SFDP nor a known RDID */
+/* Size of EEPROM Page. Also the unit of the page_addr arguments and of the
+ * page cache, whatever the program page of the device */
 #define EEPROM_PAGE_SIZE                        (256u)
 
 /* Number of pages in EEPROM */
 #define EEPROM_NUM_PAGES                        (32768u)
 
+/* Typical program/erase/write status times; the first WIP poll is issued
+ * after them, later polls adapt to the measured times */
+#define EEPROM_T_PP_US                          (450u)
+#define EEPROM_T_SE_US                          (50000u)
+#define EEPROM_T_BE32_US                        (150000u)
+#define EEPROM_T_BE64_US                        (220000u)
+#define EEPROM_T_CE_US                          (20000000u)
+#define EEPROM_T_W_US                           (2000u)
+
+/* Maximum times; an operation still busy after them fails with
+ * STATE_TIMEOUT */
+#define EEPROM_T_PP_MAX_US                      (1350u)
+#define EEPROM_T_SE_MAX_US                      (300000u)
+#define EEPROM_T_BE32_MAX_US                    (600000u)
+#define EEPROM_T_BE64_MAX_US                    (1150000u)
+#define EEPROM_T_CE_MAX_US                      (80000000u)
+#define EEPROM_T_W_MAX_US                       (15000u)
+
+/* Program/erase suspend: longest time until reads are served, and the
+ * shortest time from resume to the next suspend for the operation to make
+ * progress */
+#define EEPROM_T_SUS_US                         (40u)
+#define EEPROM_T_RS_US                          (100u)
+
+/* Shortest interval between two WIP polls */
+#define EEPROM_POLL_MIN_US                      (20u)
+
+/* Highest SPI clock for READ (0x03); faster reads use FAST_READ (0x0B) */
+#define EEPROM_READ_MAX_FREQ_HZ                 (50000000u)
+
+/* Number of operations spi_eeprom_submit holds, including the one in progress */
+#define SPI_EEPROM_QUEUE_LEN                    (8u)
+
+/* Critical operations started ahead of a background one, queued or in
+ * progress, before it runs without being set aside again */
+#ifndef SPI_EEPROM_STARVATION_LIMIT
+#define SPI_EEPROM_STARVATION_LIMIT             (8u)
+#endif
+
+/* Longest deadline of spi_eeprom_submit_prio, within half the range of
+ * timer_now */
+#define SPI_EEPROM_DEADLINE_MAX_US              (600000000u)
+
+/* EEPROMs on the SPI bus, device n on slave select line n (up to 4). They
+ * share SCB, DMA and clock dividers; each runs its own operations */
+#ifndef SPI_EEPROM_DEVICES
+#define SPI_EEPROM_DEVICES                      (1u)
+#endif
+
 /* EEPROM Address Types (8-bit, 16-bit, 24-bit, 32-bit) */
 #define EEPROM_ADDRESS_TYPE_8                   (1)
 #define EEPROM_ADDRESS_TYPE_16                  (2)
 #define EEPROM_ADDRESS_TYPE_24                  (3)
 #define EEPROM_ADDRESS_TYPE_32                  (4)
 
-/* Set the EEPROM address type as per the EEPROM device used */
+/* Set the EEPROM address type as per the EEPROM device used, for devices
+ * without SFDP or known RDID */
+#ifndef SET_EEPROM_ADDRESS_TYPE
 #define SET_EEPROM_ADDRESS_TYPE                 (EEPROM_ADDRESS_TYPE_24)
+#endif
 
 /******************************************************************************
  * Structure/Enum type declaration
@@ -109,38 +167,159 @@ typedef enum spi_flash_cmd
     FLASH_READ_STATUS = 5,
     FLASH_WRITE_ENABLE = 6,
     FLASH_READ_STATUS_2 = 7,
+    FLASH_FAST_READ = 0x0B,
     FLASH_4K_SECTOR_ERASE = 0x20,
     FLASH_READ_CONFIG = 0x35,
     FLASH_32K_BLOCK_ERASE = 0x52,
+    FLASH_READ_SFDP = 0x5A,
+    FLASH_SUSPEND = 0x75,
+    FLASH_RESUME = 0x7A,
     FLASH_64K_BLOCK_ERASE = 0xD8,
     FLASH_CHIP_ERASE = 0x60,
     FLASH_CHIP_ERASE_ALT = 0xC7,
-    FLASH_RDID = 0x9F
+    FLASH_RDID = 0x9F,
+    FLASH_ENTER_4BYTE = 0xB7
 } spi_flash_cmd_t;
 
+/* Operations of spi_eeprom_submit */
+typedef enum
+{
+    SPI_EEPROM_OP_READ,         /* Sequential read of any length */
+    SPI_EEPROM_OP_WRITE,        /* Write of any length, WREN and WIP per page */
+    SPI_EEPROM_OP_ERASE_4K,     /* WREN and 4 KB sector erase */
+    SPI_EEPROM_OP_ERASE_32K,    /* WREN and 32 KB block erase */
+    SPI_EEPROM_OP_ERASE_64K,    /* WREN and 64 KB block erase */
+    SPI_EEPROM_OP_ERASE_CHIP,   /* WREN and chip erase */
+    SPI_EEPROM_OP_COMPARE,      /* Compare with the buffer, blank check without */
+    SPI_EEPROM_OP_CRC,          /* CRC-32 of the range, read into the buffer if any */
+    SPI_EEPROM_OP_WRITE_VERIFY  /* Write, then compare the range with the buffer */
+} spi_eeprom_op_t;
+
+/* Priority classes of spi_eeprom_submit_prio */
+typedef enum
+{
+    SPI_EEPROM_PRIO_CRITICAL,   /* Latency-critical, e.g. USB-PD policy reads */
+    SPI_EEPROM_PRIO_BACKGROUND, /* Bulk writes, erases and checks, e.g. logs */
+    SPI_EEPROM_PRIOS
+} spi_eeprom_prio_t;
+
+/* Operations that keep the EEPROM busy, index of the times of
+ * spi_eeprom_geometry_t */
+typedef enum
+{
+    SPI_EEPROM_TIME_PP,         /* Page program */
+    SPI_EEPROM_TIME_SE,         /* 4 KB sector erase */
+    SPI_EEPROM_TIME_BE32,       /* 32 KB block erase */
+    SPI_EEPROM_TIME_BE64,       /* 64 KB block erase */
+    SPI_EEPROM_TIME_CE,         /* Chip erase */
+    SPI_EEPROM_TIME_W,          /* Write status register */
+    SPI_EEPROM_TIME_COUNT
+} spi_eeprom_time_t;
+
+/* Where the geometry of a device comes from */
+typedef enum
+{
+    SPI_EEPROM_GEOMETRY_DEFAULT,    /* EEPROM_* macros */
+    SPI_EEPROM_GEOMETRY_RDID,       /* Table of known parts */
+    SPI_EEPROM_GEOMETRY_SFDP        /* Basic flash parameter table of SFDP */
+} spi_eeprom_geometry_source_t;
+
+/* Geometry, opcodes and timing of a device, found by spi_eeprom_probe */
+typedef struct
+{
+    spi_eeprom_geometry_source_t source;
+    uint8_t     jedec_id[3];        /* RDID: manufacturer, type, capacity */
+    uint32_t    size;               /* Bytes */
+    uint32_t    page_size;          /* Page program buffer */
+    uint8_t     addr_bytes;         /* Address bytes of array commands */
+    bool        fast_read;          /* FAST_READ (0x0B) supported */
+    uint8_t     erase_4k_cmd;       /* Erase opcodes, 0 if not supported */
+    uint8_t     erase_32k_cmd;
+    uint8_t     erase_64k_cmd;
+    uint8_t     suspend_cmd;        /* Program/erase suspend, 0 if not supported */
+    uint8_t     resume_cmd;
+    uint32_t    t_suspend_us;       /* Suspend latency */
+    uint32_t    t_resume_us;        /* Resume to the next suspend */
+    uint32_t    t_typ_us[SPI_EEPROM_TIME_COUNT];
+    uint32_t    t_max_us[SPI_EEPROM_TIME_COUNT];
+} spi_eeprom_geometry_t;
+
+/* Critical operations of a device and the background ones set aside for them */
+typedef struct
+{
+    uint32_t    urgent_reads;       /* Critical reads completed */
+    uint32_t    suspends;           /* Programs and erases suspended */
+    uint32_t    suspend_max_us;     /* Longest wait from suspend to WIP clear */
+    uint32_t    parks;              /* Writes set aside between two pages */
+    uint32_t    starved;            /* Background operations let go first */
+    uint32_t    late;               /* Critical operations started past the deadline */
+} spi_eeprom_suspend_stats_t;
+
+/* Completion callback of an operation, executed as part of the DMA interrupt.
+ * status is INIT_SUCCESS, STATE_TRANSFER_ERROR with the cause from
+ * spi_transfer_get_error in error, or STATE_TIMEOUT if the EEPROM stayed busy
+ * past the maximum time of its geometry; ctx is the pointer given with the
+ * operation. The callback may start the next operation. */
+typedef void (*spi_eeprom_callback_t)(eeprom_dma_status_t status, cy_rslt_t error, void *ctx);
+
 /******************************************************************************
  * Global function declaration
  ******************************************************************************/
 eeprom_dma_status_t spi_eeprom_init(void);
-eeprom_dma_status_t spi_eeprom_rdid_reg(uint8_t *data, uint8_t data_len);
-eeprom_dma_status_t spi_eeprom_read_status_reg(uint8_t *status);
-eeprom_dma_status_t spi_eeprom_read_status_2_reg(uint8_t *status);
-eeprom_dma_status_t spi_eeprom_read_config_reg(uint8_t *rd_config);
-eeprom_dma_status_t spi_eeprom_write_status_reg(bool srwd_block_write_prot_en);
-eeprom_dma_status_t spi_eeprom_write_enable(bool enable);
-eeprom_dma_status_t spi_eeprom_read_flash(uint8_t *buffer, uint16_t size, uint32_t page_addr);
-eeprom_dma_status_t spi_eeprom_write_flash(uint8_t *buffer, uint16_t size, uint32_t page_addr);
-eeprom_dma_status_t spi_eeprom_64k_block_erase(uint32_t page_addr);
-eeprom_dma_status_t spi_eeprom_32k_block_erase(uint32_t page_addr);
-eeprom_dma_status_t spi_eeprom_4k_sector_erase(uint32_t page_addr);
-eeprom_dma_status_t spi_eeprom_chip_erase(void);
+eeprom_dma_status_t spi_eeprom_probe(uint32_t device);
+const spi_eeprom_geometry_t *spi_eeprom_get_geometry(uint32_t device);
+eeprom_dma_status_t spi_eeprom_rdid_reg(uint8_t *data, uint8_t data_len,
+        spi_eeprom_callback_t cb, void *ctx);
+eeprom_dma_status_t spi_eeprom_read_status_reg(uint8_t *status, spi_eeprom_callback_t cb, void *ctx);
+eeprom_dma_status_t spi_eeprom_read_status_2_reg(uint8_t *status, spi_eeprom_callback_t cb, void *ctx);
+eeprom_dma_status_t spi_eeprom_read_config_reg(uint8_t *rd_config, spi_eeprom_callback_t cb, void *ctx);
+eeprom_dma_status_t spi_eeprom_write_status_reg(bool srwd_block_write_prot_en,
+        spi_eeprom_callback_t cb, void *ctx);
+eeprom_dma_status_t spi_eeprom_write_enable(bool enable, spi_eeprom_callback_t cb, void *ctx);
+eeprom_dma_status_t spi_eeprom_read_flash(uint8_t *buffer, uint16_t size, uint32_t page_addr,
+        spi_eeprom_callback_t cb, void *ctx);
+eeprom_dma_status_t spi_eeprom_read_range(uint32_t addr, uint8_t *buffer, uint32_t size,
+        spi_eeprom_callback_t cb, void *ctx);
+eeprom_dma_status_t spi_eeprom_compare_range(uint32_t addr, const uint8_t *data, uint32_t size,
+        spi_eeprom_callback_t cb, void *ctx);
+eeprom_dma_status_t spi_eeprom_crc_range(uint32_t addr, uint8_t *buffer, uint32_t size,
+        spi_eeprom_callback_t cb, void *ctx);
+uint32_t spi_eeprom_get_crc(void);
+eeprom_dma_status_t spi_eeprom_write_flash(uint8_t *buffer, uint16_t size, uint32_t page_addr,
+        spi_eeprom_callback_t cb, void *ctx);
+eeprom_dma_status_t spi_eeprom_write_range(uint32_t addr, uint8_t *buffer, uint32_t size,
+        spi_eeprom_callback_t cb, void *ctx);
+eeprom_dma_status_t spi_eeprom_write_verify(uint32_t addr, uint8_t *buffer, uint32_t size,
+        spi_eeprom_callback_t cb, void *ctx);
+eeprom_dma_status_t spi_eeprom_64k_block_erase(uint32_t page_addr, spi_eeprom_callback_t cb, void *ctx);
+eeprom_dma_status_t spi_eeprom_32k_block_erase(uint32_t page_addr, spi_eeprom_callback_t cb, void *ctx);
+eeprom_dma_status_t spi_eeprom_4k_sector_erase(uint32_t page_addr, spi_eeprom_callback_t cb, void *ctx);
+eeprom_dma_status_t spi_eeprom_chip_erase(spi_eeprom_callback_t cb, void *ctx);
+eeprom_dma_status_t spi_eeprom_submit(spi_eeprom_op_t op, uint32_t addr, uint8_t *buffer, uint32_t size,
+        spi_eeprom_callback_t cb, void *ctx);
+eeprom_dma_status_t spi_eeprom_submit_to(uint32_t device, spi_eeprom_op_t op, uint32_t addr,
+        uint8_t *buffer, uint32_t size, spi_eeprom_callback_t cb, void *ctx);
+eeprom_dma_status_t spi_eeprom_submit_prio(uint32_t device, spi_eeprom_op_t op, spi_eeprom_prio_t prio,
+        uint32_t deadline_us, uint32_t addr, uint8_t *buffer, uint32_t size, spi_eeprom_callback_t cb, void *ctx);
+eeprom_dma_status_t spi_eeprom_read_urgent(uint32_t device, uint32_t addr, uint8_t *buffer, uint32_t size,
+        spi_eeprom_callback_t cb, void *ctx);
+void spi_eeprom_get_suspend_stats(uint32_t device, spi_eeprom_suspend_stats_t *stats);
+uint32_t spi_eeprom_queue_count(void);
+eeprom_dma_status_t spi_eeprom_set_device(uint32_t device);
+uint32_t spi_eeprom_get_device(void);
+bool spi_eeprom_device_busy(uint32_t device);
+eeprom_dma_status_t spi_eeprom_set_clock_divider(uint32_t cmd_divider, uint32_t read_divider);
+void spi_eeprom_get_clock_divider(uint32_t *cmd_divider, uint32_t *read_divider);
+uint32_t spi_eeprom_get_data_rate(uint32_t divider);
+uint32_t spi_eeprom_divider_for_rate(uint32_t data_rate);
 
 bool spi_eeprom_done(void);
 cy_rslt_t spi_transfer_get_error(void);
 void spi_state_reset(void);
+bool spi_eeprom_wait(eeprom_dma_status_t status);
 
 eeprom_dma_status_t spi_master_read_write_array(uint8_t *wr_buf, uint8_t *rd_buf,
-        uint16_t size, uint8_t *cmd_buff, uint8_t cmd_size);
-bool dma_completion_cb(void);
+        uint16_t size, uint8_t *cmd_buff, uint8_t cmd_size, spi_eeprom_callback_t cb, void *ctx);
+bool dma_completion_cb(bool error);
 
 #endif /* _SPI_EEPROM_MASTER_H_ */
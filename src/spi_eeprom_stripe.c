@@ -0,0 +1,559 @@
+/******************************************************************************
+ * File Name: spi_eeprom_stripe.c
+ *
+ * Description: Source file for a volume striped page by page across the
+ *                           EEPROMs on the SPI bus. Consecutive pages go to consecutive
+ *                           devices, and every device runs its own chain of page
+ *                           operations, so that one device programs while the others
+ *                           take the bus.
+ *
+ * Related Document: See README.md
+ *
+ *******************************************************************************
+ * Copyright 2023, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+
+
+/*******************************************************************************
+ * Include header files
+ ******************************************************************************/
+#include "spi_eeprom_stripe.h"
+#include "spi_eeprom_erase.h"
+#include "dma_master.h"
+
+/*******************************************************************************
+ * Macros
+ *******************************************************************************/
+/* Context of a lane operation: range number above the lane, so that the
+ * callbacks of a range that has ended are told apart */
+#define LANE_BITS               (2u)
+#define LANE_CTX(gen, k)        ((void *) (uintptr_t) (((gen) << LANE_BITS) | (k)))
+
+/*******************************************************************************
+* Global variables declaration
+*******************************************************************************/
+/* Volume: page n is page n / devices from base_addr on device n % devices */
+static struct
+{
+    uint32_t devices;
+    uint32_t base;
+    uint32_t device_size;   /* Smallest size of the devices */
+    volatile bool busy;
+    uint32_t gen;           /* Number of the range in progress */
+    spi_eeprom_op_t op;
+    uint8_t *buffer;        /* Data of volume address start */
+    uint32_t start;
+    uint32_t end;
+    uint32_t running;       /* Lanes with an operation queued */
+    eeprom_dma_status_t status;     /* First lane operation that failed */
+    cy_rslt_t error;
+    spi_eeprom_callback_t cb;
+    void *ctx;
+} stripe;
+
+/* Chain of operations of one device. For reads and writes, next is the
+ * volume address of its next page; for erases, next and end are addresses
+ * on the device */
+static struct
+{
+    uint32_t next;
+    uint32_t end;
+} lanes[SPI_EEPROM_DEVICES];
+
+/* Internal functions */
+static void lane_done(eeprom_dma_status_t status, cy_rslt_t error, void *ctx);
+static void lane_continue(uint32_t k);
+
+/*******************************************************************************
+ * Function Name: device_addr
+ *******************************************************************************
+ *
+ * Summary:
+ *  Address on its device of a volume address.
+ *
+ ******************************************************************************/
+static uint32_t device_addr(uint32_t addr)
+{
+    uint32_t page = addr / EEPROM_PAGE_SIZE;
+
+    return stripe.base + (page / stripe.devices) * EEPROM_PAGE_SIZE + (addr % EEPROM_PAGE_SIZE);
+}
+
+/*******************************************************************************
+ * Function Name: stripe_finish
+ *******************************************************************************
+ *
+ * Summary:
+ *  End the range and call its callback.
+ *
+ ******************************************************************************/
+static void stripe_finish(eeprom_dma_status_t status, cy_rslt_t error)
+{
+    stripe.gen++;
+    stripe.busy = false;
+    if (stripe.cb != NULL)
+    {
+        stripe.cb(status, error, stripe.ctx);
+    }
+}
+
+/*******************************************************************************
+ * Function Name: stripe_fail
+ *******************************************************************************
+ *
+ * Summary:
+ *  Keep the first error of the range; no lane starts another operation.
+ *
+ ******************************************************************************/
+static void stripe_fail(eeprom_dma_status_t status, cy_rslt_t error)
+{
+    if (stripe.status == INIT_SUCCESS)
+    {
+        stripe.status = status;
+        stripe.error = error;
+    }
+}
+
+/*******************************************************************************
+ * Function Name: lane_next
+ *******************************************************************************
+ *
+ * Summary:
+ *  Queue the next operation of lane k on its device: the part of the range
+ *  in its next page, or the largest erase unit left. Fails the range if the
+ *  queue refuses it.
+ *
+ * Return:
+ *  (bool) true if an operation was queued, false if the lane is done or
+ *  the queue refused it.
+ *
+ ******************************************************************************/
+static bool lane_next(uint32_t k)
+{
+    eeprom_dma_status_t status;
+    spi_eeprom_op_t op = stripe.op;
+    uint32_t addr;
+    uint8_t *buffer = NULL;
+    uint32_t size = 0;
+
+    if (lanes[k].next >= lanes[k].end)
+    {
+        return false;
+    }
+
+    if (op == SPI_EEPROM_OP_ERASE_4K)
+    {
+        addr = lanes[k].next;
+        size = SPI_EEPROM_SECTOR_SIZE;
+        if ((spi_eeprom_get_geometry(k)->erase_64k_cmd != 0) &&
+            ((addr & (SPI_EEPROM_BLOCK_64K_SIZE - 1u)) == 0) && ((lanes[k].end - addr) >= SPI_EEPROM_BLOCK_64K_SIZE))
+        {
+            op = SPI_EEPROM_OP_ERASE_64K;
+            size = SPI_EEPROM_BLOCK_64K_SIZE;
+        }
+        lanes[k].next += size;
+        size = 0;
+    }
+    else
+    {
+        uint32_t page_end = (lanes[k].next / EEPROM_PAGE_SIZE + 1u) * EEPROM_PAGE_SIZE;
+
+        addr = device_addr(lanes[k].next);
+        buffer = &stripe.buffer[lanes[k].next - stripe.start];
+        size = ((page_end < lanes[k].end) ? page_end : lanes[k].end) - lanes[k].next;
+        lanes[k].next = page_end + (stripe.devices - 1u) * EEPROM_PAGE_SIZE;
+    }
+
+    status = spi_eeprom_submit_to(k, op, addr, buffer, size, lane_done, LANE_CTX(stripe.gen, k));
+    if (status != STATE_UNCONFIRMED_SUCCESS)
+    {
+        stripe_fail(status, CY_RSLT_SUCCESS);
+        return false;
+    }
+    return true;
+}
+
+/*******************************************************************************
+ * Function Name: lane_continue
+ *******************************************************************************
+ *
+ * Summary:
+ *  Queue the next operation of lane k, unless the lane is done or the range
+ *  has failed. The range ends with the last lane that has nothing queued,
+ *  so no operation of it runs once its callback is called.
+ *
+ ******************************************************************************/
+static void lane_continue(uint32_t k)
+{
+    if (((stripe.status != INIT_SUCCESS) || !lane_next(k)) && (--stripe.running == 0))
+    {
+        stripe_finish(stripe.status, stripe.error);
+    }
+}
+
+/*******************************************************************************
+ * Function Name: lane_done
+ *******************************************************************************
+ *
+ * Summary:
+ *  Completion callback of every operation of a lane, executed as part of
+ *  the DMA interrupt; queues the next one of the same lane. After the first
+ *  error the lanes stop and the range ends once the operations already
+ *  queued have completed. A DMA error ends it right away: the other lanes
+ *  then stall until spi_state_reset abandons their operations.
+ *
+ ******************************************************************************/
+static void lane_done(eeprom_dma_status_t status, cy_rslt_t error, void *ctx)
+{
+    uint32_t k = (uint32_t) (uintptr_t) ctx & ((1u << LANE_BITS) - 1u);
+
+    if (!stripe.busy || (LANE_CTX(stripe.gen, k) != ctx))
+    {
+        return;
+    }
+    if (status != INIT_SUCCESS)
+    {
+        stripe_fail(status, error);
+        if (dma_has_error())
+        {
+            stripe_finish(stripe.status, stripe.error);
+            return;
+        }
+    }
+    lane_continue(k);
+}
+
+/*******************************************************************************
+ * Function Name: stripe_start
+ *******************************************************************************
+ *
+ * Summary:
+ *  Start op on the volume range, or on the device range start..end of every
+ *  device for an erase, with one lane per device. The first operation of
+ *  every lane is queued, or none if the queue has not room for all.
+ *
+ ******************************************************************************/
+static eeprom_dma_status_t stripe_start(spi_eeprom_op_t op, uint32_t start, uint32_t end, uint8_t *buffer,
+        spi_eeprom_callback_t cb, void *ctx)
+{
+    uint32_t intr;
+    uint32_t needed = 0;
+    bool started;
+
+    intr = Cy_SysLib_EnterCriticalSection();
+    if (stripe.busy || (stripe.devices == 0))
+    {
+        Cy_SysLib_ExitCriticalSection(intr);
+        return (stripe.devices == 0) ? INIT_FAILURE : STATE_QUEUE_FULL;
+    }
+
+    for (uint32_t k = 0; k < stripe.devices; k++)
+    {
+        if (op == SPI_EEPROM_OP_ERASE_4K)
+        {
+            lanes[k].next = start;
+        }
+        else
+        {
+            /* First page of the range on device k */
+            uint32_t page = start / EEPROM_PAGE_SIZE;
+            uint32_t skip = (k + stripe.devices - (page % stripe.devices)) % stripe.devices;
+
+            lanes[k].next = (skip == 0) ? start : (page + skip) * EEPROM_PAGE_SIZE;
+        }
+        lanes[k].end = end;
+        needed += (lanes[k].next < end) ? 1u : 0u;
+    }
+    if ((SPI_EEPROM_QUEUE_LEN - spi_eeprom_queue_count()) < needed)
+    {
+        Cy_SysLib_ExitCriticalSection(intr);
+        return STATE_QUEUE_FULL;
+    }
+    stripe.busy = true;
+    stripe.op = op;
+    stripe.buffer = buffer;
+    stripe.start = start;
+    stripe.end = end;
+    stripe.running = stripe.devices;
+    stripe.status = INIT_SUCCESS;
+    stripe.error = CY_RSLT_SUCCESS;
+
+    /* The queue has room for all first operations; should one be refused
+     * all the same, a range that ends here has no callback and the caller
+     * gets the error instead */
+    stripe.cb = NULL;
+    for (uint32_t k = 0; k < stripe.devices; k++)
+    {
+        lane_continue(k);
+    }
+    started = stripe.busy;
+    if (started)
+    {
+        stripe.cb = cb;
+        stripe.ctx = ctx;
+    }
+    Cy_SysLib_ExitCriticalSection(intr);
+
+    return started ? STATE_UNCONFIRMED_SUCCESS : STATE_QUEUE_FULL;
+}
+
+/*******************************************************************************
+ * Function Name: stripe_check
+ *******************************************************************************
+ *
+ * Summary:
+ *  Check a volume range.
+ *
+ ******************************************************************************/
+static eeprom_dma_status_t stripe_check(uint32_t addr, uint32_t size)
+{
+    uint32_t volume = spi_eeprom_stripe_size();
+
+    if (size == 0)
+    {
+        return STATE_INVALID_ARGUMENT;
+    }
+    if ((addr >= volume) || (size > (volume - addr)))
+    {
+        return STATE_INVALID_PAGE;
+    }
+    return INIT_SUCCESS;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_stripe_init
+ *******************************************************************************
+ *
+ * Summary:
+ *  Set up the striped volume over devices 0 to devices - 1, as probed by
+ *  spi_eeprom_probe. Page n of the volume is page n / devices from
+ *  base_addr on device n % devices, so a range of the volume spreads over
+ *  all devices page by page. Does not touch the EEPROMs.
+ *
+ * Parameters:
+ *  devices Number of devices, 1 to SPI_EEPROM_DEVICES.
+ *  base_addr Byte address of the volume on each device, aligned to
+ *            SPI_EEPROM_SECTOR_SIZE. The volume takes the rest of the
+ *            smallest device on each device.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) INIT_SUCCESS, STATE_INVALID_ARGUMENT or
+ *  STATE_QUEUE_FULL if a range is in progress.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_stripe_init(uint32_t devices, uint32_t base_addr)
+{
+    uint32_t device_size = UINT32_MAX;
+
+    if ((devices == 0) || (devices > SPI_EEPROM_DEVICES))
+    {
+        return STATE_INVALID_ARGUMENT;
+    }
+    for (uint32_t k = 0; k < devices; k++)
+    {
+        if (spi_eeprom_get_geometry(k)->size < device_size)
+        {
+            device_size = spi_eeprom_get_geometry(k)->size;
+        }
+    }
+    if (((base_addr & (SPI_EEPROM_SECTOR_SIZE - 1u)) != 0) || (base_addr >= device_size))
+    {
+        return STATE_INVALID_ARGUMENT;
+    }
+    if (stripe.busy)
+    {
+        return STATE_QUEUE_FULL;
+    }
+    stripe.devices = devices;
+    stripe.base = base_addr;
+    stripe.device_size = device_size;
+    return INIT_SUCCESS;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_stripe_size
+ *******************************************************************************
+ *
+ * Summary:
+ *  Size of the striped volume.
+ *
+ * Parameters:
+ *  None
+ *
+ * Return:
+ *  (uint32_t) Number of bytes, 0 before spi_eeprom_stripe_init.
+ *
+ ******************************************************************************/
+uint32_t spi_eeprom_stripe_size(void)
+{
+    return stripe.devices * (stripe.device_size - stripe.base);
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_stripe_read_range
+ *******************************************************************************
+ *
+ * Summary:
+ *  Read a range of the volume, as spi_eeprom_read_range. Every device
+ *  reads its pages of the range in turn, each page a queued operation, and
+ *  the bus arbiter interleaves the devices. One range at a time.
+ *
+ * Parameters:
+ *  addr Byte address in the volume.
+ *  buffer Buffer of size bytes.
+ *  size Number of bytes.
+ *  cb Called as part of the DMA interrupt when the range has completed,
+ *     may be NULL.
+ *  ctx User context passed to cb.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) STATE_UNCONFIRMED_SUCCESS if the read was
+ *  started, STATE_QUEUE_FULL if a range is in progress or the queue is
+ *  full, INIT_FAILURE before spi_eeprom_stripe_init, STATE_INVALID_ARGUMENT
+ *  or STATE_INVALID_PAGE if the range exceeds the volume.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_stripe_read_range(uint32_t addr, uint8_t *buffer, uint32_t size,
+        spi_eeprom_callback_t cb, void *ctx)
+{
+    eeprom_dma_status_t status = stripe_check(addr, size);
+
+    if ((status == INIT_SUCCESS) && (buffer == NULL))
+    {
+        status = STATE_INVALID_ARGUMENT;
+    }
+    if (status != INIT_SUCCESS)
+    {
+        return (stripe.devices == 0) ? INIT_FAILURE : status;
+    }
+    return stripe_start(SPI_EEPROM_OP_READ, addr, addr + size, buffer, cb, ctx);
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_stripe_write_range
+ *******************************************************************************
+ *
+ * Summary:
+ *  Write a range of the volume, as spi_eeprom_write_range. Every device
+ *  programs its pages of the range in turn and polls its own WIP, so while
+ *  one device programs a page the next ones are sent to the others: with
+ *  n devices, n page programs overlap.
+ *
+ * Parameters:
+ *  addr Byte address in the volume.
+ *  buffer Data of size bytes, valid until the callback.
+ *  size Number of bytes.
+ *  cb Called as part of the DMA interrupt when the range has completed,
+ *     may be NULL.
+ *  ctx User context passed to cb.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) As spi_eeprom_stripe_read_range.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_stripe_write_range(uint32_t addr, uint8_t *buffer, uint32_t size,
+        spi_eeprom_callback_t cb, void *ctx)
+{
+    eeprom_dma_status_t status = stripe_check(addr, size);
+
+    if ((status == INIT_SUCCESS) && (buffer == NULL))
+    {
+        status = STATE_INVALID_ARGUMENT;
+    }
+    if (status != INIT_SUCCESS)
+    {
+        return (stripe.devices == 0) ? INIT_FAILURE : status;
+    }
+    return stripe_start(SPI_EEPROM_OP_WRITE, addr, addr + size, buffer, cb, ctx);
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_stripe_erase_range
+ *******************************************************************************
+ *
+ * Summary:
+ *  Erase a range of the volume of whole stripes of sectors: a stripe of
+ *  devices * SPI_EEPROM_SECTOR_SIZE bytes is one sector on every device.
+ *  The devices erase their part side by side, with 64 KB block erases
+ *  where aligned.
+ *
+ * Parameters:
+ *  addr Byte address in the volume, aligned to a stripe of sectors.
+ *  size Number of bytes, a multiple of a stripe of sectors.
+ *  cb Called as part of the DMA interrupt when the range has completed,
+ *     may be NULL.
+ *  ctx User context passed to cb.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) As spi_eeprom_stripe_read_range, and
+ *  STATE_INVALID_ARGUMENT for an unaligned range.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_stripe_erase_range(uint32_t addr, uint32_t size,
+        spi_eeprom_callback_t cb, void *ctx)
+{
+    uint32_t unit = stripe.devices * SPI_EEPROM_SECTOR_SIZE;
+    eeprom_dma_status_t status = stripe_check(addr, size);
+
+    if ((status == INIT_SUCCESS) && (((addr % unit) != 0) || ((size % unit) != 0)))
+    {
+        status = STATE_INVALID_ARGUMENT;
+    }
+    if (status != INIT_SUCCESS)
+    {
+        return (stripe.devices == 0) ? INIT_FAILURE : status;
+    }
+    return stripe_start(SPI_EEPROM_OP_ERASE_4K, stripe.base + addr / stripe.devices,
+                        stripe.base + (addr + size) / stripe.devices, NULL, cb, ctx);
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_stripe_busy
+ *******************************************************************************
+ *
+ * Summary:
+ *  Return whether a range of the volume is in progress.
+ *
+ * Parameters:
+ *  None
+ *
+ * Return:
+ *  (bool) true while a range is in progress.
+ *
+ ******************************************************************************/
+bool spi_eeprom_stripe_busy(void)
+{
+    return stripe.busy;
+}
+
+/* [] END OF FILE */
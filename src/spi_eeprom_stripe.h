@@ -0,0 +1,66 @@
+/******************************************************************************
+ * File Name: spi_eeprom_stripe.h
+ *
+ * Description: Header file for the volume striped across several EEPROMs.
+ *
+ * Related Document: See README.md
+ *
+ *******************************************************************************
+ * Copyright 2023, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+
+
+#ifndef SOURCE_SPI_EEPROM_STRIPE_H_
+#define SOURCE_SPI_EEPROM_STRIPE_H_
+
+/*******************************************************************************
+ * Include header files
+ ******************************************************************************/
+#include "spi_eeprom_master.h"
+
+/******************************************************************************
+ * Global function declaration
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_stripe_init(uint32_t devices, uint32_t base_addr);
+uint32_t spi_eeprom_stripe_size(void);
+eeprom_dma_status_t spi_eeprom_stripe_read_range(uint32_t addr, uint8_t *buffer, uint32_t size,
+        spi_eeprom_callback_t cb, void *ctx);
+eeprom_dma_status_t spi_eeprom_stripe_write_range(uint32_t addr, uint8_t *buffer, uint32_t size,
+        spi_eeprom_callback_t cb, void *ctx);
+eeprom_dma_status_t spi_eeprom_stripe_erase_range(uint32_t addr, uint32_t size,
+        spi_eeprom_callback_t cb, void *ctx);
+bool spi_eeprom_stripe_busy(void);
+
+#endif /* SOURCE_SPI_EEPROM_STRIPE_H_ */
+
+/* [] END OF FILE */
@@ -0,0 +1,595 @@
+/******************************************************************************
+ * File Name: spi_eeprom_trace.c
+ *
+ * Description: Source file for the optional latency trace of the SPI EEPROM
+ *              operations: phases timestamped with a free-running TCPWM counter
+ *              and collected in histograms per operation type.
+ *
+ * Related Document: See README.md
+ *
+ *******************************************************************************
+ * Copyright 2023, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+
+
+/*******************************************************************************
+ * Include header files
+ ******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "spi_eeprom_trace.h"
+#include "spi_eeprom_master.h"
+#include "timer_master.h"
+
+#if SPI_EEPROM_TRACE
+
+/*******************************************************************************
+* Global variables declaration
+*******************************************************************************/
+/* Phases of one operation so far */
+typedef struct
+{
+    bool active;
+    bool busy;                      /* WIP polling */
+    spi_eeprom_trace_class_t cls;
+    spi_eeprom_trace_interval_t phase;  /* Interval the time since last goes to */
+    uint32_t submit;
+    uint32_t last;
+    uint32_t acc[SPI_EEPROM_TRACE_INTERVALS];
+} trace_op_t;
+
+/* Per device the operation in progress, the one whose callback is
+ * running: the callback may already start the next operation, and the
+ * operation set aside for critical ones */
+static trace_op_t current[SPI_EEPROM_DEVICES];
+static trace_op_t finished[SPI_EEPROM_DEVICES];
+static trace_op_t suspended[SPI_EEPROM_DEVICES];
+
+static spi_eeprom_trace_hist_t histograms[SPI_EEPROM_TRACE_CLASSES][SPI_EEPROM_TRACE_INTERVALS];
+
+static const char * const class_name[SPI_EEPROM_TRACE_CLASSES] =
+{
+    "read", "program", "erase", "other", "critical"
+};
+
+static const char * const interval_name[SPI_EEPROM_TRACE_INTERVALS] =
+{
+    "queue", "setup", "transfer", "isr", "busy", "callback", "total"
+};
+
+/* Internal functions */
+static void trace_advance(trace_op_t *op, uint32_t now);
+static void trace_record(const trace_op_t *op);
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_trace_init
+ *******************************************************************************
+ *
+ * Summary:
+ *  Clear the histograms. Called by spi_eeprom_init after timer_init, whose
+ *  timer_now is the time base.
+ *
+ * Parameters:
+ *  None
+ *
+ * Return:
+ *  (uint32_t) INIT_SUCCESS
+ *
+ ******************************************************************************/
+uint32_t spi_eeprom_trace_init(void)
+{
+    memset(current, 0, sizeof(current));
+    memset(finished, 0, sizeof(finished));
+    memset(suspended, 0, sizeof(suspended));
+    spi_eeprom_trace_reset();
+    return INIT_SUCCESS;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_trace_now
+ *******************************************************************************
+ *
+ * Summary:
+ *  Timestamp of the trace, the time of timer_now.
+ *
+ * Parameters:
+ *  None
+ *
+ * Return:
+ *  (uint32_t) Timestamp in microseconds.
+ *
+ ******************************************************************************/
+uint32_t spi_eeprom_trace_now(void)
+{
+    return timer_now();
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_trace_event
+ *******************************************************************************
+ *
+ * Summary:
+ *  Trace point of the driver: the time since the previous one is added to
+ *  the interval of the current phase, then the event selects the next
+ *  phase. While WIP is polled the status register reads count as busy, not
+ *  as transfers. At the end of the callback the intervals of the operation
+ *  go into the histograms of its type.
+ *
+ * Parameters:
+ *  device: device of the operation
+ *  event: point reached by the operation in progress
+ *
+ ******************************************************************************/
+void spi_eeprom_trace_event(uint32_t device, spi_eeprom_trace_event_t event)
+{
+    trace_op_t *cur = &current[device];
+    trace_op_t *fin = &finished[device];
+    uint32_t now = spi_eeprom_trace_now();
+
+    if (event == SPI_EEPROM_TRACE_START)
+    {
+        memset(cur, 0, sizeof(*cur));
+        cur->active = true;
+        cur->cls = SPI_EEPROM_TRACE_OTHER;
+        cur->phase = SPI_EEPROM_TRACE_SETUP;
+        cur->submit = now;
+        cur->last = now;
+        return;
+    }
+    if (event == SPI_EEPROM_TRACE_END)
+    {
+        if (fin->active)
+        {
+            trace_advance(fin, now);
+            fin->acc[SPI_EEPROM_TRACE_TOTAL] = now - fin->submit;
+            trace_record(fin);
+            fin->active = false;
+        }
+        return;
+    }
+    if (!cur->active)
+    {
+        return;
+    }
+
+    trace_advance(cur, now);
+    switch (event)
+    {
+        case SPI_EEPROM_TRACE_FIRST_BYTE:
+            if (!cur->busy)
+            {
+                cur->phase = SPI_EEPROM_TRACE_TRANSFER;
+            }
+            break;
+        case SPI_EEPROM_TRACE_DMA_DONE:
+            if (!cur->busy)
+            {
+                cur->phase = SPI_EEPROM_TRACE_ISR;
+            }
+            break;
+        case SPI_EEPROM_TRACE_WIP_WAIT:
+            cur->busy = true;
+            cur->phase = SPI_EEPROM_TRACE_BUSY;
+            break;
+        case SPI_EEPROM_TRACE_WIP_CLEAR:
+            cur->busy = false;
+            cur->phase = SPI_EEPROM_TRACE_ISR;
+            break;
+        case SPI_EEPROM_TRACE_CALLBACK:
+            cur->phase = SPI_EEPROM_TRACE_CB;
+            *fin = *cur;
+            cur->active = false;
+            break;
+        default:
+            break;
+    }
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_trace_command
+ *******************************************************************************
+ *
+ * Summary:
+ *  Classify the operation in progress by a command it sends. The first
+ *  read, program or erase command decides, so the WREN before a program
+ *  or the read back of a verified write do not change the type.
+ *
+ * Parameters:
+ *  device: device of the operation
+ *  cmd: opcode
+ *
+ ******************************************************************************/
+void spi_eeprom_trace_command(uint32_t device, uint8_t cmd)
+{
+    spi_eeprom_trace_class_t cls;
+
+    switch (cmd)
+    {
+        case FLASH_READ_DATA:
+        case FLASH_FAST_READ:
+            cls = SPI_EEPROM_TRACE_READ;
+            break;
+        case FLASH_WRITE_DATA:
+            cls = SPI_EEPROM_TRACE_PROGRAM;
+            break;
+        case FLASH_4K_SECTOR_ERASE:
+        case FLASH_32K_BLOCK_ERASE:
+        case FLASH_64K_BLOCK_ERASE:
+        case FLASH_CHIP_ERASE:
+        case FLASH_CHIP_ERASE_ALT:
+            cls = SPI_EEPROM_TRACE_ERASE;
+            break;
+        default:
+            return;
+    }
+    if (current[device].active && (current[device].cls == SPI_EEPROM_TRACE_OTHER))
+    {
+        current[device].cls = cls;
+    }
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_trace_submitted
+ *******************************************************************************
+ *
+ * Summary:
+ *  Set the time the operation just started was queued by spi_eeprom_submit.
+ *
+ * Parameters:
+ *  device: device of the operation
+ *  time: timestamp of spi_eeprom_trace_now at submission
+ *
+ ******************************************************************************/
+void spi_eeprom_trace_submitted(uint32_t device, uint32_t time)
+{
+    trace_op_t *cur = &current[device];
+
+    if (cur->active)
+    {
+        cur->acc[SPI_EEPROM_TRACE_QUEUE] = cur->submit - time;
+        cur->submit = time;
+    }
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_trace_urgent
+ *******************************************************************************
+ *
+ * Summary:
+ *  Count the operation just started as critical, whatever it sends.
+ *
+ * Parameters:
+ *  device: device of the operation
+ *
+ ******************************************************************************/
+void spi_eeprom_trace_urgent(uint32_t device)
+{
+    if (current[device].active)
+    {
+        current[device].cls = SPI_EEPROM_TRACE_URGENT;
+    }
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_trace_suspend
+ *******************************************************************************
+ *
+ * Summary:
+ *  Set the operation in progress aside while it is suspended or parked, so
+ *  that the critical operations in between are traced as operations of
+ *  their own.
+ *
+ * Parameters:
+ *  device: device of the operation
+ *
+ ******************************************************************************/
+void spi_eeprom_trace_suspend(uint32_t device)
+{
+    trace_op_t *cur = &current[device];
+
+    if (cur->active)
+    {
+        trace_advance(cur, spi_eeprom_trace_now());
+    }
+    suspended[device] = *cur;
+    cur->active = false;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_trace_resume
+ *******************************************************************************
+ *
+ * Summary:
+ *  Continue the operation set aside by spi_eeprom_trace_suspend. The time
+ *  it was suspended counts to the phase it was in, busy.
+ *
+ * Parameters:
+ *  device: device of the operation
+ *
+ ******************************************************************************/
+void spi_eeprom_trace_resume(uint32_t device)
+{
+    current[device] = suspended[device];
+    suspended[device].active = false;
+}
+
+/*******************************************************************************
+ * Function Name: trace_advance
+ *******************************************************************************
+ *
+ * Summary:
+ *  Add the time since the last trace point to the current phase of op.
+ *
+ ******************************************************************************/
+static void trace_advance(trace_op_t *op, uint32_t now)
+{
+    op->acc[op->phase] += now - op->last;
+    op->last = now;
+}
+
+/*******************************************************************************
+ * Function Name: trace_record
+ *******************************************************************************
+ *
+ * Summary:
+ *  Add all intervals of a completed operation to the histograms of its
+ *  type, zero ones included, so that every interval has the same count.
+ *
+ ******************************************************************************/
+static void trace_record(const trace_op_t *op)
+{
+    for (uint32_t i = 0; i < SPI_EEPROM_TRACE_INTERVALS; i++)
+    {
+        spi_eeprom_trace_hist_t *h = &histograms[op->cls][i];
+        uint32_t us = op->acc[i];
+        uint32_t bucket = 0;
+
+        for (uint32_t v = us >> 1; (v != 0u) && (bucket < (SPI_EEPROM_TRACE_BUCKETS - 1u)); v >>= 1)
+        {
+            bucket++;
+        }
+        h->count++;
+        h->sum += us;
+        if (us > h->max)
+        {
+            h->max = us;
+        }
+        if (h->buckets[bucket] < UINT16_MAX)
+        {
+            h->buckets[bucket]++;
+        }
+    }
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_trace_get
+ *******************************************************************************
+ *
+ * Summary:
+ *  Copy one histogram, consistent even while operations complete.
+ *
+ * Parameters:
+ *  cls: operation type
+ *  interval: measured interval
+ *  hist: receives the histogram
+ *
+ ******************************************************************************/
+void spi_eeprom_trace_get(spi_eeprom_trace_class_t cls, spi_eeprom_trace_interval_t interval,
+        spi_eeprom_trace_hist_t *hist)
+{
+    uint32_t intr = Cy_SysLib_EnterCriticalSection();
+
+    *hist = histograms[cls][interval];
+    Cy_SysLib_ExitCriticalSection(intr);
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_trace_percentile
+ *******************************************************************************
+ *
+ * Summary:
+ *  Upper bound of the bucket holding the given percentile, so that all
+ *  percentiles are bucket bounds; the maximum seen for the open last bucket.
+ *
+ * Parameters:
+ *  hist: histogram of spi_eeprom_trace_get
+ *  percent: 1 to 100
+ *
+ * Return:
+ *  (uint32_t) Duration in microseconds, 0 for an empty histogram.
+ *
+ ******************************************************************************/
+uint32_t spi_eeprom_trace_percentile(const spi_eeprom_trace_hist_t *hist, uint32_t percent)
+{
+    uint32_t target = (uint32_t) (((uint64_t) hist->count * percent + 99u) / 100u);
+    uint32_t seen = 0;
+
+    if (target == 0u)
+    {
+        target = 1u;
+    }
+    for (uint32_t b = 0; b < (SPI_EEPROM_TRACE_BUCKETS - 1u); b++)
+    {
+        seen += hist->buckets[b];
+        if (seen >= target)
+        {
+            return (2UL << b) - 1u;
+        }
+    }
+    return hist->max;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_trace_reset
+ *******************************************************************************
+ *
+ * Summary:
+ *  Clear all histograms. An operation in progress is still recorded.
+ *
+ ******************************************************************************/
+void spi_eeprom_trace_reset(void)
+{
+    uint32_t intr = Cy_SysLib_EnterCriticalSection();
+
+    memset(histograms, 0, sizeof(histograms));
+    Cy_SysLib_ExitCriticalSection(intr);
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_trace_dump
+ *******************************************************************************
+ *
+ * Summary:
+ *  Print one line per operation type and interval that was ever non-zero:
+ *  count, mean, percentiles as bucket upper bounds and maximum, then the
+ *  non-empty buckets as upper bound:count. All durations in microseconds.
+ *
+ * Parameters:
+ *  print: called with consecutive pieces of the text, lines end with "\r\n"
+ *
+ ******************************************************************************/
+void spi_eeprom_trace_dump(spi_eeprom_trace_print_t print)
+{
+    spi_eeprom_trace_hist_t h;
+    char text[96];
+
+    print("type     interval   count     avg   p50<=   p99<=     max  buckets\r\n");
+    for (uint32_t c = 0; c < SPI_EEPROM_TRACE_CLASSES; c++)
+    {
+        for (uint32_t i = 0; i < SPI_EEPROM_TRACE_INTERVALS; i++)
+        {
+            spi_eeprom_trace_get((spi_eeprom_trace_class_t) c, (spi_eeprom_trace_interval_t) i, &h);
+            if (h.max == 0u)
+            {
+                continue;
+            }
+            snprintf(text, sizeof(text), "%-8s %-8s %7lu %7lu %7lu %7lu %7lu ",
+                    class_name[c], interval_name[i], (unsigned long) h.count,
+                    (unsigned long) (h.sum / h.count),
+                    (unsigned long) spi_eeprom_trace_percentile(&h, 50u),
+                    (unsigned long) spi_eeprom_trace_percentile(&h, 99u),
+                    (unsigned long) h.max);
+            print(text);
+            for (uint32_t b = 0; b < SPI_EEPROM_TRACE_BUCKETS; b++)
+            {
+                if (h.buckets[b] == 0u)
+                {
+                    continue;
+                }
+                if (b == (SPI_EEPROM_TRACE_BUCKETS - 1u))
+                {
+                    snprintf(text, sizeof(text), " >%lu:%u", (2UL << (b - 1u)) - 1u, h.buckets[b]);
+                }
+                else
+                {
+                    snprintf(text, sizeof(text), " %lu:%u", (2UL << b) - 1u, h.buckets[b]);
+                }
+                print(text);
+            }
+            print("\r\n");
+        }
+    }
+}
+
+#else /* SPI_EEPROM_TRACE == 0: no trace points in the driver */
+
+uint32_t spi_eeprom_trace_init(void)
+{
+    return INIT_SUCCESS;
+}
+
+uint32_t spi_eeprom_trace_now(void)
+{
+    return timer_now();
+}
+
+void spi_eeprom_trace_event(uint32_t device, spi_eeprom_trace_event_t event)
+{
+    (void) device;
+    (void) event;
+}
+
+void spi_eeprom_trace_command(uint32_t device, uint8_t cmd)
+{
+    (void) device;
+    (void) cmd;
+}
+
+void spi_eeprom_trace_submitted(uint32_t device, uint32_t time)
+{
+    (void) device;
+    (void) time;
+}
+
+void spi_eeprom_trace_urgent(uint32_t device)
+{
+    (void) device;
+}
+
+void spi_eeprom_trace_suspend(uint32_t device)
+{
+    (void) device;
+}
+
+void spi_eeprom_trace_resume(uint32_t device)
+{
+    (void) device;
+}
+
+void spi_eeprom_trace_get(spi_eeprom_trace_class_t cls, spi_eeprom_trace_interval_t interval,
+        spi_eeprom_trace_hist_t *hist)
+{
+    (void) cls;
+    (void) interval;
+    memset(hist, 0, sizeof(*hist));
+}
+
+uint32_t spi_eeprom_trace_percentile(const spi_eeprom_trace_hist_t *hist, uint32_t percent)
+{
+    (void) hist;
+    (void) percent;
+    return 0;
+}
+
+void spi_eeprom_trace_reset(void)
+{
+}
+
+void spi_eeprom_trace_dump(spi_eeprom_trace_print_t print)
+{
+    (void) print;
+}
+
+#endif /* SPI_EEPROM_TRACE */
+
+/* [] END OF FILE */
@@ -0,0 +1,158 @@
+/******************************************************************************
+ * File Name: spi_eeprom_trace.h
+ *
+ * Description: Header file for the optional latency trace of the SPI EEPROM
+ *              operations.
+ *
+ * Related Document: See README.md
+ *
+ *******************************************************************************
+ * Copyright 2023, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+
+
+#ifndef SOURCE_SPI_EEPROM_TRACE_H_
+#define SOURCE_SPI_EEPROM_TRACE_H_
+
+/*******************************************************************************
+ * Include header files
+ ******************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Timestamp the phases of every operation and collect their durations in
+ * histograms; 0 removes the trace points from the driver */
+#ifndef SPI_EEPROM_TRACE
+#define SPI_EEPROM_TRACE                (0u)
+#endif
+
+/* Buckets of a histogram: bucket b counts durations from 2^b to 2^(b+1) - 1
+ * microseconds (bucket 0 also 0), the last one everything longer */
+#define SPI_EEPROM_TRACE_BUCKETS        (20u)
+
+/* Trace points of the driver, compiled out without SPI_EEPROM_TRACE */
+#if SPI_EEPROM_TRACE
+#define SPI_EEPROM_TRACE_EVENT(dev, event)      spi_eeprom_trace_event(dev, event)
+#define SPI_EEPROM_TRACE_COMMAND(dev, cmd)       spi_eeprom_trace_command(dev, cmd)
+#define SPI_EEPROM_TRACE_STAMP(time)             ((time) = spi_eeprom_trace_now())
+#define SPI_EEPROM_TRACE_SUBMITTED(dev, time)    spi_eeprom_trace_submitted(dev, time)
+#define SPI_EEPROM_TRACE_URGENT(dev)             spi_eeprom_trace_urgent(dev)
+#define SPI_EEPROM_TRACE_SUSPEND(dev)            spi_eeprom_trace_suspend(dev)
+#define SPI_EEPROM_TRACE_RESUME(dev)             spi_eeprom_trace_resume(dev)
+#else
+#define SPI_EEPROM_TRACE_EVENT(dev, event)      do { } while (0)
+#define SPI_EEPROM_TRACE_COMMAND(dev, cmd)       do { } while (0)
+#define SPI_EEPROM_TRACE_STAMP(time)             do { } while (0)
+#define SPI_EEPROM_TRACE_SUBMITTED(dev, time)    do { } while (0)
+#define SPI_EEPROM_TRACE_URGENT(dev)             do { } while (0)
+#define SPI_EEPROM_TRACE_SUSPEND(dev)            do { } while (0)
+#define SPI_EEPROM_TRACE_RESUME(dev)             do { } while (0)
+#endif
+
+/******************************************************************************
+ * Structure/Enum type declaration
+ ******************************************************************************/
+/* Points in the life of an operation */
+typedef enum
+{
+    SPI_EEPROM_TRACE_START,         /* Operation started by the driver */
+    SPI_EEPROM_TRACE_FIRST_BYTE,    /* Bus granted, DMA channels enabled */
+    SPI_EEPROM_TRACE_DMA_DONE,      /* DMA transfer completed */
+    SPI_EEPROM_TRACE_WIP_WAIT,      /* WIP poll scheduled on the timer */
+    SPI_EEPROM_TRACE_WIP_CLEAR,     /* Status register shows WIP cleared */
+    SPI_EEPROM_TRACE_CALLBACK,      /* Completion callback entered */
+    SPI_EEPROM_TRACE_END            /* Completion callback returned */
+} spi_eeprom_trace_event_t;
+
+/* Operation types with separate histograms, by the command they send */
+typedef enum
+{
+    SPI_EEPROM_TRACE_READ,          /* Read, compare and CRC */
+    SPI_EEPROM_TRACE_PROGRAM,       /* Page programs, verified or not */
+    SPI_EEPROM_TRACE_ERASE,         /* Sector, block and chip erase */
+    SPI_EEPROM_TRACE_OTHER,         /* Register access */
+    SPI_EEPROM_TRACE_URGENT,        /* Critical operations, e.g. urgent reads */
+    SPI_EEPROM_TRACE_CLASSES
+} spi_eeprom_trace_class_t;
+
+/* Intervals measured for each operation. Time the driver spends between
+ * the DMA transfers of an operation is counted as setup when it follows the
+ * start, as ISR when it follows a DMA completion; both include waiting for
+ * the bus while another device transfers */
+typedef enum
+{
+    SPI_EEPROM_TRACE_QUEUE,         /* spi_eeprom_submit to start */
+    SPI_EEPROM_TRACE_SETUP,         /* Start to first byte: command and descriptors */
+    SPI_EEPROM_TRACE_TRANSFER,      /* First byte to DMA done, all transfers */
+    SPI_EEPROM_TRACE_ISR,           /* DMA done to the next transfer or callback */
+    SPI_EEPROM_TRACE_BUSY,          /* First WIP poll scheduled to WIP clear */
+    SPI_EEPROM_TRACE_CB,            /* Completion callback */
+    SPI_EEPROM_TRACE_TOTAL,         /* Submit or start to callback returned */
+    SPI_EEPROM_TRACE_INTERVALS
+} spi_eeprom_trace_interval_t;
+
+/* Durations of one interval of one operation type, in microseconds */
+typedef struct
+{
+    uint32_t    count;
+    uint32_t    max;
+    uint64_t    sum;
+    uint16_t    buckets[SPI_EEPROM_TRACE_BUCKETS];  /* Saturate at UINT16_MAX */
+} spi_eeprom_trace_hist_t;
+
+/* Output of spi_eeprom_trace_dump, e.g. a wrapper of Cy_SCB_UART_PutString */
+typedef void (*spi_eeprom_trace_print_t)(const char *line);
+
+/******************************************************************************
+ * Global function declaration
+ ******************************************************************************/
+uint32_t spi_eeprom_trace_init(void);
+uint32_t spi_eeprom_trace_now(void);
+void spi_eeprom_trace_event(uint32_t device, spi_eeprom_trace_event_t event);
+void spi_eeprom_trace_command(uint32_t device, uint8_t cmd);
+void spi_eeprom_trace_submitted(uint32_t device, uint32_t time);
+void spi_eeprom_trace_urgent(uint32_t device);
+void spi_eeprom_trace_suspend(uint32_t device);
+void spi_eeprom_trace_resume(uint32_t device);
+void spi_eeprom_trace_get(spi_eeprom_trace_class_t cls, spi_eeprom_trace_interval_t interval,
+        spi_eeprom_trace_hist_t *hist);
+uint32_t spi_eeprom_trace_percentile(const spi_eeprom_trace_hist_t *hist, uint32_t percent);
+void spi_eeprom_trace_reset(void);
+void spi_eeprom_trace_dump(spi_eeprom_trace_print_t print);
+
+#endif /* SOURCE_SPI_EEPROM_TRACE_H_ */
+
+/* [] END OF FILE */
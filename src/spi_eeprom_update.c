@@ -0,0 +1,615 @@
+/******************************************************************************
+ * File Name: spi_eeprom_update.c
+ *
+ * Description: Source file for in-place updates of the EEPROM without erase.
+ *              Programs only the pages that differ when the new data just clears
+ *              bits, and erases and rewrites a sector only when it sets bits.
+ *
+ * Related Document: See README.md
+ *
+ *******************************************************************************
+ * Copyright 2023, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+
+
+/*******************************************************************************
+ * Include header files
+ ******************************************************************************/
+#include <string.h>
+#include "spi_eeprom_update.h"
+
+/*******************************************************************************
+* Global variables declaration
+*******************************************************************************/
+/* Steps of an update, per sector */
+typedef enum
+{
+    UPDATE_IDLE,
+    UPDATE_READ,            /* Reading the current content of the range */
+    UPDATE_PROGRAM,         /* Programming the pages that differ */
+    UPDATE_READ_HEAD,       /* Reading the sector before the range */
+    UPDATE_READ_TAIL,       /* Reading the sector after the range */
+    UPDATE_ERASE,           /* Erasing the sector */
+    UPDATE_REWRITE,         /* Programming the sector again */
+    UPDATE_COMPARE,         /* Comparing a page for spi_eeprom_write_changed */
+    UPDATE_WRITE            /* Programming a page that differs */
+} update_state_t;
+
+/* Update in progress; lo..hi is the part of the range in the current sector */
+static struct
+{
+    volatile update_state_t state;
+    uint32_t start;         /* First address of the range, data[0] */
+    uint32_t addr;          /* First address of the range not done yet */
+    const uint8_t *data;
+    uint32_t end;
+    uint32_t sector;        /* Start address of the current sector */
+    uint32_t lo;
+    uint32_t hi;
+    uint32_t cursor;        /* Next address to examine in UPDATE_PROGRAM / UPDATE_REWRITE */
+    spi_eeprom_callback_t cb;
+    void *ctx;
+} update;
+
+/* Current content of the sector */
+static uint8_t sector_buf[SPI_EEPROM_UPDATE_SECTOR_SIZE];
+
+static spi_eeprom_update_stats_t update_stats;
+
+/* Internal functions */
+static void update_step(eeprom_dma_status_t status, cy_rslt_t error, void *ctx);
+
+/*******************************************************************************
+ * Function Name: update_finish
+ *******************************************************************************
+ *
+ * Summary:
+ *  End the update and call its callback.
+ *
+ ******************************************************************************/
+static void update_finish(eeprom_dma_status_t status, cy_rslt_t error)
+{
+    spi_eeprom_callback_t cb = update.cb;
+
+    update.state = UPDATE_IDLE;
+    if (status == INIT_SUCCESS)
+    {
+        update_stats.updates++;
+    }
+    if (cb != NULL)
+    {
+        cb(status, error, update.ctx);
+    }
+}
+
+/*******************************************************************************
+ * Function Name: submit
+ *******************************************************************************
+ *
+ * Summary:
+ *  Queue the next operation of the update, entering state. Ends the update
+ *  if the queue refuses it.
+ *
+ ******************************************************************************/
+static void submit(update_state_t state, spi_eeprom_op_t op, uint32_t addr, uint8_t *buffer, uint32_t size)
+{
+    eeprom_dma_status_t status;
+
+    update.state = state;
+    status = spi_eeprom_submit(op, addr, buffer, size, update_step, NULL);
+    if (status != STATE_UNCONFIRMED_SUCCESS)
+    {
+        update_finish(status, CY_RSLT_SUCCESS);
+    }
+}
+
+/*******************************************************************************
+ * Function Name: typical_us
+ *******************************************************************************
+ *
+ * Summary:
+ *  Typical time of operation t on the selected EEPROM.
+ *
+ ******************************************************************************/
+static uint32_t typical_us(spi_eeprom_time_t t)
+{
+    return spi_eeprom_get_geometry(spi_eeprom_get_device())->t_typ_us[t];
+}
+
+/*******************************************************************************
+ * Function Name: update_skip
+ *******************************************************************************
+ *
+ * Summary:
+ *  Count a page of size bytes of the range as unchanged.
+ *
+ ******************************************************************************/
+static void update_skip(uint32_t size)
+{
+    update_stats.pages_unchanged++;
+    update_stats.bytes_skipped += size;
+    update_stats.us_skipped += typical_us(SPI_EEPROM_TIME_PP);
+}
+
+/*******************************************************************************
+ * Function Name: sector_start
+ *******************************************************************************
+ *
+ * Summary:
+ *  Read the current content of the part of the range in the next sector, or
+ *  finish the update if the whole range is done.
+ *
+ ******************************************************************************/
+static void sector_start(void)
+{
+    if (update.addr >= update.end)
+    {
+        update_finish(INIT_SUCCESS, CY_RSLT_SUCCESS);
+        return;
+    }
+
+    update.sector = update.addr & ~(SPI_EEPROM_UPDATE_SECTOR_SIZE - 1u);
+    update.lo = update.addr;
+    update.hi = update.sector + SPI_EEPROM_UPDATE_SECTOR_SIZE;
+    if (update.hi > update.end)
+    {
+        update.hi = update.end;
+    }
+    submit(UPDATE_READ, SPI_EEPROM_OP_READ, update.lo, &sector_buf[update.lo - update.sector],
+           update.hi - update.lo);
+}
+
+/*******************************************************************************
+ * Function Name: new_byte
+ *******************************************************************************
+ *
+ * Summary:
+ *  New data for an address within the range.
+ *
+ ******************************************************************************/
+static uint8_t new_byte(uint32_t a)
+{
+    return update.data[a - update.start];
+}
+
+/*******************************************************************************
+ * Function Name: sector_programmable
+ *******************************************************************************
+ *
+ * Summary:
+ *  Check whether the new data only clears bits of the current content
+ *  (old & new == new), so it can be programmed without erase.
+ *
+ ******************************************************************************/
+static bool sector_programmable(void)
+{
+    for (uint32_t a = update.lo; a < update.hi; a++)
+    {
+        uint8_t n = new_byte(a);
+
+        if ((sector_buf[a - update.sector] & n) != n)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*******************************************************************************
+ * Function Name: program_next
+ *******************************************************************************
+ *
+ * Summary:
+ *  Program the differing bytes of the next page of lo..hi that differs.
+ *  Pages holding the data already are skipped.
+ *
+ ******************************************************************************/
+static void program_next(void)
+{
+    while (update.cursor < update.hi)
+    {
+        uint32_t page_end = (update.cursor | (EEPROM_PAGE_SIZE - 1u)) + 1u;
+        uint32_t first = UINT32_MAX;
+        uint32_t last = 0;
+
+        if (page_end > update.hi)
+        {
+            page_end = update.hi;
+        }
+        for (uint32_t a = update.cursor; a < page_end; a++)
+        {
+            if (sector_buf[a - update.sector] != new_byte(a))
+            {
+                first = (first == UINT32_MAX) ? a : first;
+                last = a;
+            }
+        }
+
+        if (first == UINT32_MAX)
+        {
+            update_skip(page_end - update.cursor);
+            update.cursor = page_end;
+            continue;
+        }
+        update.cursor = page_end;
+        update_stats.pages_programmed++;
+        submit(UPDATE_PROGRAM, SPI_EEPROM_OP_WRITE, first, (uint8_t *) &update.data[first - update.start],
+               last - first + 1u);
+        return;
+    }
+
+    /* Sector done */
+    update.addr = update.hi;
+    sector_start();
+}
+
+/*******************************************************************************
+ * Function Name: rewrite_next
+ *******************************************************************************
+ *
+ * Summary:
+ *  Program the next run of pages of the erased sector that are not blank.
+ *
+ ******************************************************************************/
+static void rewrite_next(void)
+{
+    const uint32_t sector_end = update.sector + SPI_EEPROM_UPDATE_SECTOR_SIZE;
+    uint32_t first = UINT32_MAX;
+
+    while (update.cursor < sector_end)
+    {
+        bool blank = true;
+
+        for (uint32_t i = 0; blank && (i < EEPROM_PAGE_SIZE); i++)
+        {
+            blank = (sector_buf[update.cursor - update.sector + i] == 0xFFu);
+        }
+        if (blank && (first != UINT32_MAX))
+        {
+            break;
+        }
+        if (!blank)
+        {
+            first = (first == UINT32_MAX) ? update.cursor : first;
+            update_stats.pages_programmed++;
+        }
+        update.cursor += EEPROM_PAGE_SIZE;
+    }
+
+    if (first != UINT32_MAX)
+    {
+        submit(UPDATE_REWRITE, SPI_EEPROM_OP_WRITE, first, &sector_buf[first - update.sector],
+               update.cursor - first);
+        return;
+    }
+
+    /* Sector done */
+    update.addr = update.hi;
+    sector_start();
+}
+
+/*******************************************************************************
+ * Function Name: changed_next
+ *******************************************************************************
+ *
+ * Summary:
+ *  Compare the next page of the range for spi_eeprom_write_changed, or
+ *  finish once the whole range is done.
+ *
+ ******************************************************************************/
+static void changed_next(void)
+{
+    if (update.addr >= update.end)
+    {
+        update_finish(INIT_SUCCESS, CY_RSLT_SUCCESS);
+        return;
+    }
+
+    update.lo = update.addr;
+    update.hi = (update.addr | (EEPROM_PAGE_SIZE - 1u)) + 1u;
+    if (update.hi > update.end)
+    {
+        update.hi = update.end;
+    }
+    submit(UPDATE_COMPARE, SPI_EEPROM_OP_COMPARE, update.lo, (uint8_t *) &update.data[update.lo - update.start],
+           update.hi - update.lo);
+}
+
+/*******************************************************************************
+ * Function Name: update_step
+ *******************************************************************************
+ *
+ * Summary:
+ *  Completion callback of every operation of the update, executed as part of
+ *  the DMA interrupt; queues the next one.
+ *
+ ******************************************************************************/
+static void update_step(eeprom_dma_status_t status, cy_rslt_t error, void *ctx)
+{
+    (void) ctx;
+
+    if ((update.state == UPDATE_COMPARE) && (status == STATE_COMPARE_MISMATCH))
+    {
+        update_stats.pages_programmed++;
+        submit(UPDATE_WRITE, SPI_EEPROM_OP_WRITE, update.lo, (uint8_t *) &update.data[update.lo - update.start],
+               update.hi - update.lo);
+        return;
+    }
+    if (status != INIT_SUCCESS)
+    {
+        update_finish(status, error);
+        return;
+    }
+
+    switch (update.state)
+    {
+        case UPDATE_COMPARE:
+            update_skip(update.hi - update.lo);
+            /* fall through */
+        case UPDATE_WRITE:
+            update.addr = update.hi;
+            changed_next();
+            break;
+        case UPDATE_READ:
+            if (sector_programmable())
+            {
+                update_stats.sectors_in_place++;
+                update_stats.us_skipped += typical_us(SPI_EEPROM_TIME_SE);
+                update.cursor = update.lo;
+                program_next();
+                break;
+            }
+            update_stats.sectors_erased++;
+            if (update.lo > update.sector)
+            {
+                submit(UPDATE_READ_HEAD, SPI_EEPROM_OP_READ, update.sector, sector_buf,
+                       update.lo - update.sector);
+                break;
+            }
+            /* fall through */
+        case UPDATE_READ_HEAD:
+            if (update.hi < (update.sector + SPI_EEPROM_UPDATE_SECTOR_SIZE))
+            {
+                submit(UPDATE_READ_TAIL, SPI_EEPROM_OP_READ, update.hi, &sector_buf[update.hi - update.sector],
+                       update.sector + SPI_EEPROM_UPDATE_SECTOR_SIZE - update.hi);
+                break;
+            }
+            /* fall through */
+        case UPDATE_READ_TAIL:
+            for (uint32_t a = update.lo; a < update.hi; a++)
+            {
+                sector_buf[a - update.sector] = new_byte(a);
+            }
+            submit(UPDATE_ERASE, SPI_EEPROM_OP_ERASE_4K, update.sector, NULL, 0);
+            break;
+        case UPDATE_ERASE:
+            update.cursor = update.sector;
+            rewrite_next();
+            break;
+        case UPDATE_PROGRAM:
+            program_next();
+            break;
+        case UPDATE_REWRITE:
+            rewrite_next();
+            break;
+        default:
+            break;
+    }
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_update
+ *******************************************************************************
+ *
+ * Summary:
+ *  Replace a range of the EEPROM with new data, erasing only where needed.
+ *  NOR programming can only clear bits, so for each 4 KB sector of the
+ *  range the current content is read and compared: if the new data only
+ *  clears bits (old & new == new), just the pages that differ are programmed
+ *  and the erase is skipped. Otherwise the rest of the sector is read, the
+ *  sector erased and its pages that are not blank programmed again.
+ *
+ *  Runs as a chain of spi_eeprom_submit operations from the DMA interrupt.
+ *  One update at a time.
+ *
+ * Parameters:
+ *  addr Byte address to start writing to.
+ *  data New data. Must stay valid until cb.
+ *  size Number of bytes to be written.
+ *  cb Called as part of the DMA interrupt when the update has completed,
+ *     may be NULL.
+ *  ctx User context passed to cb.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) STATE_UNCONFIRMED_SUCCESS if the update was
+ *  started, STATE_QUEUE_FULL if an update is in progress or the queue is
+ *  full, STATE_INVALID_ARGUMENT or STATE_INVALID_PAGE for invalid
+ *  arguments.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_update(uint32_t addr, const uint8_t *data, uint32_t size,
+        spi_eeprom_callback_t cb, void *ctx)
+{
+    const uint32_t eeprom_size = spi_eeprom_get_geometry(spi_eeprom_get_device())->size;
+    uint32_t intr;
+    bool started;
+
+    if ((data == NULL) || (size == 0))
+    {
+        return STATE_INVALID_ARGUMENT;
+    }
+    if ((addr >= eeprom_size) || (size > (eeprom_size - addr)))
+    {
+        return STATE_INVALID_PAGE;
+    }
+
+    intr = Cy_SysLib_EnterCriticalSection();
+    if (update.state != UPDATE_IDLE)
+    {
+        Cy_SysLib_ExitCriticalSection(intr);
+        return STATE_QUEUE_FULL;
+    }
+    update.start = addr;
+    update.addr = addr;
+    update.data = data;
+    update.end = addr + size;
+
+    /* If the queue refuses the first read, the update ends without a
+     * callback and the caller gets the error instead */
+    update.cb = NULL;
+    sector_start();
+    started = (update.state != UPDATE_IDLE);
+    if (started)
+    {
+        update.cb = cb;
+        update.ctx = ctx;
+    }
+    Cy_SysLib_ExitCriticalSection(intr);
+
+    return started ? STATE_UNCONFIRMED_SUCCESS : STATE_QUEUE_FULL;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_write_changed
+ *******************************************************************************
+ *
+ * Summary:
+ *  Write a range of the EEPROM, skipping pages that hold the data already.
+ *  Each page is compared first with spi_eeprom_compare_range, which needs no
+ *  buffer for the current content, and programmed only if it differs. Pages
+ *  that differ are programmed as by spi_eeprom_write_range, so they must be
+ *  blank; meant for rewriting content such as a firmware image that is
+ *  mostly unchanged, after spi_eeprom_erase_range with blank check has
+ *  erased only the sectors that changed. Use spi_eeprom_update for content
+ *  that is neither blank nor identical.
+ *
+ *  Runs as a chain of spi_eeprom_submit operations from the DMA interrupt.
+ *  Shares its state with spi_eeprom_update, one of them at a time.
+ *
+ * Parameters:
+ *  addr Byte address to start writing to.
+ *  data New data. Must stay valid until cb.
+ *  size Number of bytes to be written.
+ *  cb Called as part of the DMA interrupt when the write has completed,
+ *     may be NULL.
+ *  ctx User context passed to cb.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) STATE_UNCONFIRMED_SUCCESS if the write was started,
+ *  STATE_QUEUE_FULL if an update is in progress or the queue is full,
+ *  STATE_INVALID_ARGUMENT or STATE_INVALID_PAGE for invalid arguments.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_write_changed(uint32_t addr, const uint8_t *data, uint32_t size,
+        spi_eeprom_callback_t cb, void *ctx)
+{
+    const uint32_t eeprom_size = spi_eeprom_get_geometry(spi_eeprom_get_device())->size;
+    uint32_t intr;
+    bool started;
+
+    if ((data == NULL) || (size == 0))
+    {
+        return STATE_INVALID_ARGUMENT;
+    }
+    if ((addr >= eeprom_size) || (size > (eeprom_size - addr)))
+    {
+        return STATE_INVALID_PAGE;
+    }
+
+    intr = Cy_SysLib_EnterCriticalSection();
+    if (update.state != UPDATE_IDLE)
+    {
+        Cy_SysLib_ExitCriticalSection(intr);
+        return STATE_QUEUE_FULL;
+    }
+    update.start = addr;
+    update.addr = addr;
+    update.data = data;
+    update.end = addr + size;
+
+    /* If the queue refuses the first compare, the update ends without a
+     * callback and the caller gets the error instead */
+    update.cb = NULL;
+    changed_next();
+    started = (update.state != UPDATE_IDLE);
+    if (started)
+    {
+        update.cb = cb;
+        update.ctx = ctx;
+    }
+    Cy_SysLib_ExitCriticalSection(intr);
+
+    return started ? STATE_UNCONFIRMED_SUCCESS : STATE_QUEUE_FULL;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_update_busy
+ *******************************************************************************
+ *
+ * Summary:
+ *  Return whether spi_eeprom_update or spi_eeprom_write_changed is in
+ *  progress.
+ *
+ * Parameters:
+ *  None
+ *
+ * Return:
+ *  (bool) true while an update is in progress.
+ *
+ ******************************************************************************/
+bool spi_eeprom_update_busy(void)
+{
+    return update.state != UPDATE_IDLE;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_update_get_stats
+ *******************************************************************************
+ *
+ * Summary:
+ *  Counters of sectors updated in place or erased, pages programmed and
+ *  work skipped.
+ *
+ * Parameters:
+ *  stats Filled with the counters.
+ *
+ * Return:
+ *  None
+ *
+ ******************************************************************************/
+void spi_eeprom_update_get_stats(spi_eeprom_update_stats_t *stats)
+{
+    *stats = update_stats;
+}
+
+/* [] END OF FILE */
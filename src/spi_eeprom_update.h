@@ -0,0 +1,86 @@
+/******************************************************************************
+ * File Name: spi_eeprom_update.h
+ *
+ * Description: Header file for in-place updates of the EEPROM without erase.
+ *
+ * Related Document: See README.md
+ *
+ *******************************************************************************
+ * Copyright 2023, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+
+
+#ifndef SOURCE_SPI_EEPROM_UPDATE_H_
+#define SOURCE_SPI_EEPROM_UPDATE_H_
+
+/*******************************************************************************
+ * Include header files
+ ******************************************************************************/
+#include "spi_eeprom_master.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Erase unit of the fallback; a RAM buffer of this size holds the sector
+ * content while it is erased and programmed again */
+#define SPI_EEPROM_UPDATE_SECTOR_SIZE   (0x1000u)
+
+/******************************************************************************
+ * Structure/Enum type declaration
+ ******************************************************************************/
+/* Counters of spi_eeprom_update and spi_eeprom_write_changed since
+ * initialization */
+typedef struct
+{
+    uint32_t    updates;            /* Completed updates */
+    uint32_t    sectors_in_place;   /* Sectors updated by programming only */
+    uint32_t    sectors_erased;     /* Sectors erased and programmed again */
+    uint32_t    pages_programmed;   /* Page programs issued */
+    uint32_t    pages_unchanged;    /* Pages of the range already holding the data */
+    uint32_t    bytes_skipped;      /* Bytes of the unchanged pages */
+    uint32_t    us_skipped;         /* Typical program and erase time saved */
+} spi_eeprom_update_stats_t;
+
+/******************************************************************************
+ * Global function declaration
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_update(uint32_t addr, const uint8_t *data, uint32_t size,
+        spi_eeprom_callback_t cb, void *ctx);
+eeprom_dma_status_t spi_eeprom_write_changed(uint32_t addr, const uint8_t *data, uint32_t size,
+        spi_eeprom_callback_t cb, void *ctx);
+bool spi_eeprom_update_busy(void);
+void spi_eeprom_update_get_stats(spi_eeprom_update_stats_t *stats);
+
+#endif /* SOURCE_SPI_EEPROM_UPDATE_H_ */
+
+/* [] END OF FILE */
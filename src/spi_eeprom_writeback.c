@@ -0,0 +1,628 @@
+/******************************************************************************
+ * File Name: spi_eeprom_writeback.c
+ *
+ * Description: Source file for the write-back buffer of the EEPROM interface.
+ *              Merges small writes per page in RAM and programs each page once
+ *              through the operation queue.
+ *
+ * Related Document: See README.md
+ *
+ *******************************************************************************
+ * Copyright 2023, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+
+
+/*******************************************************************************
+ * Include header files
+ ******************************************************************************/
+#include <string.h>
+#include "spi_eeprom_writeback.h"
+
+/*******************************************************************************
+* Global variables declaration
+*******************************************************************************/
+/* States of a page buffer */
+typedef enum
+{
+    WB_FREE,
+    WB_DIRTY,               /* Collecting writes */
+    WB_FLUSHING             /* Program queued, data must stay unchanged */
+} wb_state_t;
+
+/* Page buffer; bytes outside lo..hi are 0xFF */
+typedef struct
+{
+    volatile wb_state_t state;
+    uint32_t page_addr;
+    uint16_t lo;            /* First written byte */
+    uint16_t hi;            /* One past the last written byte */
+    uint8_t data[EEPROM_PAGE_SIZE];
+} wb_slot_t;
+
+static wb_slot_t slots[SPI_EEPROM_WB_PAGES];
+
+/* Programs of a flush in progress and the callback for the last one */
+static struct
+{
+    uint32_t outstanding;
+    eeprom_dma_status_t status;     /* First program that failed */
+    cy_rslt_t error;
+    spi_eeprom_callback_t cb;
+    void *ctx;
+} flush;
+
+/* Age of the oldest write not yet flushed */
+static uint32_t dirty_age_ms;
+
+/* Read of spi_eeprom_buffered_read in progress */
+static struct
+{
+    bool busy;
+    uint32_t addr;
+    uint8_t *buffer;
+    uint32_t size;
+    spi_eeprom_callback_t cb;
+    void *ctx;
+} wb_read;
+
+static spi_eeprom_wb_stats_t wb_stats;
+
+/*******************************************************************************
+ * Function Name: find_dirty
+ *******************************************************************************
+ *
+ * Summary:
+ *  Page buffer collecting writes for page_addr, NULL if there is none.
+ *
+ ******************************************************************************/
+static wb_slot_t *find_dirty(uint32_t page_addr)
+{
+    for (uint32_t i = 0; i < SPI_EEPROM_WB_PAGES; i++)
+    {
+        if ((slots[i].state == WB_DIRTY) && (slots[i].page_addr == page_addr))
+        {
+            return &slots[i];
+        }
+    }
+    return NULL;
+}
+
+/*******************************************************************************
+ * Function Name: find_free
+ *******************************************************************************
+ *
+ * Summary:
+ *  Unused page buffer, NULL if all are in use.
+ *
+ ******************************************************************************/
+static wb_slot_t *find_free(void)
+{
+    for (uint32_t i = 0; i < SPI_EEPROM_WB_PAGES; i++)
+    {
+        if (slots[i].state == WB_FREE)
+        {
+            return &slots[i];
+        }
+    }
+    return NULL;
+}
+
+/*******************************************************************************
+ * Function Name: dirty_bytes
+ *******************************************************************************
+ *
+ * Summary:
+ *  Bytes spanned by the writes collected so far.
+ *
+ ******************************************************************************/
+static uint32_t dirty_bytes(void)
+{
+    uint32_t bytes = 0;
+
+    for (uint32_t i = 0; i < SPI_EEPROM_WB_PAGES; i++)
+    {
+        if (slots[i].state == WB_DIRTY)
+        {
+            bytes += slots[i].hi - slots[i].lo;
+        }
+    }
+    return bytes;
+}
+
+/*******************************************************************************
+ * Function Name: program_done
+ *******************************************************************************
+ *
+ * Summary:
+ *  Completion callback of the page program of one buffer, executed as part
+ *  of the DMA interrupt. The buffer is released. If the program failed, its
+ *  data collects writes again, merged into a newer buffer of the same page
+ *  if there is one, and goes out with the next flush. The callback of
+ *  spi_eeprom_flush follows the last program, with the status of the first
+ *  one that failed.
+ *
+ ******************************************************************************/
+static void program_done(eeprom_dma_status_t status, cy_rslt_t error, void *ctx)
+{
+    wb_slot_t *slot = (wb_slot_t *) ctx;
+    wb_slot_t *newer = find_dirty(slot->page_addr);
+    spi_eeprom_callback_t cb;
+
+    if (status == INIT_SUCCESS)
+    {
+        slot->state = WB_FREE;
+    }
+    else if (newer != NULL)
+    {
+        for (uint32_t i = slot->lo; i < slot->hi; i++)
+        {
+            newer->data[i] &= slot->data[i];
+        }
+        newer->lo = (slot->lo < newer->lo) ? slot->lo : newer->lo;
+        newer->hi = (slot->hi > newer->hi) ? slot->hi : newer->hi;
+        slot->state = WB_FREE;
+    }
+    else
+    {
+        slot->state = WB_DIRTY;
+    }
+    if ((status != INIT_SUCCESS) && (flush.status == INIT_SUCCESS))
+    {
+        flush.status = status;
+        flush.error = error;
+    }
+
+    if (--flush.outstanding == 0)
+    {
+        cb = flush.cb;
+        status = flush.status;
+        error = flush.error;
+        flush.cb = NULL;
+        flush.status = INIT_SUCCESS;
+        flush.error = CY_RSLT_SUCCESS;
+        if (cb != NULL)
+        {
+            cb(status, error, flush.ctx);
+        }
+    }
+}
+
+/*******************************************************************************
+ * Function Name: flush_start
+ *******************************************************************************
+ *
+ * Summary:
+ *  Queue one program for each page buffer that collects writes. Called with
+ *  interrupts disabled.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) STATE_UNCONFIRMED_SUCCESS, or the error of
+ *  spi_eeprom_submit; buffers not queued stay dirty.
+ *
+ ******************************************************************************/
+static eeprom_dma_status_t flush_start(void)
+{
+    eeprom_dma_status_t status = STATE_UNCONFIRMED_SUCCESS;
+
+    for (uint32_t i = 0; i < SPI_EEPROM_WB_PAGES; i++)
+    {
+        wb_slot_t *slot = &slots[i];
+
+        if (slot->state != WB_DIRTY)
+        {
+            continue;
+        }
+        status = spi_eeprom_submit(SPI_EEPROM_OP_WRITE, slot->page_addr * EEPROM_PAGE_SIZE + slot->lo,
+                &slot->data[slot->lo], slot->hi - slot->lo, program_done, slot);
+        if (status != STATE_UNCONFIRMED_SUCCESS)
+        {
+            break;
+        }
+        slot->state = WB_FLUSHING;
+        flush.outstanding++;
+        wb_stats.programs++;
+    }
+    wb_stats.flushes++;
+    dirty_age_ms = 0;
+    return status;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_writeback_init
+ *******************************************************************************
+ *
+ * Summary:
+ *  Discard all buffered data and reset the counters. To be called after
+ *  spi_eeprom_init.
+ *
+ * Parameters:
+ *  None
+ *
+ * Return:
+ *  None
+ *
+ ******************************************************************************/
+void spi_eeprom_writeback_init(void)
+{
+    memset(slots, 0, sizeof(slots));
+    memset(&flush, 0, sizeof(flush));
+    memset(&wb_read, 0, sizeof(wb_read));
+    memset(&wb_stats, 0, sizeof(wb_stats));
+    dirty_age_ms = 0;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_buffered_write
+ *******************************************************************************
+ *
+ * Summary:
+ *  Write through the write-back buffer. The data is copied into a RAM buffer
+ *  of its page, merged with earlier writes to the same page, and programmed
+ *  later with one page program per page. Merging follows NOR programming:
+ *  a buffer holds the AND of all data written to it, so the EEPROM ends up
+ *  exactly as with one program per write.
+ *
+ *  A flush starts when SPI_EEPROM_WB_FLUSH_BYTES are buffered, when the last
+ *  free buffer has been taken, when spi_eeprom_writeback_tick reports
+ *  SPI_EEPROM_WB_TIMEOUT_MS since the first buffered write, or on
+ *  spi_eeprom_flush. The target range must be erased beforehand as for
+ *  spi_eeprom_write_range.
+ *
+ * Parameters:
+ *  addr Byte address to start writing to.
+ *  data Data to be written; may be reused when the function returns.
+ *  size Number of bytes to be written.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) INIT_SUCCESS if the data is buffered,
+ *  STATE_QUEUE_FULL if there are not enough free buffers (a flush is then
+ *  in progress, retry once it completes), STATE_INVALID_ARGUMENT or
+ *  STATE_INVALID_PAGE for invalid arguments. Nothing is buffered on error.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_buffered_write(uint32_t addr, const uint8_t *data, uint32_t size)
+{
+    const uint32_t eeprom_size = spi_eeprom_get_geometry(spi_eeprom_get_device())->size;
+    uint32_t first = addr / EEPROM_PAGE_SIZE;
+    uint32_t last = (addr + size - 1u) / EEPROM_PAGE_SIZE;
+    uint32_t needed = 0;
+    uint32_t free_slots = 0;
+    uint32_t intr;
+
+    if ((data == NULL) || (size == 0))
+    {
+        return STATE_INVALID_ARGUMENT;
+    }
+    if ((addr >= eeprom_size) || (size > (eeprom_size - addr)))
+    {
+        return STATE_INVALID_PAGE;
+    }
+
+    intr = Cy_SysLib_EnterCriticalSection();
+
+    /* All pages must fit, so that a write is buffered entirely or not at all */
+    for (uint32_t page = first; page <= last; page++)
+    {
+        if (find_dirty(page) == NULL)
+        {
+            needed++;
+        }
+    }
+    for (uint32_t i = 0; i < SPI_EEPROM_WB_PAGES; i++)
+    {
+        free_slots += (slots[i].state == WB_FREE) ? 1u : 0u;
+    }
+    if (needed > free_slots)
+    {
+        (void) flush_start();
+        Cy_SysLib_ExitCriticalSection(intr);
+        return STATE_QUEUE_FULL;
+    }
+
+    if (dirty_bytes() == 0)
+    {
+        dirty_age_ms = 0;
+    }
+    while (size > 0)
+    {
+        uint32_t page = addr / EEPROM_PAGE_SIZE;
+        uint32_t offset = addr % EEPROM_PAGE_SIZE;
+        uint32_t chunk = EEPROM_PAGE_SIZE - offset;
+        wb_slot_t *slot = find_dirty(page);
+
+        if (chunk > size)
+        {
+            chunk = size;
+        }
+        if (slot == NULL)
+        {
+            /* Never NULL, free buffers were counted above */
+            slot = find_free();
+            if (slot == NULL)
+            {
+                break;
+            }
+            memset(slot->data, 0xFF, sizeof(slot->data));
+            slot->page_addr = page;
+            slot->lo = EEPROM_PAGE_SIZE;
+            slot->hi = 0;
+            slot->state = WB_DIRTY;
+        }
+        for (uint32_t i = 0; i < chunk; i++)
+        {
+            slot->data[offset + i] &= data[i];
+        }
+        if (offset < slot->lo)
+        {
+            slot->lo = offset;
+        }
+        if ((offset + chunk) > slot->hi)
+        {
+            slot->hi = offset + chunk;
+        }
+
+        addr += chunk;
+        data += chunk;
+        size -= chunk;
+    }
+    wb_stats.writes++;
+
+    if ((dirty_bytes() >= SPI_EEPROM_WB_FLUSH_BYTES) || (find_free() == NULL))
+    {
+        (void) flush_start();
+    }
+    Cy_SysLib_ExitCriticalSection(intr);
+    return INIT_SUCCESS;
+}
+
+/*******************************************************************************
+ * Function Name: read_done
+ *******************************************************************************
+ *
+ * Summary:
+ *  Completion callback of spi_eeprom_buffered_read: apply the writes still
+ *  buffered to the data read, then call the caller's callback.
+ *
+ ******************************************************************************/
+static void read_done(eeprom_dma_status_t status, cy_rslt_t error, void *ctx)
+{
+    spi_eeprom_callback_t cb = wb_read.cb;
+
+    (void) ctx;
+    for (uint32_t i = 0; (status == INIT_SUCCESS) && (i < SPI_EEPROM_WB_PAGES); i++)
+    {
+        wb_slot_t *slot = &slots[i];
+        uint32_t from, to;
+
+        if (slot->state == WB_FREE)
+        {
+            continue;
+        }
+        from = slot->page_addr * EEPROM_PAGE_SIZE + slot->lo;
+        to = slot->page_addr * EEPROM_PAGE_SIZE + slot->hi;
+        if (from < wb_read.addr)
+        {
+            from = wb_read.addr;
+        }
+        if (to > (wb_read.addr + wb_read.size))
+        {
+            to = wb_read.addr + wb_read.size;
+        }
+        for (uint32_t a = from; a < to; a++)
+        {
+            wb_read.buffer[a - wb_read.addr] &= slot->data[a % EEPROM_PAGE_SIZE];
+        }
+    }
+
+    wb_read.busy = false;
+    if (cb != NULL)
+    {
+        cb(status, error, wb_read.ctx);
+    }
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_buffered_read
+ *******************************************************************************
+ *
+ * Summary:
+ *  Read through the write-back buffer: the range is read with the operation
+ *  queue and bytes with buffered writes are taken from the buffer, so the
+ *  result is what the EEPROM holds after the next flush. One read at a time.
+ *
+ * Parameters:
+ *  addr Byte address to start reading from.
+ *  buffer Buffer to store data.
+ *  size Number of bytes to be read.
+ *  cb Called as part of the DMA interrupt when the data is complete, may be
+ *     NULL.
+ *  ctx User context passed to cb.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) STATE_UNCONFIRMED_SUCCESS if the read was queued,
+ *  STATE_QUEUE_FULL if a read is in progress or the queue is full, and the
+ *  argument errors of spi_eeprom_submit.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_buffered_read(uint32_t addr, uint8_t *buffer, uint32_t size,
+        spi_eeprom_callback_t cb, void *ctx)
+{
+    eeprom_dma_status_t status;
+    uint32_t intr = Cy_SysLib_EnterCriticalSection();
+
+    if (wb_read.busy)
+    {
+        Cy_SysLib_ExitCriticalSection(intr);
+        return STATE_QUEUE_FULL;
+    }
+    wb_read.busy = true;
+    wb_read.addr = addr;
+    wb_read.buffer = buffer;
+    wb_read.size = size;
+    wb_read.cb = cb;
+    wb_read.ctx = ctx;
+
+    status = spi_eeprom_submit(SPI_EEPROM_OP_READ, addr, buffer, size, read_done, NULL);
+    if (status != STATE_UNCONFIRMED_SUCCESS)
+    {
+        wb_read.busy = false;
+    }
+    Cy_SysLib_ExitCriticalSection(intr);
+    return status;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_flush
+ *******************************************************************************
+ *
+ * Summary:
+ *  Program all buffered writes now.
+ *
+ * Parameters:
+ *  cb Called as part of the DMA interrupt when the last page is programmed,
+ *     or before the function returns if nothing is pending; may be NULL.
+ *     Its status is that of the first program that failed, if any. Not
+ *     called if the function returns an error.
+ *  ctx User context passed to cb.
+ *
+ * Return:
+ *  (eeprom_dma_status_t) STATE_UNCONFIRMED_SUCCESS, STATE_QUEUE_FULL if a
+ *  flush with a callback is still in progress or the operation queue is full.
+ *
+ ******************************************************************************/
+eeprom_dma_status_t spi_eeprom_flush(spi_eeprom_callback_t cb, void *ctx)
+{
+    eeprom_dma_status_t status;
+    uint32_t intr = Cy_SysLib_EnterCriticalSection();
+
+    if ((cb != NULL) && (flush.cb != NULL))
+    {
+        Cy_SysLib_ExitCriticalSection(intr);
+        return STATE_QUEUE_FULL;
+    }
+
+    status = flush_start();
+    if ((status == STATE_UNCONFIRMED_SUCCESS) && (flush.outstanding == 0))
+    {
+        Cy_SysLib_ExitCriticalSection(intr);
+        if (cb != NULL)
+        {
+            cb(INIT_SUCCESS, CY_RSLT_SUCCESS, ctx);
+        }
+        return status;
+    }
+    if ((status == STATE_UNCONFIRMED_SUCCESS) && (cb != NULL))
+    {
+        flush.cb = cb;
+        flush.ctx = ctx;
+    }
+    Cy_SysLib_ExitCriticalSection(intr);
+    return status;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_writeback_tick
+ *******************************************************************************
+ *
+ * Summary:
+ *  Advance the age of buffered writes, e.g. from a periodic timer or the main
+ *  loop, and flush them once it reaches SPI_EEPROM_WB_TIMEOUT_MS.
+ *
+ * Parameters:
+ *  elapsed_ms Time since the last call.
+ *
+ * Return:
+ *  None
+ *
+ ******************************************************************************/
+void spi_eeprom_writeback_tick(uint32_t elapsed_ms)
+{
+    uint32_t intr = Cy_SysLib_EnterCriticalSection();
+
+    if (dirty_bytes() != 0)
+    {
+        dirty_age_ms += elapsed_ms;
+        if (dirty_age_ms >= SPI_EEPROM_WB_TIMEOUT_MS)
+        {
+            (void) flush_start();
+        }
+    }
+    Cy_SysLib_ExitCriticalSection(intr);
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_writeback_clean
+ *******************************************************************************
+ *
+ * Summary:
+ *  Return whether all buffered writes are programmed.
+ *
+ * Parameters:
+ *  None
+ *
+ * Return:
+ *  (bool) true if no buffer is dirty or being flushed.
+ *
+ ******************************************************************************/
+bool spi_eeprom_writeback_clean(void)
+{
+    for (uint32_t i = 0; i < SPI_EEPROM_WB_PAGES; i++)
+    {
+        if (slots[i].state != WB_FREE)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*******************************************************************************
+ * Function Name: spi_eeprom_writeback_get_stats
+ *******************************************************************************
+ *
+ * Summary:
+ *  Counters of buffered writes, page programs and flushes.
+ *
+ * Parameters:
+ *  stats Filled with the counters.
+ *
+ * Return:
+ *  None
+ *
+ ******************************************************************************/
+void spi_eeprom_writeback_get_stats(spi_eeprom_wb_stats_t *stats)
+{
+    *stats = wb_stats;
+}
+
+/* [] END OF FILE */
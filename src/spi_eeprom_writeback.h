@@ -0,0 +1,88 @@
+/******************************************************************************
+ * File Name: spi_eeprom_writeback.h
+ *
+ * Description: Header file for the write-back buffer of the EEPROM interface.
+ *
+ * Related Document: See README.md
+ *
+ *******************************************************************************
+ * Copyright 2023, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+
+
+#ifndef SOURCE_SPI_EEPROM_WRITEBACK_H_
+#define SOURCE_SPI_EEPROM_WRITEBACK_H_
+
+/*******************************************************************************
+ * Include header files
+ ******************************************************************************/
+#include "spi_eeprom_master.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* Page buffers collecting small writes, EEPROM_PAGE_SIZE bytes each */
+#define SPI_EEPROM_WB_PAGES             (4u)
+
+/* Buffered bytes that start a flush */
+#define SPI_EEPROM_WB_FLUSH_BYTES       (EEPROM_PAGE_SIZE)
+
+/* Age of the oldest buffered write that starts a flush */
+#define SPI_EEPROM_WB_TIMEOUT_MS        (100u)
+
+/******************************************************************************
+ * Structure/Enum type declaration
+ ******************************************************************************/
+/* Counters of the write-back buffer since initialization */
+typedef struct
+{
+    uint32_t    writes;         /* Calls of spi_eeprom_buffered_write */
+    uint32_t    programs;       /* Page programs issued by flushes */
+    uint32_t    flushes;        /* Flushes started, by any trigger */
+} spi_eeprom_wb_stats_t;
+
+/******************************************************************************
+ * Global function declaration
+ ******************************************************************************/
+void spi_eeprom_writeback_init(void);
+eeprom_dma_status_t spi_eeprom_buffered_write(uint32_t addr, const uint8_t *data, uint32_t size);
+eeprom_dma_status_t spi_eeprom_buffered_read(uint32_t addr, uint8_t *buffer, uint32_t size,
+        spi_eeprom_callback_t cb, void *ctx);
+eeprom_dma_status_t spi_eeprom_flush(spi_eeprom_callback_t cb, void *ctx);
+void spi_eeprom_writeback_tick(uint32_t elapsed_ms);
+bool spi_eeprom_writeback_clean(void);
+void spi_eeprom_writeback_get_stats(spi_eeprom_wb_stats_t *stats);
+
+#endif /* SOURCE_SPI_EEPROM_WRITEBACK_H_ */
+
+/* [] END OF FILE */
@@ -51,6 +51,12 @@ typedef enum
     STATE_INVALID_ARGUMENT,             /* Invalid argument. */
     STATE_INVALID_COMMAND,              /* Invalid command. */
     STATE_INVALID_PAGE,                 /* Invalid page. */
+    STATE_TRANSFER_ERROR,               /* SPI or DMA error during transfer. */
+    STATE_QUEUE_FULL,                   /* No free entry in the operation queue. */
+    STATE_COMPARE_MISMATCH,             /* EEPROM content differs from the data. */
+    STATE_NOT_FOUND,                    /* Key or device not found. */
+    STATE_NO_SPACE,                     /* No space left in the store. */
+    STATE_BUSY,                         /* Device has an operation in progress or queued. */
     STATE_UNCONFIRMED_SUCCESS = 0x80,   /* Special status code indicating success
                                          * of transmission without checks. */
 } eeprom_dma_status_t;
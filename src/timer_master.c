@@ -0,0 +1,424 @@
+/******************************************************************************
+ * File Name: timer_master.c
+ *
+ * Description: Source file for the TCPWM timer used to schedule delayed work
+ *              from interrupt context.
+ *
+ * Related Document: See README.md
+ *
+ *******************************************************************************
+ * Copyright 2023, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+
+
+/*******************************************************************************
+ * Include header files
+ ******************************************************************************/
+#include <string.h>
+#include "timer_master.h"
+#include "cy_sysint.h"
+#include "cy_tcpwm_counter.h"
+
+/*******************************************************************************
+ * Global variables declaration
+ ******************************************************************************/
+/* One-shot counter, started by timer_start */
+static const cy_stc_tcpwm_counter_config_t timer_config =
+{
+    .period             = TIMER_MAX_TICKS,
+    .clockPrescaler     = CY_TCPWM_COUNTER_PRESCALER_DIVBY_1,
+    .runMode            = CY_TCPWM_COUNTER_ONESHOT,
+    .countDirection     = CY_TCPWM_COUNTER_COUNT_UP,
+    .compareOrCapture   = CY_TCPWM_COUNTER_MODE_COMPARE,
+    .compare0           = 0u,
+    .compare1           = 0u,
+    .enableCompareSwap  = false,
+    .interruptSources   = CY_TCPWM_INT_ON_TC,
+    .captureInputMode   = CY_TCPWM_INPUT_LEVEL,
+    .captureInput       = CY_TCPWM_INPUT_0,
+    .reloadInputMode    = CY_TCPWM_INPUT_LEVEL,
+    .reloadInput        = CY_TCPWM_INPUT_0,
+    .startInputMode     = CY_TCPWM_INPUT_LEVEL,
+    .startInput         = CY_TCPWM_INPUT_0,
+    .stopInputMode      = CY_TCPWM_INPUT_LEVEL,
+    .stopInput          = CY_TCPWM_INPUT_0,
+    .countInputMode     = CY_TCPWM_INPUT_LEVEL,
+    .countInput         = CY_TCPWM_INPUT_1,
+};
+
+static cy_stc_sysint_t timer_int_cfg =
+{
+        .intrSrc      = (IRQn_Type)TIMER_IRQ,
+        .intrPriority = TIMER_INT_PRIORITY,
+};
+
+/* Continuous counter of timer_now */
+static const cy_stc_tcpwm_counter_config_t clock_config =
+{
+    .period             = (1UL << TIMER_CLOCK_BITS) - 1u,
+    .clockPrescaler     = CY_TCPWM_COUNTER_PRESCALER_DIVBY_1,
+    .runMode            = CY_TCPWM_COUNTER_CONTINUOUS,
+    .countDirection     = CY_TCPWM_COUNTER_COUNT_UP,
+    .compareOrCapture   = CY_TCPWM_COUNTER_MODE_COMPARE,
+    .compare0           = 0u,
+    .compare1           = 0u,
+    .enableCompareSwap  = false,
+    .interruptSources   = CY_TCPWM_INT_ON_TC,
+    .captureInputMode   = CY_TCPWM_INPUT_LEVEL,
+    .captureInput       = CY_TCPWM_INPUT_0,
+    .reloadInputMode    = CY_TCPWM_INPUT_LEVEL,
+    .reloadInput        = CY_TCPWM_INPUT_0,
+    .startInputMode     = CY_TCPWM_INPUT_LEVEL,
+    .startInput         = CY_TCPWM_INPUT_0,
+    .stopInputMode      = CY_TCPWM_INPUT_LEVEL,
+    .stopInput          = CY_TCPWM_INPUT_0,
+    .countInputMode     = CY_TCPWM_INPUT_LEVEL,
+    .countInput         = CY_TCPWM_INPUT_1,
+};
+
+static cy_stc_sysint_t clock_int_cfg =
+{
+        .intrSrc      = (IRQn_Type)TIMER_CLOCK_IRQ,
+        .intrPriority = TIMER_INT_PRIORITY,
+};
+
+/* Wraps of the counter of timer_now counted by its interrupt */
+static volatile uint32_t clock_wraps;
+
+/* Pending delay of each channel, in ticks from the start of the segment
+ * running on the counter */
+static struct
+{
+    callback_timer cb;
+    uint32_t remaining;
+    bool running;
+} channels[TIMER_CHANNELS];
+
+/* Length of the segment running on the counter, 0 while it is stopped */
+static uint32_t segment_ticks = 0;
+
+/* Internal functions */
+static void timer_sync(void);
+static void timer_arm(void);
+static void timer_complete(void);
+static void timer_clock_wrap(void);
+
+/******************************************************************************
+* Function Name: timer_init
+*******************************************************************************
+*
+* Summary:
+*  Clock the TCPWM counter with TIMER_TICK_HZ, initialize it as one-shot
+*  counter and register its interrupt. The counter of timer_now shares the
+*  clock and starts running.
+*
+* Parameters:
+*  None
+*
+* Return:
+*  (uint32_t) INIT_SUCCESS or INIT_FAILURE
+*
+******************************************************************************/
+uint32_t timer_init(void)
+{
+    cy_en_sysclk_status_t clk_status;
+
+    clk_status = Cy_SysClk_PeriphDisableDivider(CY_SYSCLK_DIV_16_BIT, TIMER_CLK_DIV_NUM);
+    clk_status |= Cy_SysClk_PeriphSetDivider(CY_SYSCLK_DIV_16_BIT, TIMER_CLK_DIV_NUM,
+            (Cy_SysClk_ClkPeriGetFrequency() / TIMER_TICK_HZ) - 1u);
+    clk_status |= Cy_SysClk_PeriphEnableDivider(CY_SYSCLK_DIV_16_BIT, TIMER_CLK_DIV_NUM);
+    clk_status |= Cy_SysClk_PeriphAssignDivider(TIMER_CLK_DST, CY_SYSCLK_DIV_16_BIT, TIMER_CLK_DIV_NUM);
+    clk_status |= Cy_SysClk_PeriphAssignDivider(TIMER_CLOCK_CLK_DST, CY_SYSCLK_DIV_16_BIT, TIMER_CLK_DIV_NUM);
+    if (clk_status != CY_SYSCLK_SUCCESS)
+        return INIT_FAILURE;
+
+    if (Cy_TCPWM_Counter_Init(TIMER_HW, TIMER_CNT_NUM, &timer_config) != CY_TCPWM_SUCCESS)
+        return INIT_FAILURE;
+    Cy_TCPWM_Counter_Enable(TIMER_HW, TIMER_CNT_NUM);
+    if (Cy_TCPWM_Counter_Init(TIMER_HW, TIMER_CLOCK_CNT_NUM, &clock_config) != CY_TCPWM_SUCCESS)
+        return INIT_FAILURE;
+    Cy_TCPWM_Counter_Enable(TIMER_HW, TIMER_CLOCK_CNT_NUM);
+
+    memset(channels, 0, sizeof(channels));
+    segment_ticks = 0;
+
+    /* Initialize and enable the interrupt from the timer */
+    Cy_SysInt_Init(&timer_int_cfg, &timer_complete);
+    NVIC_EnableIRQ(timer_int_cfg.intrSrc);
+
+    clock_wraps = 0;
+    Cy_SysInt_Init(&clock_int_cfg, &timer_clock_wrap);
+    NVIC_EnableIRQ(clock_int_cfg.intrSrc);
+    Cy_TCPWM_TriggerStart(TIMER_HW, TIMER_CLOCK_CNT_MASK);
+
+    return INIT_SUCCESS;
+}
+
+/******************************************************************************
+* Function Name: timer_start
+*******************************************************************************
+*
+* Summary:
+*  Call cb from the timer interrupt after delay_us. Restarts the channel if
+*  it is already running; the other channels keep their delays, the counter
+*  always runs up to the nearest one.
+*
+* Parameters:
+*  channel: channel of the delay, below TIMER_CHANNELS
+*  delay_us: delay in microseconds
+*  cb: callback executed when the delay has expired
+*
+* Return:
+*  None
+*
+******************************************************************************/
+void timer_start(uint32_t channel, uint32_t delay_us, callback_timer cb)
+{
+    uint32_t intr = Cy_SysLib_EnterCriticalSection();
+
+    timer_sync();
+    channels[channel].cb = cb;
+    channels[channel].remaining = (delay_us == 0u) ? 1u : delay_us;
+    channels[channel].running = true;
+    timer_arm();
+    Cy_SysLib_ExitCriticalSection(intr);
+}
+
+/******************************************************************************
+* Function Name: timer_stop
+*******************************************************************************
+*
+* Summary:
+*  Cancel a pending delay. Its callback is not called.
+*
+* Parameters:
+*  channel: channel of the delay
+*
+* Return:
+*  (uint32_t) Microseconds the delay had left, 0 if it was not pending.
+*
+******************************************************************************/
+uint32_t timer_stop(uint32_t channel)
+{
+    uint32_t intr = Cy_SysLib_EnterCriticalSection();
+    uint32_t remaining;
+
+    timer_sync();
+    remaining = channels[channel].running ? channels[channel].remaining : 0u;
+    channels[channel].running = false;
+    timer_arm();
+    Cy_SysLib_ExitCriticalSection(intr);
+    return remaining;
+}
+
+/******************************************************************************
+* Function Name: timer_running
+*******************************************************************************
+*
+* Summary:
+*  Return whether a delay is pending.
+*
+* Parameters:
+*  channel: channel of the delay
+*
+* Return:
+*  (bool) true if a delay is pending, false otherwise.
+*
+******************************************************************************/
+bool timer_running(uint32_t channel)
+{
+    return channels[channel].running;
+}
+
+/******************************************************************************
+* Function Name: timer_now
+*******************************************************************************
+*
+* Summary:
+*  Current time in microseconds; wraps after about 71 minutes, so only
+*  differences are meaningful. A wrap whose interrupt is still pending, for
+*  instance while the DMA interrupt is running, is accounted for here.
+*
+* Parameters:
+*  None
+*
+* Return:
+*  (uint32_t) Timestamp in microseconds.
+*
+******************************************************************************/
+uint32_t timer_now(void)
+{
+    uint32_t intr = Cy_SysLib_EnterCriticalSection();
+    uint32_t wraps = clock_wraps;
+    uint32_t count = Cy_TCPWM_Counter_GetCounter(TIMER_HW, TIMER_CLOCK_CNT_NUM);
+
+    if ((Cy_TCPWM_GetInterruptStatusMasked(TIMER_HW, TIMER_CLOCK_CNT_NUM) & CY_TCPWM_INT_ON_TC) != 0u)
+    {
+        /* Read again: count may be from before the wrap */
+        wraps++;
+        count = Cy_TCPWM_Counter_GetCounter(TIMER_HW, TIMER_CLOCK_CNT_NUM);
+    }
+    Cy_SysLib_ExitCriticalSection(intr);
+    return (wraps << TIMER_CLOCK_BITS) | count;
+}
+
+/******************************************************************************
+* Function Name: timer_clock_wrap
+*******************************************************************************
+*
+* Summary:
+*  Interrupt at the terminal count of the counter of timer_now.
+*
+******************************************************************************/
+static void timer_clock_wrap(void)
+{
+    Cy_TCPWM_ClearInterrupt(TIMER_HW, TIMER_CLOCK_CNT_NUM, CY_TCPWM_INT_ON_TC);
+    clock_wraps++;
+}
+
+/******************************************************************************
+* Function Name: timer_sync
+*******************************************************************************
+*
+* Summary:
+*  Stop the counter and deduct the ticks of the segment elapsed so far from
+*  all pending delays.
+*
+******************************************************************************/
+static void timer_sync(void)
+{
+    uint32_t elapsed;
+
+    if (segment_ticks == 0u)
+    {
+        return;
+    }
+    Cy_TCPWM_TriggerStopOrKill(TIMER_HW, TIMER_CNT_MASK);
+    elapsed = Cy_TCPWM_Counter_GetCounter(TIMER_HW, TIMER_CNT_NUM);
+    if (((Cy_TCPWM_GetInterruptStatusMasked(TIMER_HW, TIMER_CNT_NUM) & CY_TCPWM_INT_ON_TC) != 0u) ||
+        (elapsed > segment_ticks))
+    {
+        elapsed = segment_ticks;
+    }
+    Cy_TCPWM_ClearInterrupt(TIMER_HW, TIMER_CNT_NUM, CY_TCPWM_INT_ON_TC);
+
+    for (uint32_t i = 0; i < TIMER_CHANNELS; i++)
+    {
+        if (channels[i].running)
+        {
+            channels[i].remaining -= (elapsed < channels[i].remaining) ? elapsed : channels[i].remaining;
+        }
+    }
+    segment_ticks = 0;
+}
+
+/******************************************************************************
+* Function Name: timer_arm
+*******************************************************************************
+*
+* Summary:
+*  Run the counter up to the nearest pending delay, at most TIMER_MAX_TICKS.
+*  A delay that has already expired gets the shortest segment, so that its
+*  callback is still called from the interrupt.
+*
+******************************************************************************/
+static void timer_arm(void)
+{
+    uint32_t ticks = UINT32_MAX;
+
+    for (uint32_t i = 0; i < TIMER_CHANNELS; i++)
+    {
+        if (channels[i].running && (channels[i].remaining < ticks))
+        {
+            ticks = channels[i].remaining;
+        }
+    }
+    if (ticks == UINT32_MAX)
+    {
+        return;
+    }
+    if (ticks == 0u)
+    {
+        ticks = 1u;
+    }
+    if (ticks > TIMER_MAX_TICKS)
+    {
+        ticks = TIMER_MAX_TICKS;
+    }
+
+    segment_ticks = ticks;
+    Cy_TCPWM_Counter_SetCounter(TIMER_HW, TIMER_CNT_NUM, 0u);
+    Cy_TCPWM_Counter_SetPeriod(TIMER_HW, TIMER_CNT_NUM, ticks);
+    Cy_TCPWM_TriggerStart(TIMER_HW, TIMER_CNT_MASK);
+}
+
+/******************************************************************************
+* Function Name: timer_complete
+*******************************************************************************
+*
+* Summary:
+*  Interrupt on terminal count. Calls the callbacks of all delays that have
+*  expired, then starts the next segment for the remaining ones.
+*
+* Parameters:
+*  None
+*
+* Return:
+*  None
+*
+******************************************************************************/
+static void timer_complete(void)
+{
+    if ((Cy_TCPWM_GetInterruptStatusMasked(TIMER_HW, TIMER_CNT_NUM) & CY_TCPWM_INT_ON_TC) == 0u)
+    {
+        return;
+    }
+    timer_sync();
+
+    for (uint32_t i = 0; i < TIMER_CHANNELS; i++)
+    {
+        if (channels[i].running && (channels[i].remaining == 0u))
+        {
+            channels[i].running = false;
+            if (channels[i].cb != NULL)
+            {
+                /* May start this or another channel again */
+                channels[i].cb(i);
+            }
+        }
+    }
+    timer_sync();
+    timer_arm();
+}
+
+/* [] END OF FILE */
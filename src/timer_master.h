@@ -0,0 +1,108 @@
+/******************************************************************************
+ * File Name: timer_master.h
+ *
+ * Description: Header file for the TCPWM timer used to schedule delayed work
+ *              from interrupt context.
+ *
+ * Related Document: See README.md
+ *
+ *******************************************************************************
+ * Copyright 2023, Cypress Semiconductor Corporation (an Infineon company) or
+ * an affiliate of Cypress Semiconductor Corporation.  All rights reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software") is owned by Cypress Semiconductor Corporation
+ * or one of its affiliates ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products.  Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ *******************************************************************************/
+
+
+
+#ifndef SOURCE_TIMER_MASTER_H_
+#define SOURCE_TIMER_MASTER_H_
+
+/*******************************************************************************
+ * Include header files
+ ******************************************************************************/
+#include "cy_pdl.h"
+#include "cycfg.h"
+#include "status.h"
+
+/*******************************************************************************
+* Macros
+********************************************************************************/
+/* TCPWM counter used as one-shot timer */
+#define TIMER_HW                  (TCPWM)
+#define TIMER_CNT_NUM             (0u)
+#define TIMER_CNT_MASK            (1UL << TIMER_CNT_NUM)
+#define TIMER_IRQ                 (tcpwm_interrupts_0_IRQn)
+
+/* Same priority as the DMA interrupt, so the handlers never preempt each other */
+#define TIMER_INT_PRIORITY        (3u)
+
+/* 16-bit peripheral divider clocking the counter (divider 0 is CYBSP_CLK_SPI) */
+#define TIMER_CLK_DST             (PCLK_TCPWM_CLOCKS0)
+#define TIMER_CLK_DIV_NUM         (1u)
+
+/* Counter clock: one tick per microsecond */
+#define TIMER_TICK_HZ             (1000000u)
+
+/* Longest period of the 16-bit counter; longer delays are chained */
+#define TIMER_MAX_TICKS           (0xFFFFu)
+
+/* TCPWM counter running free on the same clock as time base of timer_now;
+ * the interrupt at each wrap extends it to 32 bits */
+#define TIMER_CLOCK_CNT_NUM       (1u)
+#define TIMER_CLOCK_CNT_MASK      (1UL << TIMER_CLOCK_CNT_NUM)
+#define TIMER_CLOCK_IRQ           (tcpwm_interrupts_1_IRQn)
+#define TIMER_CLOCK_CLK_DST       (PCLK_TCPWM_CLOCKS1)
+#define TIMER_CLOCK_BITS          (16u)
+
+/* Delays pending at the same time, each with its own callback: one per
+ * EEPROM device for its WIP polls and one for the SPI bus */
+#ifndef TIMER_CHANNELS
+#define TIMER_CHANNELS            (5u)
+#endif
+
+/******************************************************************************
+ * Structure/Enum type declaration
+ ******************************************************************************/
+/* Type for callback function executed as part of the timer interrupt after
+ * the delay has expired. */
+typedef void (*callback_timer)(uint32_t channel);
+
+/******************************************************************************
+ * Global function declaration
+ ******************************************************************************/
+uint32_t timer_init(void);
+void timer_start(uint32_t channel, uint32_t delay_us, callback_timer cb);
+uint32_t timer_stop(uint32_t channel);
+bool timer_running(uint32_t channel);
+uint32_t timer_now(void);
+
+#endif /* SOURCE_TIMER_MASTER_H_ */
+
+/* [] END OF FILE */